@@ -0,0 +1,203 @@
+#include "ATrousFilter.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// Annonymous namespace to hold variables/helpers
+// only accessible in this file
+namespace
+{
+	// Rows per job for each pass
+	const unsigned int RowsPerJob = 16;
+
+	// B3 spline kernel, applied along both axes
+	const float Kernel[5] = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+
+	// Darkest albedo the color is divided by, so black
+	// surfaces don't blow up their (specular) lighting
+	const float MinAlbedo = 0.01f;
+
+	// Keeps the luminance weight finite for noise free pixels
+	const float LuminanceEpsilon = 1e-6f;
+
+	float Luminance(float r, float g, float b)
+	{
+		return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+	}
+
+	FilterFloat3 DemodulationAlbedo(const FilterFloat4& albedo)
+	{
+		return FilterFloat3{
+			std::max(albedo.x, MinAlbedo),
+			std::max(albedo.y, MinAlbedo),
+			std::max(albedo.z, MinAlbedo) };
+	}
+
+	// --------------------------------------------------------
+	// Variance around a pixel, blurred with a 3x3 gaussian as
+	// in SVGF - a few samples often all agree by chance, and
+	// a variance of zero would stop the pixel being filtered
+	// --------------------------------------------------------
+	float BlurredVariance(const std::vector<FilterFloat4>& source, unsigned int width, unsigned int height, int x, int y)
+	{
+		const float Gaussian[2] = { 1.0f / 2, 1.0f / 4 };
+		float variance = 0;
+		float weightSum = 0;
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				int tapX = x + dx;
+				int tapY = y + dy;
+				if (tapX < 0 || tapY < 0 || tapX >= (int)width || tapY >= (int)height)
+					continue;
+
+				float weight = Gaussian[std::abs(dx)] * Gaussian[std::abs(dy)];
+				variance += source[(size_t)tapY * width + tapX].w * weight;
+				weightSum += weight;
+			}
+		}
+		return variance / weightSum;
+	}
+
+	// Averaged normals aren't unit length, and the sky's is zero
+	FilterFloat3 UnitNormal(const FilterFloat4& normalDepth)
+	{
+		float length = std::sqrt(normalDepth.x * normalDepth.x + normalDepth.y * normalDepth.y + normalDepth.z * normalDepth.z);
+		if (length <= 0)
+			return FilterFloat3{ 0, 0, 0 };
+		return FilterFloat3{ normalDepth.x / length, normalDepth.y / length, normalDepth.z / length };
+	}
+
+	// --------------------------------------------------------
+	// Illumination (color divided by albedo) with the variance
+	// of its luminance in w.  The moments are of the color's
+	// luminance, so their variance is scaled by the albedo's.
+	// --------------------------------------------------------
+	FilterFloat4 Demodulate(const ATrousFilter::Frame& frame, size_t index)
+	{
+		FilterFloat3 albedo = DemodulationAlbedo(frame.Albedo[index]);
+		const FilterFloat4& color = frame.Color[index];
+		const FilterFloat2& moments = frame.Moments[index];
+
+		float albedoLuminance = Luminance(albedo.x, albedo.y, albedo.z);
+		float sampleVariance = std::max(moments.y - moments.x * moments.x, 0.0f);
+		float variance = sampleVariance / std::max(color.w, 1.0f) / (albedoLuminance * albedoLuminance);
+		return FilterFloat4{ color.x / albedo.x, color.y / albedo.y, color.z / albedo.z, variance };
+	}
+
+	// --------------------------------------------------------
+	// One pass of the filter over illumination and its
+	// variance, matching Denoise.hlsl tap for tap
+	// --------------------------------------------------------
+	void FilterPass(
+		const ATrousFilter::Frame& frame,
+		const ATrousSettings& settings,
+		const std::vector<FilterFloat3>& normals,
+		unsigned int pass,
+		const std::vector<FilterFloat4>& source,
+		std::vector<FilterFloat4>& destination)
+	{
+		int step = 1 << pass;
+
+		JobSystem::ParallelFor(frame.Height, RowsPerJob, [&](unsigned int begin, unsigned int end)
+			{
+				for (unsigned int y = begin; y < end; y++)
+				{
+					for (unsigned int x = 0; x < frame.Width; x++)
+					{
+						size_t index = (size_t)y * frame.Width + x;
+						FilterFloat4 center = source[index];
+						FilterFloat3 normal = normals[index];
+						float depth = frame.NormalDepth[index].w;
+
+						// The sky is already noise free
+						if (normal.x == 0 && normal.y == 0 && normal.z == 0)
+						{
+							destination[index] = center;
+							continue;
+						}
+
+						float luminance = Luminance(center.x, center.y, center.z);
+						float luminanceScale = settings.LuminancePhi * std::sqrt(BlurredVariance(source, frame.Width, frame.Height, x, y)) + LuminanceEpsilon;
+
+						FilterFloat3 sum{ 0, 0, 0 };
+						float varianceSum = 0;
+						float weightSum = 0;
+						for (int dy = -2; dy <= 2; dy++)
+						{
+							for (int dx = -2; dx <= 2; dx++)
+							{
+								int tapX = (int)x + dx * step;
+								int tapY = (int)y + dy * step;
+								if (tapX < 0 || tapY < 0 || tapX >= (int)frame.Width || tapY >= (int)frame.Height)
+									continue;
+
+								size_t tapIndex = (size_t)tapY * frame.Width + tapX;
+								FilterFloat4 color = source[tapIndex];
+								FilterFloat3 tapNormal = normals[tapIndex];
+								float tapDepth = frame.NormalDepth[tapIndex].w;
+
+								float cosine = normal.x * tapNormal.x + normal.y * tapNormal.y + normal.z * tapNormal.z;
+								float normalWeight = std::pow(std::max(cosine, 0.0f), settings.NormalPhi);
+
+								float pixelDistance = std::sqrt((float)(dx * dx + dy * dy)) * step;
+								float depthWeight = std::exp(-std::abs(depth - tapDepth) / (settings.DepthPhi * depth * pixelDistance + 1e-6f));
+
+								float luminanceWeight = std::exp(-std::abs(luminance - Luminance(color.x, color.y, color.z)) / luminanceScale);
+
+								float weight = Kernel[dx + 2] * Kernel[dy + 2] * normalWeight * depthWeight * luminanceWeight;
+								sum.x += color.x * weight;
+								sum.y += color.y * weight;
+								sum.z += color.z * weight;
+								varianceSum += color.w * weight * weight;
+								weightSum += weight;
+							}
+						}
+
+						destination[index] = weightSum > 0 ?
+							FilterFloat4{ sum.x / weightSum, sum.y / weightSum, sum.z / weightSum, varianceSum / (weightSum * weightSum) } :
+							center;
+					}
+				}
+			});
+	}
+}
+
+void ATrousFilter::Filter(const Frame& frame, const ATrousSettings& settings, std::vector<FilterFloat3>& output)
+{
+	size_t pixelCount = (size_t)frame.Width * frame.Height;
+	output.resize(pixelCount);
+	if (pixelCount == 0)
+		return;
+
+	unsigned int iterations = settings.Enabled ? settings.Iterations : 0;
+
+	// Filter the illumination, ping-ponging between two buffers
+	std::vector<FilterFloat4> filtered[2];
+	filtered[0].resize(pixelCount);
+	std::vector<FilterFloat3> normals(pixelCount);
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		filtered[0][i] = Demodulate(frame, i);
+		normals[i] = UnitNormal(frame.NormalDepth[i]);
+	}
+
+	if (iterations > 0)
+		filtered[1].resize(pixelCount);
+	for (unsigned int pass = 0; pass < iterations; pass++)
+		FilterPass(frame, settings, normals, pass, filtered[pass % 2], filtered[(pass + 1) % 2]);
+
+	// Put the albedo back, and gamma encode like the shader's output
+	const std::vector<FilterFloat4>& result = filtered[iterations % 2];
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		FilterFloat3 albedo = DemodulationAlbedo(frame.Albedo[i]);
+		output[i] = FilterFloat3{
+			std::pow(std::max(result[i].x * albedo.x, 0.0f), 1.0f / 2.2f),
+			std::pow(std::max(result[i].y * albedo.y, 0.0f), 1.0f / 2.2f),
+			std::pow(std::max(result[i].z * albedo.z, 0.0f), 1.0f / 2.2f) };
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+
+// Plain vectors, so the filters don't depend on DirectXMath
+// (laid out the same as XMFLOAT2/3/4, so read back textures
+// can be passed straight in)
+struct FilterFloat2
+{
+	float x = 0;
+	float y = 0;
+};
+
+struct FilterFloat3
+{
+	float x = 0;
+	float y = 0;
+	float z = 0;
+};
+
+struct FilterFloat4
+{
+	float x = 0;
+	float y = 0;
+	float z = 0;
+	float w = 0;
+};
+
+struct ATrousSettings
+{
+	bool Enabled = true;
+	unsigned int Iterations = 4;		// Passes, each with twice the spacing of the last (0 = off)
+	float LuminancePhi = 4.0f;			// Luminance difference neighbors may have, in standard deviations
+	float NormalPhi = 128.0f;			// Power on the cosine between normals
+	float DepthPhi = 0.01f;				// Relative hit distance difference per pixel of offset
+};
+
+// --------------------------------------------------------
+// Edge-avoiding a-trous wavelet filter (Dammertz et al.,
+// "Edge-Avoiding A-Trous Wavelet Transform for fast Global
+// Illumination Filtering", 2010), for denoising the path
+// traced image.
+//
+// Each pass blurs with a 5x5 B3 spline kernel whose taps
+// are spread 2^pass pixels apart, so a few passes cover
+// a wide area at the cost of 25 taps each.  Every tap is
+// weighted down when its normal, hit distance or luminance
+// differs from the center's, so edges stay sharp.
+//
+// How much luminance may differ depends on how noisy the
+// pixel is, as in SVGF (Schied et al., "Spatiotemporal
+// Variance-Guided Filtering", 2017): the variance of each
+// pixel's mean comes from the luminance moments kept for
+// adaptive sampling, and is filtered along with the color
+// so later passes trust the smoother result more.  (A
+// fixed color threshold either keeps low sample count
+// noise or blurs over real lighting changes.)
+//
+// The other weights use the G-buffer the path tracer keeps
+// alongside the accumulated color:
+//  - Normal: world space normal at the first hit, with
+//    the hit distance in w (all zero for the sky, which
+//    is never blurred into anything)
+//  - Albedo: surface color at the first hit (one for
+//    the sky)
+// Both are averaged over the same samples as the color.
+// The color is divided by the albedo before filtering and
+// multiplied back afterwards, so textures aren't blurred
+// along with the noise.
+//
+// The filter is implemented here on the CPU as a reference
+// for the shader (and tested on known images), with rows
+// filtered in parallel on the job system.
+//
+// Nothing here knows about D3D12.
+// --------------------------------------------------------
+namespace ATrousFilter
+{
+	// Inputs, one entry per pixel, row by row
+	struct Frame
+	{
+		unsigned int Width = 0;
+		unsigned int Height = 0;
+		const FilterFloat4* Color = 0;			// Accumulated linear color (sample count in w)
+		const FilterFloat2* Moments = 0;		// Mean luminance and luminance squared
+		const FilterFloat4* NormalDepth = 0;
+		const FilterFloat4* Albedo = 0;
+	};
+
+	// Filters the frame, writing the gamma encoded colors the
+	// shader writes to the output (before it's quantized)
+	void Filter(const Frame& frame, const ATrousSettings& settings, std::vector<FilterFloat3>& output);
+}
@@ -0,0 +1,90 @@
+#include "AccelerationStructureMemory.h"
+
+// --------------------------------------------------------
+// Starts tracking a newly built BLAS
+// --------------------------------------------------------
+unsigned int AccelerationStructureMemory::AddBLAS(uint64_t builtSizeInBytes)
+{
+	blasRecords.push_back({ builtSizeInBytes, builtSizeInBytes });
+
+	stats.BLASCount++;
+	stats.BLASBytesBeforeCompaction += builtSizeInBytes;
+	stats.BLASBytes += builtSizeInBytes;
+
+	return (unsigned int)(blasRecords.size() - 1);
+}
+
+// --------------------------------------------------------
+// Swaps a BLAS's size for its compacted size, assuming the
+// compacted version is actually smaller.  The original's
+// size is pending release until the copy is done.
+//
+// index                - Index returned by AddBLAS()
+// compactedSizeInBytes - Size of the compacted copy
+// releaseFenceValue    - Fence value reached once the GPU is
+//                        done copying from the original
+// --------------------------------------------------------
+bool AccelerationStructureMemory::CompactBLAS(unsigned int index, uint64_t compactedSizeInBytes, uint64_t releaseFenceValue)
+{
+	if (index >= blasRecords.size())
+		return false;
+
+	// Already compacted, or no savings?
+	BLASRecord& record = blasRecords[index];
+	if (record.CurrentSize != record.BuiltSize ||
+		compactedSizeInBytes == 0 ||
+		compactedSizeInBytes >= record.BuiltSize)
+		return false;
+
+	AddPendingRelease(record.CurrentSize, releaseFenceValue);
+	stats.BLASBytes -= record.CurrentSize;
+	stats.BLASBytes += compactedSizeInBytes;
+	stats.CompactedBLASCount++;
+	record.CurrentSize = compactedSizeInBytes;
+	return true;
+}
+
+// --------------------------------------------------------
+// Records a new TLAS buffer.  The previous one (if any) is
+// pending release until the given fence value is reached.
+// --------------------------------------------------------
+void AccelerationStructureMemory::SetTLASSize(uint64_t sizeInBytes, uint64_t releaseFenceValue)
+{
+	AddPendingRelease(stats.TLASBytes, releaseFenceValue);
+	stats.TLASBytes = sizeInBytes;
+}
+
+// --------------------------------------------------------
+// Stops counting every replaced structure whose fence value
+// is less than or equal to the given completed value
+// --------------------------------------------------------
+void AccelerationStructureMemory::Retire(uint64_t completedFenceValue)
+{
+	while (!pendingReleases.empty() && pendingReleases.front().FenceValue <= completedFenceValue)
+	{
+		stats.PendingReleaseBytes -= pendingReleases.front().Size;
+		pendingReleases.pop_front();
+	}
+}
+
+void AccelerationStructureMemory::Clear()
+{
+	blasRecords.clear();
+	pendingReleases.clear();
+	stats = {};
+}
+
+AccelerationStructureMemoryStats AccelerationStructureMemory::GetStats() { return stats; }
+
+// --------------------------------------------------------
+// Fence values must be non-decreasing, as they are when they
+// all come from the frame fence
+// --------------------------------------------------------
+void AccelerationStructureMemory::AddPendingRelease(uint64_t sizeInBytes, uint64_t fenceValue)
+{
+	if (sizeInBytes == 0)
+		return;
+
+	pendingReleases.push_back({ fenceValue, sizeInBytes });
+	stats.PendingReleaseBytes += sizeInBytes;
+}
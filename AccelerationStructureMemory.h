@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Memory usage of all acceleration structures
+struct AccelerationStructureMemoryStats
+{
+	uint64_t BLASCount = 0;
+	uint64_t CompactedBLASCount = 0;
+	uint64_t BLASBytesBeforeCompaction = 0;	// Sum of each BLAS's original (build) size
+	uint64_t BLASBytes = 0;					// Sum of each BLAS's current size
+	uint64_t TLASBytes = 0;
+	uint64_t PendingReleaseBytes = 0;		// Replaced structures the GPU may still be using
+
+	// Before and after compaction, including the TLAS
+	uint64_t TotalBytesBeforeCompaction() const { return BLASBytesBeforeCompaction + TLASBytes; }
+	uint64_t TotalBytes() const { return BLASBytes + TLASBytes; }
+
+	// Everything still in memory, including what's waiting to be released
+	uint64_t ResidentBytes() const { return TotalBytes() + PendingReleaseBytes; }
+};
+
+// --------------------------------------------------------
+// Keeps track of how much memory each acceleration
+// structure is using, both as originally built and after
+// any compaction.  Only sizes are tracked here, so this
+// knows nothing about D3D12.
+//
+// A structure that's replaced (the original of a compacted
+// BLAS, or a TLAS that was too small) stays in memory until
+// the GPU finishes the frame that replaced it.  Its size is
+// counted as pending release until Retire() is called with
+// that frame's fence value, matching when the resource
+// itself is actually released.
+// --------------------------------------------------------
+class AccelerationStructureMemory
+{
+public:
+	static const unsigned int InvalidIndex = UINT32_MAX;
+
+	// Returns the index used to refer to this BLAS later
+	unsigned int AddBLAS(uint64_t builtSizeInBytes);
+
+	// Records a BLAS being replaced by a compacted copy.  Returns
+	// false (and changes nothing) if the compacted copy wouldn't
+	// actually be any smaller, in which case it isn't worth it.
+	bool CompactBLAS(unsigned int index, uint64_t compactedSizeInBytes, uint64_t releaseFenceValue);
+
+	// Records the TLAS being (re)created, replacing any previous one
+	void SetTLASSize(uint64_t sizeInBytes, uint64_t releaseFenceValue);
+
+	// Stops counting replaced structures once their fence is reached
+	void Retire(uint64_t completedFenceValue);
+	void Clear();
+
+	AccelerationStructureMemoryStats GetStats();
+
+private:
+	struct BLASRecord
+	{
+		uint64_t BuiltSize;
+		uint64_t CurrentSize;
+	};
+
+	struct PendingRelease
+	{
+		uint64_t FenceValue;
+		uint64_t Size;
+	};
+
+	std::vector<BLASRecord> blasRecords;
+	std::deque<PendingRelease> pendingReleases;
+	AccelerationStructureMemoryStats stats;
+
+	void AddPendingRelease(uint64_t sizeInBytes, uint64_t fenceValue);
+};
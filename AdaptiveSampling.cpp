@@ -0,0 +1,168 @@
+#include "AdaptiveSampling.h"
+
+#include <algorithm>
+#include <cmath>
+
+AdaptiveSampler::AdaptiveSampler() :
+	pixelCount(0),
+	lastActivePixels(0),
+	lastSamplesTraced(0),
+	hasFeedback(false)
+{
+}
+
+void AdaptiveSampler::SetSettings(const AdaptiveSamplingSettings& settings)
+{
+	this->settings = settings;
+	this->settings.MinSamples = std::max(settings.MinSamples, 1u);
+	this->settings.MaxSamplesPerPixelPerFrame = std::max(settings.MaxSamplesPerPixelPerFrame, 1u);
+	this->settings.RayBudgetPerPixel = std::max(settings.RayBudgetPerPixel, 0.0f);
+}
+
+const AdaptiveSamplingSettings& AdaptiveSampler::GetSettings() const { return settings; }
+
+// --------------------------------------------------------
+// A new resolution means all pixels start over, so assume
+// they're all active until told otherwise
+// --------------------------------------------------------
+void AdaptiveSampler::SetPixelCount(uint64_t pixelCount)
+{
+	this->pixelCount = pixelCount;
+	lastActivePixels = pixelCount;
+	lastSamplesTraced = 0;
+	hasFeedback = false;
+}
+
+uint64_t AdaptiveSampler::GetPixelCount() const { return pixelCount; }
+
+void AdaptiveSampler::RecordFrame(uint64_t activePixels, uint64_t samplesTraced)
+{
+	lastActivePixels = activePixels;
+	lastSamplesTraced = samplesTraced;
+	hasFeedback = true;
+}
+
+uint64_t AdaptiveSampler::GetRayBudget() const
+{
+	return (uint64_t)(pixelCount * (double)settings.RayBudgetPerPixel);
+}
+
+// --------------------------------------------------------
+// Every pixel was below the threshold in the latest frame
+// (since the last restart), so there's nothing left to trace
+// --------------------------------------------------------
+bool AdaptiveSampler::IsConverged() const
+{
+	return settings.Enabled && hasFeedback && lastActivePixels == 0;
+}
+
+// --------------------------------------------------------
+// Shares the budget out evenly over the active pixels of
+// the latest finished frame.  Converging usually only ever
+// shrinks that count, so it makes a good prediction.
+// --------------------------------------------------------
+AdaptiveSampleAllocation AdaptiveSampler::GetAllocation() const
+{
+	AdaptiveSampleAllocation allocation;
+	allocation.SamplesPerActivePixel = settings.MaxSamplesPerPixelPerFrame;
+	if (!settings.Enabled)
+		return allocation;
+
+	uint64_t activePixels = hasFeedback ? lastActivePixels : pixelCount;
+	if (activePixels == 0)
+		return allocation;
+
+	uint64_t budget = std::max(GetRayBudget(), (uint64_t)1);
+	uint64_t samplesPerPixel = budget / activePixels;
+	allocation.SamplesPerActivePixel = (unsigned int)std::clamp(samplesPerPixel, (uint64_t)1, (uint64_t)settings.MaxSamplesPerPixelPerFrame);
+
+	// Not enough for one sample each?  Trace a random subset.
+	if (samplesPerPixel == 0)
+		allocation.ActivePixelFraction = (float)((double)budget / (double)activePixels);
+
+	return allocation;
+}
+
+uint64_t AdaptiveSampler::GetLastActivePixelCount() const { return lastActivePixels; }
+uint64_t AdaptiveSampler::GetLastSampleCount() const { return lastSamplesTraced; }
+
+// --------------------------------------------------------
+// Standard error of the mean luminance, relative to the
+// mean itself so dark and bright pixels are judged alike.
+// A small floor keeps near-black pixels from looking
+// infinitely noisy.
+// --------------------------------------------------------
+float AdaptiveSampler::RelativeError(const PixelMoments& pixel)
+{
+	if (pixel.SampleCount <= 1)
+		return INFINITY;
+
+	float variance = std::max(pixel.MeanLuminanceSquared - pixel.MeanLuminance * pixel.MeanLuminance, 0.0f);
+	float standardError = std::sqrt(variance / pixel.SampleCount);
+	return standardError / std::max(pixel.MeanLuminance, 0.01f);
+}
+
+bool AdaptiveSampler::IsActive(const PixelMoments& pixel, const AdaptiveSamplingSettings& settings)
+{
+	if (!settings.Enabled || pixel.SampleCount < settings.MinSamples)
+		return true;
+
+	return RelativeError(pixel) > settings.ErrorThreshold;
+}
+
+// --------------------------------------------------------
+// The most samples this pixel may trace this frame.  (The
+// shader can still stop early, once the samples it has
+// just traced bring the error below the threshold.)
+// Pixels without any samples are always traced, so the
+// image never has holes.
+// --------------------------------------------------------
+unsigned int AdaptiveSampler::SamplesForPixel(
+	const PixelMoments& pixel,
+	unsigned int pixelX, unsigned int pixelY, unsigned int frameIndex,
+	const AdaptiveSamplingSettings& settings,
+	const AdaptiveSampleAllocation& allocation)
+{
+	if (!IsActive(pixel, settings))
+		return 0;
+
+	if (pixel.SampleCount > 0 && PixelHash01(pixelX, pixelY, frameIndex) >= allocation.ActivePixelFraction)
+		return 0;
+
+	return allocation.SamplesPerActivePixel;
+}
+
+// --------------------------------------------------------
+// A cheap integer hash mapped to [0, 1), identical to the
+// one in the shader
+// --------------------------------------------------------
+float AdaptiveSampler::PixelHash01(unsigned int pixelX, unsigned int pixelY, unsigned int frameIndex)
+{
+	uint32_t h = pixelX * 1973u + pixelY * 9277u + frameIndex * 26699u;
+	h = (h ^ 61u) ^ (h >> 16);
+	h *= 9u;
+	h ^= h >> 4;
+	h *= 0x27d4eb2du;
+	h ^= h >> 15;
+	return (float)(h >> 8) / 16777216.0f;
+}
+
+uint64_t AdaptiveSampler::AllocateImage(
+	const std::vector<PixelMoments>& pixels,
+	unsigned int width, unsigned int frameIndex,
+	const AdaptiveSamplingSettings& settings,
+	const AdaptiveSampleAllocation& allocation,
+	std::vector<unsigned int>& samplesOut)
+{
+	samplesOut.resize(pixels.size());
+
+	uint64_t total = 0;
+	for (size_t i = 0; i < pixels.size(); i++)
+	{
+		unsigned int x = width ? (unsigned int)(i % width) : 0;
+		unsigned int y = width ? (unsigned int)(i / width) : 0;
+		samplesOut[i] = SamplesForPixel(pixels[i], x, y, frameIndex, settings, allocation);
+		total += samplesOut[i];
+	}
+	return total;
+}
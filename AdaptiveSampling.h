@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct AdaptiveSamplingSettings
+{
+	bool Enabled = true;
+	float ErrorThreshold = 0.02f;			// Relative standard error of a pixel's mean luminance
+	unsigned int MinSamples = 4;			// Before the variance estimate is trusted
+	unsigned int MaxSamplesPerPixelPerFrame = 8;
+	float RayBudgetPerPixel = 1.0f;			// Average samples per pixel per frame, across the whole image
+};
+
+// What's known about one pixel's samples so far
+struct PixelMoments
+{
+	float MeanLuminance = 0;
+	float MeanLuminanceSquared = 0;
+	float SampleCount = 0;
+};
+
+// How the budget is spread over pixels that still need samples
+struct AdaptiveSampleAllocation
+{
+	unsigned int SamplesPerActivePixel = 1;
+	float ActivePixelFraction = 1.0f;		// Chance an active pixel is traced at all this frame
+};
+
+// --------------------------------------------------------
+// Decides how many samples each pixel gets per frame, so
+// pixels that have already converged (like flat sky) stop
+// costing rays and the rest get more.
+//
+// A pixel is active while it has fewer than MinSamples
+// samples or its estimated error is above the threshold.
+// The shader applies that test per pixel, using luminance
+// moments it keeps alongside the accumulated color, and
+// counts how many pixels were active.  That count comes
+// back a few frames later and sets how the per-frame ray
+// budget is shared out: more samples per active pixel when
+// few are active, and only a fraction of them traced when
+// there are more active pixels than the budget allows.
+//
+// The per-pixel policy is also implemented here, on the
+// CPU, as a reference for the shader.
+//
+// Nothing here knows about D3D12.
+// --------------------------------------------------------
+class AdaptiveSampler
+{
+public:
+	AdaptiveSampler();
+
+	void SetSettings(const AdaptiveSamplingSettings& settings);
+	const AdaptiveSamplingSettings& GetSettings() const;
+	void SetPixelCount(uint64_t pixelCount);
+	uint64_t GetPixelCount() const;
+
+	// Feedback from the GPU, for a frame that has finished
+	void RecordFrame(uint64_t activePixels, uint64_t samplesTraced);
+
+	// How to spread the budget over the next frame
+	AdaptiveSampleAllocation GetAllocation() const;
+	uint64_t GetRayBudget() const;
+	bool IsConverged() const;
+
+	// Latest feedback
+	uint64_t GetLastActivePixelCount() const;
+	uint64_t GetLastSampleCount() const;
+
+	// Per-pixel policy, matching the shader
+	static float RelativeError(const PixelMoments& pixel);
+	static bool IsActive(const PixelMoments& pixel, const AdaptiveSamplingSettings& settings);
+	static unsigned int SamplesForPixel(
+		const PixelMoments& pixel,
+		unsigned int pixelX, unsigned int pixelY, unsigned int frameIndex,
+		const AdaptiveSamplingSettings& settings,
+		const AdaptiveSampleAllocation& allocation);
+	static float PixelHash01(unsigned int pixelX, unsigned int pixelY, unsigned int frameIndex);
+
+	// Reference allocation for a whole image, returning the total
+	static uint64_t AllocateImage(
+		const std::vector<PixelMoments>& pixels,
+		unsigned int width, unsigned int frameIndex,
+		const AdaptiveSamplingSettings& settings,
+		const AdaptiveSampleAllocation& allocation,
+		std::vector<unsigned int>& samplesOut);
+
+private:
+	AdaptiveSamplingSettings settings;
+	uint64_t pixelCount;
+	uint64_t lastActivePixels;
+	uint64_t lastSamplesTraced;
+	bool hasFeedback;
+};
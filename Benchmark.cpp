@@ -0,0 +1,305 @@
+#include "Benchmark.h"
+#include "BenchmarkTimeline.h"
+#include "JobSystem.h"
+#include "SceneSimulation.h"
+#include "ScriptedScene.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// --------------------------------------------------------
+	// Splits a command line on whitespace, keeping anything in
+	// double quotes together (so paths may contain spaces)
+	// --------------------------------------------------------
+	std::vector<std::string> SplitArguments(const std::string& commandLine)
+	{
+		std::vector<std::string> args;
+		std::string current;
+		bool inQuotes = false;
+		bool hasArg = false;
+
+		for (char c : commandLine)
+		{
+			if (c == '"')
+			{
+				inQuotes = !inQuotes;
+				hasArg = true;
+			}
+			else if ((c == ' ' || c == '\t') && !inQuotes)
+			{
+				if (hasArg)
+					args.push_back(current);
+				current.clear();
+				hasArg = false;
+			}
+			else
+			{
+				current += c;
+				hasArg = true;
+			}
+		}
+
+		if (hasArg)
+			args.push_back(current);
+		return args;
+	}
+
+	bool ParseNumber(const std::string& text, double& value)
+	{
+		std::istringstream stream(text);
+		return (stream >> value) && stream.eof() && value >= 0;
+	}
+
+	// Appends one threshold check to the report
+	bool CheckThreshold(const char* name, double value, double threshold, std::string& report)
+	{
+		if (threshold <= 0)
+			return true;
+
+		bool passed = value <= threshold;
+		char line[128];
+		snprintf(line, sizeof(line), "  %-5s %8.3f ms (limit %8.3f ms) %s\n",
+			name, value, threshold, passed ? "ok" : "EXCEEDED");
+		report += line;
+		return passed;
+	}
+
+	// --------------------------------------------------------
+	// The scene's objects, repeated (each copy further along
+	// +Z) until there are as many as asked for
+	// --------------------------------------------------------
+	std::vector<SceneObjectState> CreateHeadlessObjects(unsigned int count)
+	{
+		std::vector<SceneObjectState> objects = ScriptedScene::CreateInitialObjects();
+		size_t sceneCount = objects.size();
+		for (size_t i = sceneCount; i < count; i++)
+		{
+			SceneObjectState copy = objects[i % sceneCount];
+			copy.Position.z += 5.0f * (float)(i / sceneCount);
+			objects.push_back(copy);
+		}
+		return objects;
+	}
+}
+
+
+// --------------------------------------------------------
+// Reads benchmark options from the command line.  Unknown
+// arguments are errors so typos don't silently run the
+// wrong benchmark.
+// --------------------------------------------------------
+bool Benchmark::ParseCommandLine(const std::string& commandLine, Options& options, std::string* error)
+{
+	std::vector<std::string> args = SplitArguments(commandLine);
+
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		const std::string& arg = args[i];
+
+		// Flags
+		if (arg == "-headless")
+		{
+			options.Headless = true;
+			continue;
+		}
+
+		// Everything else needs a value
+		if (i + 1 >= args.size())
+		{
+			if (error) *error = "Missing value for " + arg;
+			return false;
+		}
+		const std::string& value = args[++i];
+
+		double number = 0;
+		bool isNumber = ParseNumber(value, number);
+
+		if (arg == "-benchmark")
+		{
+			options.Enabled = true;
+			options.TimelinePath = std::wstring(value.begin(), value.end());
+		}
+		else if (arg == "-out")
+		{
+			options.OutputPath = std::wstring(value.begin(), value.end());
+		}
+		else if (arg == "-frames" && isNumber && number >= 1)
+		{
+			options.FrameCount = (unsigned int)number;
+		}
+		else if (arg == "-dt" && isNumber && number > 0)
+		{
+			options.DeltaTime = (float)number;
+		}
+		else if (arg == "-objects" && isNumber)
+		{
+			options.ObjectCount = (unsigned int)number;
+		}
+		else if (arg == "-max-mean" && isNumber)
+		{
+			options.MaxMeanMs = number;
+		}
+		else if (arg == "-max-p95" && isNumber)
+		{
+			options.MaxP95Ms = number;
+		}
+		else if (arg == "-max-p99" && isNumber)
+		{
+			options.MaxP99Ms = number;
+		}
+		else
+		{
+			if (error) *error = "Invalid argument: " + arg + " " + value;
+			return false;
+		}
+	}
+
+	if (options.Headless && !options.Enabled)
+	{
+		if (error) *error = "-headless requires -benchmark";
+		return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Checks each threshold that was set and reports the result
+// --------------------------------------------------------
+int Benchmark::CheckThresholds(const FrameStatsSummary& summary, const Options& options, std::string* report)
+{
+	std::string text;
+	char line[128];
+	snprintf(line, sizeof(line), "Benchmark: %u frames, %u hitches\n", summary.FrameCount, summary.HitchCount);
+	text += line;
+
+	if (summary.FrameCount == 0)
+	{
+		text += "  No frames were recorded\n";
+		if (report) *report = text;
+		return ExitCodeError;
+	}
+
+	bool passed = true;
+	passed &= CheckThreshold("mean", summary.Total.Mean, options.MaxMeanMs, text);
+	passed &= CheckThreshold("p95", summary.Total.P95, options.MaxP95Ms, text);
+	passed &= CheckThreshold("p99", summary.Total.P99, options.MaxP99Ms, text);
+
+	snprintf(line, sizeof(line), "  p50 %.3f ms, max %.3f ms\n", summary.Total.P50, summary.Total.Max);
+	text += line;
+	text += passed ? "PASSED\n" : "FAILED\n";
+
+	if (report) *report = text;
+	return passed ? ExitCodePassed : ExitCodeRegression;
+}
+
+// --------------------------------------------------------
+// Writes the run's stats to the output path and checks
+// them against the thresholds
+// --------------------------------------------------------
+int Benchmark::Finish(const Options& options, FrameStats& frameStats, const FrameSchedulerStats* gpuStats, const PathTracingStats* pathStats)
+{
+	if (!frameStats.ExportJSON(options.OutputPath, options.FrameCount, gpuStats, pathStats))
+		printf("Benchmark: unable to write stats file\n");
+
+	std::string report;
+	FrameStatsSummary summary = frameStats.Summarize(options.FrameCount);
+	int result = CheckThresholds(summary, options, &report);
+	printf("%s", report.c_str());
+
+	// Time the GPU spent waiting on the CPU between frames
+	if (gpuStats && gpuStats->GPUFrameCount > 0)
+	{
+		printf("  GPU idle %.3f ms over %llu frames (mean gap %.3f ms, max %.3f ms, %u starved), %.1f%% busy\n",
+			gpuStats->GPUIdleMs,
+			(unsigned long long)gpuStats->GPUFrameCount,
+			gpuStats->AverageGPUIdleMs(),
+			gpuStats->MaxGPUIdleMs,
+			gpuStats->StarvedFrames,
+			gpuStats->GPUUtilization() * 100.0);
+	}
+
+	// How long paths were, and how quickly they were traced
+	// (per frame, at the mean frame time, since the counts
+	// arrive a few frames late)
+	if (pathStats && pathStats->FrameCount > 0 && summary.Total.Mean > 0)
+	{
+		printf("  Paths: %.3f rays per sample, %.2f M rays/s (%llu samples, %llu rays over %llu frames)\n",
+			pathStats->AveragePathLength(),
+			pathStats->RaysPerFrame() / summary.Total.Mean / 1000.0,
+			(unsigned long long)pathStats->SampleCount,
+			(unsigned long long)pathStats->RayCount,
+			(unsigned long long)pathStats->FrameCount);
+	}
+	return result;
+}
+
+// --------------------------------------------------------
+// Runs the game's per-frame CPU work without a window or
+// GPU, replaying the timeline with the benchmark's fixed
+// time step, and times each frame:
+//  - Update: the SceneSimulation (as Game::UpdateBenchmark
+//    runs it) and the view from the timeline's camera
+//  - TLAS build: the instance transforms the ray tracer
+//    would upload for this frame and the last
+// --------------------------------------------------------
+int Benchmark::RunHeadless(const Options& options, const BenchmarkTimeline& timeline)
+{
+	// Interpolation is spread over the job system, as in the game
+	JobSystem::Initialize();
+
+	// The stats ring is too big for the stack
+	std::unique_ptr<FrameStats> frameStats = std::make_unique<FrameStats>();
+	SceneSimulation simulation(CreateHeadlessObjects(options.ObjectCount));
+	std::vector<SceneInstanceTransform> instanceTransforms;
+	std::vector<SceneInstanceTransform> previousInstanceTransforms;
+	SceneFloat4x4 lastView = simulation.GetViewMatrix();
+	unsigned int cameraMoves = 0;
+
+	FrameStats::Clock::time_point frameStart = FrameStats::Clock::now();
+	for (unsigned int i = 0; i < options.FrameCount; i++)
+	{
+		FrameStats::Clock::time_point phaseStart = frameStart;
+		FrameTiming timing;
+
+		float totalTime = (float)(i * (double)options.DeltaTime);
+		simulation.Simulate(options.DeltaTime, &timeline);
+		simulation.PrepareRenderState();
+		simulation.FollowCamera(timeline, totalTime);
+		timing.PhaseMs[FRAME_PHASE_UPDATE] = FrameStats::Lap(phaseStart);
+
+		// Without last frame's matrices (the first frame), nothing has moved
+		const std::vector<SceneFloat4x4>& worldMatrices = simulation.GetWorldMatrices();
+		const std::vector<SceneFloat4x4>& lastWorldMatrices =
+			simulation.GetPreviousWorldMatrices().size() == worldMatrices.size() ? simulation.GetPreviousWorldMatrices() : worldMatrices;
+		instanceTransforms.resize(worldMatrices.size());
+		previousInstanceTransforms.resize(worldMatrices.size());
+		for (size_t j = 0; j < worldMatrices.size(); j++)
+		{
+			instanceTransforms[j] = SceneSimulation::InstanceTransform(worldMatrices[j]);
+			previousInstanceTransforms[j] = SceneSimulation::InstanceTransform(lastWorldMatrices[j]);
+		}
+		timing.PhaseMs[FRAME_PHASE_TLAS_BUILD] = FrameStats::Lap(phaseStart);
+
+		// A moving camera restarts accumulation in the game
+		if (memcmp(&lastView, &simulation.GetViewMatrix(), sizeof(SceneFloat4x4)) != 0)
+			cameraMoves++;
+		lastView = simulation.GetViewMatrix();
+
+		timing.TotalMs = FrameStats::Lap(frameStart);
+		frameStats->RecordFrame(timing);
+	}
+
+	JobSystem::ShutDown();
+
+	printf("Headless: %zu objects, camera moved on %u of %u frames\n",
+		instanceTransforms.size(), cameraMoves, options.FrameCount);
+	return Finish(options, *frameStats);
+}
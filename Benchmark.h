@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+
+#include "FrameStats.h"
+
+class BenchmarkTimeline;
+
+// --------------------------------------------------------
+// Command line driven benchmark runs.  A benchmark replays
+// a BenchmarkTimeline with a fixed time step for a set
+// number of frames, writes the resulting frame stats to
+// disk and fails if any timing threshold is exceeded.
+//
+// Options (all but -benchmark are optional):
+//   -benchmark <timeline>   Enables benchmark mode
+//   -frames <count>         Frames to run (default 1000)
+//   -dt <seconds>           Fixed time step (default 1/60)
+//   -out <path>             Stats file (default Benchmark.json)
+//   -headless               No window or GPU, just the
+//                           scene simulation
+//   -objects <count>        Objects simulated headless (default
+//                           the scene's own, repeated beyond it)
+//   -max-mean <ms>          Thresholds, in milliseconds, for
+//   -max-p95 <ms>           the frame time over the last
+//   -max-p99 <ms>           FrameStats::Capacity frames
+//
+// Headless runs do everything a frame does on the CPU short
+// of the graphics API: the SceneSimulation's fixed steps and
+// interpolated world matrices, the view from the timeline's
+// camera and the TLAS's instance transforms.  They work on
+// any platform (see HeadlessMain.cpp for the entry point
+// used outside of Windows).
+//
+// Nothing here touches the window or graphics API.
+// --------------------------------------------------------
+namespace Benchmark
+{
+	// Process exit codes
+	const int ExitCodePassed = 0;
+	const int ExitCodeRegression = 1;
+	const int ExitCodeError = 2;
+
+	struct Options
+	{
+		bool Enabled = false;
+		bool Headless = false;
+		std::wstring TimelinePath;
+		std::wstring OutputPath = L"Benchmark.json";
+		unsigned int FrameCount = 1000;
+		float DeltaTime = 1.0f / 60.0f;
+		unsigned int ObjectCount = 0;	// Zero means just the scene's own
+
+		// Zero means "don't check"
+		double MaxMeanMs = 0;
+		double MaxP95Ms = 0;
+		double MaxP99Ms = 0;
+	};
+
+	// Returns false (and the reason in error) for bad options
+	bool ParseCommandLine(const std::string& commandLine, Options& options, std::string* error = 0);
+
+	// Compares a run against the options' thresholds, returning one
+	// of the exit codes above and a human readable report
+	int CheckThresholds(const FrameStatsSummary& summary, const Options& options, std::string* report = 0);
+
+	// Saves the stats of a finished run, prints its report (with
+	// the GPU's idle gaps and the paths it traced, when there was
+	// a GPU) and returns the exit code
+	int Finish(const Options& options, FrameStats& frameStats, const FrameSchedulerStats* gpuStats = 0, const PathTracingStats* pathStats = 0);
+
+	// Runs a whole benchmark without a window or graphics API,
+	// returning the exit code
+	int RunHeadless(const Options& options, const BenchmarkTimeline& timeline);
+}
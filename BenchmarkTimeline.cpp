@@ -0,0 +1,238 @@
+#include "BenchmarkTimeline.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	TimelineFloat3 Lerp(const TimelineFloat3& a, const TimelineFloat3& b, float t)
+	{
+		return TimelineFloat3{
+			a.x + (b.x - a.x) * t,
+			a.y + (b.y - a.y) * t,
+			a.z + (b.z - a.z) * t };
+	}
+
+	bool ReadFloat3(std::istringstream& line, TimelineFloat3& value)
+	{
+		return (bool)(line >> value.x >> value.y >> value.z);
+	}
+
+	void WriteFloat3(std::ofstream& file, const TimelineFloat3& value)
+	{
+		file << " " << value.x << " " << value.y << " " << value.z;
+	}
+}
+
+
+// --------------------------------------------------------
+// Inserts a keyframe, keeping the track sorted by time.
+// A keyframe at the same time as an existing one replaces it.
+// --------------------------------------------------------
+void BenchmarkTimeline::AddKeyframe(Track& track, const TimelineKeyframe& keyframe)
+{
+	Track::iterator it = std::lower_bound(track.begin(), track.end(), keyframe.Time,
+		[](const TimelineKeyframe& k, float time) { return k.Time < time; });
+
+	if (it != track.end() && it->Time == keyframe.Time)
+		*it = keyframe;
+	else
+		track.insert(it, keyframe);
+}
+
+void BenchmarkTimeline::AddCameraKeyframe(const TimelineKeyframe& keyframe)
+{
+	AddKeyframe(cameraTrack, keyframe);
+}
+
+void BenchmarkTimeline::AddEntityKeyframe(unsigned int entityIndex, const TimelineKeyframe& keyframe)
+{
+	if (entityIndex >= entityTracks.size())
+		entityTracks.resize(entityIndex + 1);
+
+	AddKeyframe(entityTracks[entityIndex], keyframe);
+}
+
+void BenchmarkTimeline::Clear()
+{
+	cameraTrack.clear();
+	entityTracks.clear();
+}
+
+// --------------------------------------------------------
+// Interpolates between the two keyframes surrounding the
+// given time, or holds the first/last keyframe outside them
+// --------------------------------------------------------
+bool BenchmarkTimeline::Sample(const Track& track, float time, TimelineKeyframe& result)
+{
+	if (track.empty())
+		return false;
+
+	// First keyframe after the given time
+	Track::const_iterator next = std::upper_bound(track.begin(), track.end(), time,
+		[](float time, const TimelineKeyframe& k) { return time < k.Time; });
+
+	if (next == track.begin())
+	{
+		result = track.front();
+	}
+	else if (next == track.end())
+	{
+		result = track.back();
+	}
+	else
+	{
+		const TimelineKeyframe& prev = *(next - 1);
+		float t = (time - prev.Time) / (next->Time - prev.Time);
+
+		result.Time = time;
+		result.Position = Lerp(prev.Position, next->Position, t);
+		result.PitchYawRoll = Lerp(prev.PitchYawRoll, next->PitchYawRoll, t);
+		result.Scale = Lerp(prev.Scale, next->Scale, t);
+	}
+
+	return true;
+}
+
+bool BenchmarkTimeline::SampleCamera(float time, TimelineKeyframe& result) const
+{
+	return Sample(cameraTrack, time, result);
+}
+
+bool BenchmarkTimeline::SampleEntity(unsigned int entityIndex, float time, TimelineKeyframe& result) const
+{
+	if (entityIndex >= entityTracks.size())
+		return false;
+
+	return Sample(entityTracks[entityIndex], time, result);
+}
+
+bool BenchmarkTimeline::IsEmpty() const
+{
+	if (!cameraTrack.empty())
+		return false;
+
+	for (const Track& track : entityTracks)
+		if (!track.empty())
+			return false;
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Time of the last keyframe across every track
+// --------------------------------------------------------
+float BenchmarkTimeline::GetDuration() const
+{
+	float duration = cameraTrack.empty() ? 0.0f : cameraTrack.back().Time;
+	for (const Track& track : entityTracks)
+		if (!track.empty())
+			duration = std::max(duration, track.back().Time);
+
+	return duration;
+}
+
+unsigned int BenchmarkTimeline::GetEntityTrackCount() const
+{
+	return (unsigned int)entityTracks.size();
+}
+
+// --------------------------------------------------------
+// Replaces this timeline with the one in the given file.
+// On failure the timeline is left empty and, if requested,
+// the reason is written to error.
+// --------------------------------------------------------
+bool BenchmarkTimeline::Load(const std::wstring& path, std::string* error)
+{
+	Clear();
+
+	std::ifstream file(std::filesystem::path{ path });
+	if (!file.is_open())
+	{
+		if (error) *error = "Unable to open timeline file";
+		return false;
+	}
+
+	std::string text;
+	unsigned int lineNumber = 0;
+	while (std::getline(file, text))
+	{
+		lineNumber++;
+
+		std::istringstream line(text);
+		std::string type;
+		if (!(line >> type) || type[0] == '#')
+			continue;
+
+		TimelineKeyframe keyframe;
+		bool valid = false;
+		if (type == "camera")
+		{
+			valid =
+				(bool)(line >> keyframe.Time) &&
+				ReadFloat3(line, keyframe.Position) &&
+				ReadFloat3(line, keyframe.PitchYawRoll);
+
+			if (valid)
+				AddCameraKeyframe(keyframe);
+		}
+		else if (type == "entity")
+		{
+			unsigned int index = 0;
+			valid =
+				(bool)(line >> index >> keyframe.Time) &&
+				ReadFloat3(line, keyframe.Position) &&
+				ReadFloat3(line, keyframe.PitchYawRoll) &&
+				ReadFloat3(line, keyframe.Scale);
+
+			if (valid)
+				AddEntityKeyframe(index, keyframe);
+		}
+
+		if (!valid)
+		{
+			if (error) *error = "Invalid keyframe on line " + std::to_string(lineNumber);
+			Clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool BenchmarkTimeline::Save(const std::wstring& path) const
+{
+	std::ofstream file(std::filesystem::path{ path });
+	if (!file.is_open())
+		return false;
+
+	file.precision(9);
+	file << "# camera <time> <px py pz> <pitch yaw roll>\n";
+	file << "# entity <index> <time> <px py pz> <pitch yaw roll> <sx sy sz>\n";
+
+	for (const TimelineKeyframe& k : cameraTrack)
+	{
+		file << "camera " << k.Time;
+		WriteFloat3(file, k.Position);
+		WriteFloat3(file, k.PitchYawRoll);
+		file << "\n";
+	}
+
+	for (size_t i = 0; i < entityTracks.size(); i++)
+	{
+		for (const TimelineKeyframe& k : entityTracks[i])
+		{
+			file << "entity " << i << " " << k.Time;
+			WriteFloat3(file, k.Position);
+			WriteFloat3(file, k.PitchYawRoll);
+			WriteFloat3(file, k.Scale);
+			file << "\n";
+		}
+	}
+
+	return file.good();
+}
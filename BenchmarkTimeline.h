@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Plain vector, so timelines don't depend on DirectXMath
+// (laid out the same as an XMFLOAT3)
+struct TimelineFloat3
+{
+	float x = 0;
+	float y = 0;
+	float z = 0;
+};
+
+// Where a single object is at a single point in time
+struct TimelineKeyframe
+{
+	float Time = 0;
+	TimelineFloat3 Position{ 0, 0, 0 };
+	TimelineFloat3 PitchYawRoll{ 0, 0, 0 };
+	TimelineFloat3 Scale{ 1, 1, 1 };
+};
+
+// --------------------------------------------------------
+// A recorded path for the camera and any number of entities,
+// used to replay the exact same scene motion in benchmarks.
+//
+// Each object has its own list of keyframes, sorted by time,
+// and is linearly interpolated between them.  Sampling before
+// the first or after the last keyframe holds that keyframe.
+//
+// Timelines are saved as plain text, one keyframe per line:
+//   camera <time> <px py pz> <pitch yaw roll>
+//   entity <index> <time> <px py pz> <pitch yaw roll> <sx sy sz>
+// Blank lines and lines starting with # are ignored.
+//
+// Nothing here touches the window, input or graphics API,
+// so it also runs in the headless benchmark on any platform.
+// --------------------------------------------------------
+class BenchmarkTimeline
+{
+public:
+	// Building
+	void AddCameraKeyframe(const TimelineKeyframe& keyframe);
+	void AddEntityKeyframe(unsigned int entityIndex, const TimelineKeyframe& keyframe);
+	void Clear();
+
+	// Sampling - these return false if the object has no keyframes
+	bool SampleCamera(float time, TimelineKeyframe& result) const;
+	bool SampleEntity(unsigned int entityIndex, float time, TimelineKeyframe& result) const;
+
+	// Info
+	bool IsEmpty() const;
+	float GetDuration() const;
+	unsigned int GetEntityTrackCount() const;
+
+	// File IO
+	bool Load(const std::wstring& path, std::string* error = 0);
+	bool Save(const std::wstring& path) const;
+
+private:
+	typedef std::vector<TimelineKeyframe> Track;
+
+	Track cameraTrack;
+	std::vector<Track> entityTracks;
+
+	static void AddKeyframe(Track& track, const TimelineKeyframe& keyframe);
+	static bool Sample(const Track& track, float time, TimelineKeyframe& result);
+};
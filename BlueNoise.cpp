@@ -0,0 +1,162 @@
+#include "BlueNoise.h"
+#include "PathSampler.h"
+
+#include <cmath>
+
+// Annonymous namespace to hold variables/helpers
+// only accessible in this file
+namespace
+{
+	// Width of the filter that measures how clustered texels
+	// are - the value from the original paper
+	const float Sigma = 1.5f;
+
+	// Fraction of texels in the initial pattern
+	const float InitialDensity = 0.1f;
+
+	// Texels that are set, and how crowded each texel's
+	// neighborhood is, wrapping around the edges
+	struct Pattern
+	{
+		unsigned int Size;
+		std::vector<float> Kernel;		// Filter weight by wrapped offset
+		std::vector<uint8_t> Set;
+		std::vector<float> Energy;
+
+		explicit Pattern(unsigned int size) :
+			Size(size),
+			Kernel(size * size),
+			Set(size * size, 0),
+			Energy(size * size, 0.0f)
+		{
+			for (unsigned int y = 0; y < size; y++)
+			{
+				for (unsigned int x = 0; x < size; x++)
+				{
+					// Shortest distance around the torus
+					float dx = (float)(x <= size / 2 ? x : size - x);
+					float dy = (float)(y <= size / 2 ? y : size - y);
+					Kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * Sigma * Sigma));
+				}
+			}
+		}
+
+		void Toggle(unsigned int index)
+		{
+			float sign = Set[index] ? -1.0f : 1.0f;
+			Set[index] = !Set[index];
+
+			unsigned int ix = index % Size;
+			unsigned int iy = index / Size;
+			for (unsigned int y = 0; y < Size; y++)
+			{
+				const float* kernelRow = &Kernel[((y + Size - iy) % Size) * Size];
+				float* energyRow = &Energy[y * Size];
+				for (unsigned int x = 0; x < Size; x++)
+					energyRow[x] += sign * kernelRow[(x + Size - ix) % Size];
+			}
+		}
+
+		// Most crowded set texel
+		unsigned int TightestCluster() const
+		{
+			unsigned int best = 0;
+			float bestEnergy = -INFINITY;
+			for (unsigned int i = 0; i < Set.size(); i++)
+			{
+				if (Set[i] && Energy[i] > bestEnergy)
+				{
+					best = i;
+					bestEnergy = Energy[i];
+				}
+			}
+			return best;
+		}
+
+		// Emptiest unset texel
+		unsigned int LargestVoid() const
+		{
+			unsigned int best = 0;
+			float bestEnergy = INFINITY;
+			for (unsigned int i = 0; i < Set.size(); i++)
+			{
+				if (!Set[i] && Energy[i] < bestEnergy)
+				{
+					best = i;
+					bestEnergy = Energy[i];
+				}
+			}
+			return best;
+		}
+	};
+}
+
+// --------------------------------------------------------
+// Takes a moment (a few hundred milliseconds at 64x64 in
+// release builds), so generate once at startup
+// --------------------------------------------------------
+std::vector<uint16_t> BlueNoise::GenerateTile(unsigned int size, uint32_t seed)
+{
+	unsigned int texelCount = size * size;
+	std::vector<uint16_t> ranks(texelCount, 0);
+	if (texelCount == 0)
+		return ranks;
+
+	// Start from a random sparse pattern
+	Pattern initial(size);
+	unsigned int initialCount = (unsigned int)(texelCount * InitialDensity);
+	if (initialCount == 0)
+		initialCount = 1;
+	for (unsigned int placed = 0, attempt = 0; placed < initialCount; attempt++)
+	{
+		unsigned int index = PathSampler::PCGHash(seed ^ PathSampler::PCGHash(attempt)) % texelCount;
+		if (!initial.Set[index])
+		{
+			initial.Toggle(index);
+			placed++;
+		}
+	}
+
+	// Even it out by moving the most crowded texel to the emptiest
+	// spot, until that would put it right back where it was (with
+	// a limit, in case it ends up cycling instead)
+	for (unsigned int move = 0; move < texelCount; move++)
+	{
+		unsigned int cluster = initial.TightestCluster();
+		initial.Toggle(cluster);
+		unsigned int emptiest = initial.LargestVoid();
+		initial.Toggle(emptiest);
+		if (emptiest == cluster)
+			break;
+	}
+
+	// Rank the initial texels by removing the most crowded first
+	Pattern pattern = initial;
+	for (unsigned int rank = initialCount; rank > 0; rank--)
+	{
+		unsigned int cluster = pattern.TightestCluster();
+		pattern.Toggle(cluster);
+		ranks[cluster] = (uint16_t)(rank - 1);
+	}
+
+	// Rank the rest by filling the emptiest spots first.  (Past half
+	// full this is the same as removing the most crowded unset texel,
+	// since the filter weights around any texel sum to a constant.)
+	pattern = initial;
+	for (unsigned int rank = initialCount; rank < texelCount; rank++)
+	{
+		unsigned int emptiest = pattern.LargestVoid();
+		pattern.Toggle(emptiest);
+		ranks[emptiest] = (uint16_t)rank;
+	}
+
+	return ranks;
+}
+
+std::vector<float> BlueNoise::RanksToOffsets(const std::vector<uint16_t>& ranks)
+{
+	std::vector<float> offsets(ranks.size());
+	for (size_t i = 0; i < ranks.size(); i++)
+		offsets[i] = (ranks[i] + 0.5f) / ranks.size();
+	return offsets;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// --------------------------------------------------------
+// Generates a tileable blue noise threshold map with the
+// void-and-cluster method (Ulichney, 1993).  Every texel
+// gets a unique rank, and the texels below any rank are
+// spread out evenly, so neighboring pixels that offset
+// their random numbers by their rank end up with errors
+// that look like fine, even grain rather than clumps.
+//
+// Nothing here knows about D3D12.
+// --------------------------------------------------------
+namespace BlueNoise
+{
+	// Side length of the tiles the renderer uses
+	const unsigned int TileSize = 64;
+
+	// Ranks from 0 to size * size - 1, row by row
+	std::vector<uint16_t> GenerateTile(unsigned int size, uint32_t seed);
+
+	// Per-texel offsets in [0, 1), from a tile's ranks
+	std::vector<float> RanksToOffsets(const std::vector<uint16_t>& ranks);
+}
@@ -23,7 +23,25 @@ struct RaytracingSceneData
 {
 	DirectX::XMFLOAT4X4 inverseViewProjection;
 	DirectX::XMFLOAT3 cameraPosition;
-	float pad;
+	unsigned int accumulationFrameIndex;	// Frames already in the accumulation buffer (0 = start over)
+	unsigned int samplesPerPixel;			// Most samples any pixel traces this frame
+	float adaptiveErrorThreshold;			// Relative error a pixel stops sampling at (0 = never stop)
+	unsigned int adaptiveMinSamples;		// Samples before the error estimate is trusted
+	float activePixelFraction;				// Chance a pixel that needs samples gets them this frame
+	unsigned int samplerType;				// PathSampler::SamplerType
+	unsigned int blueNoiseOffsets;			// Offset each pixel's samples by a blue noise tile?
+	unsigned int maxBounces;				// Paths still going after this many hits contribute nothing
+	unsigned int russianRouletteStartBounce;	// Bounces before paths may be ended at random
+	unsigned int lightCount;				// Lights in the light buffer
+	unsigned int nextEventEstimation;		// Sample lights directly at each hit?
+	unsigned int distantLightCount;			// Directional lights, which come first in the light buffer
+	unsigned int lightTreeSampling;			// Pick point and spot lights with the light tree?
+	unsigned int environmentMapIndex;		// HDR sky's SRV index in the bindless table (-1 for none)
+	unsigned int environmentWidth;			// Size of the sky's sampling distribution
+	unsigned int environmentHeight;
+	float environmentIntensity;				// Scale on the sky's radiance
+	DirectX::XMFLOAT4X4 previousViewProjection;	// Last frame's camera, for motion vectors
+	DirectX::XMFLOAT3 previousCameraPosition;
 };
 
 // All material data for raytracing
@@ -44,6 +44,13 @@ float Camera::GetFOV()
 	return fov;
 }
 
+void Camera::SetPositionAndRotation(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 pitchYawRoll)
+{
+	transform.SetPosition(position);
+	transform.SetRotation(pitchYawRoll);
+	UpdateViewMatrix();
+}
+
 void Camera::UpdateProjectionMatrix(float aspectRatio)
 {
 	//TODO: Add orthographic support
@@ -81,35 +88,36 @@ void Camera::Update(float deltaTime)
 		deltaTime *= 4;
 	}
 
-	// Move camera
-	if (Input::KeyDown('W'))
+	// Move camera, scaled by how much of the frame each key was
+	// held so taps and mid-frame presses move the right amount
+	if (Input::KeyDown('W') || Input::KeyRelease('W'))
 	{
-		transform.MoveRelative(0, 0, movementSpeed * deltaTime);
+		transform.MoveRelative(0, 0, movementSpeed * deltaTime * Input::GetKeyDownFraction('W'));
 		dirtyViewMatrix = true;
 	}
-	if (Input::KeyDown('S'))
+	if (Input::KeyDown('S') || Input::KeyRelease('S'))
 	{
-		transform.MoveRelative(0, 0, -movementSpeed * deltaTime);
+		transform.MoveRelative(0, 0, -movementSpeed * deltaTime * Input::GetKeyDownFraction('S'));
 		dirtyViewMatrix = true;
 	}
-	if (Input::KeyDown('A'))
+	if (Input::KeyDown('A') || Input::KeyRelease('A'))
 	{
-		transform.MoveRelative(-movementSpeed * deltaTime, 0, 0);
+		transform.MoveRelative(-movementSpeed * deltaTime * Input::GetKeyDownFraction('A'), 0, 0);
 		dirtyViewMatrix = true;
 	}
-	if (Input::KeyDown('D'))
+	if (Input::KeyDown('D') || Input::KeyRelease('D'))
 	{
-		transform.MoveRelative(movementSpeed * deltaTime, 0, 0);
+		transform.MoveRelative(movementSpeed * deltaTime * Input::GetKeyDownFraction('D'), 0, 0);
 		dirtyViewMatrix = true;
 	}
-	if (Input::KeyDown(VK_SPACE))
+	if (Input::KeyDown(VK_SPACE) || Input::KeyRelease(VK_SPACE))
 	{
-		transform.MoveRelative(0, movementSpeed * deltaTime, 0);
+		transform.MoveRelative(0, movementSpeed * deltaTime * Input::GetKeyDownFraction(VK_SPACE), 0);
 		dirtyViewMatrix = true;
 	}
-	if (Input::KeyDown(VK_CONTROL))
+	if (Input::KeyDown(VK_CONTROL) || Input::KeyRelease(VK_CONTROL))
 	{
-		transform.MoveRelative(0, -movementSpeed * deltaTime, 0);
+		transform.MoveRelative(0, -movementSpeed * deltaTime * Input::GetKeyDownFraction(VK_CONTROL), 0);
 		dirtyViewMatrix = true;
 	}
 
@@ -34,6 +34,9 @@ public:
 	Transform GetTransform();
 	float GetFOV();
 
+	// Setters
+	void SetPositionAndRotation(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 pitchYawRoll);
+
 	// Matrix Updates
 	void UpdateProjectionMatrix(float aspectRatio);
 	void UpdateViewMatrix();
@@ -0,0 +1,139 @@
+#include "CommandListPool.h"
+#include "Graphics.h"
+#include "FrameSlotPool.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace CommandListPool
+{
+	// Annonymous namespace to hold variables
+	// only accessible in this file
+	namespace
+	{
+		// An allocator and the list that records into it
+		struct PooledCommandList
+		{
+			Microsoft::WRL::ComPtr<ID3D12CommandAllocator> Allocator;
+			Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> List;
+		};
+
+		// A list handed out this frame and where it goes in the submission
+		struct AcquiredCommandList
+		{
+			int Order;
+			ID3D12GraphicsCommandList* List;
+		};
+
+		std::mutex poolMutex;
+		FrameSlotPool<PooledCommandList> pool;
+		std::vector<AcquiredCommandList> acquiredThisFrame;
+		unsigned int lastFrameListCount = 0;
+	}
+}
+
+// --------------------------------------------------------
+// Gets an open command list for recording a pass on the
+// calling thread.  Its allocator is used only by this list,
+// and only reused once the GPU has finished this frame.
+//
+// order - Where the list is submitted relative to the main
+//         command list (MainCommandListOrder) and the other
+//         lists from this frame.  Lists with the same order
+//         are submitted in the order they were acquired.
+// --------------------------------------------------------
+ID3D12GraphicsCommandList* CommandListPool::Acquire(int order)
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+
+	bool created = false;
+	PooledCommandList& entry = pool.Acquire(
+		Graphics::CurrentFrameFenceValue(),
+		Graphics::CompletedFrameFenceValue(),
+		&created);
+
+	if (created)
+	{
+		Graphics::Device->CreateCommandAllocator(
+			D3D12_COMMAND_LIST_TYPE_DIRECT,
+			IID_PPV_ARGS(entry.Allocator.GetAddressOf()));
+
+		// Lists are created open, ready for recording
+		Graphics::Device->CreateCommandList(
+			0,
+			D3D12_COMMAND_LIST_TYPE_DIRECT,
+			entry.Allocator.Get(),
+			0,
+			IID_PPV_ARGS(entry.List.GetAddressOf()));
+	}
+	else
+	{
+		// The GPU is done with this allocator's previous frame
+		entry.Allocator->Reset();
+		entry.List->Reset(entry.Allocator.Get(), 0);
+	}
+
+	acquiredThisFrame.push_back({ order, entry.List.Get() });
+	return entry.List.Get();
+}
+
+// --------------------------------------------------------
+// Closes every list acquired this frame and builds the
+// final submission order, with the main list placed at
+// MainCommandListOrder.  The main list must already be
+// closed, and no other thread may still be recording.
+// --------------------------------------------------------
+void CommandListPool::CloseFrameLists(ID3D12CommandList* mainList, std::vector<ID3D12CommandList*>& submitOrder)
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+
+	for (AcquiredCommandList& acquired : acquiredThisFrame)
+		acquired.List->Close();
+
+	// Stable, so lists with the same order stay in acquisition order
+	std::stable_sort(acquiredThisFrame.begin(), acquiredThisFrame.end(),
+		[](const AcquiredCommandList& a, const AcquiredCommandList& b) { return a.Order < b.Order; });
+
+	// Anything at or after the main list's order goes after it
+	submitOrder.clear();
+	bool mainListAdded = false;
+	for (AcquiredCommandList& acquired : acquiredThisFrame)
+	{
+		if (!mainListAdded && acquired.Order >= MainCommandListOrder)
+		{
+			submitOrder.push_back(mainList);
+			mainListAdded = true;
+		}
+		submitOrder.push_back(acquired.List);
+	}
+
+	if (!mainListAdded)
+		submitOrder.push_back(mainList);
+
+	lastFrameListCount = (unsigned int)acquiredThisFrame.size();
+	acquiredThisFrame.clear();
+}
+
+// --------------------------------------------------------
+// Releases every pooled allocator and list.  The GPU must
+// be idle, since they may still be referenced by work in
+// flight otherwise.
+// --------------------------------------------------------
+void CommandListPool::ShutDown()
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+	acquiredThisFrame.clear();
+	pool.Clear();
+}
+
+unsigned int CommandListPool::GetPooledListCount()
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+	return pool.GetSize();
+}
+
+unsigned int CommandListPool::GetLastFrameListCount()
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+	return lastFrameListCount;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <d3d12.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Hands out extra command lists so independent passes can
+// be recorded on several threads at once.
+//
+// Each acquired list has its own command allocator and is
+// only used by the thread that acquired it.  Every list
+// acquired during a frame is closed and submitted alongside
+// Graphics::CommandList in a single ExecuteCommandLists()
+// call, sorted by the order given when acquiring it.  The
+// main command list sits at MainCommandListOrder, so passes
+// can be placed before or after it.
+//
+// Lists and allocators are recycled once the GPU finishes
+// the frame that used them (see FrameSlotPool).
+//
+// All recording into acquired lists must be finished before
+// the frame is submitted.
+// --------------------------------------------------------
+namespace CommandListPool
+{
+	// --- CONSTANTS ---
+	// Where Graphics::CommandList goes in the submission order
+	const int MainCommandListOrder = 0;
+
+	// Where each pass recorded on another thread goes.  Buffer
+	// uploads come first so anything may use them, then the
+	// acceleration structure builds that tracing needs, then
+	// the passes that read its results.  Timestamps are
+	// resolved last, once every list has written them.
+	const int UploadCommandListOrder = -30;
+	const int BLASBuildCommandListOrder = -20;
+	const int TLASBuildCommandListOrder = -10;
+	const int DenoiseCommandListOrder = 10;
+	const int ProfilerResolveCommandListOrder = 100;
+
+	// --- FUNCTIONS ---
+	// Thread safe.  Returns an open list, ready for recording.
+	ID3D12GraphicsCommandList* Acquire(int order);
+
+	// Closes this frame's lists and fills the given vector with
+	// them and the (already closed) main list, in submission order
+	void CloseFrameLists(ID3D12CommandList* mainList, std::vector<ID3D12CommandList*>& submitOrder);
+
+	// Only call once the GPU is idle
+	void ShutDown();
+
+	// Stats
+	unsigned int GetPooledListCount();
+	unsigned int GetLastFrameListCount();
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+// --------------------------------------------------------
+// Holds onto objects (typically ComPtrs to GPU resources)
+// until the GPU is guaranteed to be done with them.
+//
+// Each object is tagged with the fence value that will be
+// signaled once the GPU finishes the frame that last used
+// it, and is destroyed once Release() is called with a
+// completed fence value at least that large.
+//
+// Fence values must be enqueued in non-decreasing order,
+// which is naturally the case when they come from a single
+// frame fence.  Nothing here knows about D3D12.
+// --------------------------------------------------------
+template<typename T>
+class DeferredReleaseQueue
+{
+public:
+	// Hang onto an object until the given fence value is reached
+	void Enqueue(T object, uint64_t fenceValue)
+	{
+		pending.push_back({ fenceValue, std::move(object) });
+	}
+
+	// Destroys every object whose fence value has been reached,
+	// returning how many were released.  Each object is taken out
+	// of the queue before it's destroyed, so destroying it may
+	// enqueue more objects (which wait for their own fence).
+	unsigned int Release(uint64_t completedFenceValue)
+	{
+		unsigned int count = 0;
+		while (!pending.empty() && pending.front().FenceValue <= completedFenceValue)
+		{
+			T object = std::move(pending.front().Object);
+			pending.pop_front();
+			count++;
+		}
+		return count;
+	}
+
+	// Destroys everything regardless of fence values.  Only safe
+	// once the GPU is known to be completely idle.
+	void Flush()
+	{
+		while (!pending.empty())
+		{
+			T object = std::move(pending.front().Object);
+			pending.pop_front();
+		}
+	}
+
+	unsigned int GetPendingCount() { return (unsigned int)pending.size(); }
+
+private:
+	struct Entry
+	{
+		uint64_t FenceValue;
+		T Object;
+	};
+
+	std::deque<Entry> pending;
+};
@@ -0,0 +1,168 @@
+// One pass of the edge-avoiding a-trous filter over the path traced image
+// - Must match ATrousFilter.cpp, which is the CPU reference for it
+
+// B3 spline kernel, applied along both axes
+static const float Kernel[5] = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+
+// 3x3 gaussian for the variance, applied along both axes
+static const float Gaussian[2] = { 1.0f / 2, 1.0f / 4 };
+
+// Darkest albedo the color is divided by
+static const float MinAlbedo = 0.01f;
+
+// Keeps the luminance weight finite for noise free pixels
+static const float LuminanceEpsilon = 1e-6f;
+
+// === Constant buffers ===
+
+cbuffer DenoiseData : register(b0)
+{
+    uint pass; // Taps are 2^pass pixels apart
+    uint lastPass; // Put the albedo back and write the output?
+    float luminancePhi;
+    float normalPhi;
+    float depthPhi;
+};
+
+
+// === Resources ===
+
+// Written by the path tracer
+RWTexture2D<float4> GBufferNormalDepth : register(u2);
+RWTexture2D<float4> GBufferAlbedo : register(u3);
+
+// Filtered illumination (rgb) and its variance (a), ping-ponged between passes
+RWTexture2D<float4> Filtered[2] : register(u4);
+
+// What's copied to the back buffer
+RWTexture2D<float4> OutputColor : register(u6);
+
+// The path tracer's accumulated color and luminance moments,
+// with history reused by Reproject.hlsl
+RWTexture2D<float4> TemporalColor : register(u8);
+RWTexture2D<float2> TemporalMoments : register(u9);
+
+
+// === Helpers ===
+
+float Luminance(float3 color)
+{
+    return dot(color, float3(0.2126f, 0.7152f, 0.0722f));
+}
+
+float3 DemodulationAlbedo(uint2 pixel)
+{
+    return max(GBufferAlbedo[pixel].rgb, MinAlbedo);
+}
+
+// The first pass filters the (reprojected) color divided by the albedo,
+// with the variance of its mean from the moments (scaled by the albedo,
+// as the moments are of the color), and the rest filter the previous
+// pass's result
+float4 LoadIllumination(uint2 pixel)
+{
+    if (pass > 0)
+        return Filtered[pass % 2][pixel];
+
+    float3 albedo = DemodulationAlbedo(pixel);
+    float4 color = TemporalColor[pixel];
+    float2 moments = TemporalMoments[pixel];
+
+    float albedoLuminance = Luminance(albedo);
+    float sampleVariance = max(moments.y - moments.x * moments.x, 0.0f);
+    float variance = sampleVariance / max(color.a, 1.0f) / (albedoLuminance * albedoLuminance);
+    return float4(color.rgb / albedo, variance);
+}
+
+// Variance around a pixel, blurred so a few samples that
+// happen to agree don't stop it being filtered
+float BlurredVariance(int2 pixel, uint width, uint height)
+{
+    float variance = 0;
+    float weightSum = 0;
+    for (int dy = -1; dy <= 1; dy++)
+    {
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            int2 tap = pixel + int2(dx, dy);
+            if (any(tap < 0) || tap.x >= (int) width || tap.y >= (int) height)
+                continue;
+
+            float weight = Gaussian[abs(dx)] * Gaussian[abs(dy)];
+            variance += LoadIllumination(tap).a * weight;
+            weightSum += weight;
+        }
+    }
+    return variance / weightSum;
+}
+
+// Averaged normals aren't unit length, and the sky's is zero
+float3 UnitNormal(float3 normal)
+{
+    float length = sqrt(dot(normal, normal));
+    return length > 0 ? normal / length : float3(0, 0, 0);
+}
+
+
+// === Shaders ===
+
+[numthreads(8, 8, 1)]
+void main(uint3 threadID : SV_DispatchThreadID)
+{
+    uint width, height;
+    OutputColor.GetDimensions(width, height);
+    if (threadID.x >= width || threadID.y >= height)
+        return;
+
+    int2 pixel = (int2) threadID.xy;
+    float4 center = LoadIllumination(pixel);
+    float4 normalDepth = GBufferNormalDepth[pixel];
+    float3 normal = UnitNormal(normalDepth.xyz);
+    float depth = normalDepth.w;
+
+    // The sky is already noise free
+    float4 result = center;
+    if (any(normal != 0))
+    {
+        int step = 1 << pass;
+        float luminance = Luminance(center.rgb);
+        float luminanceScale = luminancePhi * sqrt(BlurredVariance(pixel, width, height)) + LuminanceEpsilon;
+
+        float3 sum = float3(0, 0, 0);
+        float varianceSum = 0;
+        float weightSum = 0;
+        for (int dy = -2; dy <= 2; dy++)
+        {
+            for (int dx = -2; dx <= 2; dx++)
+            {
+                int2 tap = pixel + int2(dx, dy) * step;
+                if (any(tap < 0) || tap.x >= (int) width || tap.y >= (int) height)
+                    continue;
+
+                float4 color = LoadIllumination(tap);
+                float4 tapNormalDepth = GBufferNormalDepth[tap];
+                float3 tapNormal = UnitNormal(tapNormalDepth.xyz);
+
+                // Taps across a crease, a depth discontinuity or a change
+                // in lighting bigger than the noise count for less
+                float normalWeight = pow(max(dot(normal, tapNormal), 0.0f), normalPhi);
+                float pixelDistance = sqrt((float) (dx * dx + dy * dy)) * step;
+                float depthWeight = exp(-abs(depth - tapNormalDepth.w) / (depthPhi * depth * pixelDistance + 1e-6f));
+                float luminanceWeight = exp(-abs(luminance - Luminance(color.rgb)) / luminanceScale);
+
+                float weight = Kernel[dx + 2] * Kernel[dy + 2] * normalWeight * depthWeight * luminanceWeight;
+                sum += color.rgb * weight;
+                varianceSum += color.a * weight * weight;
+                weightSum += weight;
+            }
+        }
+
+        if (weightSum > 0)
+            result = float4(sum / weightSum, varianceSum / (weightSum * weightSum));
+    }
+
+    if (lastPass)
+        OutputColor[pixel] = float4(pow(max(result.rgb * DemodulationAlbedo(pixel), 0), 1.0f / 2.2f), 1);
+    else
+        Filtered[(pass + 1) % 2][pixel] = result;
+}
@@ -0,0 +1,536 @@
+#include "Denoiser.h"
+#include "Graphics.h"
+#include "GPUMemory.h"
+#include "GPUProfiler.h"
+
+#include <d3dcompiler.h>
+#include <DirectXPackedVector.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Makes use of integer division to ensure we are aligned to the proper multiple of "alignment"
+#define ALIGN(value, alignment) (((value + alignment - 1) / alignment) * alignment)
+
+namespace Denoiser
+{
+	// Annonymous namespace to hold variables/helpers
+	// only accessible in this file
+	namespace
+	{
+		bool initialized = false;
+
+		// Both shaders share one root signature
+		Microsoft::WRL::ComPtr<ID3D12RootSignature> rootSignature;
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState;
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> reprojectPipelineState;
+
+		// Must match the cbuffer in Denoise.hlsl
+		struct DenoiseConstants
+		{
+			unsigned int pass;
+			unsigned int lastPass;
+			float luminancePhi;
+			float normalPhi;
+			float depthPhi;
+		};
+		const unsigned int DenoiseConstantCount = sizeof(DenoiseConstants) / sizeof(UINT);
+
+		// Must match the cbuffer in Reproject.hlsl
+		struct ReprojectConstants
+		{
+			unsigned int useHistory;
+			float maxHistorySamples;
+			float clipGamma;
+			float depthTolerance;
+			float normalThreshold;
+		};
+		const unsigned int ReprojectConstantCount = sizeof(ReprojectConstants) / sizeof(UINT);
+		const unsigned int RootConstantCount = DenoiseConstantCount > ReprojectConstantCount ? DenoiseConstantCount : ReprojectConstantCount;
+
+		// Pixels per thread group, along each axis
+		const unsigned int GroupSize = 8;
+
+		// The path tracer's textures, the denoiser's own ping-pong
+		// textures for filtered illumination, and two sets of history
+		// (the reprojected color and moments, and the G-buffer they
+		// were made with, in the same formats as the path tracer's)
+		const unsigned int TextureCount = 16;
+		enum TextureIndex
+		{
+			Color, Moments, NormalDepth, Albedo, FilteredA, FilteredB, Output, Motion,
+			TemporalColorA, TemporalMomentsA, SavedNormalDepthA, SavedAlbedoA,
+			TemporalColorB, TemporalMomentsB, SavedNormalDepthB, SavedAlbedoB
+		};
+		const TextureIndex HistorySources[] = { Color, Moments, NormalDepth, Albedo };
+		const unsigned int HistorySetSize = ARRAYSIZE(HistorySources);
+		Microsoft::WRL::ComPtr<ID3D12Resource> textures[TextureCount];
+		unsigned int width = 0;
+		unsigned int height = 0;
+
+		// Which history set this frame writes (the other is last
+		// frame's), and whether last frame's can be used at all
+		unsigned int historySet = 0;
+		bool historyValid = false;
+
+		// One set of UAV slots per in-flight frame, so recreating the
+		// textures never overwrites descriptors the GPU might still be
+		// reading (the same as the path tracer's outputs).  Each set has
+		// a table for either history set being written, since the shader
+		// expects this frame's at u8-u11 and last frame's at u12-u15.
+		D3D12_CPU_DESCRIPTOR_HANDLE uavSlots_CPU[Graphics::MaxFramesInFlight][2][TextureCount]{};
+		D3D12_GPU_DESCRIPTOR_HANDLE uavSlots_GPU[Graphics::MaxFramesInFlight][2]{};
+		unsigned int uavSlotIndex = 0;
+
+		// Validation: where the spatial filter's inputs and output are
+		// copied for the CPU, and which frame and settings they came from
+		// (history textures are from the set written that frame)
+		const TextureIndex ValidatedTextures[] = { TemporalColorA, TemporalMomentsA, NormalDepth, Albedo, Output };
+		const unsigned int ValidatedTextureCount = ARRAYSIZE(ValidatedTextures);
+		Microsoft::WRL::ComPtr<ID3D12Resource> validationReadback;
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT validationFootprints[ValidatedTextureCount]{};
+		UINT64 validationReadbackSize = 0;
+		bool validationRequested = false;
+		bool validationPending = false;
+		UINT64 validationFence = 0;
+		ATrousSettings validationSettings;
+
+		// Largest difference from the CPU filter that's expected, in
+		// 8-bit steps - the GPU's exp() and pow() aren't exact
+		const int ValidationTolerance = 2;
+
+		// --------------------------------------------------------
+		// Which texture is in a table's slot, given the history
+		// set the table has this frame writing
+		// --------------------------------------------------------
+		TextureIndex TableTexture(unsigned int set, unsigned int slot)
+		{
+			if (slot < TemporalColorA)
+				return (TextureIndex)slot;
+
+			unsigned int offset = slot - TemporalColorA;
+			unsigned int slotSet = (offset / HistorySetSize + set) % 2;
+			return (TextureIndex)(TemporalColorA + slotSet * HistorySetSize + offset % HistorySetSize);
+		}
+
+		// --------------------------------------------------------
+		// Unpacks a read back texture of floats, half floats or
+		// 8-bit unorms into floats (with any missing channels zero)
+		// --------------------------------------------------------
+		std::vector<FilterFloat4> UnpackTexture(const unsigned char* data, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint)
+		{
+			unsigned int channels = footprint.Footprint.Format == DXGI_FORMAT_R32G32_FLOAT ? 2 : 4;
+			std::vector<FilterFloat4> pixels((size_t)width * height);
+			for (unsigned int y = 0; y < height; y++)
+			{
+				const unsigned char* row = data + footprint.Offset + (size_t)y * footprint.Footprint.RowPitch;
+				for (unsigned int x = 0; x < width; x++)
+				{
+					float* pixel = &pixels[(size_t)y * width + x].x;
+					for (unsigned int c = 0; c < channels; c++)
+					{
+						switch (footprint.Footprint.Format)
+						{
+						case DXGI_FORMAT_R32G32B32A32_FLOAT:
+						case DXGI_FORMAT_R32G32_FLOAT: pixel[c] = ((const float*)row)[x * channels + c]; break;
+						case DXGI_FORMAT_R16G16B16A16_FLOAT: pixel[c] = DirectX::PackedVector::XMConvertHalfToFloat(((const DirectX::PackedVector::HALF*)row)[x * 4 + c]); break;
+						default: pixel[c] = row[x * 4 + c] / 255.0f; break;
+						}
+					}
+				}
+			}
+			return pixels;
+		}
+
+		// --------------------------------------------------------
+		// Runs the CPU filter over a validated frame's inputs
+		// (once the GPU has finished it) and reports how far the
+		// shader's output is from it, and how long the CPU took
+		// --------------------------------------------------------
+		void CheckValidation()
+		{
+			if (!validationPending || Graphics::CompletedFrameFenceValue() < validationFence)
+				return;
+			validationPending = false;
+
+			unsigned char* mapped = 0;
+			D3D12_RANGE readRange = { 0, (SIZE_T)validationReadbackSize };
+			if (FAILED(validationReadback->Map(0, &readRange, (void**)&mapped)))
+				return;
+			std::vector<FilterFloat4> unpacked[ValidatedTextureCount];
+			for (unsigned int i = 0; i < ValidatedTextureCount; i++)
+				unpacked[i] = UnpackTexture(mapped, validationFootprints[i]);
+			D3D12_RANGE writeRange = { 0, 0 };
+			validationReadback->Unmap(0, &writeRange);
+
+			std::vector<FilterFloat2> moments(unpacked[1].size());
+			for (size_t i = 0; i < moments.size(); i++)
+				moments[i] = FilterFloat2{ unpacked[1][i].x, unpacked[1][i].y };
+
+			ATrousFilter::Frame frame;
+			frame.Width = width;
+			frame.Height = height;
+			frame.Color = unpacked[0].data();
+			frame.Moments = moments.data();
+			frame.NormalDepth = unpacked[2].data();
+			frame.Albedo = unpacked[3].data();
+
+			std::vector<FilterFloat3> expected;
+			auto start = std::chrono::high_resolution_clock::now();
+			ATrousFilter::Filter(frame, validationSettings, expected);
+			double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			// Compare in 8-bit steps, as the output is stored
+			int maxError = 0;
+			size_t failedPixels = 0;
+			const std::vector<FilterFloat4>& output = unpacked[4];
+			for (size_t i = 0; i < expected.size(); i++)
+			{
+				const float* expectedColor = &expected[i].x;
+				const float* outputColor = &output[i].x;
+				int pixelError = 0;
+				for (unsigned int c = 0; c < 3; c++)
+				{
+					int expectedValue = (int)(expectedColor[c] > 1 ? 255 : expectedColor[c] * 255 + 0.5f);
+					int error = abs((int)(outputColor[c] * 255 + 0.5f) - expectedValue);
+					pixelError = error > pixelError ? error : pixelError;
+				}
+				maxError = pixelError > maxError ? pixelError : maxError;
+				if (pixelError > ValidationTolerance)
+					failedPixels++;
+			}
+
+			double megapixels = (double)width * height / 1000000.0;
+			printf("\nDenoiser validation (%ux%u, %u passes): %s - max error %d/255, %zu pixels over %d/255\n",
+				width, height,
+				validationSettings.Enabled ? validationSettings.Iterations : 0,
+				failedPixels == 0 ? "passed" : "FAILED",
+				maxError, failedPixels, ValidationTolerance);
+			printf("CPU filter took %.1fms (%.1fms per megapixel)\n", cpuMs, cpuMs / megapixels);
+		}
+
+		// --------------------------------------------------------
+		// Copies the inputs and output where the CPU can read them
+		// once this frame is done
+		// --------------------------------------------------------
+		void CopyForValidation(ID3D12GraphicsCommandList* commandList)
+		{
+			if (!validationReadback)
+			{
+				validationReadback = Graphics::CreateBuffer(
+					validationReadbackSize,
+					D3D12_HEAP_TYPE_READBACK,
+					D3D12_RESOURCE_STATE_COPY_DEST);
+			}
+
+			ID3D12Resource* sources[ValidatedTextureCount] = {};
+			for (unsigned int i = 0; i < ValidatedTextureCount; i++)
+				sources[i] = textures[TableTexture(historySet, ValidatedTextures[i])].Get();
+
+			D3D12_RESOURCE_BARRIER barriers[ValidatedTextureCount] = {};
+			for (unsigned int i = 0; i < ValidatedTextureCount; i++)
+			{
+				barriers[i].Transition.pResource = sources[i];
+				barriers[i].Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+				barriers[i].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+				barriers[i].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+			}
+			commandList->ResourceBarrier(ValidatedTextureCount, barriers);
+
+			for (unsigned int i = 0; i < ValidatedTextureCount; i++)
+			{
+				D3D12_TEXTURE_COPY_LOCATION destination = {};
+				destination.pResource = validationReadback.Get();
+				destination.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+				destination.PlacedFootprint = validationFootprints[i];
+
+				D3D12_TEXTURE_COPY_LOCATION source = {};
+				source.pResource = sources[i];
+				source.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+				source.SubresourceIndex = 0;
+
+				commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, 0);
+			}
+
+			for (unsigned int i = 0; i < ValidatedTextureCount; i++)
+			{
+				barriers[i].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
+				barriers[i].Transition.StateAfter = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+			}
+			commandList->ResourceBarrier(ValidatedTextureCount, barriers);
+
+			validationRequested = false;
+			validationPending = true;
+			validationFence = Graphics::CurrentFrameFenceValue();
+			validationSettings = Settings;
+		}
+	}
+}
+
+
+// --------------------------------------------------------
+// Creates the root signature and pipeline states for the
+// filter's and reprojection's compute shaders
+// --------------------------------------------------------
+HRESULT Denoiser::Initialize(std::wstring denoiseShaderFile, std::wstring reprojectShaderFile)
+{
+	Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+	Microsoft::WRL::ComPtr<ID3DBlob> reprojectShaderBlob;
+	HRESULT result = D3DReadFileToBlob(denoiseShaderFile.c_str(), shaderBlob.GetAddressOf());
+	if (SUCCEEDED(result))
+		result = D3DReadFileToBlob(reprojectShaderFile.c_str(), reprojectShaderBlob.GetAddressOf());
+	if (FAILED(result))
+	{
+		printf("\nERROR: Could not load the denoiser's shaders - denoising is unavailable.\n");
+		return result;
+	}
+
+	// Two parameters: root constants for the pass, and a table
+	// of every texture the passes touch
+	{
+		D3D12_DESCRIPTOR_RANGE uavRange = {};
+		uavRange.BaseShaderRegister = 0;
+		uavRange.NumDescriptors = TextureCount;
+		uavRange.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+		uavRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+		uavRange.RegisterSpace = 0;
+
+		D3D12_ROOT_PARAMETER rootParams[2] = {};
+		rootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+		rootParams[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+		rootParams[0].Constants.Num32BitValues = RootConstantCount;
+		rootParams[0].Constants.ShaderRegister = 0;
+		rootParams[0].Constants.RegisterSpace = 0;
+
+		rootParams[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+		rootParams[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+		rootParams[1].DescriptorTable.NumDescriptorRanges = 1;
+		rootParams[1].DescriptorTable.pDescriptorRanges = &uavRange;
+
+		Microsoft::WRL::ComPtr<ID3DBlob> blob;
+		Microsoft::WRL::ComPtr<ID3DBlob> errors;
+		D3D12_ROOT_SIGNATURE_DESC rootSigDesc = {};
+		rootSigDesc.NumParameters = ARRAYSIZE(rootParams);
+		rootSigDesc.pParameters = rootParams;
+		rootSigDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
+
+		D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1, blob.GetAddressOf(), errors.GetAddressOf());
+		result = Graphics::Device->CreateRootSignature(0, blob->GetBufferPointer(), blob->GetBufferSize(), IID_PPV_ARGS(rootSignature.GetAddressOf()));
+		if (FAILED(result))
+			return result;
+	}
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+	psoDesc.pRootSignature = rootSignature.Get();
+	psoDesc.CS.pShaderBytecode = shaderBlob->GetBufferPointer();
+	psoDesc.CS.BytecodeLength = shaderBlob->GetBufferSize();
+	result = Graphics::Device->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(pipelineState.GetAddressOf()));
+	if (FAILED(result))
+		return result;
+
+	psoDesc.CS.pShaderBytecode = reprojectShaderBlob->GetBufferPointer();
+	psoDesc.CS.BytecodeLength = reprojectShaderBlob->GetBufferSize();
+	result = Graphics::Device->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(reprojectPipelineState.GetAddressOf()));
+	if (FAILED(result))
+		return result;
+
+	initialized = true;
+	return S_OK;
+}
+
+
+// --------------------------------------------------------
+// Takes the path tracer's new textures, recreates the
+// ping-pong and history textures and readback buffer at
+// the same size, and fills in the next set of UAV slots
+// --------------------------------------------------------
+void Denoiser::SetInputs(
+	Microsoft::WRL::ComPtr<ID3D12Resource> color,
+	Microsoft::WRL::ComPtr<ID3D12Resource> moments,
+	Microsoft::WRL::ComPtr<ID3D12Resource> normalDepth,
+	Microsoft::WRL::ComPtr<ID3D12Resource> albedo,
+	Microsoft::WRL::ComPtr<ID3D12Resource> motion,
+	Microsoft::WRL::ComPtr<ID3D12Resource> output)
+{
+	textures[Color] = color;
+	textures[Moments] = moments;
+	textures[NormalDepth] = normalDepth;
+	textures[Albedo] = albedo;
+	textures[Motion] = motion;
+	textures[Output] = output;
+
+	D3D12_RESOURCE_DESC desc = output->GetDesc();
+	width = (unsigned int)desc.Width;
+	height = desc.Height;
+
+	// Filtered illumination is HDR, and its variance can get tiny
+	// enough that half floats would flush it to zero
+	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	desc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+	for (TextureIndex filtered : { FilteredA, FilteredB })
+	{
+		Graphics::ReleaseWhenFrameCompletes(textures[filtered]);
+		textures[filtered] = GPUMemory::CreatePlacedResource(
+			desc,
+			D3D12_HEAP_TYPE_DEFAULT,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	}
+
+	// History is in the same formats as what it's made from, and
+	// there's none at the new size yet
+	for (unsigned int set = 0; set < 2; set++)
+	{
+		for (unsigned int i = 0; i < HistorySetSize; i++)
+		{
+			unsigned int index = TemporalColorA + set * HistorySetSize + i;
+			Graphics::ReleaseWhenFrameCompletes(textures[index]);
+			textures[index] = GPUMemory::CreatePlacedResource(
+				textures[HistorySources[i]]->GetDesc(),
+				D3D12_HEAP_TYPE_DEFAULT,
+				D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}
+	}
+	historyValid = false;
+
+	// Where validated frames are copied, one texture after another
+	// (the buffer itself is only created once it's needed)
+	validationReadbackSize = 0;
+	for (unsigned int i = 0; i < ValidatedTextureCount; i++)
+	{
+		D3D12_RESOURCE_DESC textureDesc = textures[ValidatedTextures[i]]->GetDesc();
+		UINT64 textureSize = 0;
+		Graphics::Device->GetCopyableFootprints(&textureDesc, 0, 1, 0, &validationFootprints[i], 0, 0, &textureSize);
+		validationFootprints[i].Offset = validationReadbackSize;
+		validationReadbackSize = ALIGN(validationReadbackSize + textureSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+	}
+	Graphics::ReleaseWhenFrameCompletes(validationReadback);
+	validationReadback.Reset();
+	validationPending = false;
+
+	// Do we have UAV slots already?
+	if (!uavSlots_GPU[0][0].ptr)
+	{
+		// Nope, so reserve them - each table must be
+		// consecutive, since it's bound as one
+		for (unsigned int i = 0; i < Graphics::MaxFramesInFlight; i++)
+		{
+			for (unsigned int set = 0; set < 2; set++)
+			{
+				for (unsigned int t = 0; t < TextureCount; t++)
+					Graphics::ReserveDescriptorHeapSlot(&uavSlots_CPU[i][set][t], t == 0 ? &uavSlots_GPU[i][set] : 0);
+			}
+		}
+	}
+	else
+	{
+		// Move on to the next set, which by the time we've
+		// cycled through all of them is no longer in use
+		uavSlotIndex = (uavSlotIndex + 1) % Graphics::MaxFramesInFlight;
+	}
+
+	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+	for (unsigned int set = 0; set < 2; set++)
+	{
+		for (unsigned int t = 0; t < TextureCount; t++)
+		{
+			Graphics::Device->CreateUnorderedAccessView(
+				textures[TableTexture(set, t)].Get(),
+				0,
+				&uavDesc,
+				uavSlots_CPU[uavSlotIndex][set][t]);
+		}
+	}
+}
+
+
+// --------------------------------------------------------
+// Reprojects last frame's result, then filters the path
+// tracer's output in place, one dispatch per pass, with a
+// UAV barrier between dispatches since each reads what the
+// last one wrote
+// --------------------------------------------------------
+void Denoiser::Denoise(ID3D12GraphicsCommandList* commandList)
+{
+	if (!initialized || !textures[Output])
+		return;
+
+	// Anything validated earlier might be ready by now
+	CheckValidation();
+
+	// Tracing (and each pass) must be done writing before the next pass reads
+	D3D12_RESOURCE_BARRIER uavBarrier = {};
+	uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+	uavBarrier.UAV.pResource = 0; // Any UAV access
+
+	unsigned int iterations = Settings.Enabled ? Settings.Iterations : 0;
+	if (iterations > 0)
+	{
+		GPUProfiler::ScopedZone zone("Denoise", commandList);
+
+		ID3D12DescriptorHeap* heap[] = { Graphics::CBVSRVDescriptorHeap.Get() };
+		commandList->SetDescriptorHeaps(1, heap);
+		commandList->SetComputeRootSignature(rootSignature.Get());
+
+		// Reuse what can be found of last frame's result, and
+		// keep this frame's for the next
+		historySet = 1 - historySet;
+		commandList->SetComputeRootDescriptorTable(1, uavSlots_GPU[uavSlotIndex][historySet]);
+		{
+			GPUProfiler::ScopedZone reprojectZone("Reproject", commandList);
+			commandList->ResourceBarrier(1, &uavBarrier);
+			commandList->SetPipelineState(reprojectPipelineState.Get());
+
+			ReprojectConstants constants = {};
+			constants.useHistory = historyValid && Temporal.Enabled;
+			constants.maxHistorySamples = (float)Temporal.MaxHistorySamples;
+			constants.clipGamma = Temporal.ClipGamma;
+			constants.depthTolerance = Temporal.DepthTolerance;
+			constants.normalThreshold = Temporal.NormalThreshold;
+			commandList->SetComputeRoot32BitConstants(0, ReprojectConstantCount, &constants, 0);
+
+			commandList->Dispatch(
+				(width + GroupSize - 1) / GroupSize,
+				(height + GroupSize - 1) / GroupSize,
+				1);
+			historyValid = true;
+		}
+
+		commandList->SetPipelineState(pipelineState.Get());
+		for (unsigned int pass = 0; pass < iterations; pass++)
+		{
+			commandList->ResourceBarrier(1, &uavBarrier);
+
+			DenoiseConstants constants = {};
+			constants.pass = pass;
+			constants.lastPass = pass + 1 == iterations;
+			constants.luminancePhi = Settings.LuminancePhi;
+			constants.normalPhi = Settings.NormalPhi;
+			constants.depthPhi = Settings.DepthPhi;
+			commandList->SetComputeRoot32BitConstants(0, DenoiseConstantCount, &constants, 0);
+
+			commandList->Dispatch(
+				(width + GroupSize - 1) / GroupSize,
+				(height + GroupSize - 1) / GroupSize,
+				1);
+		}
+	}
+	else
+	{
+		// Nothing's kept while the denoiser is off
+		historyValid = false;
+	}
+
+	// The history set written this frame holds the spatial filter's inputs
+	if (validationRequested && !validationPending && iterations > 0)
+	{
+		commandList->ResourceBarrier(1, &uavBarrier);
+		CopyForValidation(commandList);
+	}
+}
+
+void Denoiser::RequestValidation()
+{
+	validationRequested = true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <string>
+
+#include "ATrousFilter.h"
+#include "TemporalReprojection.h"
+
+// --------------------------------------------------------
+// Runs the edge-avoiding a-trous filter (see ATrousFilter.h)
+// over the path tracer's output in compute, one dispatch
+// per pass, between tracing and the copy to the back
+// buffer.
+//
+// First, last frame's result is reprojected along the
+// path tracer's motion vectors and blended with the
+// accumulated color (see TemporalReprojection.h).  The
+// result, and the G-buffer it was made with, are kept for
+// next frame in one of two sets of history textures, which
+// swap every frame.
+//
+// The spatial passes filter that result, ping-ponging
+// illumination between two textures of its own, and the
+// last pass overwrites the path tracer's output.
+//
+// On request, one frame's spatial filter inputs and output
+// are read back and run through the CPU filter to check the
+// shader against it, which also times the CPU filter.  The
+// GPU's time is the "Denoise" profiler zone, which includes
+// the "Reproject" zone.
+// --------------------------------------------------------
+namespace Denoiser
+{
+	// --- GLOBAL VARS ---
+	inline ATrousSettings Settings;
+	inline TemporalSettings Temporal;
+
+	// --- FUNCTIONS ---
+	HRESULT Initialize(std::wstring denoiseShaderFile, std::wstring reprojectShaderFile);
+
+	// Call whenever the path tracer's textures are (re)created,
+	// which also resizes the denoiser's own textures to match
+	void SetInputs(
+		Microsoft::WRL::ComPtr<ID3D12Resource> color,
+		Microsoft::WRL::ComPtr<ID3D12Resource> moments,
+		Microsoft::WRL::ComPtr<ID3D12Resource> normalDepth,
+		Microsoft::WRL::ComPtr<ID3D12Resource> albedo,
+		Microsoft::WRL::ComPtr<ID3D12Resource> motion,
+		Microsoft::WRL::ComPtr<ID3D12Resource> output);
+
+	// Records every pass - the inputs and output must be in the
+	// unordered access state, and stay there.  May be called from
+	// any one thread, with a list of its own.
+	void Denoise(ID3D12GraphicsCommandList* commandList);
+
+	// Checks the next denoised frame against the CPU filter,
+	// printing the results once the GPU is done with it
+	// (waits for the denoiser to be on)
+	void RequestValidation();
+}
@@ -5,7 +5,7 @@ Entity::Entity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Camera> camera, std::
 	transform = std::shared_ptr<Transform>(new Transform());
 }
 
-std::shared_ptr<Mesh> Entity::GetMesh()
+std::shared_ptr<Mesh> Entity::GetMesh() const
 {
 	return mesh;
 }
@@ -15,12 +15,12 @@ void Entity::SetMesh(std::shared_ptr<Mesh> mesh)
 	this->mesh = mesh;
 };
 
-std::shared_ptr<Transform> Entity::GetTransform()
+std::shared_ptr<Transform> Entity::GetTransform() const
 {
 	return transform;
 }
 
-std::shared_ptr<Material> Entity::GetMaterial()
+std::shared_ptr<Material> Entity::GetMaterial() const
 {
 	return material;
 }
@@ -16,12 +16,12 @@ private:
 public:
 	Entity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Camera> camera, std::shared_ptr<Material> material);
 
-	std::shared_ptr<Mesh> GetMesh();
+	std::shared_ptr<Mesh> GetMesh() const;
 	void SetMesh(std::shared_ptr<Mesh> mesh);
 
-	std::shared_ptr<Transform> GetTransform();
+	std::shared_ptr<Transform> GetTransform() const;
 
-	std::shared_ptr<Material> GetMaterial();
+	std::shared_ptr<Material> GetMaterial() const;
 	void SetMaterial(std::shared_ptr<Material> material);
 };
 
@@ -0,0 +1,167 @@
+#include "EnvironmentDistribution.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Annonymous namespace to hold variables/helpers
+// only accessible in this file
+namespace
+{
+	const float Pi = 3.14159265f;
+
+	// Distribution rows per job
+	const unsigned int RowsPerJob = 8;
+
+	// Turns running totals into a CDF ending at exactly 1, or an
+	// even one if there's nothing to go on.  Returns the total.
+	float NormalizeCDF(float* cdf, unsigned int count)
+	{
+		float total = cdf[count - 1];
+		for (unsigned int i = 0; i < count; i++)
+			cdf[i] = total > 0 ? cdf[i] / total : (float)(i + 1) / count;
+		cdf[count - 1] = 1.0f;
+		return total;
+	}
+
+	// First entry above u, which is never an empty bin
+	unsigned int FindInCDF(const float* cdf, unsigned int count, float u)
+	{
+		unsigned int index = (unsigned int)(std::upper_bound(cdf, cdf + count, u) - cdf);
+		return std::min(index, count - 1);
+	}
+}
+
+EnvironmentDistribution::EnvironmentDistribution() :
+	width(0),
+	height(0)
+{
+}
+
+void EnvironmentDistribution::Build(const RadianceHDR::Image& image)
+{
+	width = 0;
+	height = 0;
+	cdfs.clear();
+	if (image.Width == 0 || image.Height == 0)
+		return;
+
+	// Average big maps down in square blocks
+	unsigned int blockSize = (image.Width + MaxWidth - 1) / MaxWidth;
+	width = (image.Width + blockSize - 1) / blockSize;
+	height = (image.Height + blockSize - 1) / blockSize;
+	cdfs.resize(height + (size_t)width * height);
+
+	// Each row's weights, summed as they go
+	std::vector<float> rowTotals(height);
+	JobSystem::ParallelFor(height, RowsPerJob, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int y = begin; y < end; y++)
+			{
+				float sinTheta = std::sin((y + 0.5f) / height * Pi);
+				unsigned int top = y * blockSize;
+				unsigned int bottom = std::min(top + blockSize, image.Height);
+
+				float* row = &cdfs[height + (size_t)y * width];
+				float total = 0;
+				for (unsigned int x = 0; x < width; x++)
+				{
+					unsigned int left = x * blockSize;
+					unsigned int right = std::min(left + blockSize, image.Width);
+
+					float luminance = 0;
+					for (unsigned int py = top; py < bottom; py++)
+					{
+						for (unsigned int px = left; px < right; px++)
+						{
+							RadianceHDR::Color color = RadianceHDR::Decode(image, px, py);
+							luminance += 0.2126f * color.R + 0.7152f * color.G + 0.0722f * color.B;
+						}
+					}
+
+					total += luminance / ((bottom - top) * (right - left)) * sinTheta;
+					row[x] = total;
+				}
+				rowTotals[y] = NormalizeCDF(row, width);
+			}
+		});
+
+	// Then the rows against each other
+	float total = 0;
+	for (unsigned int y = 0; y < height; y++)
+	{
+		total += rowTotals[y];
+		cdfs[y] = total;
+	}
+	NormalizeCDF(cdfs.data(), height);
+}
+
+unsigned int EnvironmentDistribution::GetWidth() const { return width; }
+unsigned int EnvironmentDistribution::GetHeight() const { return height; }
+const std::vector<float>& EnvironmentDistribution::GetCDFs() const { return cdfs; }
+
+// --------------------------------------------------------
+// Picks a row, then a column within it, then a spot within
+// that texel.  The pdf over the unit square is constant
+// over each texel, and converts to solid angle by dividing
+// by the area the square maps to: 2 * PI * PI * sin(theta).
+// --------------------------------------------------------
+EnvironmentFloat3 EnvironmentDistribution::Sample(float u0, float u1, float* pdf) const
+{
+	*pdf = 0;
+	if (cdfs.empty())
+		return EnvironmentFloat3{ 0, 1, 0 };
+
+	unsigned int y = FindInCDF(cdfs.data(), height, u1);
+	float rowStart = y > 0 ? cdfs[y - 1] : 0;
+	float rowEnd = cdfs[y];
+
+	const float* row = &cdfs[height + (size_t)y * width];
+	unsigned int x = FindInCDF(row, width, u0);
+	float columnStart = x > 0 ? row[x - 1] : 0;
+	float columnEnd = row[x];
+
+	EnvironmentFloat2 uv{
+		(x + (u0 - columnStart) / std::max(columnEnd - columnStart, 1e-12f)) / width,
+		(y + (u1 - rowStart) / std::max(rowEnd - rowStart, 1e-12f)) / height };
+
+	float sinTheta = std::sin(uv.y * Pi);
+	float pdfUV = (rowEnd - rowStart) * height * (columnEnd - columnStart) * width;
+	*pdf = sinTheta > 0 ? pdfUV / (2 * Pi * Pi * sinTheta) : 0;
+	return UVToDirection(uv);
+}
+
+float EnvironmentDistribution::Pdf(const EnvironmentFloat3& direction) const
+{
+	if (cdfs.empty())
+		return 0;
+
+	EnvironmentFloat2 uv = DirectionToUV(direction);
+	unsigned int x = std::min((unsigned int)(uv.x * width), width - 1);
+	unsigned int y = std::min((unsigned int)(uv.y * height), height - 1);
+
+	const float* row = &cdfs[height + (size_t)y * width];
+	float rowProbability = cdfs[y] - (y > 0 ? cdfs[y - 1] : 0);
+	float columnProbability = row[x] - (x > 0 ? row[x - 1] : 0);
+
+	float sinTheta = std::sqrt(std::max(1 - direction.y * direction.y, 0.0f));
+	float pdfUV = rowProbability * height * columnProbability * width;
+	return sinTheta > 0 ? pdfUV / (2 * Pi * Pi * sinTheta) : 0;
+}
+
+EnvironmentFloat2 EnvironmentDistribution::DirectionToUV(const EnvironmentFloat3& direction)
+{
+	return EnvironmentFloat2{
+		(std::atan2(direction.z, direction.x) + Pi) / (2 * Pi),
+		std::acos(std::clamp(direction.y, -1.0f, 1.0f)) / Pi };
+}
+
+EnvironmentFloat3 EnvironmentDistribution::UVToDirection(const EnvironmentFloat2& uv)
+{
+	float theta = uv.y * Pi;
+	float phi = uv.x * 2 * Pi - Pi;
+	return EnvironmentFloat3{
+		std::sin(theta) * std::cos(phi),
+		std::cos(theta),
+		std::sin(theta) * std::sin(phi) };
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+
+#include "RadianceHDR.h"
+
+// Directions and equirectangular coordinates, kept plain
+// so the distribution doesn't need DirectXMath
+struct EnvironmentFloat2
+{
+	float x = 0;
+	float y = 0;
+};
+
+struct EnvironmentFloat3
+{
+	float x = 0;
+	float y = 0;
+	float z = 0;
+};
+
+// --------------------------------------------------------
+// Piecewise-constant 2D distribution over an equirectangular
+// environment map, for picking directions in proportion to
+// how bright the sky is that way (Pharr, Jakob & Humphreys,
+// "Physically Based Rendering", 13.6.5 and 14.2.4).
+//
+// Each texel's weight is its luminance times the sine of
+// its elevation, since rows near the poles cover less of
+// the sphere.  One cumulative distribution (CDF) per row
+// picks a column, and a marginal CDF over the rows' totals
+// picks the row.  Maps wider than MaxWidth are averaged
+// down in square blocks first - the distribution only
+// needs to roughly follow the map, and an 8K one would be
+// hundreds of megabytes.
+//
+// Rows are built in parallel on the job system.
+//
+// Directions: v = 0 is straight up (+Y), and u wraps around
+// starting from -X, through -Z, +X and +Z.
+//
+// Sampling and pdfs are implemented here too, on the CPU,
+// as a reference for the shader.
+//
+// Nothing here knows about D3D12.
+// --------------------------------------------------------
+class EnvironmentDistribution
+{
+public:
+	static const unsigned int MaxWidth = 2048;
+
+	EnvironmentDistribution();
+
+	void Build(const RadianceHDR::Image& image);
+
+	// Size of the distribution, which may be smaller than the map
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+
+	// The marginal CDF (one value per row), then every row's
+	// conditional CDF (one value per column) - each entry is
+	// the total up to and including that row or column
+	const std::vector<float>& GetCDFs() const;
+
+	// Solid angle pdfs, matching the shader
+	EnvironmentFloat3 Sample(float u0, float u1, float* pdf) const;
+	float Pdf(const EnvironmentFloat3& direction) const;
+
+	static EnvironmentFloat2 DirectionToUV(const EnvironmentFloat3& direction);
+	static EnvironmentFloat3 UVToDirection(const EnvironmentFloat2& uv);
+
+private:
+	unsigned int width;
+	unsigned int height;
+	std::vector<float> cdfs;
+};
@@ -0,0 +1,61 @@
+#include "FixedTimestep.h"
+
+#include <algorithm>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Leftover time within this fraction of a step still counts
+	// as a full step, so a frame time equal to the step size
+	// reliably runs exactly one step despite rounding
+	const double StepTolerance = 1e-6;
+}
+
+
+FixedTimestep::FixedTimestep(double stepSeconds, unsigned int maxStepsPerFrame) :
+	stepSeconds(stepSeconds),
+	maxStepsPerFrame(std::max(maxStepsPerFrame, 1u)),
+	accumulator(0),
+	time(0),
+	stepCount(0),
+	droppedSeconds(0)
+{
+}
+
+// --------------------------------------------------------
+// Banks another frame's worth of time, dropping anything
+// beyond what maxStepsPerFrame steps can consume
+// --------------------------------------------------------
+void FixedTimestep::AddFrameTime(double frameSeconds)
+{
+	accumulator += std::max(frameSeconds, 0.0);
+
+	double maxAccumulated = stepSeconds * maxStepsPerFrame;
+	if (accumulator > maxAccumulated)
+	{
+		droppedSeconds += accumulator - maxAccumulated;
+		accumulator = maxAccumulated;
+	}
+}
+
+// --------------------------------------------------------
+// Consumes one step of banked time, if there is enough.
+// Returns true when the caller should simulate a step.
+// --------------------------------------------------------
+bool FixedTimestep::Step()
+{
+	if (accumulator < stepSeconds * (1.0 - StepTolerance))
+		return false;
+
+	accumulator = std::max(accumulator - stepSeconds, 0.0);
+	time += stepSeconds;
+	stepCount++;
+	return true;
+}
+
+double FixedTimestep::GetStepSeconds() const { return stepSeconds; }
+double FixedTimestep::GetTime() const { return time; }
+float FixedTimestep::GetAlpha() const { return (float)std::min(accumulator / stepSeconds, 1.0); }
+uint64_t FixedTimestep::GetStepCount() const { return stepCount; }
+double FixedTimestep::GetDroppedSeconds() const { return droppedSeconds; }
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+// --------------------------------------------------------
+// Turns variable frame times into a whole number of fixed
+// simulation steps, so simulation results don't depend on
+// the frame rate.
+//
+// Each frame, add its duration with AddFrameTime() and then
+// call Step() until it returns false.  Whatever time is left
+// over carries into the next frame, and GetAlpha() says how
+// far between the last two steps the frame actually is, for
+// interpolating what gets rendered.
+//
+// To avoid spiraling (slow frames needing more steps, which
+// make frames slower still) a single frame runs at most
+// maxStepsPerFrame steps and the rest of its time is dropped.
+// --------------------------------------------------------
+class FixedTimestep
+{
+public:
+	FixedTimestep(double stepSeconds = 1.0 / 60.0, unsigned int maxStepsPerFrame = 8);
+
+	void AddFrameTime(double frameSeconds);
+	bool Step();
+
+	// Getters
+	double GetStepSeconds() const;
+	double GetTime() const;			// Simulated time after the last step
+	float GetAlpha() const;			// 0-1 between the last two steps
+	uint64_t GetStepCount() const;
+	double GetDroppedSeconds() const;
+
+private:
+	double stepSeconds;
+	unsigned int maxStepsPerFrame;
+
+	double accumulator;
+	double time;
+	uint64_t stepCount;
+	double droppedSeconds;
+};
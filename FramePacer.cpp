@@ -0,0 +1,172 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Annonymous namespace to hold variables/helpers
+// only accessible in this file
+namespace
+{
+	// How quickly predictions follow changes in cost
+	const double PredictorWeight = 0.1;
+
+	// Standard deviations of headroom in each prediction, so
+	// a slightly slow CPU frame or a slightly fast GPU frame
+	// doesn't leave the GPU idle.  Both mean sleeping less: the
+	// CPU is predicted on the slow side, the GPU on the fast.
+	const double PredictorDeviations = 2.0;
+
+	// Costs far above the prediction are treated as one-off
+	// hitches and only count as this much, so a single very slow
+	// frame doesn't throw the predictions off for dozens of
+	// frames afterwards.  A lasting change still gets through,
+	// as the variance grows with it.
+	const double OutlierDeviations = 4.0;
+	const double OutlierFraction = 0.5;
+}
+
+void FramePacer::CostPredictor::Add(double ms)
+{
+	if (!HasSamples)
+	{
+		Mean = ms;
+		Variance = 0;
+		HasSamples = true;
+		return;
+	}
+
+	double outlierMs = Mean * (1.0 + OutlierFraction) + OutlierDeviations * std::sqrt(Variance);
+	double difference = std::min(ms, outlierMs) - Mean;
+	Mean += PredictorWeight * difference;
+	Variance = (1.0 - PredictorWeight) * (Variance + PredictorWeight * difference * difference);
+}
+
+double FramePacer::CostPredictor::Predict(double deviations) const
+{
+	return std::max(Mean + deviations * std::sqrt(Variance), 0.0);
+}
+
+
+FramePacer::FramePacer() :
+	enabled(false),
+	safetyMarginMs(0.5),
+	lastSubmittedFrame(0),
+	lastGPUFrame(0),
+	lastGPUFrameEndMs(0)
+{
+}
+
+void FramePacer::SetEnabled(bool enabled) { this->enabled = enabled; }
+bool FramePacer::GetEnabled() const { return enabled; }
+void FramePacer::SetSafetyMarginMs(double marginMs) { safetyMarginMs = std::max(marginMs, 0.0); }
+double FramePacer::GetSafetyMarginMs() const { return safetyMarginMs; }
+
+// --------------------------------------------------------
+// Estimates when the GPU will finish everything submitted
+// so far, starting from the last frame it's known to have
+// finished: each later frame starts once both it has been
+// submitted and the frame before it is done.  The next
+// frame should then be submitted right at that moment, so
+// its input is sampled the predicted CPU cost before it.
+// --------------------------------------------------------
+double FramePacer::GetSleepMs(double nowMs, uint64_t completedFrame) const
+{
+	if (!enabled || !cpuCost.HasSamples || !gpuCost.HasSamples || lastGPUFrame == 0)
+		return 0;
+
+	double predictedGPUMs = gpuCost.Predict(-PredictorDeviations);
+	double gpuFreeMs = lastGPUFrameEndMs;
+	for (uint64_t frame = lastGPUFrame + 1; frame <= lastSubmittedFrame; frame++)
+	{
+		// Too old to estimate?  Then the GPU is too far behind
+		// for sleeping to help anyway.
+		const FrameRecord* record = FindFrame(frame);
+		if (!record || !record->Submitted)
+			return 0;
+
+		gpuFreeMs = std::max(gpuFreeMs, record->SubmitMs) + predictedGPUMs;
+
+		// Finished frames can't end in the future
+		if (frame <= completedFrame)
+			gpuFreeMs = std::min(gpuFreeMs, nowMs);
+	}
+
+	double inputSampleMs = gpuFreeMs - cpuCost.Predict(PredictorDeviations) - safetyMarginMs;
+	return std::clamp(inputSampleMs - nowMs, 0.0, MaxSleepMs);
+}
+
+// --------------------------------------------------------
+// Input for the given frame was just sampled, after
+// sleeping for the given time
+// --------------------------------------------------------
+void FramePacer::BeginFrame(uint64_t frame, double inputSampleMs, double sleptMs)
+{
+	FrameRecord& record = history[frame % HistorySize];
+	record.Frame = frame;
+	record.InputSampleMs = inputSampleMs;
+	record.Submitted = false;
+
+	stats.FrameCount++;
+	stats.SleepMs += sleptMs;
+}
+
+// --------------------------------------------------------
+// The given frame was just handed to the GPU.  Its CPU cost
+// is everything from sampling input up to now.
+// --------------------------------------------------------
+void FramePacer::EndFrame(uint64_t frame, double submitMs)
+{
+	FrameRecord& record = history[frame % HistorySize];
+	if (record.Frame != frame)
+		return;
+
+	record.SubmitMs = submitMs;
+	record.Submitted = true;
+	lastSubmittedFrame = std::max(lastSubmittedFrame, frame);
+
+	cpuCost.Add(std::max(submitMs - record.InputSampleMs, 0.0));
+	stats.PredictedCPUMs = cpuCost.Predict(PredictorDeviations);
+}
+
+// --------------------------------------------------------
+// The GPU's start and end times for a finished frame, which
+// give both its GPU cost and its input latency
+// --------------------------------------------------------
+void FramePacer::RecordGPUFrame(uint64_t frame, double startMs, double endMs)
+{
+	gpuCost.Add(std::max(endMs - startMs, 0.0));
+	stats.PredictedGPUMs = gpuCost.Predict(-PredictorDeviations);
+
+	if (frame > lastGPUFrame)
+	{
+		lastGPUFrame = frame;
+		lastGPUFrameEndMs = endMs;
+	}
+
+	const FrameRecord* record = FindFrame(frame);
+	if (record)
+	{
+		double latencyMs = std::max(endMs - record->InputSampleMs, 0.0);
+		stats.LatencySampleCount++;
+		stats.LatencyMs += latencyMs;
+		stats.MaxLatencyMs = std::max(stats.MaxLatencyMs, latencyMs);
+	}
+}
+
+FramePacerStats FramePacer::GetStats() const { return stats; }
+
+// --------------------------------------------------------
+// Starts a new measurement window, keeping the predictions
+// --------------------------------------------------------
+void FramePacer::ResetStats()
+{
+	stats = {};
+	stats.PredictedCPUMs = cpuCost.HasSamples ? cpuCost.Predict(PredictorDeviations) : 0;
+	stats.PredictedGPUMs = gpuCost.HasSamples ? gpuCost.Predict(-PredictorDeviations) : 0;
+}
+
+const FramePacer::FrameRecord* FramePacer::FindFrame(uint64_t frame) const
+{
+	const FrameRecord& record = history[frame % HistorySize];
+	return record.Frame == frame ? &record : 0;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+
+// Latency and pacing over a stretch of frames
+struct FramePacerStats
+{
+	uint64_t FrameCount = 0;
+	double SleepMs = 0;				// Total time spent sleeping before sampling input
+
+	// Input-to-GPU-finished latency of frames whose GPU timing has arrived
+	uint64_t LatencySampleCount = 0;
+	double LatencyMs = 0;
+	double MaxLatencyMs = 0;
+
+	// Latest predictions
+	double PredictedCPUMs = 0;
+	double PredictedGPUMs = 0;
+
+	double AverageSleepMs() const { return FrameCount ? SleepMs / FrameCount : 0; }
+	double AverageLatencyMs() const { return LatencySampleCount ? LatencyMs / LatencySampleCount : 0; }
+};
+
+// --------------------------------------------------------
+// Predicts how long the CPU and GPU will take on the next
+// frame and decides how long to sleep before sampling
+// input, so the frame is submitted just as the GPU runs out
+// of earlier work.  Frames then don't sit in a queue, and
+// input is sampled as late as possible.
+//
+// Each frame is identified by its frame fence value.  The
+// owner reports when input was sampled, when the frame was
+// submitted, and (once known) when the GPU started and
+// finished it, all in milliseconds on the same clock.  GPU
+// timings may arrive several frames late; frames since then
+// are estimated from the predicted GPU cost.
+//
+// Pacing only ever adds sleep.  The hard limit on how many
+// frames can be queued is the number of frames in flight.
+//
+// This class knows nothing about D3D12, so it can be driven
+// by recorded timings just as well as live ones.
+// --------------------------------------------------------
+class FramePacer
+{
+public:
+	// Frames remembered while waiting for their GPU timings
+	static constexpr unsigned int HistorySize = 16;
+
+	// Never sleep longer than this, even if predictions say to
+	static constexpr double MaxSleepMs = 50.0;
+
+	FramePacer();
+
+	// Settings
+	void SetEnabled(bool enabled);
+	bool GetEnabled() const;
+	void SetSafetyMarginMs(double marginMs);
+	double GetSafetyMarginMs() const;
+
+	// How long to sleep before sampling input for the next frame.
+	// Frames up to completedFrame are known to be finished by now.
+	double GetSleepMs(double nowMs, uint64_t completedFrame) const;
+
+	// Per-frame reports, in order
+	void BeginFrame(uint64_t frame, double inputSampleMs, double sleptMs);
+	void EndFrame(uint64_t frame, double submitMs);
+	void RecordGPUFrame(uint64_t frame, double startMs, double endMs);
+
+	// Measurements
+	FramePacerStats GetStats() const;
+	void ResetStats();
+
+private:
+	// Exponentially weighted mean and variance of a cost,
+	// predicted some standard deviations either side of the mean
+	struct CostPredictor
+	{
+		double Mean = 0;
+		double Variance = 0;
+		bool HasSamples = false;
+
+		void Add(double ms);
+		double Predict(double deviations) const;
+	};
+
+	struct FrameRecord
+	{
+		uint64_t Frame = 0;
+		double InputSampleMs = 0;
+		double SubmitMs = 0;
+		bool Submitted = false;
+	};
+
+	bool enabled;
+	double safetyMarginMs;
+
+	CostPredictor cpuCost;
+	CostPredictor gpuCost;
+	FrameRecord history[HistorySize];
+	uint64_t lastSubmittedFrame;
+
+	// Most recent frame the GPU is known to have finished
+	uint64_t lastGPUFrame;
+	double lastGPUFrameEndMs;
+
+	FramePacerStats stats;
+
+	const FrameRecord* FindFrame(uint64_t frame) const;
+};
@@ -0,0 +1,103 @@
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <initializer_list>
+
+FrameScheduler::FrameScheduler(unsigned int maxFramesInFlight, unsigned int framesInFlight) :
+	maxFramesInFlight(std::max(maxFramesInFlight, 1u)),
+	framesInFlight(1),
+	currentFenceValue(1), // Zero is the fence's initial value, so start above it
+	lastGPUFrameEndMs(0),
+	hasLastGPUFrame(false)
+{
+	SetFramesInFlight(framesInFlight);
+}
+
+// --------------------------------------------------------
+// Sets how many frames may be queued up or executing at
+// once, including the one being recorded.  One means the
+// CPU and GPU never overlap.
+// --------------------------------------------------------
+void FrameScheduler::SetFramesInFlight(unsigned int frames)
+{
+	framesInFlight = std::clamp(frames, 1u, maxFramesInFlight);
+	stats.FramesInFlight = framesInFlight;
+	totalStats.FramesInFlight = framesInFlight;
+}
+
+unsigned int FrameScheduler::GetFramesInFlight() const { return framesInFlight; }
+unsigned int FrameScheduler::GetMaxFramesInFlight() const { return maxFramesInFlight; }
+uint64_t FrameScheduler::GetCurrentFenceValue() const { return currentFenceValue; }
+
+// --------------------------------------------------------
+// Fence values go up by one per frame, so they double as
+// frame numbers for picking per-frame resources
+// --------------------------------------------------------
+unsigned int FrameScheduler::GetCurrentFrameIndex() const
+{
+	return (unsigned int)((currentFenceValue - 1) % maxFramesInFlight);
+}
+
+// --------------------------------------------------------
+// Call once the current frame has been submitted and its
+// fence value signaled.  The next frame can be recorded
+// once the frame framesInFlight frames before it is done.
+// --------------------------------------------------------
+uint64_t FrameScheduler::EndFrame(uint64_t completedFenceValue)
+{
+	// How much work did the GPU have lined up (including this frame)?
+	uint64_t queued = currentFenceValue > completedFenceValue ? currentFenceValue - completedFenceValue : 0;
+	for (FrameSchedulerStats* s : { &stats, &totalStats })
+	{
+		s->QueuedFrames += (double)queued;
+		s->FrameCount++;
+	}
+
+	currentFenceValue++;
+	return currentFenceValue > framesInFlight ? currentFenceValue - framesInFlight : 0;
+}
+
+void FrameScheduler::RecordCPUWait(double waitMs)
+{
+	for (FrameSchedulerStats* s : { &stats, &totalStats })
+	{
+		s->CPUWaitMs += waitMs;
+		s->MaxCPUWaitMs = std::max(s->MaxCPUWaitMs, waitMs);
+	}
+}
+
+// --------------------------------------------------------
+// Adds a completed GPU frame, in order.  Any gap since the
+// previous frame ended is time the GPU sat waiting on the
+// CPU.
+// --------------------------------------------------------
+void FrameScheduler::RecordGPUFrame(double startMs, double endMs)
+{
+	double gapMs = hasLastGPUFrame ? std::max(startMs - lastGPUFrameEndMs, 0.0) : 0;
+	for (FrameSchedulerStats* s : { &stats, &totalStats })
+	{
+		s->GPUFrameCount++;
+		s->GPUBusyMs += std::max(endMs - startMs, 0.0);
+		s->GPUIdleMs += gapMs;
+		s->MaxGPUIdleMs = std::max(s->MaxGPUIdleMs, gapMs);
+		if (gapMs > StarvationThresholdMs)
+			s->StarvedFrames++;
+	}
+
+	lastGPUFrameEndMs = endMs;
+	hasLastGPUFrame = true;
+}
+
+FrameSchedulerStats FrameScheduler::GetStats() const { return stats; }
+FrameSchedulerStats FrameScheduler::GetTotalStats() const { return totalStats; }
+
+// --------------------------------------------------------
+// Starts a new measurement window.  The last GPU frame is
+// kept so the next gap is still measured correctly, and
+// the totals carry on regardless.
+// --------------------------------------------------------
+void FrameScheduler::ResetStats()
+{
+	stats = {};
+	stats.FramesInFlight = framesInFlight;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+
+// How well the CPU and GPU overlapped over a stretch of frames
+struct FrameSchedulerStats
+{
+	unsigned int FramesInFlight = 0;
+
+	// CPU side, measured as each frame is submitted
+	uint64_t FrameCount = 0;
+	double CPUWaitMs = 0;			// Total time spent blocked on the GPU
+	double MaxCPUWaitMs = 0;
+	double QueuedFrames = 0;		// Sum of frames the GPU still had queued at each submit
+
+	// GPU side, measured from timestamps once frames complete
+	uint64_t GPUFrameCount = 0;
+	double GPUBusyMs = 0;			// Time spent inside frames
+	double GPUIdleMs = 0;			// Gaps between one frame ending and the next starting
+	double MaxGPUIdleMs = 0;
+	unsigned int StarvedFrames = 0;	// Frames that started after a noticeable gap
+
+	double AverageCPUWaitMs() const { return FrameCount ? CPUWaitMs / FrameCount : 0; }
+	double AverageQueuedFrames() const { return FrameCount ? QueuedFrames / FrameCount : 0; }
+	double AverageGPUIdleMs() const { return GPUFrameCount ? GPUIdleMs / GPUFrameCount : 0; }
+	double GPUUtilization() const { return GPUBusyMs + GPUIdleMs > 0 ? GPUBusyMs / (GPUBusyMs + GPUIdleMs) : 0; }
+};
+
+// --------------------------------------------------------
+// Decides how far the CPU may run ahead of the GPU, and
+// measures whether that's enough to keep the GPU busy.
+//
+// Every frame signals its own fence value when the GPU
+// finishes it, and values only ever increase.  Before the
+// CPU starts recording a frame it must wait for the frame
+// framesInFlight frames earlier, which frees up that frame's
+// per-frame resources (command allocator, upload space...).
+// Per-frame resources are picked with GetCurrentFrameIndex(),
+// which cycles through maxFramesInFlight indices, so the
+// depth can change at any time without resources being
+// reused too early.
+//
+// This class knows nothing about D3D12, so the owner does
+// the actual signaling and waiting.
+// --------------------------------------------------------
+class FrameScheduler
+{
+public:
+	// GPU gaps shorter than this are just the cost of
+	// switching between command lists, not starvation
+	static constexpr double StarvationThresholdMs = 0.1;
+
+	FrameScheduler(unsigned int maxFramesInFlight, unsigned int framesInFlight);
+
+	// Depth
+	void SetFramesInFlight(unsigned int frames);
+	unsigned int GetFramesInFlight() const;
+	unsigned int GetMaxFramesInFlight() const;
+
+	// The frame currently being recorded
+	uint64_t GetCurrentFenceValue() const;
+	unsigned int GetCurrentFrameIndex() const;
+
+	// Moves on to the next frame, returning the fence value that
+	// must complete before recording it (0 if there's no need)
+	uint64_t EndFrame(uint64_t completedFenceValue);
+
+	// Measurements
+	void RecordCPUWait(double waitMs);
+	void RecordGPUFrame(double startMs, double endMs);
+	FrameSchedulerStats GetStats() const;		// Since the last ResetStats()
+	FrameSchedulerStats GetTotalStats() const;	// Since the scheduler was created
+	void ResetStats();
+
+private:
+	unsigned int maxFramesInFlight;
+	unsigned int framesInFlight;
+	uint64_t currentFenceValue;
+
+	FrameSchedulerStats stats;
+	FrameSchedulerStats totalStats;
+	double lastGPUFrameEndMs;
+	bool hasLastGPUFrame;
+};
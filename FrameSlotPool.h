@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+// --------------------------------------------------------
+// A growable pool of objects (typically command allocators
+// and their lists) that are each used by one frame at a
+// time and only handed out again once the GPU has finished
+// that frame.
+//
+// Acquire() tags an object with the fence value of the
+// frame that's using it.  An object is free again once the
+// completed fence value reaches that tag.  If nothing is
+// free, a new default-constructed object is added and the
+// caller is told to create its contents.
+//
+// Objects never move once added, so references stay valid.
+// Not thread safe on its own, and nothing here knows about
+// D3D12.
+// --------------------------------------------------------
+template<typename T>
+class FrameSlotPool
+{
+public:
+	// Finds (or adds) an object no unfinished frame is using and
+	// marks it as used by the frame that will signal frameFenceValue
+	T& Acquire(uint64_t frameFenceValue, uint64_t completedFenceValue, bool* created = 0)
+	{
+		if (created)
+			*created = false;
+
+		for (Entry& entry : entries)
+		{
+			if (entry.FenceValue <= completedFenceValue)
+			{
+				entry.FenceValue = frameFenceValue;
+				return entry.Object;
+			}
+		}
+
+		if (created)
+			*created = true;
+
+		entries.push_back({ frameFenceValue, T() });
+		return entries.back().Object;
+	}
+
+	unsigned int GetSize() const { return (unsigned int)entries.size(); }
+
+	unsigned int GetFreeCount(uint64_t completedFenceValue) const
+	{
+		unsigned int count = 0;
+		for (const Entry& entry : entries)
+		{
+			if (entry.FenceValue <= completedFenceValue)
+				count++;
+		}
+		return count;
+	}
+
+	// Only safe once the GPU is known to be completely idle
+	void Clear() { entries.clear(); }
+
+private:
+	struct Entry
+	{
+		uint64_t FenceValue;
+		T Object;
+	};
+
+	std::deque<Entry> entries;
+};
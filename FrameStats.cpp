@@ -0,0 +1,276 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Lowercase names used for export
+	const char* phaseNames[FRAME_PHASE_COUNT] =
+	{
+		"update",
+		"tlas_build",
+		"raytrace_record",
+		"submit",
+		"present_wait"
+	};
+
+	// --------------------------------------------------------
+	// Finds the value at the given percentile (0-1) of an
+	// already sorted set, using the nearest-rank method
+	// --------------------------------------------------------
+	double Percentile(const std::vector<double>& sorted, double percentile)
+	{
+		if (sorted.empty())
+			return 0;
+
+		size_t rank = (size_t)ceil(percentile * sorted.size());
+		return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+	}
+
+	// --------------------------------------------------------
+	// Sorts the given timings and builds their summary
+	// --------------------------------------------------------
+	TimingSummary SummarizeTimings(std::vector<double>& timings)
+	{
+		TimingSummary summary = {};
+		if (timings.empty())
+			return summary;
+
+		std::sort(timings.begin(), timings.end());
+
+		double sum = 0;
+		for (double t : timings)
+			sum += t;
+
+		summary.Mean = sum / timings.size();
+		summary.P50 = Percentile(timings, 0.50);
+		summary.P95 = Percentile(timings, 0.95);
+		summary.P99 = Percentile(timings, 0.99);
+		summary.Max = timings.back();
+		return summary;
+	}
+
+	// Writes a summary as a JSON object
+	void WriteSummaryJSON(std::ofstream& file, const TimingSummary& summary)
+	{
+		file << "{ \"mean\": " << summary.Mean <<
+			", \"p50\": " << summary.P50 <<
+			", \"p95\": " << summary.P95 <<
+			", \"p99\": " << summary.P99 <<
+			", \"max\": " << summary.Max << " }";
+	}
+}
+
+
+FrameStats::FrameStats() : writeCount(0)
+{
+}
+
+// --------------------------------------------------------
+// Returns the milliseconds elapsed since the given time
+// point, and moves the time point up to now so the next
+// phase can be timed from here
+// --------------------------------------------------------
+double FrameStats::Lap(Clock::time_point& start)
+{
+	Clock::time_point now = Clock::now();
+	double ms = std::chrono::duration<double, std::milli>(now - start).count();
+	start = now;
+	return ms;
+}
+
+// --------------------------------------------------------
+// Adds a frame to the ring, overwriting the oldest frame
+// once the ring is full.  Only one thread should record.
+// --------------------------------------------------------
+void FrameStats::RecordFrame(const FrameTiming& frame)
+{
+	uint64_t index = writeCount.load(std::memory_order_relaxed);
+	frames[index % Capacity] = frame;
+	frames[index % Capacity].FrameIndex = index;
+
+	// Publish the frame to readers
+	writeCount.store(index + 1, std::memory_order_release);
+}
+
+uint64_t FrameStats::GetRecordedFrameCount() { return writeCount.load(std::memory_order_acquire); }
+
+// --------------------------------------------------------
+// Copies up to maxFrames of the most recent frames, oldest
+// first, and returns how many were actually copied
+// --------------------------------------------------------
+unsigned int FrameStats::CopyRecentFrames(FrameTiming* frames, unsigned int maxFrames)
+{
+	uint64_t end = writeCount.load(std::memory_order_acquire);
+	uint64_t count = std::min<uint64_t>({ (uint64_t)maxFrames, end, (uint64_t)Capacity });
+	uint64_t start = end - count;
+
+	for (uint64_t i = start; i < end; i++)
+		frames[i - start] = this->frames[i % Capacity];
+
+	// Did the writer lap us while we were copying?  If so, the
+	// oldest frames may have been overwritten, so drop them.
+	uint64_t endAfterCopy = writeCount.load(std::memory_order_acquire);
+	uint64_t overwritten = endAfterCopy > start + Capacity ? endAfterCopy - start - Capacity : 0;
+	if (overwritten == 0)
+		return (unsigned int)count;
+	if (overwritten >= count)
+		return 0;
+
+	// Keep only the frames that are still valid
+	std::move(frames + overwritten, frames + count, frames);
+	return (unsigned int)(count - overwritten);
+}
+
+// --------------------------------------------------------
+// Summarizes the most recent windowSize frames
+// --------------------------------------------------------
+FrameStatsSummary FrameStats::Summarize(unsigned int windowSize)
+{
+	std::vector<FrameTiming> recent(std::min(windowSize, Capacity));
+	unsigned int count = CopyRecentFrames(recent.data(), (unsigned int)recent.size());
+	return SummarizeFrames(recent.data(), count);
+}
+
+// --------------------------------------------------------
+// Computes percentiles for the total frame time and each
+// phase, and counts hitches relative to the median frame
+// --------------------------------------------------------
+FrameStatsSummary FrameStats::SummarizeFrames(const FrameTiming* frames, unsigned int frameCount)
+{
+	FrameStatsSummary summary = {};
+	summary.FrameCount = frameCount;
+	if (frameCount == 0)
+		return summary;
+
+	std::vector<double> timings(frameCount);
+
+	// Each phase on its own
+	for (int p = 0; p < FRAME_PHASE_COUNT; p++)
+	{
+		for (unsigned int i = 0; i < frameCount; i++)
+			timings[i] = frames[i].PhaseMs[p];
+		summary.Phases[p] = SummarizeTimings(timings);
+	}
+
+	// Overall frame time
+	for (unsigned int i = 0; i < frameCount; i++)
+		timings[i] = frames[i].TotalMs;
+	summary.Total = SummarizeTimings(timings);
+
+	// Count frames that stand out from the rest
+	double hitchThreshold = summary.Total.P50 * HitchMultiplier;
+	for (unsigned int i = 0; i < frameCount; i++)
+	{
+		if (frames[i].TotalMs > hitchThreshold)
+			summary.HitchCount++;
+	}
+
+	return summary;
+}
+
+const char* FrameStats::GetPhaseName(FramePhase phase)
+{
+	return phase < FRAME_PHASE_COUNT ? phaseNames[phase] : "unknown";
+}
+
+// --------------------------------------------------------
+// Writes one row per frame: the frame index, total time
+// and the time of each phase
+// --------------------------------------------------------
+bool FrameStats::ExportCSV(const std::wstring& path, unsigned int windowSize)
+{
+	std::ofstream file(std::filesystem::path{ path });
+	if (!file.is_open())
+		return false;
+
+	std::vector<FrameTiming> recent(std::min(windowSize, Capacity));
+	unsigned int count = CopyRecentFrames(recent.data(), (unsigned int)recent.size());
+
+	// Header
+	file << "frame,total_ms";
+	for (int p = 0; p < FRAME_PHASE_COUNT; p++)
+		file << "," << phaseNames[p] << "_ms";
+	file << "\n";
+
+	// One frame per line
+	for (unsigned int i = 0; i < count; i++)
+	{
+		file << recent[i].FrameIndex << "," << recent[i].TotalMs;
+		for (int p = 0; p < FRAME_PHASE_COUNT; p++)
+			file << "," << recent[i].PhaseMs[p];
+		file << "\n";
+	}
+
+	return file.good();
+}
+
+// --------------------------------------------------------
+// Writes the summary of the most recent frames, the GPU's
+// idle gaps and the paths it traced (if given), then the
+// raw total frame times.  Rays per second are the average
+// rays per frame at the window's mean frame time, since
+// path counts arrive a few frames late.
+// --------------------------------------------------------
+bool FrameStats::ExportJSON(const std::wstring& path, unsigned int windowSize, const FrameSchedulerStats* gpuStats, const PathTracingStats* pathStats)
+{
+	std::ofstream file(std::filesystem::path{ path });
+	if (!file.is_open())
+		return false;
+
+	std::vector<FrameTiming> recent(std::min(windowSize, Capacity));
+	unsigned int count = CopyRecentFrames(recent.data(), (unsigned int)recent.size());
+	FrameStatsSummary summary = SummarizeFrames(recent.data(), count);
+
+	file << "{\n";
+	file << "  \"frameCount\": " << summary.FrameCount << ",\n";
+	file << "  \"hitchCount\": " << summary.HitchCount << ",\n";
+	file << "  \"hitchMultiplier\": " << HitchMultiplier << ",\n";
+	file << "  \"total_ms\": ";
+	WriteSummaryJSON(file, summary.Total);
+	file << ",\n";
+
+	file << "  \"phases_ms\": {\n";
+	for (int p = 0; p < FRAME_PHASE_COUNT; p++)
+	{
+		file << "    \"" << phaseNames[p] << "\": ";
+		WriteSummaryJSON(file, summary.Phases[p]);
+		file << (p < FRAME_PHASE_COUNT - 1 ? ",\n" : "\n");
+	}
+	file << "  },\n";
+
+	if (gpuStats)
+	{
+		file << "  \"gpu\": { \"frameCount\": " << gpuStats->GPUFrameCount <<
+			", \"busy_ms\": " << gpuStats->GPUBusyMs <<
+			", \"idle_ms\": " << gpuStats->GPUIdleMs <<
+			", \"mean_idle_ms\": " << gpuStats->AverageGPUIdleMs() <<
+			", \"max_idle_ms\": " << gpuStats->MaxGPUIdleMs <<
+			", \"starvedFrames\": " << gpuStats->StarvedFrames <<
+			", \"utilization\": " << gpuStats->GPUUtilization() << " },\n";
+	}
+
+	if (pathStats)
+	{
+		double raysPerSecond = summary.Total.Mean > 0 ? pathStats->RaysPerFrame() * 1000.0 / summary.Total.Mean : 0;
+		file << "  \"paths\": { \"frameCount\": " << pathStats->FrameCount <<
+			", \"samples\": " << pathStats->SampleCount <<
+			", \"rays\": " << pathStats->RayCount <<
+			", \"average_path_length\": " << pathStats->AveragePathLength() <<
+			", \"rays_per_second\": " << raysPerSecond << " },\n";
+	}
+
+	file << "  \"frames_ms\": [";
+	for (unsigned int i = 0; i < count; i++)
+		file << (i > 0 ? ", " : "") << recent[i].TotalMs;
+	file << "]\n";
+	file << "}\n";
+
+	return file.good();
+}
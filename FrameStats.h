@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "FrameScheduler.h"
+
+// The parts of a frame we time separately on the CPU
+enum FramePhase
+{
+	FRAME_PHASE_UPDATE,
+	FRAME_PHASE_TLAS_BUILD,
+	FRAME_PHASE_RAYTRACE_RECORD,
+	FRAME_PHASE_SUBMIT,
+	FRAME_PHASE_PRESENT_WAIT,
+
+	FRAME_PHASE_COUNT
+};
+
+// CPU timings for a single frame, in milliseconds
+struct FrameTiming
+{
+	uint64_t FrameIndex = 0;
+	double TotalMs = 0;	// Full frame-to-frame time
+	double PhaseMs[FRAME_PHASE_COUNT]{};
+};
+
+// Distribution of a single set of timings
+struct TimingSummary
+{
+	double Mean = 0;
+	double P50 = 0;
+	double P95 = 0;
+	double P99 = 0;
+	double Max = 0;
+};
+
+// Summary of a window of recent frames
+struct FrameStatsSummary
+{
+	unsigned int FrameCount = 0;
+	unsigned int HitchCount = 0;	// Frames well above the median (see HitchMultiplier)
+	TimingSummary Total;
+	TimingSummary Phases[FRAME_PHASE_COUNT];
+};
+
+// Work the GPU reports back about the paths it traced
+struct PathTracingStats
+{
+	uint64_t FrameCount = 0;	// Frames whose counts have been read back
+	uint64_t SampleCount = 0;
+	uint64_t RayCount = 0;
+
+	double AveragePathLength() const { return SampleCount ? (double)RayCount / SampleCount : 0.0; }
+	double RaysPerFrame() const { return FrameCount ? (double)RayCount / FrameCount : 0.0; }
+};
+
+// --------------------------------------------------------
+// Records per-frame CPU timings into a fixed-size ring and
+// summarizes them over sliding windows (the last N frames).
+//
+// A single thread records frames without locking, and any
+// other thread may read recent frames at the same time.
+// Readers simply discard frames that were overwritten
+// while they were being copied.
+//
+// Nothing here is tied to the window or graphics API, so
+// it can be driven by synthetic timings.
+// --------------------------------------------------------
+class FrameStats
+{
+public:
+	// How many frames of history are kept
+	static constexpr unsigned int Capacity = 4096;
+
+	// A frame counts as a hitch when it takes this many
+	// times longer than the median frame in its window
+	static constexpr double HitchMultiplier = 2.0;
+
+	// Timing helpers
+	using Clock = std::chrono::steady_clock;
+	static double Lap(Clock::time_point& start);
+
+	FrameStats();
+
+	// Writer side
+	void RecordFrame(const FrameTiming& frame);
+
+	// Reader side
+	uint64_t GetRecordedFrameCount();
+	unsigned int CopyRecentFrames(FrameTiming* frames, unsigned int maxFrames);
+	FrameStatsSummary Summarize(unsigned int windowSize);
+
+	// Summarizes an arbitrary set of frames
+	static FrameStatsSummary SummarizeFrames(const FrameTiming* frames, unsigned int frameCount);
+	static const char* GetPhaseName(FramePhase phase);
+
+	// Export the most recent frames (up to windowSize) to disk.  The
+	// JSON can also include how busy the GPU was kept, if measured.
+	bool ExportCSV(const std::wstring& path, unsigned int windowSize = Capacity);
+	bool ExportJSON(const std::wstring& path, unsigned int windowSize = Capacity, const FrameSchedulerStats* gpuStats = 0, const PathTracingStats* pathStats = 0);
+
+private:
+	FrameTiming frames[Capacity];
+
+	// Total frames ever recorded; the next frame goes
+	// into frames[writeCount % Capacity]
+	std::atomic<uint64_t> writeCount;
+};
@@ -0,0 +1,424 @@
+#include "GPUMemory.h"
+#include "Graphics.h"
+#include "OffsetAllocator.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Makes use of integer division to ensure we are aligned to the proper multiple of "alignment"
+#define ALIGN(value, alignment) (((value + alignment - 1) / alignment) * alignment)
+
+namespace GPUMemory
+{
+	// Annonymous namespace to hold variables
+	// only accessible in this file
+	namespace
+	{
+		// A single ID3D12Heap and the allocator tracking which parts of it are in use
+		struct HeapBlock
+		{
+			Microsoft::WRL::ComPtr<ID3D12Heap> Heap;
+			OffsetAllocator Allocator;
+			std::mutex Lock;
+
+			// Consecutive calls to Trim() that found it empty
+			unsigned int EmptyTrims = 0;
+		};
+
+		// Heaps grouped by heap type and heap flags, since
+		// each heap can only hold one category of resource
+		std::map<std::pair<D3D12_HEAP_TYPE, D3D12_HEAP_FLAGS>, std::vector<std::shared_ptr<HeapBlock>>> pools;
+		std::mutex poolLock;
+
+		// The single heap shared (aliased) by all transient buffers
+		std::shared_ptr<HeapBlock> transientBlock;
+		unsigned int transientEmptyTrims = 0;
+
+		// Running totals, updated as resources come and go
+		std::atomic<UINT64> allocatedBytes = 0;
+		std::atomic<unsigned int> resourceCount = 0;
+
+		// The adapter our device lives on, for budget queries
+		Microsoft::WRL::ComPtr<IDXGIAdapter3> adapter;
+
+		// Key under which each placed resource stores its allocation
+		const GUID PlacedAllocationGUID = { 0x6b2f9a31, 0x4c1e, 0x4d7a, { 0x9e, 0x52, 0x13, 0x8c, 0x7f, 0x0a, 0xd4, 0x61 } };
+
+		// --------------------------------------------------------
+		// A tiny COM object attached to each placed resource as
+		// private data.  D3D releases it when the resource is
+		// destroyed, which gives the memory back to its heap.
+		// It also keeps the heap itself alive until then.
+		// --------------------------------------------------------
+		class PlacedAllocation : public IUnknown
+		{
+		public:
+			PlacedAllocation(std::shared_ptr<HeapBlock> block, UINT64 offset, UINT64 size, bool aliased)
+				: block(block), offset(offset), size(size), aliased(aliased), refCount(1)
+			{
+				resourceCount++;
+				if (!aliased)
+					allocatedBytes += size;
+			}
+
+			HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+			{
+				if (!object)
+					return E_POINTER;
+
+				if (riid == __uuidof(IUnknown))
+				{
+					*object = this;
+					AddRef();
+					return S_OK;
+				}
+
+				*object = 0;
+				return E_NOINTERFACE;
+			}
+
+			ULONG STDMETHODCALLTYPE AddRef() override { return ++refCount; }
+			ULONG STDMETHODCALLTYPE Release() override
+			{
+				ULONG count = --refCount;
+				if (count == 0)
+					delete this;
+				return count;
+			}
+
+		private:
+			~PlacedAllocation()
+			{
+				resourceCount--;
+
+				// Aliased memory is shared, so there's nothing to give back
+				if (aliased)
+					return;
+
+				std::lock_guard<std::mutex> lock(block->Lock);
+				block->Allocator.Free(offset, size);
+				allocatedBytes -= size;
+			}
+
+			std::shared_ptr<HeapBlock> block;
+			UINT64 offset;
+			UINT64 size;
+			bool aliased;
+			std::atomic<ULONG> refCount;
+		};
+
+		// --------------------------------------------------------
+		// Determines which category of heap a resource must live in
+		// --------------------------------------------------------
+		D3D12_HEAP_FLAGS HeapFlagsForResource(const D3D12_RESOURCE_DESC& desc)
+		{
+			if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+				return D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+
+			if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+				return D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+
+			return D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+		}
+
+		// --------------------------------------------------------
+		// Reserves a brand new heap of the given type and size
+		// --------------------------------------------------------
+		std::shared_ptr<HeapBlock> CreateHeapBlock(D3D12_HEAP_TYPE heapType, D3D12_HEAP_FLAGS flags, UINT64 size)
+		{
+			// All heaps are a multiple of the default placement alignment
+			size = ALIGN(size, (UINT64)D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+
+			D3D12_HEAP_DESC heapDesc = {};
+			heapDesc.SizeInBytes = size;
+			heapDesc.Properties.Type = heapType;
+			heapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+			heapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+			heapDesc.Properties.CreationNodeMask = 1;
+			heapDesc.Properties.VisibleNodeMask = 1;
+			heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+			heapDesc.Flags = flags;
+
+			std::shared_ptr<HeapBlock> block = std::make_shared<HeapBlock>();
+			if (FAILED(Graphics::Device->CreateHeap(&heapDesc, IID_PPV_ARGS(block->Heap.GetAddressOf()))))
+				return 0;
+
+			block->Allocator.Reset(size);
+			return block;
+		}
+
+		// --------------------------------------------------------
+		// Creates the actual placed resource and attaches the
+		// allocation details so the memory can be reclaimed later
+		// --------------------------------------------------------
+		Microsoft::WRL::ComPtr<ID3D12Resource> PlaceResource(
+			std::shared_ptr<HeapBlock> block,
+			UINT64 offset,
+			UINT64 size,
+			bool aliased,
+			const D3D12_RESOURCE_DESC& desc,
+			D3D12_RESOURCE_STATES state,
+			const D3D12_CLEAR_VALUE* clearValue)
+		{
+			Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+			HRESULT result = Graphics::Device->CreatePlacedResource(
+				block->Heap.Get(),
+				offset,
+				&desc,
+				state,
+				clearValue,
+				IID_PPV_ARGS(resource.GetAddressOf()));
+
+			if (FAILED(result))
+			{
+				// Give the space back since nothing is using it
+				if (!aliased)
+				{
+					std::lock_guard<std::mutex> lock(block->Lock);
+					block->Allocator.Free(offset, size);
+				}
+				return resource;
+			}
+
+			// The resource holds the only reference to the allocation
+			PlacedAllocation* allocation = new PlacedAllocation(block, offset, size, aliased);
+			resource->SetPrivateDataInterface(PlacedAllocationGUID, allocation);
+			allocation->Release();
+			return resource;
+		}
+	}
+}
+
+
+// --------------------------------------------------------
+// Grabs the adapter our device was created on, so we can
+// ask the OS about our memory budget later.  Must be called
+// after Graphics::Device has been created.
+// --------------------------------------------------------
+void GPUMemory::Initialize()
+{
+	Microsoft::WRL::ComPtr<IDXGIFactory4> factory;
+	if (SUCCEEDED(CreateDXGIFactory1(IID_PPV_ARGS(factory.GetAddressOf()))))
+		factory->EnumAdapterByLuid(Graphics::Device->GetAdapterLuid(), IID_PPV_ARGS(adapter.GetAddressOf()));
+}
+
+// --------------------------------------------------------
+// Drops our references to all heaps.  Any resources that
+// still exist keep their own heap alive until released.
+// --------------------------------------------------------
+void GPUMemory::ShutDown()
+{
+	std::lock_guard<std::mutex> lock(poolLock);
+	pools.clear();
+	transientBlock.reset();
+	adapter.Reset();
+}
+
+// --------------------------------------------------------
+// Releases heaps that have had nothing placed in them for
+// EmptyTrimsBeforeRelease calls in a row.  One empty heap of
+// the usual size is kept per category, so a pool that keeps
+// emptying and refilling doesn't recreate its heap each time.
+//
+// Resources are only destroyed once the GPU is done with
+// them, so an empty heap is never in use by the GPU.
+// --------------------------------------------------------
+void GPUMemory::Trim()
+{
+	std::lock_guard<std::mutex> lock(poolLock);
+	for (auto& pool : pools)
+	{
+		std::vector<std::shared_ptr<HeapBlock>>& blocks = pool.second;
+		bool keptSpare = false;
+		for (auto it = blocks.begin(); it != blocks.end();)
+		{
+			HeapBlock& block = **it;
+			bool empty = false;
+			{
+				std::lock_guard<std::mutex> blockLock(block.Lock);
+				empty = block.Allocator.GetAllocationCount() == 0;
+			}
+
+			if (!empty)
+			{
+				block.EmptyTrims = 0;
+				it++;
+			}
+			else if (!keptSpare && block.Allocator.GetSize() == HeapBlockSize)
+			{
+				keptSpare = true;
+				block.EmptyTrims = 0;
+				it++;
+			}
+			else if (++block.EmptyTrims < EmptyTrimsBeforeRelease)
+			{
+				it++;
+			}
+			else
+			{
+				it = blocks.erase(it);
+			}
+		}
+	}
+
+	// Every transient buffer holds a reference to the transient heap,
+	// so if ours is the only one, nothing is using it
+	if (transientBlock && transientBlock.use_count() == 1)
+	{
+		if (++transientEmptyTrims >= EmptyTrimsBeforeRelease)
+		{
+			transientBlock.reset();
+			transientEmptyTrims = 0;
+		}
+	}
+	else
+	{
+		transientEmptyTrims = 0;
+	}
+}
+
+// --------------------------------------------------------
+// Creates a resource inside one of our shared heaps, reserving
+// a new heap if none of the existing ones have enough room
+//
+// desc       - Description of the resource (buffer or texture)
+// heapType   - Default, upload or readback
+// state      - Initial state of the resource
+// clearValue - Optimized clear value for render targets/depth buffers
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D12Resource> GPUMemory::CreatePlacedResource(
+	const D3D12_RESOURCE_DESC& desc,
+	D3D12_HEAP_TYPE heapType,
+	D3D12_RESOURCE_STATES state,
+	const D3D12_CLEAR_VALUE* clearValue)
+{
+	// How much space, and at what alignment, does this resource need?
+	D3D12_RESOURCE_ALLOCATION_INFO info = Graphics::Device->GetResourceAllocationInfo(0, 1, &desc);
+	D3D12_HEAP_FLAGS flags = HeapFlagsForResource(desc);
+
+	std::shared_ptr<HeapBlock> block;
+	UINT64 offset = OffsetAllocator::InvalidOffset;
+	{
+		std::lock_guard<std::mutex> lock(poolLock);
+		std::vector<std::shared_ptr<HeapBlock>>& pool = pools[{ heapType, flags }];
+
+		// Look for room in an existing heap first
+		for (std::shared_ptr<HeapBlock>& candidate : pool)
+		{
+			std::lock_guard<std::mutex> blockLock(candidate->Lock);
+			offset = candidate->Allocator.Allocate(info.SizeInBytes, info.Alignment);
+			if (offset != OffsetAllocator::InvalidOffset)
+			{
+				block = candidate;
+				break;
+			}
+		}
+
+		// No room anywhere, so reserve a new heap (larger than usual if necessary)
+		if (!block)
+		{
+			block = CreateHeapBlock(heapType, flags, max(HeapBlockSize, info.SizeInBytes));
+			if (!block)
+				return 0;
+
+			pool.push_back(block);
+			offset = block->Allocator.Allocate(info.SizeInBytes, info.Alignment);
+		}
+	}
+
+	return PlaceResource(block, offset, info.SizeInBytes, false, desc, state, clearValue);
+}
+
+// --------------------------------------------------------
+// Creates a buffer at the start of the transient heap, which
+// is shared by every transient buffer.  This is meant for
+// short-lived scratch memory (like acceleration structure
+// builds) where only one buffer is needed at a time.
+//
+// The caller must issue an aliasing barrier before the GPU
+// uses the new buffer.
+//
+// size  - How big should the buffer be in bytes
+// state - What state should the resulting resource be in?
+// flags - Any special flags?  Default is D3D12_RESOURCE_FLAG_NONE
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D12Resource> GPUMemory::CreateTransientBuffer(
+	UINT64 size,
+	D3D12_RESOURCE_STATES state,
+	D3D12_RESOURCE_FLAGS flags)
+{
+	D3D12_RESOURCE_DESC desc = {};
+	desc.Alignment = 0;
+	desc.DepthOrArraySize = 1;
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	desc.Flags = flags;
+	desc.Format = DXGI_FORMAT_UNKNOWN;
+	desc.Height = 1;
+	desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	desc.MipLevels = 1;
+	desc.SampleDesc.Count = 1;
+	desc.SampleDesc.Quality = 0;
+	desc.Width = size;
+
+	D3D12_RESOURCE_ALLOCATION_INFO info = Graphics::Device->GetResourceAllocationInfo(0, 1, &desc);
+
+	std::shared_ptr<HeapBlock> block;
+	{
+		std::lock_guard<std::mutex> lock(poolLock);
+
+		// Grow the transient heap if this buffer won't fit.  Existing
+		// transient buffers keep the old heap alive until released.
+		if (!transientBlock || transientBlock->Allocator.GetSize() < info.SizeInBytes)
+			transientBlock = CreateHeapBlock(D3D12_HEAP_TYPE_DEFAULT, D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS, info.SizeInBytes);
+
+		block = transientBlock;
+	}
+
+	if (!block)
+		return 0;
+
+	return PlaceResource(block, 0, info.SizeInBytes, true, desc, state, 0);
+}
+
+// --------------------------------------------------------
+// Gathers memory usage across all heaps, along with the
+// OS-provided budget for our GPU's local memory
+// --------------------------------------------------------
+GPUMemory::Stats GPUMemory::GetStats()
+{
+	Stats stats = {};
+	stats.AllocatedBytes = allocatedBytes;
+	stats.ResourceCount = resourceCount;
+
+	{
+		std::lock_guard<std::mutex> lock(poolLock);
+		for (auto& pool : pools)
+		{
+			for (std::shared_ptr<HeapBlock>& block : pool.second)
+			{
+				stats.ReservedBytes += block->Allocator.GetSize();
+				stats.HeapCount++;
+			}
+		}
+
+		if (transientBlock)
+		{
+			stats.TransientBytes = transientBlock->Allocator.GetSize();
+			stats.ReservedBytes += stats.TransientBytes;
+			stats.HeapCount++;
+		}
+	}
+
+	// Ask the OS how much we're allowed to use
+	DXGI_QUERY_VIDEO_MEMORY_INFO memoryInfo = {};
+	if (adapter && SUCCEEDED(adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &memoryInfo)))
+	{
+		stats.LocalBudgetBytes = memoryInfo.Budget;
+		stats.LocalUsageBytes = memoryInfo.CurrentUsage;
+	}
+
+	return stats;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl/client.h>
+
+// --------------------------------------------------------
+// Sub-allocates GPU resources out of a small number of
+// large ID3D12Heaps rather than giving every resource its
+// own committed allocation.  Heaps are reserved per heap
+// type (default, upload, readback) and resource category
+// (buffers, textures, render targets/depth buffers).
+//
+// Memory is returned to its heap automatically when the
+// last reference to a resource is released.  Heaps that
+// stay empty are released by Trim(), so a burst of large
+// allocations (like BLAS build scratch) doesn't keep its
+// memory reserved forever.
+// --------------------------------------------------------
+namespace GPUMemory
+{
+	// --- CONSTANTS ---
+	// Size of each heap we reserve.  Resources larger than
+	// this get a heap of their own.
+	const UINT64 HeapBlockSize = 64 * 1024 * 1024;
+
+	// Heaps that have been empty for this many calls to Trim()
+	// are released, other than one spare heap per category
+	const unsigned int EmptyTrimsBeforeRelease = 120;
+
+	// Overall memory usage
+	struct Stats
+	{
+		UINT64 ReservedBytes;		// Total size of all heaps
+		UINT64 AllocatedBytes;		// Portion of the heaps used by placed resources
+		UINT64 TransientBytes;		// Size of the aliased transient heap
+		unsigned int HeapCount;
+		unsigned int ResourceCount;
+
+		// From the OS for our GPU's local (dedicated) memory
+		UINT64 LocalBudgetBytes;
+		UINT64 LocalUsageBytes;
+	};
+
+	// --- FUNCTIONS ---
+	void Initialize();
+	void ShutDown();
+
+	// Call once per frame, after any finished frames' resources
+	// have been released
+	void Trim();
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreatePlacedResource(
+		const D3D12_RESOURCE_DESC& desc,
+		D3D12_HEAP_TYPE heapType,
+		D3D12_RESOURCE_STATES state,
+		const D3D12_CLEAR_VALUE* clearValue = 0);
+
+	// Transient buffers all alias the same memory, so only one may be
+	// in use at a time, and an aliasing barrier is required before use
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateTransientBuffer(
+		UINT64 size,
+		D3D12_RESOURCE_STATES state,
+		D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE);
+
+	Stats GetStats();
+}
@@ -0,0 +1,250 @@
+#include "GPUProfiler.h"
+#include "Graphics.h"
+#include "CommandListPool.h"
+#include "Trace.h"
+
+#include <mutex>
+
+namespace GPUProfiler
+{
+	// Annonymous namespace to hold variables
+	// only accessible in this file
+	namespace
+	{
+		const unsigned int maxQueriesPerFrame = MaxZonesPerFrame * 2;
+		const unsigned int invalidZone = UINT_MAX;
+
+		bool initialized = false;
+		bool frameOpen = false;
+
+		// Queries and where they're resolved to, split into
+		// one section per frame in flight
+		Microsoft::WRL::ComPtr<ID3D12QueryHeap> queryHeap;
+		Microsoft::WRL::ComPtr<ID3D12Resource> readbackBuffer;
+
+		// Everything recorded for a particular frame in flight
+		struct FrameSlot
+		{
+			std::vector<TimestampZoneRecord> zones;
+			unsigned int queryCount = 0;
+			bool pending = false;
+			ClockCalibration calibration;
+			UINT64 frameFenceValue = 0;	// Which frame this slot was last used by
+		};
+		FrameSlot slots[Graphics::MaxFramesInFlight];
+		unsigned int currentSlot = 0;
+
+		// Zones may be recorded from several threads at once, so
+		// the slot's zones and query count are behind this, along
+		// with how many queries open zones still need for their ends
+		std::mutex zoneMutex;
+		unsigned int reservedEndQueries = 0;
+
+		// Zones currently open on this thread, as indices into the
+		// slot's zones, and the list each one began on
+		struct OpenZone
+		{
+			unsigned int Zone;
+			ID3D12GraphicsCommandList* CommandList;
+		};
+		thread_local std::vector<OpenZone> openZones;
+
+		// Results
+		std::vector<ProfileZone> lastFrameZones;
+		ZoneTimingAggregator aggregator;
+
+		// --------------------------------------------------------
+		// Reads back and resolves the timestamps of a slot whose
+		// frame the GPU has already finished
+		// --------------------------------------------------------
+		void ReadBackSlot(unsigned int slotIndex)
+		{
+			FrameSlot& slot = slots[slotIndex];
+			if (!slot.pending)
+				return;
+
+			// Map just this slot's portion
+			SIZE_T offset = (SIZE_T)slotIndex * maxQueriesPerFrame * sizeof(UINT64);
+			D3D12_RANGE readRange = { offset, offset + slot.queryCount * sizeof(UINT64) };
+			unsigned char* mapped = 0;
+			if (SUCCEEDED(readbackBuffer->Map(0, &readRange, (void**)&mapped)))
+			{
+				lastFrameZones = ResolveTimestampZones(slot.zones, (UINT64*)(mapped + offset), slot.calibration);
+				aggregator.AddFrame(lastFrameZones);
+				Trace::RecordGPUZones(lastFrameZones);
+
+				// The top level zones span the frame's work on the GPU
+				double frameStartMs = 0;
+				double frameEndMs = 0;
+				bool anyTopLevel = false;
+				for (const ProfileZone& zone : lastFrameZones)
+				{
+					if (zone.Depth != 0)
+						continue;
+
+					frameStartMs = anyTopLevel ? min(frameStartMs, zone.StartMs) : zone.StartMs;
+					frameEndMs = anyTopLevel ? max(frameEndMs, zone.StartMs + zone.DurationMs) : zone.StartMs + zone.DurationMs;
+					anyTopLevel = true;
+				}
+				if (anyTopLevel)
+					Graphics::RecordGPUFrame(slot.frameFenceValue, frameStartMs, frameEndMs);
+
+				D3D12_RANGE writeRange = { 0, 0 };
+				readbackBuffer->Unmap(0, &writeRange);
+			}
+
+			slot.pending = false;
+		}
+	}
+}
+
+
+// --------------------------------------------------------
+// Creates the query heap and readback buffer.  Must be
+// called after the Graphics API is initialized.
+// --------------------------------------------------------
+void GPUProfiler::Initialize()
+{
+	D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+	queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryHeapDesc.Count = maxQueriesPerFrame * Graphics::MaxFramesInFlight;
+	queryHeapDesc.NodeMask = 0;
+	if (FAILED(Graphics::Device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(queryHeap.GetAddressOf()))))
+		return;
+
+	readbackBuffer = Graphics::CreateBuffer(
+		sizeof(UINT64) * queryHeapDesc.Count,
+		D3D12_HEAP_TYPE_READBACK,
+		D3D12_RESOURCE_STATE_COPY_DEST);
+
+	initialized = readbackBuffer != 0;
+}
+
+// --------------------------------------------------------
+// Starts recording zones for the current frame, first
+// resolving the zones recorded the last time this frame's
+// portion of the queries was used
+// --------------------------------------------------------
+void GPUProfiler::BeginFrame()
+{
+	if (!initialized)
+		return;
+
+	// The GPU is done with the last frame that used this slot
+	currentSlot = Graphics::FrameIndex();
+	ReadBackSlot(currentSlot);
+
+	// Start fresh
+	FrameSlot& slot = slots[currentSlot];
+	slot.zones.clear();
+	slot.queryCount = 0;
+	slot.frameFenceValue = Graphics::CurrentFrameFenceValue();
+	openZones.clear();
+	reservedEndQueries = 0;
+	frameOpen = true;
+
+	// Grab a matching pair of GPU and CPU timestamps so this
+	// frame's zones can be placed on the CPU's timeline
+	LARGE_INTEGER cpuFrequency = {};
+	QueryPerformanceFrequency(&cpuFrequency);
+	Graphics::CommandQueue->GetTimestampFrequency(&slot.calibration.GPUFrequency);
+	Graphics::CommandQueue->GetClockCalibration(&slot.calibration.GPUTimestamp, &slot.calibration.CPUTimestamp);
+	slot.calibration.CPUFrequency = cpuFrequency.QuadPart;
+}
+
+// --------------------------------------------------------
+// Resolves this frame's timestamps into the readback
+// buffer, on a list submitted after every other list this
+// frame.  Must be called once all threads are done
+// recording zones, before the frame is submitted.
+// --------------------------------------------------------
+void GPUProfiler::EndFrame()
+{
+	if (!initialized || !frameOpen)
+		return;
+
+	// Close anything left open
+	while (!openZones.empty())
+		EndZone();
+
+	FrameSlot& slot = slots[currentSlot];
+	if (slot.queryCount > 0)
+	{
+		UINT firstQuery = currentSlot * maxQueriesPerFrame;
+		ID3D12GraphicsCommandList* resolveList = CommandListPool::Acquire(CommandListPool::ProfilerResolveCommandListOrder);
+		resolveList->ResolveQueryData(
+			queryHeap.Get(),
+			D3D12_QUERY_TYPE_TIMESTAMP,
+			firstQuery,
+			slot.queryCount,
+			readbackBuffer.Get(),
+			firstQuery * sizeof(UINT64));
+		slot.pending = true;
+	}
+
+	frameOpen = false;
+}
+
+// --------------------------------------------------------
+// Opens a zone, nested inside any zone already open on
+// this thread
+// 
+// name        - Zone name, which must outlive the frame
+// commandList - Where to record its timestamps (0 for the
+//               main command list)
+// --------------------------------------------------------
+void GPUProfiler::BeginZone(const char* name, ID3D12GraphicsCommandList* commandList)
+{
+	if (!commandList)
+		commandList = Graphics::CommandList.Get();
+
+	std::lock_guard<std::mutex> lock(zoneMutex);
+	FrameSlot& slot = slots[currentSlot];
+
+	// Out of room (or not in a frame)?  Still track the zone so
+	// that its EndZone() call stays matched.  Each open zone
+	// still needs a query for its end.
+	if (!initialized || !frameOpen || slot.queryCount + reservedEndQueries + 2 > maxQueriesPerFrame)
+	{
+		openZones.push_back({ invalidZone, commandList });
+		return;
+	}
+
+	TimestampZoneRecord record = {};
+	record.Name = name;
+	record.BeginQuery = slot.queryCount++;
+	record.EndQuery = record.BeginQuery;
+	record.Depth = (unsigned int)openZones.size();
+	reservedEndQueries++;
+
+	commandList->EndQuery(queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, currentSlot * maxQueriesPerFrame + record.BeginQuery);
+
+	openZones.push_back({ (unsigned int)slot.zones.size(), commandList });
+	slot.zones.push_back(record);
+}
+
+// --------------------------------------------------------
+// Closes the most recently opened zone on this thread
+// --------------------------------------------------------
+void GPUProfiler::EndZone()
+{
+	if (openZones.empty())
+		return;
+
+	OpenZone zone = openZones.back();
+	openZones.pop_back();
+	if (zone.Zone == invalidZone)
+		return;
+
+	std::lock_guard<std::mutex> lock(zoneMutex);
+	FrameSlot& slot = slots[currentSlot];
+	TimestampZoneRecord& record = slot.zones[zone.Zone];
+	record.EndQuery = slot.queryCount++;
+	reservedEndQueries--;
+
+	zone.CommandList->EndQuery(queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, currentSlot * maxQueriesPerFrame + record.EndQuery);
+}
+
+const std::vector<ProfileZone>& GPUProfiler::GetLastFrameZones() { return lastFrameZones; }
+const std::vector<ZoneTimingStats>& GPUProfiler::GetZoneStats() { return aggregator.GetStats(); }
+void GPUProfiler::ResetZoneStats() { aggregator.Reset(); }
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <d3d12.h>
+#include <vector>
+
+#include "ProfileZones.h"
+
+// --------------------------------------------------------
+// Times regions of GPU work using timestamp queries.
+//
+// Zones are recorded into the frame's command list (or a
+// pooled list, from any thread) and their timestamps are
+// resolved into a readback buffer by a list submitted after
+// all of them.
+// Each frame in flight has its own portion of the query
+// heap and readback buffer, so results are read the next
+// time that portion comes around, once the GPU is
+// guaranteed to be done with it.
+//
+// Resolved zones are on the CPU's clock, so they can be
+// merged with CPU zones into a single timeline.
+// --------------------------------------------------------
+namespace GPUProfiler
+{
+	// --- CONSTANTS ---
+	// Maximum zones per frame (each zone uses two queries)
+	const unsigned int MaxZonesPerFrame = 64;
+
+	// --- FUNCTIONS ---
+	void Initialize();
+
+	// Call once per frame, while the frame's command list is open
+	void BeginFrame();
+	void EndFrame();
+
+	// Names must remain valid until the frame is resolved,
+	// so string literals are the best option.  Zones nest per
+	// thread, and each ends on the list it began on.  Without
+	// a list, the main command list is used.
+	void BeginZone(const char* name, ID3D12GraphicsCommandList* commandList = 0);
+	void EndZone();
+
+	// Results from the most recently resolved frame
+	const std::vector<ProfileZone>& GetLastFrameZones();
+
+	// Zone timings accumulated since the last reset
+	const std::vector<ZoneTimingStats>& GetZoneStats();
+	void ResetZoneStats();
+
+	// Times the GPU work recorded during its lifetime
+	class ScopedZone
+	{
+	public:
+		ScopedZone(const char* name, ID3D12GraphicsCommandList* commandList = 0) { BeginZone(name, commandList); }
+		~ScopedZone() { EndZone(); }
+		ScopedZone(const ScopedZone&) = delete;
+		ScopedZone& operator=(const ScopedZone&) = delete;
+	};
+}
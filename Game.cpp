@@ -5,6 +5,10 @@
 #include "PathHelpers.h"
 #include "Window.h"
 #include "BufferStructs.h"
+#include "GPUProfiler.h"
+#include "Trace.h"
+#include "JobSystem.h"
+#include "Denoiser.h"
 
 #include <DirectXMath.h>
 
@@ -15,6 +19,24 @@
 // For the DirectX Math library
 using namespace DirectX;
 
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Moves a transform to where the scripted scene has an object
+	void ApplySceneObject(const SceneObjectState& object, Transform& transform)
+	{
+		transform.SetPosition(object.Position.x, object.Position.y, object.Position.z);
+		transform.SetRotation(object.PitchYawRoll.x, object.PitchYawRoll.y, object.PitchYawRoll.z);
+		transform.SetScale(object.Scale.x, object.Scale.y, object.Scale.z);
+	}
+
+	TimelineFloat3 ToTimelineFloat3(const XMFLOAT3& value)
+	{
+		return TimelineFloat3{ value.x, value.y, value.z };
+	}
+}
+
 // --------------------------------------------------------
 // Called once per program, after the window and graphics API
 // are initialized but before the game loop begins
@@ -26,19 +48,10 @@ void Game::Initialize()
 		Window::Width(),
 		Window::Height(),
 		FixPath(L"RayTracing.cso"));
+	Denoiser::Initialize(FixPath(L"Denoise.cso"), FixPath(L"Reproject.cso"));
 
 	// Create camera
-	camera = std::make_shared<Camera>(
-		Camera(
-			Window::AspectRatio(),							// Aspect Ratio
-			DirectX::XMFLOAT3(0, 0, -10),					// Initial Position
-			45.0f,											// FOV
-			0.01f,											// Near Plane
-			1000.0f,										// Far Plane
-			0.5f,											// Movement speed
-			0.02f,											// Mouse Look Speed
-			true											// Perspective Matrix
-		));
+	CreateCamera(Window::AspectRatio());
 
 	// Create textures
 	materials.push_back(std::make_unique<Material>(pipelineState));
@@ -73,15 +86,19 @@ void Game::Initialize()
 	materials[3]->SetColorTint(DirectX::XMFLOAT3(.5f, .7f, 0.4f));
 	materials[3]->FinalizeMaterial();
 
+	// HDR sky for the ray tracer (which keeps its constant sky color without one)
+	RayTracing::LoadEnvironmentMap(FixPath(L"../../Assets/Textures/environment.hdr"));
+
 	CreateGeometry();
 
-	RayTracing::CreateTopLevelAccelerationStructureForScene(entities);
+	RayTracing::CreateTopLevelAccelerationStructureForScene(entities, simulation.GetWorldMatrices(), simulation.GetPreviousWorldMatrices());
+	RayTracing::FinishRecording();
 
 	// Finalize any initialization and wait for the GPU
 	// before proceeding to the game loop
 	Graphics::CloseAndExecuteCommandList();
 	Graphics::WaitForGPU();
-	Graphics::ResetAllocatorAndCommandList(0);
+	Graphics::ResetAllocatorAndCommandList(Graphics::FrameIndex());
 }
 
 
@@ -93,11 +110,33 @@ void Game::Initialize()
 // --------------------------------------------------------
 Game::~Game()
 {
+	// Stop simulating before anything it uses goes away
+	SetThreadedUpdate(false);
+
 	// Wait for the GPU before we shut down
 	Graphics::WaitForGPU();
 }
 
 
+// --------------------------------------------------------
+// Creates the camera the scene is viewed through
+// --------------------------------------------------------
+void Game::CreateCamera(float aspectRatio)
+{
+	camera = std::make_shared<Camera>(
+		Camera(
+			aspectRatio,									// Aspect Ratio
+			DirectX::XMFLOAT3(0, 0, -10),					// Initial Position
+			45.0f,											// FOV
+			0.01f,											// Near Plane
+			1000.0f,										// Far Plane
+			0.5f,											// Movement speed
+			0.02f,											// Mouse Look Speed
+			true											// Perspective Matrix
+		));
+}
+
+
 // --------------------------------------------------------
 // Creates the geometry we're going to draw
 // --------------------------------------------------------
@@ -109,22 +148,39 @@ void Game::CreateGeometry()
 	XMFLOAT4 green = XMFLOAT4(0.0f, 1.0f, 0.0f, 1.0f);
 	XMFLOAT4 blue = XMFLOAT4(0.0f, 0.0f, 1.0f, 1.0f);
 
-	// Load meshes
-	meshes.push_back(std::make_shared<Mesh>(WideToNarrow(FixPath(L"../../Assets/Models/sphere.obj")).c_str()));
-	meshes.push_back(std::make_shared<Mesh>(WideToNarrow(FixPath(L"../../Assets/Models/helix.obj")).c_str()));
-	meshes.push_back(std::make_shared<Mesh>(WideToNarrow(FixPath(L"../../Assets/Models/cube.obj")).c_str()));
+	// Load meshes, one per job - each records its buffer uploads
+	// and BLAS build on pooled command lists
+	const wchar_t* meshFiles[] =
+	{
+		L"../../Assets/Models/sphere.obj",
+		L"../../Assets/Models/helix.obj",
+		L"../../Assets/Models/cube.obj",
+	};
+	meshes.resize(ARRAYSIZE(meshFiles));
+	JobSystem::ParallelFor(ARRAYSIZE(meshFiles), 1, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+			meshes[i] = std::make_shared<Mesh>(WideToNarrow(FixPath(meshFiles[i])).c_str());
+	});
+
+	// Then shrink all of their BLAS's, waiting for the GPU only once
+	RayTracing::CompactBottomLevelAccelerationStructures(meshes);
 
-	// Create entities
-	entities.push_back(Entity(meshes[0], camera, materials[0]));
+	CreateScene();
+}
 
+// --------------------------------------------------------
+// Places entities and lights using the already loaded
+// meshes and materials
+// --------------------------------------------------------
+void Game::CreateScene()
+{
+	// Create entities, placed wherever the scripted scene starts them
+	entities.push_back(Entity(meshes[0], camera, materials[0]));
 	entities.push_back(Entity(meshes[1], camera, materials[1]));
-	entities[1].GetTransform()->SetPosition(2.5, 0, 0);
-
 	entities.push_back(Entity(meshes[2], camera, materials[2]));
-	entities[2].GetTransform()->SetPosition(-2.5, 0, 0);
-
 	entities.push_back(Entity(meshes[1], camera, materials[3]));
-	entities[3].GetTransform()->SetPosition(5, 4, 0);
+	PrepareRenderState();
 
 	// Create lights
 	lights[0].Type = LIGHT_TYPE_DIR;
@@ -153,6 +209,8 @@ void Game::CreateGeometry()
 	lights[4].Color = { 1, 1, 1 };
 	lights[4].Intensity = 1.0f;
 	lights[4].Range = 5.0f;
+
+	lightCount = 5;
 }
 
 // --------------------------------------------------------
@@ -175,15 +233,291 @@ void Game::OnResize()
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
+	TRACE_ZONE("Game::Update");
+	FrameStats::Clock::time_point phaseStart = FrameStats::Clock::now();
+
 	// Example input checking: Quit if the escape key is pressed
 	if (Input::KeyDown(VK_ESCAPE))
 		Window::Quit();
 
-	entities[0].GetTransform()->Rotate(0, 0, deltaTime * 2);
-	entities[1].GetTransform()->MoveAbsolute(0, -.025f * deltaTime, 0);
-	entities[2].GetTransform()->SetScale(1, 1, (float)abs(1 + sin(totalTime)));
-
+	// The camera follows input every frame, so it isn't
+	// part of the fixed-step simulation
 	camera->Update(deltaTime);
+
+	// Switch between simulating here and on its own thread
+	if (Input::KeyPress(VK_F8))
+		SetThreadedUpdate(!GetThreadedUpdate());
+
+	// Cycle how far the CPU may get ahead of the GPU
+	if (Input::KeyPress(VK_F9))
+		Graphics::SetFramesInFlight(Graphics::GetFramesInFlight() % Graphics::MaxFramesInFlight + 1);
+
+	// Toggle accumulating samples while nothing moves
+	if (Input::KeyPress(VK_F3))
+		RayTracing::Accumulation.SetEnabled(!RayTracing::Accumulation.GetEnabled());
+
+	// Cycle through random number generators (Sobol and PCG, each
+	// with and without blue noise), starting over since the old
+	// samples came from a different sequence
+	if (Input::KeyPress(VK_F2))
+	{
+		if (RayTracing::BlueNoiseOffsets)
+			RayTracing::BlueNoiseOffsets = false;
+		else
+		{
+			RayTracing::BlueNoiseOffsets = true;
+			RayTracing::Sampler = RayTracing::Sampler == PathSampler::SamplerType::Sobol ?
+				PathSampler::SamplerType::PCG :
+				PathSampler::SamplerType::Sobol;
+		}
+		RayTracing::Accumulation.Reset();
+	}
+
+	// Toggle sampling lights directly, starting over since the
+	// (infinitely small) lights are invisible without it
+	if (Input::KeyPress('N'))
+	{
+		RayTracing::NextEventEstimation = !RayTracing::NextEventEstimation;
+		RayTracing::Accumulation.Reset();
+	}
+
+	// Toggle picking lights by importance, which converges to
+	// the same image, so there's no need to start over
+	if (Input::KeyPress('L'))
+		RayTracing::LightTreeSampling = !RayTracing::LightTreeSampling;
+
+	// Toggle the denoiser, starting over when it's turned off, since
+	// the output holds the denoised image until more is traced
+	if (Input::KeyPress('F'))
+	{
+		Denoiser::Settings.Enabled = !Denoiser::Settings.Enabled;
+		RayTracing::Accumulation.Reset();
+	}
+
+	// Cycle how many passes the denoiser makes (each one
+	// covers twice the distance of the last)
+	if (Input::KeyPress('I'))
+		Denoiser::Settings.Iterations = Denoiser::Settings.Iterations % 5 + 1;
+
+	// Toggle reusing last frame's result as the camera and
+	// entities move (which the denoiser needs to be on for)
+	if (Input::KeyPress('T'))
+		Denoiser::Temporal.Enabled = !Denoiser::Temporal.Enabled;
+
+	// Check the denoiser's next frame against the CPU's filter
+	if (Input::KeyPress('V'))
+		Denoiser::RequestValidation();
+
+	// Toggle ending dim paths early
+	if (Input::KeyPress(VK_F1))
+		RayTracing::RussianRoulette = !RayTracing::RussianRoulette;
+
+	// Toggle spending samples only on noisy pixels
+	if (Input::KeyPress(VK_F4))
+	{
+		AdaptiveSamplingSettings adaptive = RayTracing::AdaptiveSampling.GetSettings();
+		adaptive.Enabled = !adaptive.Enabled;
+		RayTracing::AdaptiveSampling.SetSettings(adaptive);
+	}
+
+	// Toggle printing the stats that don't fit in the title bar
+	if (Input::KeyPress('P'))
+		Window::SetDetailedStats(!Window::GetDetailedStats());
+
+	// Toggle sleeping before input to cut latency
+	if (Input::KeyPress(VK_F11))
+		Graphics::SetFramePacing(!Graphics::GetFramePacing());
+
+	if (GetThreadedUpdate())
+	{
+		// Render what the simulation finished last frame, and let it
+		// work on the next frame while this one is drawn
+		{
+			TRACE_ZONE("Wait For Simulation");
+			WaitForSimulation();
+		}
+		PrepareRenderState();
+		RequestSimulation(deltaTime);
+	}
+	else
+	{
+		simulation.Simulate(deltaTime, 0);
+		PrepareRenderState();
+	}
+
+	// Record the camera and entities for later benchmarking
+	if (Input::KeyPress(VK_F7))
+	{
+		recordingTimeline = !recordingTimeline;
+		if (recordingTimeline)
+		{
+			recordedTimeline.Clear();
+			timelineStartTime = totalTime;
+		}
+		else
+		{
+			recordedTimeline.Save(FixPath(L"Timeline.txt"));
+		}
+	}
+	if (recordingTimeline)
+		RecordTimelineFrame(totalTime - timelineStartTime);
+
+	// Export the recent frame timings
+	if (Input::KeyPress(VK_F5))
+	{
+		frameStats.ExportCSV(FixPath(L"FrameStats.csv"));
+		frameStats.ExportJSON(FixPath(L"FrameStats.json"));
+	}
+
+	// Write out everything traced so far
+	if (Input::KeyPress(VK_F6))
+		Trace::Flush(FixPath(L"Trace.json"));
+
+	currentFrameTiming.PhaseMs[FRAME_PHASE_UPDATE] = FrameStats::Lap(phaseStart);
+}
+
+
+// --------------------------------------------------------
+// Update used by benchmarks, which replays a timeline
+// instead of reading input.  Objects with a track in the
+// timeline follow it; everything else animates as usual.
+// --------------------------------------------------------
+void Game::UpdateBenchmark(float deltaTime, float totalTime, const BenchmarkTimeline& timeline)
+{
+	TRACE_ZONE("Game::UpdateBenchmark");
+	FrameStats::Clock::time_point phaseStart = FrameStats::Clock::now();
+
+	// Results need to be repeatable, so always simulate inline
+	SetThreadedUpdate(false);
+	simulation.Simulate(deltaTime, &timeline);
+	PrepareRenderState();
+
+	if (simulation.FollowCamera(timeline, totalTime))
+	{
+		const TimelineKeyframe& keyframe = simulation.GetCamera();
+		camera->SetPositionAndRotation(
+			XMFLOAT3(keyframe.Position.x, keyframe.Position.y, keyframe.Position.z),
+			XMFLOAT3(keyframe.PitchYawRoll.x, keyframe.PitchYawRoll.y, keyframe.PitchYawRoll.z));
+	}
+
+	currentFrameTiming.PhaseMs[FRAME_PHASE_UPDATE] = FrameStats::Lap(phaseStart);
+}
+
+
+// --------------------------------------------------------
+// Takes the simulation's latest state for rendering (see
+// SceneSimulation) and moves the entities to match.  Must
+// not overlap with the simulation.
+// --------------------------------------------------------
+void Game::PrepareRenderState()
+{
+	simulation.PrepareRenderState();
+
+	const std::vector<SceneObjectState>& objects = simulation.GetRenderObjects();
+	for (size_t i = 0; i < entities.size() && i < objects.size(); i++)
+		ApplySceneObject(objects[i], *entities[i].GetTransform());
+}
+
+
+// --------------------------------------------------------
+// Starts or stops the simulation thread.  Stopping waits
+// for any frame it's in the middle of.
+// --------------------------------------------------------
+void Game::SetThreadedUpdate(bool threaded)
+{
+	if (threaded == GetThreadedUpdate())
+		return;
+
+	if (threaded)
+	{
+		simulationRequested = false;
+		stopSimulation = false;
+		simulationThread = std::thread(&Game::SimulationThreadMain, this);
+	}
+	else
+	{
+		{
+			std::lock_guard<std::mutex> lock(simulationLock);
+			stopSimulation = true;
+		}
+		simulationSignal.notify_all();
+		simulationThread.join();
+	}
+}
+
+
+// --------------------------------------------------------
+// Simulates one frame each time the main thread asks
+// --------------------------------------------------------
+void Game::SimulationThreadMain()
+{
+	Trace::SetThreadName("Simulation");
+
+	std::unique_lock<std::mutex> lock(simulationLock);
+	while (true)
+	{
+		simulationSignal.wait(lock, [&]() { return simulationRequested || stopSimulation; });
+
+		// Finish a requested frame even when stopping, so the
+		// snapshot is always complete
+		if (simulationRequested)
+		{
+			double frameSeconds = requestedFrameSeconds;
+			lock.unlock();
+			simulation.Simulate(frameSeconds, 0);
+			lock.lock();
+
+			simulationRequested = false;
+			simulationSignal.notify_all();
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+void Game::RequestSimulation(double frameSeconds)
+{
+	{
+		std::lock_guard<std::mutex> lock(simulationLock);
+		requestedFrameSeconds = frameSeconds;
+		simulationRequested = true;
+	}
+	simulationSignal.notify_all();
+}
+
+void Game::WaitForSimulation()
+{
+	std::unique_lock<std::mutex> lock(simulationLock);
+	simulationSignal.wait(lock, [&]() { return !simulationRequested; });
+}
+
+
+// --------------------------------------------------------
+// Adds the current camera and entity placement to the
+// timeline being recorded
+// --------------------------------------------------------
+void Game::RecordTimelineFrame(float time)
+{
+	Transform cameraTransform = camera->GetTransform();
+
+	TimelineKeyframe keyframe;
+	keyframe.Time = time;
+	keyframe.Position = ToTimelineFloat3(cameraTransform.GetPosition());
+	keyframe.PitchYawRoll = ToTimelineFloat3(cameraTransform.GetPitchYawRoll());
+	recordedTimeline.AddCameraKeyframe(keyframe);
+
+	// Entities come from the render state, since the simulation
+	// may be busy with the next frame on another thread
+	const std::vector<SceneObjectState>& objects = simulation.GetRenderObjects();
+	for (unsigned int i = 0; i < objects.size(); i++)
+	{
+		keyframe.Position = objects[i].Position;
+		keyframe.PitchYawRoll = objects[i].PitchYawRoll;
+		keyframe.Scale = objects[i].Scale;
+		recordedTimeline.AddEntityKeyframe(i, keyframe);
+	}
 }
 
 
@@ -196,17 +530,31 @@ void Game::Draw(float deltaTime, float totalTime)
 	Microsoft::WRL::ComPtr<ID3D12Resource> currentBackBuffer =
 		Graphics::BackBuffers[Graphics::SwapChainIndex()];
 
-	RayTracing::CreateTopLevelAccelerationStructureForScene(entities);
+	FrameStats::Clock::time_point phaseStart = FrameStats::Clock::now();
+	GPUProfiler::BeginFrame();
+	GPUProfiler::BeginZone("Frame");
+
+	// The TLAS build is recorded by a job, alongside the tracing
+	RayTracing::CreateTopLevelAccelerationStructureForScene(entities, simulation.GetWorldMatrices(), simulation.GetPreviousWorldMatrices());
+	currentFrameTiming.PhaseMs[FRAME_PHASE_TLAS_BUILD] = FrameStats::Lap(phaseStart);
+
+	// Perform ray trace (which also copies the results to the back buffer),
+	// then wait for everything being recorded on other threads
+	RayTracing::Raytrace(camera, currentBackBuffer, lights, lightCount);
+	RayTracing::FinishRecording();
+	currentFrameTiming.PhaseMs[FRAME_PHASE_RAYTRACE_RECORD] = FrameStats::Lap(phaseStart);
 
-	// Perform ray trace (which also copies the results to the back buffer)
-	RayTracing::Raytrace(camera, currentBackBuffer);
+	GPUProfiler::EndZone();
+	GPUProfiler::EndFrame();
 
 	// Present
 	{
 		// Must occur BEFORE present
 		Graphics::CloseAndExecuteCommandList();
+		currentFrameTiming.PhaseMs[FRAME_PHASE_SUBMIT] = FrameStats::Lap(phaseStart);
 
 		// Present the current back buffer and move to the next one
+		TRACE_ZONE("Present Wait");
 		bool vsync = Graphics::VsyncState();
 		Graphics::SwapChain->Present(
 			vsync ? 1 : 0,
@@ -215,9 +563,22 @@ void Game::Draw(float deltaTime, float totalTime)
 
 		// Reset allocator & cmd list for next frame
 		//Graphics::WaitForGPU();
-		Graphics::ResetAllocatorAndCommandList(Graphics::SwapChainIndex());
+		Graphics::ResetAllocatorAndCommandList(Graphics::FrameIndex());
+		currentFrameTiming.PhaseMs[FRAME_PHASE_PRESENT_WAIT] = FrameStats::Lap(phaseStart);
 	}
 }
 
 
+// --------------------------------------------------------
+// Records the timings of the frame that just finished,
+// given how long the whole frame took
+// --------------------------------------------------------
+void Game::EndFrame(double frameMs)
+{
+	currentFrameTiming.TotalMs = frameMs;
+	frameStats.RecordFrame(currentFrameTiming);
+	currentFrameTiming = {};
+}
+
+
 
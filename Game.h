@@ -2,7 +2,10 @@
 
 #include <d3d12.h>
 #include <wrl/client.h>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include "Camera.h"
 #include "Mesh.h"
@@ -10,6 +13,10 @@
 #include "Material.h"
 #include "Light.h"
 #include "RayTracing.h"
+#include "FrameStats.h"
+#include "BenchmarkTimeline.h"
+#include "ScriptedScene.h"
+#include "SceneSimulation.h"
 
 class Game
 {
@@ -24,12 +31,32 @@ public:
 	void Initialize();
 	void Update(float deltaTime, float totalTime);
 	void Draw(float deltaTime, float totalTime);
+	void EndFrame(double frameMs);
 	void OnResize();
 
+	// Benchmarking (headless runs use Benchmark::RunHeadless instead)
+	void UpdateBenchmark(float deltaTime, float totalTime, const BenchmarkTimeline& timeline);
+
+	FrameStats& GetFrameStats() { return frameStats; }
+
+	// Runs the simulation on its own thread, one frame ahead
+	// of what's being rendered
+	void SetThreadedUpdate(bool threaded);
+	bool GetThreadedUpdate() { return simulationThread.joinable(); }
+
 private:
 
 	// Initialization helper methods - feel free to customize, combine, remove, etc.
+	void CreateCamera(float aspectRatio);
 	void CreateGeometry();
+	void CreateScene();
+	void RecordTimelineFrame(float time);
+
+	// Simulation helpers
+	void PrepareRenderState();
+	void SimulationThreadMain();
+	void RequestSimulation(double frameSeconds);
+	void WaitForSimulation();
 
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
@@ -66,5 +93,27 @@ private:
 	// Other graphics data
 	D3D12_VIEWPORT viewport{};
 	D3D12_RECT scissorRect{};
+
+	// CPU timing of each frame
+	FrameStats frameStats;
+	FrameTiming currentFrameTiming;
+
+	// Fixed-step simulation of the entities, which may be on
+	// another thread.  Its render state is copied into the
+	// entities' transforms once it's safe to read.
+	SceneSimulation simulation{ ScriptedScene::CreateInitialObjects() };
+
+	// Optional simulation thread
+	std::thread simulationThread;
+	std::mutex simulationLock;
+	std::condition_variable simulationSignal;
+	bool simulationRequested = false;
+	bool stopSimulation = false;
+	double requestedFrameSeconds = 0;
+
+	// Benchmarking
+	bool recordingTimeline = false;
+	float timelineStartTime = 0;
+	BenchmarkTimeline recordedTimeline;
 };
 
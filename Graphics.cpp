@@ -1,8 +1,14 @@
 #include "Graphics.h"
+#include "GPUMemory.h"
+#include "CommandListPool.h"
+#include "Trace.h"
 #include <dxgi1_6.h>
 #include "WICTextureLoader.h"
 #include "ResourceUploadBatch.h"
 
+#include <atomic>
+#include <mutex>
+
 // Tell the drivers to use high-performance GPU in multi-GPU systems (like laptops)
 extern "C"
 {
@@ -25,93 +31,295 @@ namespace Graphics
 
 		unsigned int currentBackBufferIndex = 0;
 
+		// Frames in flight, which default to one per back buffer
+		FrameScheduler frameScheduler(MaxFramesInFlight, NumBackBuffers);
+
+		// Sleeps before input is sampled to keep latency down
+		FramePacer framePacer;
+
+		// Milliseconds on the same clock as resolved GPU timestamps
+		double NowMs()
+		{
+			LARGE_INTEGER now{}, frequency{};
+			QueryPerformanceCounter(&now);
+			QueryPerformanceFrequency(&frequency);
+			return now.QuadPart * 1000.0 / frequency.QuadPart;
+		}
+
 		// Descriptor heap management
 		SIZE_T CBVSRVDescriptorHeapIncrementSize = 0;
-		unsigned int cbvDescriptorOffset = 0;
+		RingAllocator cbvDescriptorRing;
 
 		// CB upload heap management
 		UINT64 cbUploadHeapSizeInBytes = 0;
-		UINT64 cbUploadHeapOffsetInBytes = 0;
+		RingAllocator cbUploadRing;
+
+		// Constant buffers may be filled from several recording
+		// threads at once (see CommandListPool), so both rings and
+		// the upload heap they point into are behind this
+		std::mutex ringMutex;
+
+		// How many times the CPU has blocked on the frame fence,
+		// whether for a free frame or for ring space
+		std::atomic<UINT64> frameFenceStalls = 0;
+
+		// Reused each frame to gather lists for submission
+		std::vector<ID3D12CommandList*> commandListsToExecute;
+
+		// Objects waiting for the GPU to finish with them, which
+		// threads recording pooled lists may add to as well
+		DeferredReleaseQueue<Microsoft::WRL::ComPtr<IUnknown>> deferredReleases;
+		std::mutex deferredReleaseMutex;
 		void* cbUploadHeapStartAddress = 0;
 
 		unsigned int srvDescriptorOffset = maxConstantBuffers; // Assume first SRV is after all CBVs
 		// Texture resources we need to keep alive
 		std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> textures;
 		std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> cpuSideTextureDescriptorHeaps;
+
+		// Blocks until the frame sync fence reaches the given value
+		void WaitForFrameFence(UINT64 fenceValue)
+		{
+			if (FrameSyncFence->GetCompletedValue() >= fenceValue)
+				return;
+
+			frameFenceStalls++;
+			FrameSyncFence->SetEventOnCompletion(fenceValue, FrameSyncFenceEvent);
+			WaitForSingleObject(FrameSyncFenceEvent, INFINITE);
+		}
+
+		// --------------------------------------------------------
+		// Allocates from one of the constant buffer rings, waiting on
+		// in-flight frames (oldest first) until enough space is retired.
+		// Returns InvalidOffset if the current frame alone has filled
+		// the ring, since waiting would never free anything up.
+		//
+		// The lock is let go while waiting, so other recording threads
+		// aren't stuck behind this one.  Several threads may wait at
+		// once, so each blocks in SetEventOnCompletion() rather than
+		// sharing the frame fence's event.
+		// - lock must hold ringMutex
+		// --------------------------------------------------------
+		UINT64 AllocateFromRing(std::unique_lock<std::mutex>& lock, RingAllocator& ring, UINT64 size, UINT64 alignment)
+		{
+			UINT64 offset = ring.Allocate(size, alignment);
+			while (offset == RingAllocator::InvalidOffset && ring.HasPendingFrames())
+			{
+				ring.RecordStall();
+				UINT64 fenceValue = ring.GetOldestPendingFenceValue();
+
+				lock.unlock();
+				if (FrameSyncFence->GetCompletedValue() < fenceValue)
+				{
+					frameFenceStalls++;
+					FrameSyncFence->SetEventOnCompletion(fenceValue, 0);
+				}
+				lock.lock();
+
+				// Another thread may have retired frames (or replaced the
+				// upload heap) in the meantime, so check again from scratch
+				ring.Retire(FrameSyncFence->GetCompletedValue());
+				offset = ring.Allocate(size, alignment);
+			}
+
+			return offset;
+		}
+
+		// --------------------------------------------------------
+		// Replaces the constant buffer upload heap with one at
+		// least twice as big, for when a single frame fills it.
+		// Everything allocated so far lives in the old heap, which
+		// is kept until the GPU finishes this frame, so the ring
+		// starts over empty in the new one.
+		// - ringMutex must be held
+		// --------------------------------------------------------
+		void GrowConstantBufferUploadHeap(UINT64 minimumFreeSize)
+		{
+			UINT64 newSize = max(cbUploadHeapSizeInBytes * 2, cbUploadHeapSizeInBytes + minimumFreeSize);
+			newSize = (newSize + 255) / 256 * 256;
+			printf("\nWARNING: Constant buffer upload heap filled by a single frame - growing it from %llu to %llu KB.\n",
+				cbUploadHeapSizeInBytes / 1024, newSize / 1024);
+
+			D3D12_RESOURCE_DESC resDesc = {};
+			resDesc.Alignment = 0;
+			resDesc.DepthOrArraySize = 1;
+			resDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+			resDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+			resDesc.Format = DXGI_FORMAT_UNKNOWN;
+			resDesc.Height = 1;
+			resDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+			resDesc.MipLevels = 1;
+			resDesc.SampleDesc.Count = 1;
+			resDesc.SampleDesc.Quality = 0;
+			resDesc.Width = newSize;
+
+			Microsoft::WRL::ComPtr<ID3D12Resource> newHeap = GPUMemory::CreatePlacedResource(
+				resDesc,
+				D3D12_HEAP_TYPE_UPLOAD,
+				D3D12_RESOURCE_STATE_GENERIC_READ);
+
+			// The old heap stays mapped until it's released
+			ReleaseWhenFrameCompletes(CBUploadHeap);
+			CBUploadHeap = newHeap;
+			cbUploadHeapSizeInBytes = newSize;
+			cbUploadRing.Reset(newSize);
+
+			D3D12_RANGE range{ 0, 0 };
+			CBUploadHeap->Map(0, &range, &cbUploadHeapStartAddress);
+		}
+
+		// Keeps a finished texture alive and gives it a CPU-side SRV, which
+		// can be copied to the shader-visible heap later
+		D3D12_CPU_DESCRIPTOR_HANDLE KeepTextureAndCreateSRV(Microsoft::WRL::ComPtr<ID3D12Resource> texture)
+		{
+			// Note that it would probably be better to put all texture SRVs into
+			// the same descriptor heap, but we don't know how many we'll need
+			// until they're all loaded and this is a quick and dirty implementation!
+			textures.push_back(texture);
+
+			// Create the CPU-SIDE descriptor heap for our descriptor
+			D3D12_DESCRIPTOR_HEAP_DESC dhDesc = {};
+			dhDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE; // Non-shader visible!
+			dhDesc.NodeMask = 0;
+			dhDesc.NumDescriptors = 1;
+			dhDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+
+			Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> descHeap;
+			Device->CreateDescriptorHeap(&dhDesc, IID_PPV_ARGS(descHeap.GetAddressOf()));
+
+			// Add to our list of heaps (to keep the resource alive)
+			cpuSideTextureDescriptorHeaps.push_back(descHeap);
+
+			// Create the SRV on this descriptor heap
+			// Note: Using a null description results in the "default" SRV 
+			// (same format, all mips, all array slices, etc.)
+			D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = descHeap->GetCPUDescriptorHandleForHeapStart();
+			Device->CreateShaderResourceView(texture.Get(), 0, cpuHandle);
+			return cpuHandle;
+		}
 	}
 }
 
 // --------------------------------------------------------
 // Copies the given data into the next "unused" spot in the CBV upload heap (wrapping at the end, since 
-// we treat it like a ring buffer).  Then creates a CBV in the next "unused" spot in the CBV heap that
-// points to the aforementioned spot in the upload heap and returns that CBV (a GPU descriptor handle).
+// we treat it like a ring buffer) and returns the GPU virtual address of that spot.  No descriptor is
+// created, so the result must be bound directly as a root CBV.
+// 
+// The ring only reuses space once the frame that used it has been finished by the GPU, so this
+// may block if too many constant buffers are in flight at once.
 // 
 // data - The data to copy to the GPU
 // dataSizeInBytes - The byte size of the data to copy
 // --------------------------------------------------------
-D3D12_GPU_DESCRIPTOR_HANDLE Graphics::FillNextConstantBufferAndGetGPUDescriptorHandle(
+D3D12_GPU_VIRTUAL_ADDRESS Graphics::FillNextConstantBufferAndGetGPUVirtualAddress(
 	void* data, unsigned int dataSizeInBytes)
 {
-	// How much space will we need?  Each CBV must point to a chunk of the upload heap that is
-	// a multiple of 256 bytes, so we need to calculate and reserve that amount.
+	// How much space will we need?  Constant buffer data must start on a
+	// 256 byte boundary, so we need to calculate and reserve that amount.
 	SIZE_T reservationSize = (SIZE_T)dataSizeInBytes;
 	reservationSize = (reservationSize + 255) / 256 * 256; // Integer division trick 
 
-	// Ensure this upload will fit in the remaining space.  If not, reset to beginning.
-	if (cbUploadHeapOffsetInBytes + reservationSize >= cbUploadHeapSizeInBytes)
-		cbUploadHeapOffsetInBytes = 0;
+	// Reserve space in the upload heap, which may wait on older frames.
+	// The heap may be replaced by another thread, so both addresses
+	// are worked out before letting go of the lock.
+	void* uploadAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS virtualGPUAddress = 0;
+	{
+		std::unique_lock<std::mutex> lock(ringMutex);
+		UINT64 cbUploadHeapOffsetInBytes = AllocateFromRing(lock, cbUploadRing, reservationSize, 256);
 
-	// Where in the upload heap will this data go?
-	D3D12_GPU_VIRTUAL_ADDRESS virtualGPUAddress = CBUploadHeap->GetGPUVirtualAddress() + cbUploadHeapOffsetInBytes;
+		// This frame alone has filled the heap, so rather than overwrite
+		// its earlier constant buffers, move on to a bigger heap
+		if (cbUploadHeapOffsetInBytes == RingAllocator::InvalidOffset)
+		{
+			GrowConstantBufferUploadHeap(reservationSize);
+			cbUploadHeapOffsetInBytes = cbUploadRing.Allocate(reservationSize, 256);
+		}
 
-	// === Copy data to the upload heap ===
-	{
 		// Calculate the actual upload address (which we got from mapping the buffer)
-		// Note that this is different than the GPU virtual address needed for the CBV below
-		void* uploadAddress = reinterpret_cast<void*>(
+		// Note that this is different than the GPU virtual address we return below
+		uploadAddress = reinterpret_cast<void*>(
 			(SIZE_T)cbUploadHeapStartAddress + cbUploadHeapOffsetInBytes);
+		virtualGPUAddress = CBUploadHeap->GetGPUVirtualAddress() + cbUploadHeapOffsetInBytes;
+	}
 
-		// Perform the mem copy to put new data into this part of the heap
-		memcpy(uploadAddress, data, dataSizeInBytes);
+	// Perform the mem copy to put new data into this part of the heap
+	memcpy(uploadAddress, data, dataSizeInBytes);
 
-		// Increment the offset and loop back to the beginning if necessary,
-		// allowing us to treat the upload heap like a ring buffer
-		cbUploadHeapOffsetInBytes += reservationSize;
-		if (cbUploadHeapOffsetInBytes >= cbUploadHeapSizeInBytes)
-			cbUploadHeapOffsetInBytes = 0;
+	// Where in the upload heap did this data go?
+	return virtualGPUAddress;
+}
+
+// --------------------------------------------------------
+// Copies the given data into the next "unused" spot in the CBV upload heap (see above).  Then creates
+// a CBV in the next "unused" spot in the CBV heap that points to the aforementioned spot in the upload
+// heap and returns that CBV (a GPU descriptor handle).
+// 
+// Both rings only reuse space once the frame that used it has been finished by the GPU, so this
+// may block if too many constant buffers are in flight at once.
+// 
+// data - The data to copy to the GPU
+// dataSizeInBytes - The byte size of the data to copy
+// --------------------------------------------------------
+D3D12_GPU_DESCRIPTOR_HANDLE Graphics::FillNextConstantBufferAndGetGPUDescriptorHandle(
+	void* data, unsigned int dataSizeInBytes)
+{
+	// Copy the data to the upload heap first
+	D3D12_GPU_VIRTUAL_ADDRESS virtualGPUAddress = FillNextConstantBufferAndGetGPUVirtualAddress(data, dataSizeInBytes);
+
+	// Reserve the next descriptor, which may also wait on older frames
+	UINT64 cbvDescriptorOffset = 0;
+	{
+		std::unique_lock<std::mutex> lock(ringMutex);
+		cbvDescriptorOffset = AllocateFromRing(lock, cbvDescriptorRing, 1, 1);
 	}
 
-	// Create a CBV for this section of the heap
+	// Unlike the upload heap, the CBV range can't grow, since texture
+	// SRVs come right after it in the same heap (and their handles are
+	// already in use).  Overwriting this frame's own CBVs would corrupt
+	// its draws, so hand back a null handle for the caller to skip.
+	if (cbvDescriptorOffset == RingAllocator::InvalidOffset)
 	{
-		// Calculate the CPU and GPU side handles for this descriptor
-		D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = CBVSRVDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
-		D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle = CBVSRVDescriptorHeap->GetGPUDescriptorHandleForHeapStart();
+		static std::once_flag warned;
+		std::call_once(warned, []() {
+			printf("\nWARNING: Constant buffer descriptors exhausted by a single frame - skipping draws, increase maxConstantBuffers.\n"); });
+		return D3D12_GPU_DESCRIPTOR_HANDLE{};
+	}
 
+	// Calculate the CPU and GPU side handles for this descriptor
+	D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = CBVSRVDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
+	D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle = CBVSRVDescriptorHeap->GetGPUDescriptorHandleForHeapStart();
 
-		// Offset each by based on how many descriptors we've used
-		// Note: cbvDescriptorOffset is a COUNT of descriptors, not bytes so we must calculate the size
-		cpuHandle.ptr += (SIZE_T)cbvDescriptorOffset * CBVSRVDescriptorHeapIncrementSize;
-		gpuHandle.ptr += (SIZE_T)cbvDescriptorOffset * CBVSRVDescriptorHeapIncrementSize;
+	// Offset each by based on how many descriptors we've used
+	// Note: cbvDescriptorOffset is a COUNT of descriptors, not bytes so we must calculate the size
+	cpuHandle.ptr += (SIZE_T)cbvDescriptorOffset * CBVSRVDescriptorHeapIncrementSize;
+	gpuHandle.ptr += (SIZE_T)cbvDescriptorOffset * CBVSRVDescriptorHeapIncrementSize;
 
-		// Describe the constant buffer view that points to our latest chunk of the CB upload heap
-		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-		cbvDesc.BufferLocation = virtualGPUAddress;
-		cbvDesc.SizeInBytes = (UINT)reservationSize;
+	// Describe the constant buffer view that points to our latest chunk of the CB upload heap
+	D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+	cbvDesc.BufferLocation = virtualGPUAddress;
+	cbvDesc.SizeInBytes = (dataSizeInBytes + 255) / 256 * 256; // Must match the reservation size
 
-		// Create the CBV, which is a lightweight operation in DX12
-		Device->CreateConstantBufferView(&cbvDesc, cpuHandle);
+	// Create the CBV, which is a lightweight operation in DX12
+	Device->CreateConstantBufferView(&cbvDesc, cpuHandle);
 
-		// Increment the offset and loop back to the beginning if necessary
-		// which allows us to treat the descriptor heap as a ring buffer
-		cbvDescriptorOffset++;
-		if (cbvDescriptorOffset >= maxConstantBuffers)
-			cbvDescriptorOffset = 0;
+	// Now that the CBV is ready, we return the GPU handle to it
+	// so it can be set as part of the root signature during drawing
+	return gpuHandle;
+}
 
-		// Now that the CBV is ready, we return the GPU handle to it
-		// so it can be set as part of the root signature during drawing
-		return gpuHandle;
-	}
+// Constant buffer ring statistics
+RingAllocatorStats Graphics::GetConstantBufferUploadStats()
+{
+	std::lock_guard<std::mutex> lock(ringMutex);
+	return cbUploadRing.GetStats();
+}
+RingAllocatorStats Graphics::GetConstantBufferDescriptorStats()
+{
+	std::lock_guard<std::mutex> lock(ringMutex);
+	return cbvDescriptorRing.GetStats();
 }
+UINT64 Graphics::GetFrameFenceStallCount() { return frameFenceStalls; }
 
 // Getters
 bool Graphics::VsyncState() { return vsyncDesired || !supportsTearing || isFullscreen; }
@@ -130,6 +338,10 @@ std::wstring Graphics::APIName()
 	}
 }
 unsigned int Graphics::SwapChainIndex() { return currentBackBufferIndex; }
+unsigned int Graphics::FrameIndex() { return frameScheduler.GetCurrentFrameIndex(); }
+UINT64 Graphics::CurrentFrameFenceValue() { return frameScheduler.GetCurrentFenceValue(); }
+UINT64 Graphics::CompletedFrameFenceValue() { return FrameSyncFence->GetCompletedValue(); }
+unsigned int Graphics::GetFramesInFlight() { return frameScheduler.GetFramesInFlight(); }
 
 // --------------------------------------------------------
 // Initializes the Graphics API, which requires window details.
@@ -204,6 +416,10 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 		featureLevel = levels.MaxSupportedFeatureLevel;
 	}
 
+	// Our resources are placed in shared heaps, which
+	// requires the device to exist first
+	GPUMemory::Initialize();
+
 #if defined(DEBUG) || defined(_DEBUG)
 	// Set up a callback for any debug messages
 	Device->QueryInterface(IID_PPV_ARGS(&InfoQueue));
@@ -212,8 +428,8 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 	// Set up D3D12 command allocator / queue / list,
 	// which are necessary pieces for issuing standard API calls
 	{
-		// Set up allocators
-		for (int i = 0; i < NumBackBuffers; i++)
+		// Set up allocators, one per frame that may be in flight
+		for (int i = 0; i < MaxFramesInFlight; i++)
 		{
 
 			Device->CreateCommandAllocator(
@@ -321,23 +537,13 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 		clear.DepthStencil.Depth = 1.0f;
 		clear.DepthStencil.Stencil = 0;
 
-		// Describe the memory heap that will house this resource
-		D3D12_HEAP_PROPERTIES props = {};
-		props.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-		props.CreationNodeMask = 1;
-		props.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-		props.Type = D3D12_HEAP_TYPE_DEFAULT;
-		props.VisibleNodeMask = 1;
-
-		// Actually create the resource, and the heap in which it
-		// will reside, and map the resource to that heap
-		Device->CreateCommittedResource(
-			&props,
-			D3D12_HEAP_FLAG_NONE,
-			&depthBufferDesc,
+		// Actually create the resource, placing it
+		// in one of our shared render target heaps
+		DepthBuffer = GPUMemory::CreatePlacedResource(
+			depthBufferDesc,
+			D3D12_HEAP_TYPE_DEFAULT,
 			D3D12_RESOURCE_STATE_DEPTH_WRITE,
-			&clear,
-			IID_PPV_ARGS(DepthBuffer.GetAddressOf()));
+			&clear);
 
 		// Get the handle to the Depth Stencil View that we'll
 		// be using for the depth buffer.  The DSV is stored in
@@ -379,9 +585,9 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 
 		Device->CreateDescriptorHeap(&dhDesc, IID_PPV_ARGS(CBVSRVDescriptorHeap.GetAddressOf()));
 
-		// Assume the first CBV will be at the beginning of the heap
-		// This will increase as we use more CBVs and will wrap back to 0
-		cbvDescriptorOffset = 0;
+		// The first maxConstantBuffers descriptors are treated as a ring
+		// of CBVs, which are reused once the GPU is done with them
+		cbvDescriptorRing.Reset(maxConstantBuffers);
 	}
 
 	// Create an upload heap for constant buffer data
@@ -391,17 +597,8 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 		// all 256 bytes or less, or fewer overall CBs if they're larger
 		cbUploadHeapSizeInBytes = (UINT64)maxConstantBuffers * 256;
 
-		// Assume the first CB will start at the beginning of the heap
-		// This offset changes as we use more CBs, and wraps around when full
-		cbUploadHeapOffsetInBytes = 0;
-
-		// Create the upload heap for our constant buffer
-		D3D12_HEAP_PROPERTIES heapProps = {};
-		heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-		heapProps.CreationNodeMask = 1;
-		heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-		heapProps.Type = D3D12_HEAP_TYPE_UPLOAD; // Upload heap since we'll be copying often!
-		heapProps.VisibleNodeMask = 1;
+		// Track which parts of the heap are in use by in-flight frames
+		cbUploadRing.Reset(cbUploadHeapSizeInBytes);
 
 		// Fill out description
 		D3D12_RESOURCE_DESC resDesc = {};
@@ -417,14 +614,12 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 		resDesc.SampleDesc.Quality = 0;
 		resDesc.Width = cbUploadHeapSizeInBytes; // Must be 256 byte aligned!
 
-		// Create a constant buffer resource heap
-		Device->CreateCommittedResource(
-			&heapProps,
-			D3D12_HEAP_FLAG_NONE,
-			&resDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			0,
-			IID_PPV_ARGS(CBUploadHeap.GetAddressOf()));
+		// Create the constant buffer resource in an upload heap,
+		// since we'll be copying often!
+		CBUploadHeap = GPUMemory::CreatePlacedResource(
+			resDesc,
+			D3D12_HEAP_TYPE_UPLOAD,
+			D3D12_RESOURCE_STATE_GENERIC_READ);
 
 		// Keep mapped!
 		D3D12_RANGE range{ 0, 0 };
@@ -447,6 +642,13 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 // --------------------------------------------------------
 void Graphics::ShutDown()
 {
+	// The GPU is idle by now, so nothing is in use
+	{
+		std::lock_guard<std::mutex> lock(deferredReleaseMutex);
+		deferredReleases.Flush();
+	}
+	CommandListPool::ShutDown();
+	GPUMemory::ShutDown();
 }
 
 
@@ -529,23 +731,13 @@ void Graphics::ResizeBuffers(unsigned int width, unsigned int height)
 		clear.DepthStencil.Depth = 1.0f;
 		clear.DepthStencil.Stencil = 0;
 
-		// Describe the memory heap that will house this resource
-		D3D12_HEAP_PROPERTIES props = {};
-		props.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-		props.CreationNodeMask = 1;
-		props.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-		props.Type = D3D12_HEAP_TYPE_DEFAULT;
-		props.VisibleNodeMask = 1;
-
-		// Actually create the resource, and the heap in which it
-		// will reside, and map the resource to that heap
-		Device->CreateCommittedResource(
-			&props,
-			D3D12_HEAP_FLAG_NONE,
-			&depthBufferDesc,
+		// Actually create the resource, placing it
+		// in one of our shared render target heaps
+		DepthBuffer = GPUMemory::CreatePlacedResource(
+			depthBufferDesc,
+			D3D12_HEAP_TYPE_DEFAULT,
 			D3D12_RESOURCE_STATE_DEPTH_WRITE,
-			&clear,
-			IID_PPV_ARGS(DepthBuffer.GetAddressOf()));
+			&clear);
 
 		// Now recreate the depth stencil view
 		DSVHandle = DSVHeap->GetCPUDescriptorHandleForHeapStart();
@@ -555,7 +747,8 @@ void Graphics::ResizeBuffers(unsigned int width, unsigned int height)
 			DSVHandle);
 	}
 
-	// Reset back to the first buffer
+	// Reset back to the first buffer.  Frame fence values carry
+	// on as usual, since they don't depend on the swap chain.
 	currentBackBufferIndex = 0;
 
 	// Are we in a fullscreen state?
@@ -567,36 +760,126 @@ void Graphics::ResizeBuffers(unsigned int width, unsigned int height)
 
 // --------------------------------------------------------
 // Advances the swap chain back buffer index by 1, wrapping
-// back to zero when necessary.  This should occur after
-// presenting the current frame.
+// back to zero when necessary, and moves on to the next
+// frame.  This should occur after presenting the current
+// frame.
+//
+// Only blocks if the CPU is already the maximum number of
+// frames in flight ahead of the GPU.
 // --------------------------------------------------------
 void Graphics::AdvanceSwapChainIndex()
 {
 	// Signal into command queue
-	UINT64 currentFenceCounter = FrameSyncFenceCounters[currentBackBufferIndex];
-	CommandQueue->Signal(FrameSyncFence.Get(), currentFenceCounter);
+	UINT64 currentFenceValue = frameScheduler.GetCurrentFenceValue();
+	CommandQueue->Signal(FrameSyncFence.Get(), currentFenceValue);
+	framePacer.EndFrame(currentFenceValue, NowMs());
+
+	// Everything allocated from the constant buffer rings this frame
+	// can be reused once the GPU reaches the value we just signaled
+	// - Recording threads are done by now, but the lock keeps the
+	//   rings safe even if one is still filling constant buffers
+	{
+		std::lock_guard<std::mutex> lock(ringMutex);
+		cbUploadRing.FinishFrame(currentFenceValue);
+		cbvDescriptorRing.FinishFrame(currentFenceValue);
+	}
+
+	// Move on to the next back buffer
+	currentBackBufferIndex = (currentBackBufferIndex + 1) % NumBackBuffers;
 
-	// Calculate index of next buffer
-	unsigned int nextBuffer = (currentBackBufferIndex + 1) % NumBackBuffers;
+	// Wait until the next frame's per-frame resources are free, which
+	// only happens once the CPU is too far ahead of the GPU
+	UINT64 waitFenceValue = frameScheduler.EndFrame(FrameSyncFence->GetCompletedValue());
+	{
+		double waitStartMs = NowMs();
+		WaitForFrameFence(waitFenceValue);
+		frameScheduler.RecordCPUWait(NowMs() - waitStartMs);
+	}
 
-	// Check if we need to wait for the next frame
-	if (FrameSyncFence->GetCompletedValue() < FrameSyncFenceCounters[nextBuffer])
+	// Release any ring space from frames the GPU has finished
+	UINT64 completedFenceValue = FrameSyncFence->GetCompletedValue();
+	{
+		std::lock_guard<std::mutex> lock(ringMutex);
+		cbUploadRing.Retire(completedFenceValue);
+		cbvDescriptorRing.Retire(completedFenceValue);
+	}
 	{
-		// Not finished rendering
-		FrameSyncFence->SetEventOnCompletion(FrameSyncFenceCounters[nextBuffer], FrameSyncFenceEvent);
-		WaitForSingleObject(FrameSyncFenceEvent, INFINITE);
+		std::lock_guard<std::mutex> lock(deferredReleaseMutex);
+		deferredReleases.Release(completedFenceValue);
 	}
 
-	// Fame is finished
-	FrameSyncFenceCounters[nextBuffer] = currentFenceCounter + 1;
+	// Give back any heaps that have been left empty for a while
+	GPUMemory::Trim();
+}
+
+// --------------------------------------------------------
+// Changes how many frames the CPU may get ahead of the GPU,
+// from 1 (no overlap at all) up to MaxFramesInFlight.
+// Takes effect when the current frame ends.
+// --------------------------------------------------------
+void Graphics::SetFramesInFlight(unsigned int frames)
+{
+	frameScheduler.SetFramesInFlight(frames);
+}
+
+// --------------------------------------------------------
+// Adds a frame's GPU start and end times (on the CPU's
+// timeline, in milliseconds) so idle gaps and latency can
+// be measured.  Frames must be added in the order they
+// were submitted.
+// --------------------------------------------------------
+void Graphics::RecordGPUFrame(UINT64 frameFenceValue, double startMs, double endMs)
+{
+	frameScheduler.RecordGPUFrame(startMs, endMs);
+	framePacer.RecordGPUFrame(frameFenceValue, startMs, endMs);
+}
+
+FrameSchedulerStats Graphics::GetFrameSchedulerStats() { return frameScheduler.GetStats(); }
+FrameSchedulerStats Graphics::GetTotalFrameSchedulerStats() { return frameScheduler.GetTotalStats(); }
+void Graphics::ResetFrameSchedulerStats() { frameScheduler.ResetStats(); }
+
+// --------------------------------------------------------
+// Call right before sampling input for a new frame.  If
+// pacing is on and the GPU is the bottleneck, this sleeps
+// until just late enough that the frame will be submitted
+// as the GPU finishes its earlier work, rather than waiting
+// in the queue (with increasingly stale input).
+// --------------------------------------------------------
+void Graphics::WaitForFramePacing()
+{
+	double startMs = NowMs();
+	double sleepMs = framePacer.GetSleepMs(startMs, FrameSyncFence->GetCompletedValue());
+
+	// Sleep() is only accurate to around a millisecond,
+	// so spin for whatever's left after it
+	if (sleepMs > 0)
+	{
+		double wakeMs = startMs + sleepMs;
+		if (sleepMs > 1.5)
+			Sleep((DWORD)(sleepMs - 1.0));
+		while (NowMs() < wakeMs)
+			YieldProcessor();
+	}
 
-	// Return new index
-	currentBackBufferIndex = nextBuffer;
+	double inputSampleMs = NowMs();
+	framePacer.BeginFrame(frameScheduler.GetCurrentFenceValue(), inputSampleMs, inputSampleMs - startMs);
 }
 
+void Graphics::SetFramePacing(bool enabled) { framePacer.SetEnabled(enabled); }
+bool Graphics::GetFramePacing() { return framePacer.GetEnabled(); }
+FramePacerStats Graphics::GetFramePacerStats() { return framePacer.GetStats(); }
+void Graphics::ResetFramePacerStats() { framePacer.ResetStats(); }
+
 // --------------------------------------------------------
 // Helper for creating a static buffer that will get
 // data once and remain immutable
+//
+// Thread safe.  The copy is recorded on a pooled command
+// list that's submitted ahead of everything else this frame
+// (see CommandListPool::UploadCommandListOrder), so the
+// buffer can be used by anything recorded this frame.  The
+// upload heap is released once the current frame's fence is
+// reached, so the CPU never waits here.
 // 
 // dataStride - The size of one piece of data in the buffer (like a vertex)
 // dataCount - How many pieces of data (like how many vertices)
@@ -605,38 +888,13 @@ void Graphics::AdvanceSwapChainIndex()
 Microsoft::WRL::ComPtr<ID3D12Resource> Graphics::CreateStaticBuffer(
 	size_t dataStride, size_t dataCount, void* data)
 {
-	// Creates a temporary command allocator and list so we don't
-	// screw up any other ongoing work (since resetting a command allocator
-	// cannot happen while its list is being executed).  These ComPtrs will
-	// be cleaned up automatically when they go out of scope.
-	// Note: This certainly isn't efficient, but hopefully this only
-	//       happens during start-up.  Otherwise, refactor this to use
-	//       the existing list and allocator(s).
-	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> localAllocator;
-	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> localList;
-
-	Device->CreateCommandAllocator(
-		D3D12_COMMAND_LIST_TYPE_DIRECT,
-		IID_PPV_ARGS(localAllocator.GetAddressOf()));
-
-	Device->CreateCommandList(
-		0,	// Which physical GPU will handle these tasks?  0 for single GPU setup
-		D3D12_COMMAND_LIST_TYPE_DIRECT,	// Type of command list
-		localAllocator.Get(),			// The allocator for this list (to start)
-		0,					// Initial pipeline state - none for now
-		IID_PPV_ARGS(localList.GetAddressOf()));
+	// A list of our own, so this can be called from any thread
+	// without touching the main command list
+	ID3D12GraphicsCommandList* uploadList = CommandListPool::Acquire(CommandListPool::UploadCommandListOrder);
 
 	// The overall buffer we'll be creating
 	Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
 
-	// Describes the final heap
-	D3D12_HEAP_PROPERTIES props = {};
-	props.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-	props.CreationNodeMask = 1;
-	props.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-	props.Type = D3D12_HEAP_TYPE_DEFAULT;
-	props.VisibleNodeMask = 1;
-
 	D3D12_RESOURCE_DESC desc = {};
 	desc.Alignment = 0;
 	desc.DepthOrArraySize = 1;
@@ -650,30 +908,16 @@ Microsoft::WRL::ComPtr<ID3D12Resource> Graphics::CreateStaticBuffer(
 	desc.SampleDesc.Quality = 0;
 	desc.Width = dataStride * dataCount; // Size of the buffer
 
-	Device->CreateCommittedResource(
-		&props,
-		D3D12_HEAP_FLAG_NONE,
-		&desc,
-		D3D12_RESOURCE_STATE_COPY_DEST,
-		0,
-		IID_PPV_ARGS(buffer.GetAddressOf()));
-
-	// Now create an intermediate upload heap for copying initial data
-	D3D12_HEAP_PROPERTIES uploadProps = {};
-	uploadProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-	uploadProps.CreationNodeMask = 1;
-	uploadProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-	uploadProps.Type = D3D12_HEAP_TYPE_UPLOAD;
-	uploadProps.VisibleNodeMask = 1;
-
-	Microsoft::WRL::ComPtr<ID3D12Resource> uploadHeap;
-	Device->CreateCommittedResource(
-		&uploadProps,
-		D3D12_HEAP_FLAG_NONE,
-		&desc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		0,
-		IID_PPV_ARGS(uploadHeap.GetAddressOf()));
+	buffer = GPUMemory::CreatePlacedResource(
+		desc,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_COPY_DEST);
+
+	// Now create an intermediate upload buffer for copying initial data
+	Microsoft::WRL::ComPtr<ID3D12Resource> uploadHeap = GPUMemory::CreatePlacedResource(
+		desc,
+		D3D12_HEAP_TYPE_UPLOAD,
+		D3D12_RESOURCE_STATE_GENERIC_READ);
 
 	// Do a straight map/memcpy/unmap
 	void* gpuAddress = 0;
@@ -682,7 +926,7 @@ Microsoft::WRL::ComPtr<ID3D12Resource> Graphics::CreateStaticBuffer(
 	uploadHeap->Unmap(0, 0);
 
 	// Copy the whole buffer from uploadheap to vert buffer
-	localList->CopyResource(buffer.Get(), uploadHeap.Get());
+	uploadList->CopyResource(buffer.Get(), uploadHeap.Get());
 
 	// Transition the buffer to generic read for the rest of the app lifetime (presumable)
 	D3D12_RESOURCE_BARRIER rb = {};
@@ -692,15 +936,12 @@ Microsoft::WRL::ComPtr<ID3D12Resource> Graphics::CreateStaticBuffer(
 	rb.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
 	rb.Transition.StateAfter = D3D12_RESOURCE_STATE_GENERIC_READ;
 	rb.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-	localList->ResourceBarrier(1, &rb);
+	uploadList->ResourceBarrier(1, &rb);
 
-	// Execute the local command list and wait for it to complete
-	// before returning the final buffer
-	localList->Close();
-	ID3D12CommandList* list[] = { localList.Get() };
-	CommandQueue->ExecuteCommandLists(1, list);
-
-	WaitForGPU();
+	// The current frame's fence is signaled after this copy, so once
+	// it's reached nothing needs the upload heap any more (the pool
+	// recycles the list itself)
+	ReleaseWhenFrameCompletes(uploadHeap);
 	return buffer;
 }
 
@@ -719,27 +960,33 @@ UINT Graphics::GetDescriptorIndex(D3D12_GPU_DESCRIPTOR_HANDLE handle)
 // Resets the command allocator and list
 // 
 // Always wait before reseting command allocator, as it should not
-// be reset while the GPU is processing a command list
+// be reset while the GPU is processing a command list.  Using the
+// allocator for FrameIndex() takes care of that, since
+// AdvanceSwapChainIndex() waits for its previous frame.
 // --------------------------------------------------------
-void Graphics::ResetAllocatorAndCommandList(unsigned int swapChainIndex)
+void Graphics::ResetAllocatorAndCommandList(unsigned int frameIndex)
 {
-	CommandAllocator[swapChainIndex]->Reset();
-	CommandList->Reset(CommandAllocator[swapChainIndex].Get(), 0);
+	CommandAllocator[frameIndex]->Reset();
+	CommandList->Reset(CommandAllocator[frameIndex].Get(), 0);
 }
 
 // --------------------------------------------------------
 // Closes the current command list and tells the GPU to
-// start executing those commands.  We also wait for
-// the GPU to finish this work so we can reset the
-// command allocator (which CANNOT be reset while the
-// GPU is using its commands) and the command list itself.
+// start executing those commands, along with any lists
+// recorded from the CommandListPool this frame.  Every list
+// goes in a single ExecuteCommandLists() call, in the order
+// they were acquired with.
+//
+// Any threads recording into pooled lists must be finished
+// before this is called.
 // --------------------------------------------------------
 void Graphics::CloseAndExecuteCommandList()
 {
-	// Close the current list and execute it as our only list
+	// Close the main list, then gather it with the pooled lists
 	CommandList->Close();
-	ID3D12CommandList* lists[] = { CommandList.Get() };
-	CommandQueue->ExecuteCommandLists(1, lists);
+
+	CommandListPool::CloseFrameLists(CommandList.Get(), commandListsToExecute);
+	CommandQueue->ExecuteCommandLists((UINT)commandListsToExecute.size(), commandListsToExecute.data());
 }
 
 // --------------------------------------------------------
@@ -765,6 +1012,30 @@ void Graphics::WaitForGPU()
 }
 
 
+// --------------------------------------------------------
+// Holds onto an object (usually a resource that's being
+// replaced) until the GPU finishes the frame currently
+// being recorded.  Objects are actually released in
+// AdvanceSwapChainIndex() once the frame fence is reached.
+// Thread safe, for passes recorded on pooled lists.
+// --------------------------------------------------------
+void Graphics::ReleaseWhenFrameCompletes(Microsoft::WRL::ComPtr<IUnknown> object)
+{
+	if (!object)
+		return;
+
+	// The current frame signals this value when it's done
+	std::lock_guard<std::mutex> lock(deferredReleaseMutex);
+	deferredReleases.Enqueue(object, frameScheduler.GetCurrentFenceValue());
+}
+
+unsigned int Graphics::GetPendingReleaseCount()
+{
+	std::lock_guard<std::mutex> lock(deferredReleaseMutex);
+	return deferredReleases.GetPendingCount();
+}
+
+
 // --------------------------------------------------------
 // Prints graphics debug messages waiting in the queue
 // --------------------------------------------------------
@@ -822,6 +1093,8 @@ void Graphics::PrintDebugMessages()
 
 D3D12_CPU_DESCRIPTOR_HANDLE Graphics::LoadTexture(const wchar_t* file, bool generateMips)
 {
+	TRACE_ZONE("LoadTexture");
+
 	// Helper function from DXTK for uploading a resource
 	// (like a texture) to the appropriate GPU memory
 	DirectX::ResourceUploadBatch upload(Device.Get());
@@ -836,33 +1109,63 @@ D3D12_CPU_DESCRIPTOR_HANDLE Graphics::LoadTexture(const wchar_t* file, bool gene
 	finish.wait();
 
 	// Now that we have the texture, add to our list and make a CPU-side descriptor heap
-	// just for this texture's SRV.  Note that it would probably be better to put all 
-	// texture SRVs into the same descriptor heap, but we don't know how many we'll need
-	// until they're all loaded and this is a quick and dirty implementation!
-	textures.push_back(texture);
-
-	// Create the CPU-SIDE descriptor heap for our descriptor
-	D3D12_DESCRIPTOR_HEAP_DESC dhDesc = {};
-	dhDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE; // Non-shader visible!
-	dhDesc.NodeMask = 0;
-	dhDesc.NumDescriptors = 1;
-	dhDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> descHeap;
-	Device->CreateDescriptorHeap(&dhDesc, IID_PPV_ARGS(descHeap.GetAddressOf()));
-
-	// Add to our list of heaps (to keep the resource alive)
-	cpuSideTextureDescriptorHeaps.push_back(descHeap);
-
-	// Create the SRV on this descriptor heap
-	// Note: Using a null description results in the "default" SRV 
-	// (same format, all mips, all array slices, etc.)
-	D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = descHeap->GetCPUDescriptorHandleForHeapStart();
-	Device->CreateShaderResourceView(texture.Get(), 0, cpuHandle);
-
-	// Return the CPU descriptor handle, which can be used to
-	// copy the descriptor to a shader-visible heap later
-	return cpuHandle;
+	// just for this texture's SRV.  Return the CPU descriptor handle, which can be used
+	// to copy the descriptor to a shader-visible heap later
+	return KeepTextureAndCreateSRV(texture);
+}
+
+// --------------------------------------------------------
+// Creates a single-mip texture from pixels already in memory
+// (like ones decoded from a format WIC can't read), in the
+// same way LoadTexture() does
+// 
+// pixels        - Row by row, tightly packed
+// bytesPerPixel - Size of one pixel in the given format
+// --------------------------------------------------------
+D3D12_CPU_DESCRIPTOR_HANDLE Graphics::CreateTexture(
+	unsigned int width,
+	unsigned int height,
+	DXGI_FORMAT format,
+	const void* pixels,
+	unsigned int bytesPerPixel)
+{
+	TRACE_ZONE("CreateTexture");
+
+	D3D12_RESOURCE_DESC desc = {};
+	desc.DepthOrArraySize = 1;
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	desc.Format = format;
+	desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+	desc.Width = width;
+	desc.Height = height;
+	desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+	desc.MipLevels = 1;
+	desc.SampleDesc.Count = 1;
+	desc.SampleDesc.Quality = 0;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> texture = GPUMemory::CreatePlacedResource(
+		desc,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_COPY_DEST);
+
+	// Same upload helper as LoadTexture(), waiting for it to finish
+	DirectX::ResourceUploadBatch upload(Device.Get());
+	upload.Begin();
+
+	D3D12_SUBRESOURCE_DATA data = {};
+	data.pData = pixels;
+	data.RowPitch = (LONG_PTR)width * bytesPerPixel;
+	data.SlicePitch = data.RowPitch * height;
+	upload.Upload(texture.Get(), 0, &data, 1);
+	upload.Transition(
+		texture.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+
+	auto finish = upload.End(CommandQueue.Get());
+	finish.wait();
+
+	return KeepTextureAndCreateSRV(texture);
 }
 
 D3D12_GPU_DESCRIPTOR_HANDLE Graphics::CopySRVsToDescriptorHeapAndGetGPUDescriptorHandle(D3D12_CPU_DESCRIPTOR_HANDLE firstDescriptorToCopy, unsigned int numDescriptorsToCopy)
@@ -903,16 +1206,6 @@ Microsoft::WRL::ComPtr<ID3D12Resource> Graphics::CreateBuffer(
 	D3D12_RESOURCE_FLAGS flags,
 	UINT64 alignment)
 {
-	Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
-
-	// Describe the heap
-	D3D12_HEAP_PROPERTIES heapDesc = {};
-	heapDesc.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-	heapDesc.CreationNodeMask = 1;
-	heapDesc.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-	heapDesc.Type = heapType;
-	heapDesc.VisibleNodeMask = 1;
-
 	// Describe the resource
 	D3D12_RESOURCE_DESC desc = {};
 	desc.Alignment = alignment;
@@ -927,9 +1220,8 @@ Microsoft::WRL::ComPtr<ID3D12Resource> Graphics::CreateBuffer(
 	desc.SampleDesc.Quality = 0;
 	desc.Width = size; // Size of the buffer
 
-	// Create the buffer
-	Device->CreateCommittedResource(&heapDesc, D3D12_HEAP_FLAG_NONE, &desc, state, 0, IID_PPV_ARGS(buffer.GetAddressOf()));
-	return buffer;
+	// Create the buffer within one of our shared heaps of the requested type
+	return GPUMemory::CreatePlacedResource(desc, heapType, state);
 }
 
 // --------------------------------------------------------
@@ -8,6 +8,11 @@
 #include <memory>
 #include <vector>
 
+#include "RingAllocator.h"
+#include "DeferredReleaseQueue.h"
+#include "FrameScheduler.h"
+#include "FramePacer.h"
+
 #pragma comment(lib, "d3d12.lib")
 #pragma comment(lib, "dxgi.lib")
 
@@ -16,6 +21,10 @@ namespace Graphics
 	// --- CONSTANTS ---
 	const unsigned int NumBackBuffers = 3;
 
+	// Upper limit on how many frames the CPU may get ahead of the
+	// GPU.  Per-frame resources are allocated for this many frames.
+	const unsigned int MaxFramesInFlight = 4;
+
 	// --- GLOBAL VARS ---
 
 	// Primary D3D12 API objects
@@ -24,7 +33,7 @@ namespace Graphics
 
 	// Command submission
 	inline Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>	CommandList;
-	inline Microsoft::WRL::ComPtr<ID3D12CommandAllocator>		CommandAllocator[NumBackBuffers];
+	inline Microsoft::WRL::ComPtr<ID3D12CommandAllocator>		CommandAllocator[MaxFramesInFlight];
 	inline Microsoft::WRL::ComPtr<ID3D12CommandQueue>			CommandQueue;
 
 	// Rendering buffers & descriptors
@@ -44,20 +53,37 @@ namespace Graphics
 	inline Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> CBVSRVDescriptorHeap;
 	inline Microsoft::WRL::ComPtr<ID3D12Resource> CBUploadHeap;
 
+	// Returns a null handle (ptr of 0) if a single frame has used
+	// all maxConstantBuffers descriptors, which callers should skip
 	D3D12_GPU_DESCRIPTOR_HANDLE FillNextConstantBufferAndGetGPUDescriptorHandle(
 		void* data,
 		unsigned int dataSizeInBytes);
 
+	// Same as above, but skips the CBV entirely for data that
+	// will be bound as a root CBV (or a local root CBV)
+	D3D12_GPU_VIRTUAL_ADDRESS FillNextConstantBufferAndGetGPUVirtualAddress(
+		void* data,
+		unsigned int dataSizeInBytes);
+
+	// Usage of the constant buffer rings.  Each failed allocation
+	// results in the CPU waiting for the oldest in-flight frame
+	// (counted as a stall).  If a single frame fills the upload
+	// heap it grows; filling the descriptor range fails (see above).
+	RingAllocatorStats GetConstantBufferUploadStats();
+	RingAllocatorStats GetConstantBufferDescriptorStats();
+
+	// Times the CPU has blocked on the frame fence for any reason
+	UINT64 GetFrameFenceStallCount();
+
 
 	// Basic CPU/GPU synchronization
 	inline Microsoft::WRL::ComPtr<ID3D12Fence>	WaitFence;
 	inline HANDLE							WaitFenceEvent = 0;
 	inline UINT64							WaitFenceCounter = 0;
 
-	// Frame sync fence
+	// Frame sync fence (each frame signals its own value, see FrameScheduler)
 	inline Microsoft::WRL::ComPtr<ID3D12Fence>	FrameSyncFence;
 	inline HANDLE								FrameSyncFenceEvent = 0;
-	inline UINT64								FrameSyncFenceCounters[NumBackBuffers]{};
 
 	// Debug Layer
 	inline Microsoft::WRL::ComPtr<ID3D12InfoQueue> InfoQueue;
@@ -69,23 +95,52 @@ namespace Graphics
 	std::wstring APIName();
 	unsigned int SwapChainIndex();
 
+	// Frame pacing - separate from the swap chain, since the number
+	// of frames the CPU may run ahead doesn't need to match the
+	// number of back buffers
+	unsigned int FrameIndex();					// Which per-frame resources to use (0 to MaxFramesInFlight-1)
+	UINT64 CurrentFrameFenceValue();			// Signaled once the frame being recorded is done
+	UINT64 CompletedFrameFenceValue();
+	void SetFramesInFlight(unsigned int frames);
+	unsigned int GetFramesInFlight();
+
+	// CPU/GPU overlap, accumulated until reset
+	void RecordGPUFrame(UINT64 frameFenceValue, double startMs, double endMs);
+	FrameSchedulerStats GetFrameSchedulerStats();
+	FrameSchedulerStats GetTotalFrameSchedulerStats();	// Never reset, for benchmark reports
+	void ResetFrameSchedulerStats();
+
+	// Latency - optionally sleeps before input is sampled so frames
+	// don't queue up behind the GPU.  Frames in flight remain the
+	// hard limit on latency, in frames.
+	void WaitForFramePacing();
+	void SetFramePacing(bool enabled);
+	bool GetFramePacing();
+	FramePacerStats GetFramePacerStats();
+	void ResetFramePacerStats();
+
 	// General functions
 	HRESULT Initialize(unsigned int windowWidth, unsigned int windowHeight, HWND windowHandle, bool vsyncIfPossible);
 	void ShutDown();
 	void ResizeBuffers(unsigned int width, unsigned int height);
 	void AdvanceSwapChainIndex();
 
-	// Resource creation
+	// Resource creation (static buffers from any thread)
 	Microsoft::WRL::ComPtr<ID3D12Resource> CreateStaticBuffer(
 		size_t dataStride, size_t dataCount, void* data);
 
 	UINT GetDescriptorIndex(D3D12_GPU_DESCRIPTOR_HANDLE handle);
 
 	// Command list & synchronization
-	void ResetAllocatorAndCommandList(unsigned int swapChainIndex);
+	void ResetAllocatorAndCommandList(unsigned int frameIndex);
 	void CloseAndExecuteCommandList();
 	void WaitForGPU();
 
+	// Keeps an object alive until the GPU has finished the current
+	// frame, so resources can be replaced without a full GPU flush
+	void ReleaseWhenFrameCompletes(Microsoft::WRL::ComPtr<IUnknown> object);
+	unsigned int GetPendingReleaseCount();
+
 	// Debug Layer
 	void PrintDebugMessages();
 
@@ -97,6 +152,12 @@ namespace Graphics
 	//       constant ensures we (hopefully) never run out of room.
 	const unsigned int MaxTextureDescriptors = 1000;
 	D3D12_CPU_DESCRIPTOR_HANDLE LoadTexture(const wchar_t* file, bool generateMips = true);
+	D3D12_CPU_DESCRIPTOR_HANDLE CreateTexture(
+		unsigned int width,
+		unsigned int height,
+		DXGI_FORMAT format,
+		const void* pixels,
+		unsigned int bytesPerPixel);
 	D3D12_GPU_DESCRIPTOR_HANDLE CopySRVsToDescriptorHeapAndGetGPUDescriptorHandle(
 		D3D12_CPU_DESCRIPTOR_HANDLE firstDescriptorToCopy,
 		unsigned int numDescriptorsToCopy);
@@ -0,0 +1,46 @@
+#include <cstdio>
+#include <string>
+
+#include "Benchmark.h"
+#include "BenchmarkTimeline.h"
+
+// --------------------------------------------------------
+// Entry point for headless benchmarks on platforms without
+// the window or graphics API (built by CMakeLists.txt, not
+// the Visual Studio project, which uses Main.cpp instead).
+//
+// Takes the same options as the game, but always runs
+// headless, so -benchmark <timeline> is required.
+// --------------------------------------------------------
+int main(int argc, char** argv)
+{
+	// Rebuild the command line the way Windows hands it to
+	// WinMain, quoting each argument in case of spaces
+	std::string commandLine;
+	for (int i = 1; i < argc; i++)
+		commandLine += std::string(i > 1 ? " " : "") + "\"" + argv[i] + "\"";
+
+	Benchmark::Options benchmark;
+	BenchmarkTimeline benchmarkTimeline;
+	std::string benchmarkError;
+	if (!Benchmark::ParseCommandLine(commandLine, benchmark, &benchmarkError))
+	{
+		printf("Benchmark error: %s\n", benchmarkError.c_str());
+		return Benchmark::ExitCodeError;
+	}
+
+	if (!benchmark.Enabled)
+	{
+		printf("Usage: %s -benchmark <timeline> [options]\n", argc > 0 ? argv[0] : "HeadlessBenchmark");
+		return Benchmark::ExitCodeError;
+	}
+
+	if (!benchmarkTimeline.Load(benchmark.TimelinePath, &benchmarkError))
+	{
+		printf("Benchmark error: %s\n", benchmarkError.c_str());
+		return Benchmark::ExitCodeError;
+	}
+
+	benchmark.Headless = true;
+	return Benchmark::RunHeadless(benchmark, benchmarkTimeline);
+}
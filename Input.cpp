@@ -1,5 +1,7 @@
 #include "Input.h"
+#include "InputEventQueue.h"
 #include <hidusage.h>
+#include <windowsx.h>
 
 // --------------- Basic usage -----------------
 // 
@@ -35,7 +37,15 @@
 //   if (Input::KeyReleased(' ')) { }
 // 
 // (Note that these functions will only return true on 
-// the FIRST frame that a key is pressed or released.)
+// the FIRST frame that a key is pressed or released.
+// A key tapped quickly between two frames reports both.)
+// 
+// 
+// For smooth movement, scale by how much of the last
+// frame a key was actually held rather than assuming
+// it was held the whole frame:
+// 
+//   float amount = Input::GetKeyDownFraction('W');
 // 
 // 
 // Checking for mouse button input is similar:
@@ -50,9 +60,9 @@
 // To handle relative mouse movement, you can use either
 // "standard" or "raw" mouse input, as shown below:  
 // 
-//  - *Standard* input simply reads the cursor position on
-//    the screen each frame and calculates the delta,
-//    which respects pointer acceleration.  Use these
+//  - *Standard* input adds up every cursor movement the
+//    window was told about during the frame, which 
+//    respects pointer acceleration.  Use these
 //    functions if you expect the same pointer behavior
 //    as your mouse cursor in Windows.
 // 
@@ -68,6 +78,12 @@
 //       int yRawDelta = Input::GetRawMouseYDelta();
 //                                 ^^^
 //  
+// 
+// How it works: the window procedure stamps each input
+// message with the time it arrived and queues it.  Each
+// Update() then applies the queued events in order,
+// rather than polling the keyboard and cursor once per
+// frame, so nothing that happens between frames is lost.
 // ---------------------------------------------
 
 namespace Input
@@ -75,28 +91,93 @@ namespace Input
 	// Annonymous namespace to hold variables only accessible in this file
 	namespace 
 	{
-		// Arrays for the current and previous key states
-		unsigned char* kbState = 0;
-		unsigned char* prevKbState = 0;
-
-		// Mouse position and wheel data
-		int mouseX = 0;
-		int mouseY = 0;
-		int prevMouseX = 0;
-		int prevMouseY = 0;
-		int mouseXDelta = 0;
-		int mouseYDelta = 0;
-		int rawMouseXDelta = 0;
-		int rawMouseYDelta = 0;
-		float wheelDelta = 0;
+		// Events from the window procedure, and the state derived from them
+		InputEventQueue* eventQueue = 0;
+		InputState* state = 0;
+
+		// Timestamps are seconds since Initialize()
+		LARGE_INTEGER startTime{};
+		double secondsPerCount = 0;
+
+		// Which side of each modifier (shift, control, alt) is down,
+		// since the window is only told about the key as a whole
+		bool modifierSideDown[256]{};
 
 		// Support for capturing input outside the input manager
 		bool keyboardCaptured = false;
 		bool mouseCaptured = false;
 
 		// The window's handle (id) from the OS, so
-		// we can get the cursor's position
+		// we can capture the mouse while buttons are down
 		HWND hWnd = 0;
+
+		double Now()
+		{
+			LARGE_INTEGER now{};
+			QueryPerformanceCounter(&now);
+			return (now.QuadPart - startTime.QuadPart) * secondsPerCount;
+		}
+
+		void QueueEvent(InputEvent::EventType type, int key = 0, int x = 0, int y = 0, float wheel = 0)
+		{
+			if (!eventQueue)
+				return;
+
+			InputEvent inputEvent;
+			inputEvent.Type = type;
+			inputEvent.Time = Now();
+			inputEvent.Key = key;
+			inputEvent.X = x;
+			inputEvent.Y = y;
+			inputEvent.Wheel = wheel;
+			eventQueue->Push(inputEvent);
+		}
+
+		// Queues the specific side of a modifier key followed by
+		// the key as a whole, which is down if either side is
+		void QueueModifierEvent(int wholeKey, int sideKey, int leftKey, int rightKey, bool down)
+		{
+			modifierSideDown[sideKey] = down;
+			QueueEvent(down ? InputEvent::KeyDown : InputEvent::KeyUp, sideKey);
+
+			bool wholeDown = modifierSideDown[leftKey] || modifierSideDown[rightKey];
+			QueueEvent(wholeDown ? InputEvent::KeyDown : InputEvent::KeyUp, wholeKey);
+		}
+
+		void QueueKeyEvent(WPARAM wParam, LPARAM lParam, bool down)
+		{
+			int key = (int)wParam;
+			UINT scanCode = (lParam >> 16) & 0xFF;
+			bool extended = ((lParam >> 24) & 1) != 0;
+
+			switch (key)
+			{
+			case VK_SHIFT:
+				QueueModifierEvent(VK_SHIFT, (int)MapVirtualKey(scanCode, MAPVK_VSC_TO_VK_EX), VK_LSHIFT, VK_RSHIFT, down);
+				break;
+			case VK_CONTROL:
+				QueueModifierEvent(VK_CONTROL, extended ? VK_RCONTROL : VK_LCONTROL, VK_LCONTROL, VK_RCONTROL, down);
+				break;
+			case VK_MENU:
+				QueueModifierEvent(VK_MENU, extended ? VK_RMENU : VK_LMENU, VK_LMENU, VK_RMENU, down);
+				break;
+			default:
+				QueueEvent(down ? InputEvent::KeyDown : InputEvent::KeyUp, key);
+				break;
+			}
+		}
+
+		// Capturing the mouse while any button is down means we
+		// still hear about the release outside the window
+		void QueueMouseButtonEvent(int button, bool down, WPARAM wParam)
+		{
+			QueueEvent(down ? InputEvent::KeyDown : InputEvent::KeyUp, button);
+
+			if (down)
+				SetCapture(hWnd);
+			else if (!(wParam & (MK_LBUTTON | MK_RBUTTON | MK_MBUTTON)))
+				ReleaseCapture();
+		}
 	}
 }
 
@@ -110,18 +191,16 @@ namespace Input
 // ---------------------------------------------------
 void Input::Initialize(HWND windowHandle)
 {
-	kbState = new unsigned char[256];
-	prevKbState = new unsigned char[256];
-
-	memset(kbState, 0, sizeof(unsigned char) * 256);
-	memset(prevKbState, 0, sizeof(unsigned char) * 256);
-
-	wheelDelta = 0.0f;
-	mouseX = 0; mouseY = 0;
-	prevMouseX = 0; prevMouseY = 0;
-	mouseXDelta = 0; mouseYDelta = 0;
+	eventQueue = new InputEventQueue();
+	state = new InputState();
+	memset(modifierSideDown, 0, sizeof(modifierSideDown));
 	keyboardCaptured = false; mouseCaptured = false;
 
+	LARGE_INTEGER frequency{};
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&startTime);
+	secondsPerCount = 1.0 / (double)frequency.QuadPart;
+
 	hWnd = windowHandle;
 
 	// Register for raw input from the mouse
@@ -139,68 +218,76 @@ void Input::Initialize(HWND windowHandle)
 // ---------------------------------------------------
 void Input::ShutDown()
 {
-	delete[] kbState;
-	delete[] prevKbState;
+	delete eventQueue;
+	delete state;
+	eventQueue = 0;
+	state = 0;
 }
 
 // ----------------------------------------------------------
 //  Updates the input manager for this frame.  This should
 //  be called at the beginning of every Game::Update(), 
-//  before anything that might need input
+//  before anything that might need input.
+// 
+//  Applies every input message received since the last
+//  update, in the order they arrived.
 // ----------------------------------------------------------
 void Input::Update()
 {
-	// Copy the old keys so we have last frame's data
-	memcpy(prevKbState, kbState, sizeof(unsigned char) * 256);
-
-	// Get the latest keys (from Windows)
-	// Note the use of (void), which denotes to the compiler
-	// that we're intentionally ignoring the return value
-	(void)GetKeyboardState(kbState);
-
-	// Get the current mouse position then make it relative to the window
-	POINT mousePos = {};
-	GetCursorPos(&mousePos);
-	ScreenToClient(hWnd, &mousePos);
-
-	// Save the previous mouse position, then the current mouse 
-	// position and finally calculate the change from the previous frame
-	prevMouseX = mouseX;
-	prevMouseY = mouseY;
-	mouseX = mousePos.x;
-	mouseY = mousePos.y;
-	mouseXDelta = mouseX - prevMouseX;
-	mouseYDelta = mouseY - prevMouseY;
+	state->Update(*eventQueue, Now());
 }
 
 // ----------------------------------------------------------
-//  Resets the mouse wheel value and raw mouse delta at the 
-//  end of the frame. This cannot occur earlier in the frame, 
-//  since these come from Win32 windowing messages, which are
-//  handled between frames.
+//  Queues any input-related window message.  Called by the
+//  window for every message it receives, before it handles
+//  the message itself.
 // ----------------------------------------------------------
-void Input::EndOfFrame()
+void Input::ProcessWindowMessage(UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
-	// Reset wheel value
-	wheelDelta = 0;
-	rawMouseXDelta = 0;
-	rawMouseYDelta = 0;
+	switch (uMsg)
+	{
+	case WM_KEYDOWN:
+	case WM_SYSKEYDOWN:	QueueKeyEvent(wParam, lParam, true); break;
+	case WM_KEYUP:
+	case WM_SYSKEYUP:	QueueKeyEvent(wParam, lParam, false); break;
+
+	case WM_LBUTTONDOWN:	QueueMouseButtonEvent(VK_LBUTTON, true, wParam); break;
+	case WM_LBUTTONUP:		QueueMouseButtonEvent(VK_LBUTTON, false, wParam); break;
+	case WM_RBUTTONDOWN:	QueueMouseButtonEvent(VK_RBUTTON, true, wParam); break;
+	case WM_RBUTTONUP:		QueueMouseButtonEvent(VK_RBUTTON, false, wParam); break;
+	case WM_MBUTTONDOWN:	QueueMouseButtonEvent(VK_MBUTTON, true, wParam); break;
+	case WM_MBUTTONUP:		QueueMouseButtonEvent(VK_MBUTTON, false, wParam); break;
+
+	case WM_MOUSEMOVE:
+		QueueEvent(InputEvent::MouseMove, 0, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+		break;
+
+	case WM_INPUT:
+		ProcessRawMouseInput(lParam);
+		break;
+
+	// No key up messages will arrive while we're unfocused
+	case WM_KILLFOCUS:
+		memset(modifierSideDown, 0, sizeof(modifierSideDown));
+		QueueEvent(InputEvent::ReleaseAllKeys);
+		break;
+	}
 }
 
 // ----------------------------------------------------------
 //  Get the mouse's current position in pixels relative
 //  to the top left corner of the window.
 // ----------------------------------------------------------
-int Input::GetMouseX() { return mouseX; }
-int Input::GetMouseY() { return mouseY; }
+int Input::GetMouseX() { return state->GetMouseX(); }
+int Input::GetMouseY() { return state->GetMouseY(); }
 
 
 // ---------------------------------------------------------------
 //  Get the mouse's change (delta) in position since last
 //  frame in pixels relative to the top left corner of the window.
 // ---------------------------------------------------------------
-int Input::GetMouseXDelta() { return mouseXDelta; }
-int Input::GetMouseYDelta() { return mouseYDelta; }
+int Input::GetMouseXDelta() { return state->GetMouseXDelta(); }
+int Input::GetMouseYDelta() { return state->GetMouseYDelta(); }
 
 
 // ---------------------------------------------------------------
@@ -226,9 +313,10 @@ void Input::ProcessRawMouseInput(LPARAM lParam)
 	RAWINPUT* raw = (RAWINPUT*)rawInputBytes;
 	if (raw->header.dwType == RIM_TYPEMOUSE)
 	{
-		// This is mouse data, so grab the movement values
-		rawMouseXDelta = raw->data.mouse.lLastX;
-		rawMouseYDelta = raw->data.mouse.lLastY;
+		// This is mouse data, so queue the movement values
+		// (relative movement only, which is what mice report)
+		if (!(raw->data.mouse.usFlags & MOUSE_MOVE_ABSOLUTE))
+			QueueEvent(InputEvent::RawMouseMove, 0, raw->data.mouse.lLastX, raw->data.mouse.lLastY);
 	}
 }
 
@@ -236,8 +324,8 @@ void Input::ProcessRawMouseInput(LPARAM lParam)
 //  Get the mouse's change (delta) in position since last
 //  frame based on raw mouse data (no pointer acceleration)
 // ---------------------------------------------------------------
-int Input::GetRawMouseXDelta() { return rawMouseXDelta; }
-int Input::GetRawMouseYDelta() { return rawMouseYDelta; }
+int Input::GetRawMouseXDelta() { return state->GetRawMouseXDelta(); }
+int Input::GetRawMouseYDelta() { return state->GetRawMouseYDelta(); }
 
 
 // ---------------------------------------------------------------
@@ -245,17 +333,17 @@ int Input::GetRawMouseYDelta() { return rawMouseYDelta; }
 //  no absolute position for the mouse wheel; this is either a
 //  positive number, a negative number or zero.
 // ---------------------------------------------------------------
-float Input::GetMouseWheel() { return wheelDelta; }
+float Input::GetMouseWheel() { return state->GetWheelDelta(); }
 
 
 // ---------------------------------------------------------------
-//  Sets the mouse wheel delta for this frame.  This is called
+//  Adds to the mouse wheel delta for this frame.  This is called
 //  by DXCore whenever an OS-level mouse wheel message is sent
 //  to the application.  You'll never need to call this yourself.
 // ---------------------------------------------------------------
 void Input::SetWheelDelta(float delta)
 {
-	wheelDelta = delta;
+	QueueEvent(InputEvent::MouseWheel, 0, 0, 0, delta);
 }
 
 
@@ -292,7 +380,7 @@ bool Input::KeyDown(int key)
 {
 	if (key < 0 || key > 255) return false;
 
-	return (kbState[key] & 0x80) != 0 && !keyboardCaptured;
+	return state->IsKeyDown(key) && !keyboardCaptured;
 }
 
 // ----------------------------------------------------------
@@ -306,7 +394,7 @@ bool Input::KeyUp(int key)
 {
 	if (key < 0 || key > 255) return false;
 
-	return !(kbState[key] & 0x80) && !keyboardCaptured;
+	return !state->IsKeyDown(key) && !keyboardCaptured;
 }
 
 // ----------------------------------------------------------
@@ -320,10 +408,7 @@ bool Input::KeyPress(int key)
 {
 	if (key < 0 || key > 255) return false;
 
-	return
-		kbState[key] & 0x80 &&			// Down now
-		!(prevKbState[key] & 0x80) &&	// Up last frame
-		!keyboardCaptured;
+	return state->WasKeyPressed(key) && !keyboardCaptured;
 }
 
 // ----------------------------------------------------------
@@ -337,10 +422,24 @@ bool Input::KeyRelease(int key)
 {
 	if (key < 0 || key > 255) return false;
 
-	return
-		!(kbState[key] & 0x80) &&	// Up now
-		prevKbState[key] & 0x80 &&	// Down last frame
-		!keyboardCaptured;
+	return state->WasKeyReleased(key) && !keyboardCaptured;
+}
+
+// ----------------------------------------------------------
+//  How much of the last frame was the given key held down,
+//  from 0 (not at all) to 1 (the entire frame)?  Scaling
+//  movement by this, rather than by KeyDown(), accounts for
+//  keys pressed or released partway through a frame.
+//  
+//  key - The key to check, which could be a single character
+//        like 'W' or '3', or a virtual key code like VK_TAB,
+//        VK_ESCAPE or VK_SHIFT.
+// ----------------------------------------------------------
+float Input::GetKeyDownFraction(int key)
+{
+	if (key < 0 || key > 255 || keyboardCaptured) return 0.0f;
+
+	return state->GetKeyDownFraction(key);
 }
 
 
@@ -367,7 +466,7 @@ bool Input::GetKeyArray(bool* keyArray, int size)
 	// point is on purpose; it's a quick way to
 	// convert any number to a boolean.
 	for (int i = 0; i < size; i++)
-		keyArray[i] = !!(kbState[i] & 0x80);
+		keyArray[i] = state->IsKeyDown(i);
 
 	return true;
 }
@@ -376,28 +475,28 @@ bool Input::GetKeyArray(bool* keyArray, int size)
 // ----------------------------------------------------------
 //  Is the specific mouse button down this frame?
 // ----------------------------------------------------------
-bool Input::MouseLeftDown() { return (kbState[VK_LBUTTON] & 0x80) != 0 && !mouseCaptured; }
-bool Input::MouseRightDown() { return (kbState[VK_RBUTTON] & 0x80) != 0 && !mouseCaptured; }
-bool Input::MouseMiddleDown() { return (kbState[VK_MBUTTON] & 0x80) != 0 && !mouseCaptured; }
+bool Input::MouseLeftDown() { return state->IsKeyDown(VK_LBUTTON) && !mouseCaptured; }
+bool Input::MouseRightDown() { return state->IsKeyDown(VK_RBUTTON) && !mouseCaptured; }
+bool Input::MouseMiddleDown() { return state->IsKeyDown(VK_MBUTTON) && !mouseCaptured; }
 
 
 // ----------------------------------------------------------
 //  Is the specific mouse button up this frame?
 // ----------------------------------------------------------
-bool Input::MouseLeftUp() { return !(kbState[VK_LBUTTON] & 0x80) && !mouseCaptured; }
-bool Input::MouseRightUp() { return !(kbState[VK_RBUTTON] & 0x80) && !mouseCaptured; }
-bool Input::MouseMiddleUp() { return !(kbState[VK_MBUTTON] & 0x80) && !mouseCaptured; }
+bool Input::MouseLeftUp() { return !state->IsKeyDown(VK_LBUTTON) && !mouseCaptured; }
+bool Input::MouseRightUp() { return !state->IsKeyDown(VK_RBUTTON) && !mouseCaptured; }
+bool Input::MouseMiddleUp() { return !state->IsKeyDown(VK_MBUTTON) && !mouseCaptured; }
 
 
 // ----------------------------------------------------------
 //  Was the specific mouse button initially 
 // pressed or released this frame?
 // ----------------------------------------------------------
-bool Input::MouseLeftPress() { return kbState[VK_LBUTTON] & 0x80 && !(prevKbState[VK_LBUTTON] & 0x80) && !mouseCaptured; }
-bool Input::MouseLeftRelease() { return !(kbState[VK_LBUTTON] & 0x80) && prevKbState[VK_LBUTTON] & 0x80 && !mouseCaptured; }
+bool Input::MouseLeftPress() { return state->WasKeyPressed(VK_LBUTTON) && !mouseCaptured; }
+bool Input::MouseLeftRelease() { return state->WasKeyReleased(VK_LBUTTON) && !mouseCaptured; }
 
-bool Input::MouseRightPress() { return kbState[VK_RBUTTON] & 0x80 && !(prevKbState[VK_RBUTTON] & 0x80) && !mouseCaptured; }
-bool Input::MouseRightRelease() { return !(kbState[VK_RBUTTON] & 0x80) && prevKbState[VK_RBUTTON] & 0x80 && !mouseCaptured; }
+bool Input::MouseRightPress() { return state->WasKeyPressed(VK_RBUTTON) && !mouseCaptured; }
+bool Input::MouseRightRelease() { return state->WasKeyReleased(VK_RBUTTON) && !mouseCaptured; }
 
-bool Input::MouseMiddlePress() { return kbState[VK_MBUTTON] & 0x80 && !(prevKbState[VK_MBUTTON] & 0x80) && !mouseCaptured; }
-bool Input::MouseMiddleRelease() { return !(kbState[VK_MBUTTON] & 0x80) && prevKbState[VK_MBUTTON] & 0x80 && !mouseCaptured; }
+bool Input::MouseMiddlePress() { return state->WasKeyPressed(VK_MBUTTON) && !mouseCaptured; }
+bool Input::MouseMiddleRelease() { return state->WasKeyReleased(VK_MBUTTON) && !mouseCaptured; }
@@ -9,7 +9,7 @@ namespace Input
 	void Initialize(HWND windowHandle);
 	void ShutDown();
 	void Update();
-	void EndOfFrame();
+	void ProcessWindowMessage(UINT uMsg, WPARAM wParam, LPARAM lParam);
 
 	int GetMouseX();
 	int GetMouseY();
@@ -32,6 +32,8 @@ namespace Input
 	bool KeyPress(int key);
 	bool KeyRelease(int key);
 
+	float GetKeyDownFraction(int key);
+
 	bool GetKeyArray(bool* keyArray, int size = 256);
 
 	bool MouseLeftDown();
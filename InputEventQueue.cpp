@@ -0,0 +1,182 @@
+#include "InputEventQueue.h"
+
+#include <algorithm>
+
+InputEventQueue::InputEventQueue() :
+	head(0),
+	tail(0),
+	droppedCount(0)
+{
+}
+
+bool InputEventQueue::Push(const InputEvent& inputEvent)
+{
+	uint64_t t = tail.load(std::memory_order_relaxed);
+	if (t - head.load(std::memory_order_acquire) >= Capacity)
+	{
+		droppedCount.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	events[t % Capacity] = inputEvent;
+	tail.store(t + 1, std::memory_order_release);
+	return true;
+}
+
+bool InputEventQueue::Pop(InputEvent& inputEvent)
+{
+	uint64_t h = head.load(std::memory_order_relaxed);
+	if (h == tail.load(std::memory_order_acquire))
+		return false;
+
+	inputEvent = events[h % Capacity];
+	head.store(h + 1, std::memory_order_release);
+	return true;
+}
+
+uint64_t InputEventQueue::GetDroppedCount() const { return droppedCount.load(std::memory_order_relaxed); }
+
+
+InputState::InputState() :
+	keyDown{},
+	keyPressed{},
+	keyReleased{},
+	keyDownTime{},
+	keyDownSeconds{},
+	mouseX(0),
+	mouseY(0),
+	mouseXDelta(0),
+	mouseYDelta(0),
+	rawMouseXDelta(0),
+	rawMouseYDelta(0),
+	wheelDelta(0),
+	lastUpdateTime(0),
+	intervalSeconds(0),
+	lastEventCount(0),
+	hasMousePosition(false)
+{
+}
+
+// --------------------------------------------------------
+// Starts a new interval (ending at now), applies every
+// queued event in order and works out how long each key
+// was held during the interval.  Events stamped before the
+// previous update count as happening at its start.
+// --------------------------------------------------------
+void InputState::Update(InputEventQueue& queue, double now)
+{
+	// Reset everything that only describes the last interval
+	std::fill(keyPressed, keyPressed + KeyCount, false);
+	std::fill(keyReleased, keyReleased + KeyCount, false);
+	std::fill(keyDownSeconds, keyDownSeconds + KeyCount, 0.0);
+	mouseXDelta = 0;
+	mouseYDelta = 0;
+	rawMouseXDelta = 0;
+	rawMouseYDelta = 0;
+	wheelDelta = 0;
+	lastEventCount = 0;
+
+	// Keys already held count from the start of this interval
+	double intervalStart = std::min(lastUpdateTime, now);
+	for (int key = 0; key < KeyCount; key++)
+	{
+		if (keyDown[key])
+			keyDownTime[key] = intervalStart;
+	}
+
+	InputEvent inputEvent;
+	while (queue.Pop(inputEvent))
+	{
+		lastEventCount++;
+		double time = std::clamp(inputEvent.Time, intervalStart, now);
+
+		switch (inputEvent.Type)
+		{
+		case InputEvent::KeyDown: SetKey(inputEvent.Key, true, time); break;
+		case InputEvent::KeyUp: SetKey(inputEvent.Key, false, time); break;
+
+		case InputEvent::MouseMove:
+			// The first position ever seen isn't movement
+			if (hasMousePosition)
+			{
+				mouseXDelta += inputEvent.X - mouseX;
+				mouseYDelta += inputEvent.Y - mouseY;
+			}
+			mouseX = inputEvent.X;
+			mouseY = inputEvent.Y;
+			hasMousePosition = true;
+			break;
+
+		case InputEvent::RawMouseMove:
+			rawMouseXDelta += inputEvent.X;
+			rawMouseYDelta += inputEvent.Y;
+			break;
+
+		case InputEvent::MouseWheel:
+			wheelDelta += inputEvent.Wheel;
+			break;
+
+		case InputEvent::ReleaseAllKeys:
+			for (int key = 0; key < KeyCount; key++)
+				SetKey(key, false, time);
+			break;
+		}
+	}
+
+	// Keys still held were down through the end of the interval
+	for (int key = 0; key < KeyCount; key++)
+	{
+		if (keyDown[key])
+			keyDownSeconds[key] += now - keyDownTime[key];
+	}
+
+	intervalSeconds = now - intervalStart;
+	lastUpdateTime = now;
+}
+
+// Key repeats (down while already down) are ignored
+void InputState::SetKey(int key, bool down, double time)
+{
+	if (key < 0 || key >= KeyCount || keyDown[key] == down)
+		return;
+
+	keyDown[key] = down;
+	if (down)
+	{
+		keyPressed[key] = true;
+		keyDownTime[key] = time;
+	}
+	else
+	{
+		keyReleased[key] = true;
+		keyDownSeconds[key] += time - keyDownTime[key];
+	}
+}
+
+bool InputState::IsKeyDown(int key) const { return key >= 0 && key < KeyCount && keyDown[key]; }
+bool InputState::WasKeyPressed(int key) const { return key >= 0 && key < KeyCount && keyPressed[key]; }
+bool InputState::WasKeyReleased(int key) const { return key >= 0 && key < KeyCount && keyReleased[key]; }
+double InputState::GetKeyDownSeconds(int key) const { return key >= 0 && key < KeyCount ? keyDownSeconds[key] : 0; }
+
+// --------------------------------------------------------
+// How much of the last interval the key was held, from 0
+// to 1.  An empty interval (the very first update) counts
+// a held key as fully down.
+// --------------------------------------------------------
+float InputState::GetKeyDownFraction(int key) const
+{
+	if (intervalSeconds <= 0)
+		return IsKeyDown(key) ? 1.0f : 0.0f;
+
+	return (float)std::clamp(GetKeyDownSeconds(key) / intervalSeconds, 0.0, 1.0);
+}
+
+int InputState::GetMouseX() const { return mouseX; }
+int InputState::GetMouseY() const { return mouseY; }
+int InputState::GetMouseXDelta() const { return mouseXDelta; }
+int InputState::GetMouseYDelta() const { return mouseYDelta; }
+int InputState::GetRawMouseXDelta() const { return rawMouseXDelta; }
+int InputState::GetRawMouseYDelta() const { return rawMouseYDelta; }
+float InputState::GetWheelDelta() const { return wheelDelta; }
+double InputState::GetIntervalSeconds() const { return intervalSeconds; }
+unsigned int InputState::GetLastEventCount() const { return lastEventCount; }
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// A single input message, stamped with when it arrived
+struct InputEvent
+{
+	enum EventType
+	{
+		KeyDown,		// Key is a virtual key code (mouse buttons included)
+		KeyUp,
+		MouseMove,		// X and Y are the new cursor position
+		RawMouseMove,	// X and Y are how far the mouse itself moved
+		MouseWheel,		// Wheel is the number of notches scrolled
+		ReleaseAllKeys	// Focus lost, so no key up messages are coming
+	};
+
+	EventType Type = KeyDown;
+	double Time = 0;	// Seconds, on the same clock passed to InputState::Update()
+	int Key = 0;
+	int X = 0;
+	int Y = 0;
+	float Wheel = 0;
+};
+
+// --------------------------------------------------------
+// A fixed-size, lock-free queue of input events with a
+// single producer (the window procedure) and a single
+// consumer (Input::Update()).  Events that arrive while the
+// queue is full are dropped and counted.
+// --------------------------------------------------------
+class InputEventQueue
+{
+public:
+	static constexpr unsigned int Capacity = 1024;
+
+	InputEventQueue();
+
+	// Producer only
+	bool Push(const InputEvent& inputEvent);
+
+	// Consumer only
+	bool Pop(InputEvent& inputEvent);
+
+	uint64_t GetDroppedCount() const;
+
+private:
+	InputEvent events[Capacity];
+	alignas(64) std::atomic<uint64_t> head;	// Next to pop
+	alignas(64) std::atomic<uint64_t> tail;	// Next to push
+	std::atomic<uint64_t> droppedCount;
+};
+
+// --------------------------------------------------------
+// Input state derived from an ordered stream of events,
+// advanced once per frame.
+//
+// Since every event is applied in order, a key pressed and
+// released between two updates still reports both the
+// press and the release, and mouse deltas are the sum of
+// every movement rather than the difference between two
+// polled positions.
+//
+// The timestamps also give how much of the time between
+// updates each key was actually held, so movement can be
+// scaled by that rather than by a whole frame.
+//
+// Nothing here touches the window or graphics API (Input
+// feeds the queue from the window's messages).
+// --------------------------------------------------------
+class InputState
+{
+public:
+	static constexpr int KeyCount = 256;
+
+	InputState();
+
+	// Applies every queued event, then ends the interval at the given time
+	void Update(InputEventQueue& queue, double now);
+
+	// Keys, as of the most recent update
+	bool IsKeyDown(int key) const;
+	bool WasKeyPressed(int key) const;	// Went down at least once during the last interval
+	bool WasKeyReleased(int key) const;	// Went up at least once during the last interval
+	double GetKeyDownSeconds(int key) const;
+	float GetKeyDownFraction(int key) const;
+
+	// Mouse, as of the most recent update
+	int GetMouseX() const;
+	int GetMouseY() const;
+	int GetMouseXDelta() const;
+	int GetMouseYDelta() const;
+	int GetRawMouseXDelta() const;
+	int GetRawMouseYDelta() const;
+	float GetWheelDelta() const;
+
+	// The interval the last update covered
+	double GetIntervalSeconds() const;
+	unsigned int GetLastEventCount() const;
+
+private:
+	bool keyDown[KeyCount];
+	bool keyPressed[KeyCount];
+	bool keyReleased[KeyCount];
+	double keyDownTime[KeyCount];		// When the key last went down
+	double keyDownSeconds[KeyCount];	// Time held during the last interval
+
+	int mouseX;
+	int mouseY;
+	int mouseXDelta;
+	int mouseYDelta;
+	int rawMouseXDelta;
+	int rawMouseYDelta;
+	float wheelDelta;
+
+	double lastUpdateTime;
+	double intervalSeconds;
+	unsigned int lastEventCount;
+	bool hasMousePosition;
+
+	void SetKey(int key, bool down, double time);
+};
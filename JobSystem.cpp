@@ -0,0 +1,318 @@
+#include "JobSystem.h"
+#include "WorkStealingDeque.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace JobSystem
+{
+	// Annonymous namespace to hold variables/helpers
+	// only accessible in this file
+	namespace
+	{
+		// Jobs one thread can have queued before new ones
+		// are simply run on the spot
+		const unsigned int MaxQueuedJobsPerThread = 4096;
+
+		struct Job
+		{
+			JobFunction Function;
+			JobCounter* Counter;
+			const JobCounter* Dependency;
+		};
+
+		struct Worker
+		{
+			WorkStealingDeque<Job*, MaxQueuedJobsPerThread> Deque;
+			std::thread Thread;
+		};
+
+		// Index 0 is the main thread, which has no std::thread of its own
+		std::vector<std::unique_ptr<Worker>> workers;
+		bool initialized = false;
+
+		// Jobs from threads without their own deque, and jobs
+		// put back because their dependency wasn't done yet
+		std::mutex sharedQueueMutex;
+		std::deque<Job*> sharedQueue;
+
+		// Sleeping while there's nothing to do
+		std::mutex sleepMutex;
+		std::condition_variable wakeCondition;
+		std::atomic<unsigned int> queuedJobCount{ 0 };
+		std::atomic<unsigned int> sleepingWorkerCount{ 0 };
+		std::atomic<bool> stopping{ false };
+
+		// Which worker the current thread is, if any
+		thread_local int currentWorkerIndex = -1;
+		thread_local unsigned int stealSeed = 0;
+
+		// Lets a sleeping worker know there's something new to do.
+		// The counts are sequentially consistent, so either the worker
+		// sees the new job before sleeping or we see it asleep here.
+		void WakeWorker()
+		{
+			if (sleepingWorkerCount.load() == 0)
+				return;
+
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			wakeCondition.notify_one();
+		}
+
+		void PushSharedJob(Job* job)
+		{
+			// Counted before it's visible, so it can't be taken
+			// (and uncounted) first
+			queuedJobCount.fetch_add(1);
+			{
+				std::lock_guard<std::mutex> lock(sharedQueueMutex);
+				sharedQueue.push_back(job);
+			}
+			WakeWorker();
+		}
+
+		bool PopSharedJob(Job*& job)
+		{
+			std::lock_guard<std::mutex> lock(sharedQueueMutex);
+			if (sharedQueue.empty())
+				return false;
+
+			job = sharedQueue.front();
+			sharedQueue.pop_front();
+			return true;
+		}
+
+		// Own deque first (newest work, still in cache), then the shared
+		// queue, then the oldest work of the other threads
+		bool FindJob(Job*& job)
+		{
+			bool found = false;
+			if (currentWorkerIndex >= 0)
+				found = workers[currentWorkerIndex]->Deque.Pop(job);
+
+			if (!found)
+				found = PopSharedJob(job);
+
+			if (!found && !workers.empty())
+			{
+				// Cheap xorshift so threads don't all pick the same victim
+				stealSeed ^= stealSeed << 13;
+				stealSeed ^= stealSeed >> 17;
+				stealSeed ^= stealSeed << 5;
+
+				unsigned int workerCount = (unsigned int)workers.size();
+				unsigned int first = stealSeed % workerCount;
+				for (unsigned int i = 0; i < workerCount && !found; i++)
+				{
+					unsigned int victim = (first + i) % workerCount;
+					if ((int)victim != currentWorkerIndex)
+						found = workers[victim]->Deque.Steal(job);
+				}
+			}
+
+			if (found)
+				queuedJobCount.fetch_sub(1);
+			return found;
+		}
+
+		void ExecuteJob(Job* job)
+		{
+			job->Function();
+			if (job->Counter)
+				job->Counter->Pending.fetch_sub(1, std::memory_order_acq_rel);
+			delete job;
+		}
+
+		// Runs one job if there's one ready, returning whether it did
+		bool TryExecuteJob()
+		{
+			Job* job = 0;
+			if (!FindJob(job))
+				return false;
+
+			// Not ready yet?  Put it where every thread can find it
+			// again, so the work it depends on isn't stuck behind it.
+			if (job->Dependency && !job->Dependency->IsDone())
+			{
+				PushSharedJob(job);
+				return false;
+			}
+
+			ExecuteJob(job);
+			return true;
+		}
+
+		void WorkerThreadMain(unsigned int index)
+		{
+			currentWorkerIndex = (int)index;
+			stealSeed = index * 2654435761u + 1;
+			Trace::SetThreadName(("Job Worker " + std::to_string(index)).c_str());
+
+			while (!stopping.load())
+			{
+				if (TryExecuteJob())
+					continue;
+
+				// Nothing ready.  If jobs are queued they're either being
+				// grabbed by someone else or waiting on dependencies, so
+				// just give up the time slice.  Otherwise, sleep.
+				if (queuedJobCount.load() > 0)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				sleepingWorkerCount.fetch_add(1);
+				wakeCondition.wait(lock, [] { return queuedJobCount.load() > 0 || stopping.load(); });
+				sleepingWorkerCount.fetch_sub(1);
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Starts the worker threads and gives the calling (main)
+// thread a deque of its own
+// --------------------------------------------------------
+void JobSystem::Initialize(unsigned int workerThreadCount)
+{
+	if (initialized)
+		return;
+
+	if (workerThreadCount == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		workerThreadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	stopping = false;
+	currentWorkerIndex = 0;
+	stealSeed = 1;
+
+	// Create every deque before any thread can try to steal from them
+	for (unsigned int i = 0; i <= workerThreadCount; i++)
+		workers.push_back(std::make_unique<Worker>());
+	for (unsigned int i = 1; i <= workerThreadCount; i++)
+		workers[i]->Thread = std::thread(WorkerThreadMain, i);
+
+	initialized = true;
+}
+
+// --------------------------------------------------------
+// Stops and joins the workers.  Any jobs still queued are
+// finished on the calling thread first.
+// --------------------------------------------------------
+void JobSystem::ShutDown()
+{
+	if (!initialized)
+		return;
+
+	while (queuedJobCount.load() > 0)
+		TryExecuteJob();
+
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wakeCondition.notify_all();
+
+	for (size_t i = 1; i < workers.size(); i++)
+		workers[i]->Thread.join();
+
+	workers.clear();
+	currentWorkerIndex = -1;
+	initialized = false;
+}
+
+unsigned int JobSystem::GetThreadCount() { return initialized ? (unsigned int)workers.size() : 1; }
+
+// --------------------------------------------------------
+// Queues a job on the calling thread's deque, or on the
+// shared queue if this thread doesn't have one.  Without
+// any workers (or if the deque is full) a ready job just
+// runs immediately.
+// --------------------------------------------------------
+void JobSystem::Run(JobFunction job, JobCounter* counter, const JobCounter* dependency)
+{
+	if (counter)
+		counter->Pending.fetch_add(1, std::memory_order_relaxed);
+
+	Job* newJob = new Job{ std::move(job), counter, dependency };
+	bool ready = !dependency || dependency->IsDone();
+
+	if (!initialized)
+	{
+		// Nothing else will ever run it, so wait it out here
+		if (dependency)
+			Wait(*dependency);
+		ExecuteJob(newJob);
+		return;
+	}
+
+	if (currentWorkerIndex < 0)
+	{
+		PushSharedJob(newJob);
+		return;
+	}
+
+	// Counted before it's visible, as with the shared queue
+	queuedJobCount.fetch_add(1);
+	if (workers[currentWorkerIndex]->Deque.Push(newJob))
+	{
+		WakeWorker();
+		return;
+	}
+
+	queuedJobCount.fetch_sub(1);
+	if (ready)
+		ExecuteJob(newJob);
+	else
+		PushSharedJob(newJob);
+}
+
+// --------------------------------------------------------
+// Helps out with other jobs until the given counter is done
+// --------------------------------------------------------
+void JobSystem::Wait(const JobCounter& counter)
+{
+	while (!counter.IsDone())
+	{
+		if (!TryExecuteJob())
+			std::this_thread::yield();
+	}
+}
+
+// --------------------------------------------------------
+// Runs the body over every batch of the range, with the
+// calling thread taking part.  Small ranges (or a single
+// thread) skip the job system entirely.
+// --------------------------------------------------------
+void JobSystem::ParallelFor(unsigned int count, unsigned int batchSize, const RangeFunction& body)
+{
+	batchSize = std::max(batchSize, 1u);
+	if (count <= batchSize || GetThreadCount() == 1)
+	{
+		if (count > 0)
+			body(0, count);
+		return;
+	}
+
+	// Queue all but the first batch, which we'll run ourselves
+	JobCounter counter;
+	for (unsigned int begin = batchSize; begin < count; begin += batchSize)
+	{
+		unsigned int end = std::min(begin + batchSize, count);
+		Run([&body, begin, end]() { body(begin, end); }, &counter);
+	}
+
+	body(0, batchSize);
+	Wait(counter);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+// --------------------------------------------------------
+// A small job system for spreading engine-side CPU work
+// over several threads.
+//
+// Each thread (the main thread plus the workers) owns a
+// work-stealing deque.  Jobs run from a thread go into its
+// own deque, and idle threads steal from the others.  Jobs
+// run from threads the job system doesn't own (like the
+// simulation thread) go into a shared queue instead.
+//
+// Completion is tracked with JobCounters: every job run with
+// a counter adds one to it and subtracts one when finished.
+// Waiting on a counter runs other jobs rather than blocking,
+// so waiting from inside a job is fine.  A job can also be
+// given a counter to depend on, and won't start until that
+// counter reaches zero.
+//
+// Nothing here knows about D3D12.
+// --------------------------------------------------------
+namespace JobSystem
+{
+	// --- TYPES ---
+	struct JobCounter
+	{
+		std::atomic<unsigned int> Pending{ 0 };
+		bool IsDone() const { return Pending.load(std::memory_order_acquire) == 0; }
+	};
+
+	typedef std::function<void()> JobFunction;
+	typedef std::function<void(unsigned int begin, unsigned int end)> RangeFunction;
+
+	// --- FUNCTIONS ---
+	// Call from the main thread.  Zero workers means one per
+	// hardware thread, minus the main thread.
+	void Initialize(unsigned int workerThreadCount = 0);
+	void ShutDown();
+
+	// Threads that execute jobs, including the main thread
+	unsigned int GetThreadCount();
+
+	// Queues a job.  It's only started once the dependency (if any)
+	// is done, and the counter (if any) tracks its completion.
+	void Run(JobFunction job, JobCounter* counter = 0, const JobCounter* dependency = 0);
+
+	// Runs other jobs until the counter reaches zero
+	void Wait(const JobCounter& counter);
+
+	// Splits [0, count) into batches of at most batchSize indices,
+	// runs them in parallel and waits for all of them to finish
+	void ParallelFor(unsigned int count, unsigned int batchSize, const RangeFunction& body);
+}
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "JobSystem.h"
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Times each configuration is run, keeping the fastest
+	const int Repeats = 3;
+
+	// Stand-in for a job's work: a chain of hashes the compiler
+	// can't skip, since the result ends up in the checksum
+	uint64_t Work(uint64_t seed, unsigned int iterations)
+	{
+		uint64_t x = seed;
+		for (unsigned int i = 0; i < iterations; i++)
+		{
+			x ^= x >> 33;
+			x *= 0xff51afd7ed558ccdull;
+			x ^= x >> 29;
+		}
+		return x;
+	}
+
+	// --------------------------------------------------------
+	// Runs jobCount single-index jobs of the given size through
+	// ParallelFor, returning the fastest time in milliseconds
+	// --------------------------------------------------------
+	double TimeParallelFor(unsigned int jobCount, unsigned int iterations, uint64_t& checksum)
+	{
+		std::vector<uint64_t> results(jobCount);
+		double best = 0;
+		for (int repeat = 0; repeat < Repeats; repeat++)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			JobSystem::ParallelFor(jobCount, 1, [&](unsigned int begin, unsigned int end)
+			{
+				for (unsigned int i = begin; i < end; i++)
+					results[i] = Work(i + 1, iterations);
+			});
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			best = repeat == 0 ? ms : std::min(best, ms);
+		}
+
+		for (uint64_t result : results)
+			checksum += result;
+		return best;
+	}
+
+	struct Workload
+	{
+		const char* Name;
+		unsigned int Iterations;
+	};
+}
+
+// --------------------------------------------------------
+// Measures how the job system scales from 1 thread up to
+// -max-threads (doubling each time), with a fine-grained
+// workload, where queueing and stealing dominate, and a
+// coarse one, where it should scale with the cores.
+// Built by CMakeLists.txt.
+//
+// Usage: JobSystemBenchmark [-max-threads N] [-jobs N] [-work N]
+//   -work is the coarse workload's hash iterations per job;
+//   the fine one is 1/100th of that.
+// --------------------------------------------------------
+int main(int argc, char** argv)
+{
+	unsigned int maxThreads = 64;
+	unsigned int jobCount = 20000;
+	unsigned int work = 20000;
+	for (int i = 1; i < argc; i++)
+	{
+		unsigned int* option = 0;
+		if (strcmp(argv[i], "-max-threads") == 0) option = &maxThreads;
+		else if (strcmp(argv[i], "-jobs") == 0) option = &jobCount;
+		else if (strcmp(argv[i], "-work") == 0) option = &work;
+
+		if (!option || i + 1 >= argc || atoi(argv[i + 1]) <= 0)
+		{
+			printf("Usage: %s [-max-threads N] [-jobs N] [-work N]\n", argv[0]);
+			return 1;
+		}
+		*option = (unsigned int)atoi(argv[++i]);
+	}
+
+	unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	printf("%u jobs per run, %u hardware threads\n", jobCount, hardwareThreads);
+
+	Workload workloads[] = { { "fine", std::max(1u, work / 100) }, { "coarse", work } };
+	uint64_t checksum = 0;
+	for (const Workload& workload : workloads)
+	{
+		printf("\n%s (%u iterations per job)\n", workload.Name, workload.Iterations);
+		printf("threads       ms      jobs/s  speedup  efficiency\n");
+
+		double baselineMs = 0;
+		for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+		{
+			// One thread is the main thread on its own, which
+			// ParallelFor runs serially without any workers
+			if (threads > 1)
+				JobSystem::Initialize(threads - 1);
+
+			double ms = TimeParallelFor(jobCount, workload.Iterations, checksum);
+			if (threads == 1)
+				baselineMs = ms;
+
+			if (threads > 1)
+				JobSystem::ShutDown();
+
+			double speedup = baselineMs / std::max(ms, 1e-6);
+			printf("%7u %8.2f %11.0f %8.2f %10.0f%%%s\n",
+				threads, ms, jobCount / (ms / 1000), speedup, 100 * speedup / threads,
+				threads > hardwareThreads ? "  (oversubscribed)" : "");
+		}
+	}
+
+	printf("\nchecksum %llx\n", (unsigned long long)checksum);
+	return 0;
+}
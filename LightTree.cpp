@@ -0,0 +1,494 @@
+#include "LightTree.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Annonymous namespace to hold variables/helpers
+// only accessible in this file
+namespace
+{
+	const float Pi = 3.14159265f;
+
+	// Buckets per axis when looking for the best split
+	const unsigned int SplitBins = 12;
+
+	float Dot(const LightTreeFloat3& a, const LightTreeFloat3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	LightTreeFloat3 Sub(const LightTreeFloat3& a, const LightTreeFloat3& b) { return LightTreeFloat3{ a.x - b.x, a.y - b.y, a.z - b.z }; }
+	LightTreeFloat3 Cross(const LightTreeFloat3& a, const LightTreeFloat3& b)
+	{
+		return LightTreeFloat3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	LightTreeFloat3 Normalize(const LightTreeFloat3& v)
+	{
+		float length = std::sqrt(Dot(v, v));
+		return length > 0 ? LightTreeFloat3{ v.x / length, v.y / length, v.z / length } : LightTreeFloat3{ 0, 0, 1 };
+	}
+
+	float Component(const LightTreeFloat3& v, unsigned int axis) { return axis == 0 ? v.x : (axis == 1 ? v.y : v.z); }
+	float SafeAcos(float cosine) { return std::acos(std::clamp(cosine, -1.0f, 1.0f)); }
+
+	// Everything a node knows about the lights below it,
+	// with the cone kept as angles while building
+	struct LightBounds
+	{
+		bool Empty = true;
+		LightTreeFloat3 Min{};
+		LightTreeFloat3 Max{};
+		float Power = 0;
+		float Range = 0;
+		LightTreeFloat3 Axis{ 0, 0, 1 };
+		float ThetaO = 0;
+		float ThetaE = 0;
+	};
+
+	bool SameLight(const LightTreeLight& a, const LightTreeLight& b)
+	{
+		return a.Distant == b.Distant && a.Spot == b.Spot &&
+			a.Position.x == b.Position.x && a.Position.y == b.Position.y && a.Position.z == b.Position.z &&
+			a.Direction.x == b.Direction.x && a.Direction.y == b.Direction.y && a.Direction.z == b.Direction.z &&
+			a.Range == b.Range && a.Power == b.Power;
+	}
+
+	LightBounds BoundsForLight(const LightTreeLight& light)
+	{
+		LightBounds bounds;
+		bounds.Empty = false;
+		bounds.Min = light.Position;
+		bounds.Max = light.Position;
+		bounds.Power = light.Power;
+		bounds.Range = light.Range;
+
+		// Points shine everywhere, while spots fall off to
+		// nothing at right angles to their direction
+		if (light.Spot)
+		{
+			bounds.Axis = Normalize(light.Direction);
+			bounds.ThetaO = 0;
+		}
+		else
+		{
+			bounds.ThetaO = Pi;
+		}
+		bounds.ThetaE = Pi / 2;
+		return bounds;
+	}
+
+	// --------------------------------------------------------
+	// Smallest cone holding both (Conty Estevez & Kulla's
+	// union, which is close to but not always the smallest)
+	// --------------------------------------------------------
+	void UnionCones(LightBounds& result, LightBounds a, LightBounds b)
+	{
+		if (b.ThetaO > a.ThetaO)
+			std::swap(a, b);
+
+		result.ThetaE = std::max(a.ThetaE, b.ThetaE);
+		result.Axis = a.Axis;
+
+		// Already inside the wider cone?
+		float thetaD = SafeAcos(Dot(a.Axis, b.Axis));
+		if (std::min(thetaD + b.ThetaO, Pi) <= a.ThetaO)
+		{
+			result.ThetaO = a.ThetaO;
+			return;
+		}
+
+		// Widen, and turn the axis towards the other cone
+		float thetaO = (a.ThetaO + thetaD + b.ThetaO) / 2;
+		LightTreeFloat3 rotationAxis = Cross(a.Axis, b.Axis);
+		if (thetaO >= Pi || Dot(rotationAxis, rotationAxis) < 1e-12f)
+		{
+			result.ThetaO = Pi;
+			return;
+		}
+
+		// Rodrigues' rotation, with the axis at right angles to the cone axis
+		float thetaR = thetaO - a.ThetaO;
+		LightTreeFloat3 k = Normalize(rotationAxis);
+		LightTreeFloat3 kCrossA = Cross(k, a.Axis);
+		float c = std::cos(thetaR);
+		float s = std::sin(thetaR);
+		result.Axis = Normalize(LightTreeFloat3{
+			a.Axis.x * c + kCrossA.x * s,
+			a.Axis.y * c + kCrossA.y * s,
+			a.Axis.z * c + kCrossA.z * s});
+		result.ThetaO = thetaO;
+	}
+
+	LightBounds Union(const LightBounds& a, const LightBounds& b)
+	{
+		if (a.Empty) return b;
+		if (b.Empty) return a;
+
+		LightBounds result;
+		result.Empty = false;
+		result.Min = LightTreeFloat3{ std::min(a.Min.x, b.Min.x), std::min(a.Min.y, b.Min.y), std::min(a.Min.z, b.Min.z) };
+		result.Max = LightTreeFloat3{ std::max(a.Max.x, b.Max.x), std::max(a.Max.y, b.Max.y), std::max(a.Max.z, b.Max.z) };
+		result.Power = a.Power + b.Power;
+		result.Range = std::max(a.Range, b.Range);
+		UnionCones(result, a, b);
+		return result;
+	}
+
+	LightTreeNode ToNode(const LightBounds& bounds, unsigned int index, bool isLeaf)
+	{
+		LightTreeNode node = {};
+		node.BoundsMin = bounds.Min;
+		node.BoundsMax = bounds.Max;
+		node.Power = bounds.Power;
+		node.Range = bounds.Range;
+		node.Axis = bounds.Axis;
+		node.CosThetaO = std::cos(bounds.ThetaO);
+		node.CosThetaE = std::cos(bounds.ThetaE);
+		node.Index = index;
+		node.IsLeaf = isLeaf;
+		return node;
+	}
+
+	LightBounds FromNode(const LightTreeNode& node)
+	{
+		LightBounds bounds;
+		bounds.Empty = false;
+		bounds.Min = node.BoundsMin;
+		bounds.Max = node.BoundsMax;
+		bounds.Power = node.Power;
+		bounds.Range = node.Range;
+		bounds.Axis = node.Axis;
+		bounds.ThetaO = SafeAcos(node.CosThetaO);
+		bounds.ThetaE = SafeAcos(node.CosThetaE);
+		return bounds;
+	}
+
+	// --------------------------------------------------------
+	// Surface area orientation heuristic: how likely a node
+	// is to matter, by its power, size and how widely its
+	// lights shine (the solid angle measure from the paper)
+	// --------------------------------------------------------
+	float SplitCost(const LightBounds& bounds)
+	{
+		if (bounds.Empty)
+			return 0;
+
+		LightTreeFloat3 size = Sub(bounds.Max, bounds.Min);
+		float area = 2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+
+		float thetaW = std::min(bounds.ThetaO + bounds.ThetaE, Pi);
+		float sinO = std::sin(bounds.ThetaO);
+		float cosO = std::cos(bounds.ThetaO);
+		float orientation = 2 * Pi * (1 - cosO) +
+			Pi / 2 * (2 * thetaW * sinO - std::cos(bounds.ThetaO - 2 * thetaW) - 2 * bounds.ThetaO * sinO + cosO);
+
+		// Lights in one spot still cost something, so they get split up too
+		return bounds.Power * std::max(area, 1e-4f) * orientation;
+	}
+
+	// Builds the subtree over the given lights, returning its bounds
+	LightBounds BuildNode(
+		std::vector<LightTreeNode>& nodes,
+		std::vector<unsigned int>& leafNodes,
+		const std::vector<LightBounds>& lightBounds,
+		unsigned int* lightIndices,
+		unsigned int count,
+		unsigned int firstLocalLight)
+	{
+		unsigned int nodeIndex = (unsigned int)nodes.size();
+		nodes.push_back({});
+
+		if (count == 1)
+		{
+			const LightBounds& bounds = lightBounds[lightIndices[0]];
+			nodes[nodeIndex] = ToNode(bounds, firstLocalLight + lightIndices[0], true);
+			leafNodes[lightIndices[0]] = nodeIndex;
+			return bounds;
+		}
+
+		// Where are the lights' centers?
+		LightTreeFloat3 centerMin{ INFINITY, INFINITY, INFINITY };
+		LightTreeFloat3 centerMax{ -INFINITY, -INFINITY, -INFINITY };
+		for (unsigned int i = 0; i < count; i++)
+		{
+			const LightTreeFloat3& p = lightBounds[lightIndices[i]].Min;
+			centerMin = LightTreeFloat3{ std::min(centerMin.x, p.x), std::min(centerMin.y, p.y), std::min(centerMin.z, p.z) };
+			centerMax = LightTreeFloat3{ std::max(centerMax.x, p.x), std::max(centerMax.y, p.y), std::max(centerMax.z, p.z) };
+		}
+
+		// Find the cheapest split between buckets, along any axis
+		float bestCost = INFINITY;
+		unsigned int bestAxis = 0;
+		unsigned int bestSplit = 0;
+		for (unsigned int axis = 0; axis < 3; axis++)
+		{
+			float low = Component(centerMin, axis);
+			float extent = Component(centerMax, axis) - low;
+			if (extent <= 0)
+				continue;
+
+			LightBounds bins[SplitBins];
+			for (unsigned int i = 0; i < count; i++)
+			{
+				const LightBounds& bounds = lightBounds[lightIndices[i]];
+				unsigned int bin = std::min((unsigned int)((Component(bounds.Min, axis) - low) / extent * SplitBins), SplitBins - 1);
+				bins[bin] = Union(bins[bin], bounds);
+			}
+
+			LightBounds right[SplitBins];
+			for (unsigned int i = SplitBins - 1; i > 0; i--)
+				right[i - 1] = Union(right[i], bins[i]);
+
+			LightBounds left;
+			for (unsigned int split = 0; split < SplitBins - 1; split++)
+			{
+				left = Union(left, bins[split]);
+				if (left.Empty || right[split].Empty)
+					continue;
+
+				float cost = SplitCost(left) + SplitCost(right[split]);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+				}
+			}
+		}
+
+		// Split after the best bucket, or just in half if every
+		// light is in the same place
+		unsigned int leftCount = count / 2;
+		if (bestCost < INFINITY)
+		{
+			float low = Component(centerMin, bestAxis);
+			float extent = Component(centerMax, bestAxis) - low;
+			unsigned int* middle = std::partition(lightIndices, lightIndices + count, [&](unsigned int light)
+				{
+					float center = Component(lightBounds[light].Min, bestAxis);
+					return std::min((unsigned int)((center - low) / extent * SplitBins), SplitBins - 1) <= bestSplit;
+				});
+			leftCount = (unsigned int)(middle - lightIndices);
+		}
+
+		LightBounds leftBounds = BuildNode(nodes, leafNodes, lightBounds, lightIndices, leftCount, firstLocalLight);
+		unsigned int secondChild = (unsigned int)nodes.size();
+		LightBounds rightBounds = BuildNode(nodes, leafNodes, lightBounds, lightIndices + leftCount, count - leftCount, firstLocalLight);
+
+		LightBounds bounds = Union(leftBounds, rightBounds);
+		nodes[nodeIndex] = ToNode(bounds, secondChild, false);
+		return bounds;
+	}
+}
+
+LightTree::LightTree() :
+	distantLightCount(0),
+	rebuildCount(0)
+{
+}
+
+// --------------------------------------------------------
+// Cheap enough to call every frame: nothing happens unless
+// a light changed, and moving lights are only refit
+// --------------------------------------------------------
+void LightTree::Update(const LightTreeLight* lights, unsigned int lightCount)
+{
+	if (lightCount == lastLights.size() &&
+		std::equal(lights, lights + lightCount, lastLights.begin(), SameLight))
+		return;
+
+	if (!Refit(lights, lightCount))
+		Build(lights, lightCount);
+}
+
+void LightTree::Build(const LightTreeLight* lights, unsigned int lightCount)
+{
+	lastLights.assign(lights, lights + lightCount);
+	rebuildCount++;
+
+	// Directional lights first, then the ones the tree holds
+	originalIndices.clear();
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		if (lights[i].Distant)
+			originalIndices.push_back(i);
+	}
+	distantLightCount = (unsigned int)originalIndices.size();
+
+	std::vector<LightBounds> lightBounds;
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		if (!lights[i].Distant)
+		{
+			originalIndices.push_back(i);
+			lightBounds.push_back(BoundsForLight(lights[i]));
+		}
+	}
+
+	nodes.clear();
+	leafNodes.assign(lightBounds.size(), 0);
+	if (lightBounds.empty())
+		return;
+
+	// A binary tree with one light per leaf
+	nodes.reserve(lightBounds.size() * 2 - 1);
+	std::vector<unsigned int> lightIndices(lightBounds.size());
+	for (unsigned int i = 0; i < lightIndices.size(); i++)
+		lightIndices[i] = i;
+	BuildNode(nodes, leafNodes, lightBounds, lightIndices.data(), (unsigned int)lightIndices.size(), distantLightCount);
+}
+
+// --------------------------------------------------------
+// Recomputes every node's bounds, keeping the structure.
+// Fails (and changes nothing) if the lights no longer fit
+// that structure.
+// --------------------------------------------------------
+bool LightTree::Refit(const LightTreeLight* lights, unsigned int lightCount)
+{
+	if (lightCount != lastLights.size())
+		return false;
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		if (lights[i].Distant != lastLights[i].Distant || lights[i].Spot != lastLights[i].Spot)
+			return false;
+	}
+
+	lastLights.assign(lights, lights + lightCount);
+
+	// Children always come after their parent, so going
+	// backwards updates both children before the parent
+	for (size_t i = nodes.size(); i-- > 0;)
+	{
+		LightTreeNode& node = nodes[i];
+		if (node.IsLeaf)
+			node = ToNode(BoundsForLight(lights[originalIndices[node.Index]]), node.Index, true);
+		else
+			node = ToNode(Union(FromNode(nodes[i + 1]), FromNode(nodes[node.Index])), node.Index, false);
+	}
+	return true;
+}
+
+const std::vector<unsigned int>& LightTree::GetLightOrder() const { return originalIndices; }
+const std::vector<LightTreeNode>& LightTree::GetNodes() const { return nodes; }
+unsigned int LightTree::GetDistantLightCount() const { return distantLightCount; }
+unsigned int LightTree::GetLocalLightCount() const { return (unsigned int)originalIndices.size() - distantLightCount; }
+unsigned int LightTree::GetRebuildCount() const { return rebuildCount; }
+
+// --------------------------------------------------------
+// Walks from the root, choosing each child in proportion
+// to its importance and reusing the one random number by
+// rescaling it into the chosen child's share
+// --------------------------------------------------------
+int LightTree::Sample(float u, const LightTreeFloat3& position, const LightTreeFloat3& normal, float* pdf) const
+{
+	*pdf = 0;
+	if (nodes.empty())
+		return -1;
+
+	float probability = 1.0f;
+	unsigned int nodeIndex = 0;
+	while (!nodes[nodeIndex].IsLeaf)
+	{
+		unsigned int second = nodes[nodeIndex].Index;
+		float first = Importance(nodes[nodeIndex + 1], position, normal);
+		float total = first + Importance(nodes[second], position, normal);
+		if (total <= 0)
+			return -1;
+
+		float firstProbability = first / total;
+		if (u < firstProbability)
+		{
+			u = std::min(u / firstProbability, 0.99999994f);
+			probability *= firstProbability;
+			nodeIndex++;
+		}
+		else
+		{
+			u = std::min((u - firstProbability) / (1 - firstProbability), 0.99999994f);
+			probability *= 1 - firstProbability;
+			nodeIndex = second;
+		}
+	}
+
+	*pdf = probability;
+	return (int)nodes[nodeIndex].Index;
+}
+
+// --------------------------------------------------------
+// Chance Sample() picks the given light, from the same
+// walk down to its leaf
+// --------------------------------------------------------
+float LightTree::Pdf(unsigned int lightIndex, const LightTreeFloat3& position, const LightTreeFloat3& normal) const
+{
+	if (lightIndex < distantLightCount || lightIndex >= originalIndices.size())
+		return 0;
+
+	unsigned int leaf = leafNodes[lightIndex - distantLightCount];
+	float probability = 1.0f;
+	unsigned int nodeIndex = 0;
+	while (nodeIndex != leaf)
+	{
+		unsigned int second = nodes[nodeIndex].Index;
+		float first = Importance(nodes[nodeIndex + 1], position, normal);
+		float total = first + Importance(nodes[second], position, normal);
+		if (total <= 0)
+			return 0;
+
+		// Subtrees are contiguous, so the leaf is under the first
+		// child exactly when it comes before the second
+		if (leaf < second)
+		{
+			probability *= first / total;
+			nodeIndex++;
+		}
+		else
+		{
+			probability *= 1 - first / total;
+			nodeIndex = second;
+		}
+	}
+	return probability;
+}
+
+// --------------------------------------------------------
+// Upper bound on what the node's lights could contribute
+// at the point, allowing for every position and direction
+// inside its bounds.  Zero only where none of its lights
+// can reach, face or be seen from the point.
+// --------------------------------------------------------
+float LightTree::Importance(const LightTreeNode& node, const LightTreeFloat3& position, const LightTreeFloat3& normal)
+{
+	// Out of range of every light?
+	LightTreeFloat3 closest{
+		std::clamp(position.x, node.BoundsMin.x, node.BoundsMax.x),
+		std::clamp(position.y, node.BoundsMin.y, node.BoundsMax.y),
+		std::clamp(position.z, node.BoundsMin.z, node.BoundsMax.z)};
+	LightTreeFloat3 toClosest = Sub(closest, position);
+	if (Dot(toClosest, toClosest) > node.Range * node.Range)
+		return 0;
+
+	LightTreeFloat3 center{
+		(node.BoundsMin.x + node.BoundsMax.x) / 2,
+		(node.BoundsMin.y + node.BoundsMax.y) / 2,
+		(node.BoundsMin.z + node.BoundsMax.z) / 2};
+	LightTreeFloat3 halfSize = Sub(node.BoundsMax, center);
+	float radiusSquared = Dot(halfSize, halfSize);
+	LightTreeFloat3 toCenter = Sub(center, position);
+	float distanceSquared = Dot(toCenter, toCenter);
+	float distance = std::sqrt(distanceSquared);
+
+	// Angle the bounds cover from here (all of it from inside)
+	float thetaU = distanceSquared > radiusSquared ? std::asin(std::sqrt(radiusSquared / distanceSquared)) : Pi;
+	LightTreeFloat3 direction = distance > 0 ? LightTreeFloat3{ toCenter.x / distance, toCenter.y / distance, toCenter.z / distance } : normal;
+
+	// Could the lights shine this way?
+	float theta = SafeAcos(-Dot(node.Axis, direction));
+	float thetaPrime = std::max(theta - SafeAcos(node.CosThetaO) - thetaU, 0.0f);
+	if (thetaPrime >= SafeAcos(node.CosThetaE))
+		return 0;
+
+	// Could the surface face them?
+	float thetaI = SafeAcos(Dot(normal, direction));
+	float thetaIPrime = std::max(thetaI - thetaU, 0.0f);
+	if (thetaIPrime >= Pi / 2)
+		return 0;
+
+	return node.Power * std::cos(thetaPrime) * std::cos(thetaIPrime) / std::max(std::max(distanceSquared, radiusSquared), 1e-6f);
+}
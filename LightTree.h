@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+
+// Plain vector, so the tree doesn't depend on DirectXMath
+// (laid out like XMFLOAT3 and the shader's float3)
+struct LightTreeFloat3
+{
+	float x;
+	float y;
+	float z;
+};
+
+// What the tree needs to know about one of the scene's lights
+struct LightTreeLight
+{
+	bool Distant;					// Directional lights have no position
+	bool Spot;						// Spot lights fall off away from Direction
+	LightTreeFloat3 Position;
+	LightTreeFloat3 Direction;
+	float Range;
+	float Power;					// Intensity weighted by the color's luminance
+};
+
+// One node of the flattened tree, as the shader sees it
+// - Nodes are in depth-first order, so an internal node's
+//   first child is the next node and Index is its second
+// - Leaves hold a single light, and Index is that light's
+//   position in GetLightOrder()
+struct LightTreeNode
+{
+	LightTreeFloat3 BoundsMin;		// Positions of every light below
+	float Power;					// Summed over every light below
+	LightTreeFloat3 BoundsMax;
+	float Range;					// Farthest any light below reaches
+	LightTreeFloat3 Axis;			// Bounding cone of the directions lights below shine in
+	float CosThetaO;				// Cone of the lights' axes
+	float CosThetaE;				// How far past those axes they still emit
+	unsigned int Index;				// Second child, or light
+	unsigned int IsLeaf;
+	float Padding;
+};
+static_assert(sizeof(LightTreeNode) == 64, "LightTreeNode must match the shader's layout");
+
+// --------------------------------------------------------
+// Bounding volume hierarchy over the scene's point and
+// spot lights, for picking one light to sample at a
+// shading point in proportion to how much it could light
+// that point (Conty Estevez & Kulla, "Importance Sampling
+// of Many Lights with Adaptive Tree Splitting", 2018).
+//
+// Every node bounds the positions, power, reach and
+// emission directions of the lights below it.  Sampling
+// walks down from the root, picking a child in proportion
+// to a conservative estimate of its contribution at the
+// shading point, so the cost is the depth of the tree
+// rather than the number of lights.
+//
+// Directional lights have no position, so they're kept
+// out of the tree and listed first in GetLightOrder().
+// The shader picks between them (and the sky) uniformly,
+// so the renderer uploads its lights in that order.
+//
+// The tree only sees LightTreeLight, the handful of values
+// it bounds, so the renderer converts its Lights first.
+//
+// When lights only move, Update() refits the existing
+// tree rather than building it again.  Adding, removing
+// or changing the type of a light means a full rebuild.
+//
+// The sampling and pdfs are implemented here too, on the
+// CPU, as a reference for the shader.
+//
+// Nothing here knows about D3D12.
+// --------------------------------------------------------
+class LightTree
+{
+public:
+	LightTree();
+
+	// Refits when only the lights' values changed, rebuilds otherwise
+	void Update(const LightTreeLight* lights, unsigned int lightCount);
+	void Build(const LightTreeLight* lights, unsigned int lightCount);
+	bool Refit(const LightTreeLight* lights, unsigned int lightCount);
+
+	// Where each light goes once reordered with directional
+	// lights first, which is what leaves and the shader index
+	// into: element i is the index given to Update() of light i
+	const std::vector<unsigned int>& GetLightOrder() const;
+	const std::vector<LightTreeNode>& GetNodes() const;
+	unsigned int GetDistantLightCount() const;
+	unsigned int GetLocalLightCount() const;
+	unsigned int GetRebuildCount() const;
+
+	// Sampling, matching the shader
+	// - Returns a reordered index (see GetLightOrder()), or -1
+	//   if the walk ends where no light can reach the point
+	// - Importance is only an upper bound, so a node can look
+	//   worth visiting when none of its lights are.  The pdfs
+	//   then sum to less than one, the rest being the chance
+	//   of -1, which wastes the sample but adds no bias.
+	int Sample(float u, const LightTreeFloat3& position, const LightTreeFloat3& normal, float* pdf) const;
+	float Pdf(unsigned int lightIndex, const LightTreeFloat3& position, const LightTreeFloat3& normal) const;
+	static float Importance(const LightTreeNode& node, const LightTreeFloat3& position, const LightTreeFloat3& normal);
+
+private:
+	std::vector<unsigned int> originalIndices;		// Where each ordered light came from
+	std::vector<unsigned int> leafNodes;			// Node holding each local light, by ordered index
+	std::vector<LightTreeNode> nodes;
+	std::vector<LightTreeLight> lastLights;			// As given, to spot what changed
+	unsigned int distantLightCount;
+	unsigned int rebuildCount;
+};
@@ -5,7 +5,14 @@
 #include "Window.h"
 #include "Graphics.h"
 #include "Game.h"
+#include "RayTracing.h"
 #include "Input.h"
+#include "GPUProfiler.h"
+#include "Trace.h"
+#include "JobSystem.h"
+#include "PathHelpers.h"
+#include "Benchmark.h"
+#include "BenchmarkTimeline.h"
 
 // Annonymous namespace to hold variables
 // only accessible in this file
@@ -50,12 +57,28 @@ int WINAPI WinMain(
 	printf("Console window created successfully.  Feel free to printf() here.\n");
 #endif
 
+	// Benchmarks are set up entirely from the command line
+	Benchmark::Options benchmark;
+	BenchmarkTimeline benchmarkTimeline;
+	std::string benchmarkError;
+	if (!Benchmark::ParseCommandLine(lpCmdLine, benchmark, &benchmarkError) ||
+		(benchmark.Enabled && !benchmarkTimeline.Load(benchmark.TimelinePath, &benchmarkError)))
+	{
+		printf("Benchmark error: %s\n", benchmarkError.c_str());
+		return Benchmark::ExitCodeError;
+	}
+
+	// Headless benchmarks never need a window or the GPU
+	if (benchmark.Headless)
+		return Benchmark::RunHeadless(benchmark, benchmarkTimeline);
+
 	// Set up app initialization details
 	unsigned int windowWidth = 1280;
 	unsigned int windowHeight = 720;
 	const wchar_t* windowTitle = L"Direct3D12 Game";
 	bool statsInTitleBar = true;
 	bool vsync = false;
+	bool threadedUpdate = false;	// Toggle with F8 while running
 
 	// The main application object
 	game = new Game();
@@ -80,11 +103,27 @@ int WINAPI WinMain(
 	if (FAILED(graphicsResult))
 		return graphicsResult;
 
+	// GPU timing relies on the graphics API
+	GPUProfiler::Initialize();
+
 	// Initalize the input system, which requires the window handle
 	Input::Initialize(Window::Handle());
 
+	// Label this thread in any traces
+	Trace::SetThreadName("Main");
+
+#if defined(DEBUG) || defined(_DEBUG)
+	// Report what each traced zone costs us (unoptimized here -
+	// TraceBenchmark holds optimized builds to their budget)
+	printf("Trace zone overhead: %.1f ns\n", Trace::MeasureZoneOverhead());
+#endif
+
+	// Worker threads for engine-side parallel work, one per spare hardware thread
+	JobSystem::Initialize();
+
 	// Now the game itself can be initialzied
 	game->Initialize();
+	game->SetThreadedUpdate(threadedUpdate);
 
 	// Time tracking
 	LARGE_INTEGER perfFreq{};
@@ -101,6 +140,7 @@ int WINAPI WinMain(
 	QueryPerformanceCounter((LARGE_INTEGER*)&startTime);
 	currentTime = startTime;
 	previousTime = startTime;
+	unsigned int benchmarkFrame = 0;
 
 	// Windows message loop (and our game loop)
 	MSG msg = {};
@@ -118,33 +158,75 @@ int WINAPI WinMain(
 		{
 			// Calculate up-to-date timing info
 			QueryPerformanceCounter((LARGE_INTEGER*)&currentTime);
-			float deltaTime = max((float)((currentTime - previousTime) * perfSeconds), 0.0f);
+			float frameTime = max((float)((currentTime - previousTime) * perfSeconds), 0.0f);
+			float deltaTime = frameTime;
 			float totalTime = (float)((currentTime - startTime) * perfSeconds);
 			previousTime = currentTime;
 
-			// Calculate basic fps
-			Window::UpdateStats(totalTime);
+			// Benchmarks step by a fixed amount no matter how
+			// long each frame actually takes
+			if (benchmark.Enabled)
+			{
+				deltaTime = benchmark.DeltaTime;
+				totalTime = (float)(benchmarkFrame * (double)benchmark.DeltaTime);
+			}
+
+			// Show frame stats in the title bar
+			Window::UpdateStats(totalTime, game->GetFrameStats());
+
+			// Sleep off any time the frame would otherwise spend queued
+			// behind the GPU, so input is sampled as late as possible
+			if (!benchmark.Enabled)
+				Graphics::WaitForFramePacing();
 
-			// Input updating
+			// Input updating, which applies every input message
+			// received since the last frame
 			Input::Update();
 
 			// Update and draw
-			game->Update(deltaTime, totalTime);
+			if (benchmark.Enabled)
+				game->UpdateBenchmark(deltaTime, totalTime, benchmarkTimeline);
+			else
+				game->Update(deltaTime, totalTime);
 			game->Draw(deltaTime, totalTime);
-
-			// Notify Input system about end of frame
-			Input::EndOfFrame();
+			game->EndFrame(frameTime * 1000.0);
 
 #if defined(DEBUG) || defined(_DEBUG)
 			// Print any graphics debug messages that occurred this frame
 			Graphics::PrintDebugMessages();
 #endif
+
+			// Stop once the benchmark has run its course
+			if (benchmark.Enabled && ++benchmarkFrame == benchmark.FrameCount)
+				Window::Quit();
 		}
 	}
 
+	int exitCode = (int)msg.wParam;
+	if (benchmark.Enabled)
+	{
+		FrameSchedulerStats gpuStats = Graphics::GetTotalFrameSchedulerStats();
+		PathTracingStats pathStats = RayTracing::GetTotalPathTracingStats();
+		exitCode = Benchmark::Finish(benchmark, game->GetFrameStats(), &gpuStats, &pathStats);
+
+		// How often the CPU ended up waiting on the GPU, and how
+		// close the constant buffer rings came to filling up
+		RingAllocatorStats uploadStats = Graphics::GetConstantBufferUploadStats();
+		RingAllocatorStats descriptorStats = Graphics::GetConstantBufferDescriptorStats();
+		printf("  Frame fence stalls: %llu\n", Graphics::GetFrameFenceStallCount());
+		printf("  CB upload ring: %llu / %llu bytes at most, %llu stalls\n",
+			uploadStats.HighWaterMark, uploadStats.Capacity, uploadStats.Stalls);
+		printf("  CBV ring: %llu / %llu descriptors at most, %llu stalls\n",
+			descriptorStats.HighWaterMark, descriptorStats.Capacity, descriptorStats.Stalls);
+	}
+
+	// Save the trace before shutting down
+	Trace::Flush(FixPath(L"Trace.json"));
+
 	// Clean up
 	delete game;
 	Input::ShutDown();
 	Graphics::ShutDown();
-	return (HRESULT)msg.wParam;
+	JobSystem::ShutDown();
+	return exitCode;
 }
@@ -4,6 +4,7 @@
 #include "PathHelpers.h"
 #include "Graphics.h"
 #include "RayTracing.h"
+#include "Trace.h"
 
 using namespace DirectX;
 
@@ -164,6 +165,8 @@ Mesh::Mesh(Vertex* vertices,
 
 Mesh::Mesh(const char* objFile) : vertexCount(0), indexCount(0)
 {
+	TRACE_ZONE("Mesh Load");
+
 	// Author: Chris Cascioli
 	// Purpose: Basic .OBJ 3D model loading, supporting positions, uvs and normals
 	// 
@@ -37,6 +37,7 @@ public:
 	unsigned int GetVertexCount();
 	unsigned int GetIndexCount();
 	MeshRaytracingData GetRaytracingData() { return raytracingData; }
+	void SetRaytracingData(const MeshRaytracingData& data) { raytracingData = data; }
 	void Draw();
 
 	Mesh(Vertex* vertices, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount);
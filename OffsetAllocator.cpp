@@ -0,0 +1,137 @@
+#include "OffsetAllocator.h"
+
+// Makes use of integer division to ensure we are aligned to the proper multiple of "alignment"
+#define ALIGN(value, alignment) (((value + alignment - 1) / alignment) * alignment)
+
+OffsetAllocator::OffsetAllocator(uint64_t size)
+{
+	Reset(size);
+}
+
+// --------------------------------------------------------
+// Forgets all allocations and treats the entire range
+// as a single free block
+// --------------------------------------------------------
+void OffsetAllocator::Reset(uint64_t size)
+{
+	this->size = size;
+	used = 0;
+	allocationCount = 0;
+
+	freeBlocksByOffset.clear();
+	freeBlocksBySize.clear();
+	if (size > 0)
+		AddFreeBlock(0, size);
+}
+
+// --------------------------------------------------------
+// Finds the smallest free block that can hold the given
+// size at the given alignment and carves the allocation
+// out of it.  Any space skipped for alignment, as well as
+// any space left over, remains free.
+//
+// size      - How much space to reserve
+// alignment - Required alignment of the returned offset
+// --------------------------------------------------------
+uint64_t OffsetAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	if (size == 0)
+		return InvalidOffset;
+	if (alignment == 0)
+		alignment = 1;
+
+	// Walk the free blocks from the smallest that could possibly fit,
+	// since alignment padding may rule out the first few candidates
+	for (auto it = freeBlocksBySize.lower_bound(size); it != freeBlocksBySize.end(); it++)
+	{
+		uint64_t blockOffset = it->second;
+		uint64_t blockSize = it->first;
+		uint64_t alignedOffset = ALIGN(blockOffset, alignment);
+		uint64_t padding = alignedOffset - blockOffset;
+		if (padding + size > blockSize)
+			continue;
+
+		// This block works, so remove it and give back what we don't need
+		RemoveFreeBlock(freeBlocksByOffset.find(blockOffset));
+		if (padding > 0)
+			AddFreeBlock(blockOffset, padding);
+		if (padding + size < blockSize)
+			AddFreeBlock(alignedOffset + size, blockSize - padding - size);
+
+		used += size;
+		allocationCount++;
+		return alignedOffset;
+	}
+
+	// Nothing was large enough
+	return InvalidOffset;
+}
+
+// --------------------------------------------------------
+// Returns a previously allocated range to the free list,
+// merging it with any free neighbors
+//
+// offset - The offset returned by Allocate()
+// size   - The size originally passed to Allocate()
+// --------------------------------------------------------
+void OffsetAllocator::Free(uint64_t offset, uint64_t size)
+{
+	uint64_t start = offset;
+	uint64_t end = offset + size;
+
+	// Merge with the block right after us
+	auto next = freeBlocksByOffset.find(end);
+	if (next != freeBlocksByOffset.end())
+	{
+		end += next->second;
+		RemoveFreeBlock(next);
+	}
+
+	// Merge with the block right before us
+	auto prev = freeBlocksByOffset.lower_bound(start);
+	if (prev != freeBlocksByOffset.begin())
+	{
+		prev--;
+		if (prev->first + prev->second == start)
+		{
+			start = prev->first;
+			RemoveFreeBlock(prev);
+		}
+	}
+
+	AddFreeBlock(start, end - start);
+	used -= size;
+	allocationCount--;
+}
+
+// Getters
+uint64_t OffsetAllocator::GetSize() { return size; }
+uint64_t OffsetAllocator::GetUsedSize() { return used; }
+uint64_t OffsetAllocator::GetFreeSize() { return size - used; }
+uint64_t OffsetAllocator::GetLargestFreeBlock() { return freeBlocksBySize.empty() ? 0 : freeBlocksBySize.rbegin()->first; }
+unsigned int OffsetAllocator::GetAllocationCount() { return allocationCount; }
+
+// --------------------------------------------------------
+// Helpers for keeping both free block indices in sync
+// --------------------------------------------------------
+void OffsetAllocator::AddFreeBlock(uint64_t offset, uint64_t size)
+{
+	freeBlocksByOffset[offset] = size;
+	freeBlocksBySize.insert({ size, offset });
+}
+
+void OffsetAllocator::RemoveFreeBlock(std::map<uint64_t, uint64_t>::iterator block)
+{
+	// Find the matching entry in the size index
+	auto range = freeBlocksBySize.equal_range(block->second);
+	for (auto it = range.first; it != range.second; it++)
+	{
+		if (it->second == block->first)
+		{
+			freeBlocksBySize.erase(it);
+			break;
+		}
+	}
+
+	freeBlocksByOffset.erase(block);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+// --------------------------------------------------------
+// A general purpose allocator that hands out aligned
+// offsets into a fixed-size range, such as a chunk of GPU
+// memory.  It never touches the memory itself, so it
+// knows nothing about D3D12.
+//
+// Free space is tracked as a set of blocks, which are
+// searched best-fit and merged with their neighbors
+// when allocations are freed.
+// --------------------------------------------------------
+class OffsetAllocator
+{
+public:
+	static const uint64_t InvalidOffset = UINT64_MAX;
+
+	OffsetAllocator(uint64_t size = 0);
+
+	void Reset(uint64_t size);
+
+	// Returns InvalidOffset if no free block is large enough
+	uint64_t Allocate(uint64_t size, uint64_t alignment = 1);
+	void Free(uint64_t offset, uint64_t size);
+
+	// Getters
+	uint64_t GetSize();
+	uint64_t GetUsedSize();
+	uint64_t GetFreeSize();
+	uint64_t GetLargestFreeBlock();
+	unsigned int GetAllocationCount();
+
+private:
+	uint64_t size;
+	uint64_t used;
+	unsigned int allocationCount;
+
+	// Free blocks, indexed both ways: by offset for merging
+	// neighbors and by size for finding the best fit
+	std::map<uint64_t, uint64_t> freeBlocksByOffset;
+	std::multimap<uint64_t, uint64_t> freeBlocksBySize;
+
+	void AddFreeBlock(uint64_t offset, uint64_t size);
+	void RemoveFreeBlock(std::map<uint64_t, uint64_t>::iterator block);
+};
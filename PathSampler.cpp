@@ -0,0 +1,123 @@
+#include "PathSampler.h"
+
+#include <algorithm>
+
+// Annonymous namespace to hold variables/helpers
+// only accessible in this file
+namespace
+{
+	// Hash-based permutation that only lets bits affect
+	// higher bits, which is what Owen scrambling needs
+	uint32_t LaineKarrasPermutation(uint32_t value, uint32_t seed)
+	{
+		value += seed;
+		value ^= value * 0x6c50b47cu;
+		value ^= value * 0xb82f1e52u;
+		value ^= value * 0xc7afe638u;
+		value ^= value * 0x8d22f6e6u;
+		return value;
+	}
+
+	// First two dimensions of the Sobol sequence
+	void Sobol2D(uint32_t index, uint32_t* x, uint32_t* y)
+	{
+		*x = PathSampler::ReverseBits(index);
+		*y = 0;
+		for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+		{
+			if (index & 1)
+				*y ^= v;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// PCG-based hash (Jarzynski & Olano, "Hash Functions for
+// GPU Rendering", 2020) - cheap, with good avalanche
+// --------------------------------------------------------
+uint32_t PathSampler::PCGHash(uint32_t value)
+{
+	uint32_t state = value * 747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+uint32_t PathSampler::HashCombine(uint32_t seed, uint32_t value)
+{
+	return seed ^ (PCGHash(value) + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+uint32_t PathSampler::ReverseBits(uint32_t value)
+{
+	value = (value << 16) | (value >> 16);
+	value = ((value & 0x00ff00ffu) << 8) | ((value & 0xff00ff00u) >> 8);
+	value = ((value & 0x0f0f0f0fu) << 4) | ((value & 0xf0f0f0f0u) >> 4);
+	value = ((value & 0x33333333u) << 2) | ((value & 0xccccccccu) >> 2);
+	value = ((value & 0x55555555u) << 1) | ((value & 0xaaaaaaaau) >> 1);
+	return value;
+}
+
+// --------------------------------------------------------
+// Owen scrambling: randomly flips each bit based on the
+// bits above it, which keeps the sequence stratified
+// --------------------------------------------------------
+uint32_t PathSampler::NestedUniformScramble(uint32_t value, uint32_t seed)
+{
+	value = ReverseBits(value);
+	value = LaineKarrasPermutation(value, seed);
+	return ReverseBits(value);
+}
+
+// --------------------------------------------------------
+// Top 24 bits, so the result is exact and always below 1
+// --------------------------------------------------------
+float PathSampler::ToUnitFloat(uint32_t value)
+{
+	return (float)(value >> 8) / 16777216.0f;
+}
+
+uint32_t PathSampler::BounceDimension(unsigned int bounce)
+{
+	return FirstBounceDimension + bounce * DimensionsPerBounce;
+}
+
+uint32_t PathSampler::PixelSeed(unsigned int pixelX, unsigned int pixelY)
+{
+	return PCGHash(pixelX ^ PCGHash(pixelY));
+}
+
+void PathSampler::Sample2D(SamplerType type, uint32_t sampleIndex, uint32_t dimension, uint32_t pixelSeed, float* u0, float* u1)
+{
+	uint32_t seed = HashCombine(pixelSeed, dimension);
+	if (type == SamplerType::Sobol)
+	{
+		// Shuffle the order per pixel and dimension, so pairs of
+		// dimensions don't line up, then scramble each axis
+		uint32_t index = NestedUniformScramble(sampleIndex, seed);
+		uint32_t x, y;
+		Sobol2D(index, &x, &y);
+		*u0 = ToUnitFloat(NestedUniformScramble(x, HashCombine(seed, 0)));
+		*u1 = ToUnitFloat(NestedUniformScramble(y, HashCombine(seed, 1)));
+		return;
+	}
+
+	uint32_t hash = PCGHash(seed ^ PCGHash(sampleIndex));
+	*u0 = ToUnitFloat(hash);
+	*u1 = ToUnitFloat(PCGHash(hash));
+}
+
+float PathSampler::Sample1D(SamplerType type, uint32_t sampleIndex, uint32_t dimension, uint32_t pixelSeed)
+{
+	float u0, u1;
+	Sample2D(type, sampleIndex, dimension, pixelSeed, &u0, &u1);
+	return u0;
+}
+
+// --------------------------------------------------------
+// The brightest channel, so paths only end once they can't
+// carry much light in any of them
+// --------------------------------------------------------
+float PathSampler::RouletteSurvival(float throughputR, float throughputG, float throughputB)
+{
+	return std::min(std::max(throughputR, std::max(throughputG, throughputB)), 1.0f);
+}
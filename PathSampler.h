@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+// --------------------------------------------------------
+// CPU port of the random number generation in
+// RayTracing.hlsl, so the sequences the shader uses can be
+// examined (and checked for uniformity) off the GPU.  Any
+// change here must be made there too, and vice versa.
+//
+// Every random number along a path is a function of the
+// pixel, the sample's index within that pixel, and a
+// dimension that says what the number is for (camera
+// jitter, then a few per bounce).  Nothing is carried from
+// one call to the next, so any sample can be regenerated.
+//
+// Russian roulette's survival chance is here too, so the
+// error it adds can be checked on the CPU.
+//
+//  - PCG: each number is an independent PCG hash of the
+//    pixel, sample and dimension.
+//  - Sobol: each pair of dimensions is a 2D Sobol (0,2)
+//    sequence, shuffled and Owen-scrambled per pixel and
+//    per dimension (Burley, "Practical Hash-based Owen
+//    Scrambling", 2020), so samples stay stratified across
+//    a pixel while different dimensions stay independent.
+// --------------------------------------------------------
+namespace PathSampler
+{
+	// Must match the shader's values
+	enum class SamplerType : unsigned int
+	{
+		PCG = 0,
+		Sobol = 1
+	};
+
+	// Dimensions used by each part of a path.  Every use takes
+	// a pair (one Sample2D() call), so these all step by two.
+	const unsigned int CameraJitterDimension = 0;
+	const unsigned int FirstBounceDimension = 2;
+	const unsigned int DimensionsPerBounce = 8;
+
+	// Pairs within a bounce, from its first dimension
+	const unsigned int BounceDirectionOffset = 0;
+	const unsigned int BounceChoiceOffset = 2;		// Reflection, then Russian roulette
+	const unsigned int LightChoiceOffset = 4;
+	const unsigned int LightDirectionOffset = 6;
+
+	// Building blocks
+	uint32_t PCGHash(uint32_t value);
+	uint32_t HashCombine(uint32_t seed, uint32_t value);
+	uint32_t ReverseBits(uint32_t value);
+	uint32_t NestedUniformScramble(uint32_t value, uint32_t seed);
+	float ToUnitFloat(uint32_t value);
+
+	// Seeds and samples
+	uint32_t BounceDimension(unsigned int bounce);
+	uint32_t PixelSeed(unsigned int pixelX, unsigned int pixelY);
+	void Sample2D(SamplerType type, uint32_t sampleIndex, uint32_t dimension, uint32_t pixelSeed, float* u0, float* u1);
+	float Sample1D(SamplerType type, uint32_t sampleIndex, uint32_t dimension, uint32_t pixelSeed);
+
+	// Chance a path past the roulette start bounce carries on,
+	// given its throughput.  Survivors divide by it.
+	float RouletteSurvival(float throughputR, float throughputG, float throughputB);
+}
@@ -0,0 +1,109 @@
+#include "ProfileZones.h"
+
+#include <algorithm>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// --------------------------------------------------------
+	// Converts a single GPU timestamp to CPU clock milliseconds
+	// --------------------------------------------------------
+	double GPUTimestampToCPUMs(uint64_t timestamp, const ClockCalibration& calibration)
+	{
+		// Time relative to the calibration point (may be negative)
+		double gpuSeconds = ((double)timestamp - (double)calibration.GPUTimestamp) / (double)calibration.GPUFrequency;
+		double cpuSeconds = (double)calibration.CPUTimestamp / (double)calibration.CPUFrequency;
+		return (cpuSeconds + gpuSeconds) * 1000.0;
+	}
+}
+
+// --------------------------------------------------------
+// Resolves each recorded GPU zone using the timestamps
+// read back for its frame
+// --------------------------------------------------------
+std::vector<ProfileZone> ResolveTimestampZones(
+	const std::vector<TimestampZoneRecord>& records,
+	const uint64_t* timestamps,
+	const ClockCalibration& calibration)
+{
+	std::vector<ProfileZone> zones;
+	zones.reserve(records.size());
+
+	for (const TimestampZoneRecord& record : records)
+	{
+		uint64_t begin = timestamps[record.BeginQuery];
+		uint64_t end = std::max(timestamps[record.EndQuery], begin);
+
+		ProfileZone zone;
+		zone.Name = record.Name;
+		zone.StartMs = GPUTimestampToCPUMs(begin, calibration);
+		zone.DurationMs = (double)(end - begin) * 1000.0 / (double)calibration.GPUFrequency;
+		zone.Depth = record.Depth;
+		zone.GPU = true;
+		zones.push_back(zone);
+	}
+
+	return zones;
+}
+
+// --------------------------------------------------------
+// Combines CPU and GPU zones (or any two sets) into one
+// timeline ordered by start time
+// --------------------------------------------------------
+std::vector<ProfileZone> MergeProfileZones(
+	const std::vector<ProfileZone>& a,
+	const std::vector<ProfileZone>& b)
+{
+	std::vector<ProfileZone> merged(a);
+	merged.insert(merged.end(), b.begin(), b.end());
+
+	// Stable so that a parent starting at the same time as its
+	// child (which was recorded after it) stays in front
+	std::stable_sort(merged.begin(), merged.end(),
+		[](const ProfileZone& left, const ProfileZone& right) { return left.StartMs < right.StartMs; });
+	return merged;
+}
+
+// --------------------------------------------------------
+// Adds each zone's duration to the stats for its name.
+// Multiple zones with the same name in a single frame
+// count as separate samples.
+// --------------------------------------------------------
+void ZoneTimingAggregator::AddFrame(const std::vector<ProfileZone>& zones)
+{
+	for (const ProfileZone& zone : zones)
+	{
+		auto it = std::find_if(stats.begin(), stats.end(),
+			[&](const ZoneTimingStats& s) { return s.Name == zone.Name && s.GPU == zone.GPU; });
+
+		if (it == stats.end())
+		{
+			ZoneTimingStats newStats;
+			newStats.Name = zone.Name;
+			newStats.Depth = zone.Depth;
+			newStats.GPU = zone.GPU;
+			stats.push_back(newStats);
+			it = stats.end() - 1;
+		}
+
+		it->SampleCount++;
+		it->TotalMs += zone.DurationMs;
+		it->MaxMs = std::max(it->MaxMs, zone.DurationMs);
+		it->LastMs = zone.DurationMs;
+	}
+}
+
+void ZoneTimingAggregator::Reset() { stats.clear(); }
+
+const std::vector<ZoneTimingStats>& ZoneTimingAggregator::GetStats() { return stats; }
+
+const ZoneTimingStats* ZoneTimingAggregator::FindStats(const std::string& name)
+{
+	for (const ZoneTimingStats& s : stats)
+	{
+		if (s.Name == name)
+			return &s;
+	}
+	return 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// A single timed region of work, either on the CPU or the
+// GPU.  All zones are expressed on the CPU's clock so they
+// can be placed on the same timeline.
+// --------------------------------------------------------
+struct ProfileZone
+{
+	std::string Name;
+	double StartMs = 0;		// CPU clock time, in milliseconds
+	double DurationMs = 0;
+	unsigned int Depth = 0;	// How many zones this one is nested inside
+	bool GPU = false;
+};
+
+// A GPU zone as recorded: which timestamp queries bracket it
+struct TimestampZoneRecord
+{
+	const char* Name;
+	unsigned int BeginQuery;
+	unsigned int EndQuery;
+	unsigned int Depth;
+};
+
+// A pair of GPU and CPU timestamps taken at the same moment,
+// used to move GPU timestamps onto the CPU's clock
+struct ClockCalibration
+{
+	uint64_t GPUTimestamp = 0;
+	uint64_t GPUFrequency = 1;
+	uint64_t CPUTimestamp = 0;
+	uint64_t CPUFrequency = 1;
+};
+
+// Running timing stats for all zones with a particular name
+struct ZoneTimingStats
+{
+	std::string Name;
+	unsigned int Depth = 0;
+	bool GPU = false;
+	unsigned int SampleCount = 0;
+	double TotalMs = 0;
+	double MaxMs = 0;
+	double LastMs = 0;
+
+	double AverageMs() const { return SampleCount > 0 ? TotalMs / SampleCount : 0; }
+};
+
+// --------------------------------------------------------
+// Turns recorded zones and their raw timestamps into
+// zones on the CPU's clock.  Zones whose end timestamp is
+// before their begin timestamp (which can happen if the
+// GPU's clock was reset) are given a duration of zero.
+// --------------------------------------------------------
+std::vector<ProfileZone> ResolveTimestampZones(
+	const std::vector<TimestampZoneRecord>& records,
+	const uint64_t* timestamps,
+	const ClockCalibration& calibration);
+
+// Combines two sets of zones into a single set, ordered by start time
+std::vector<ProfileZone> MergeProfileZones(
+	const std::vector<ProfileZone>& a,
+	const std::vector<ProfileZone>& b);
+
+// --------------------------------------------------------
+// Accumulates zone timings over several frames, grouped by
+// name, in the order each name was first seen
+// --------------------------------------------------------
+class ZoneTimingAggregator
+{
+public:
+	void AddFrame(const std::vector<ProfileZone>& zones);
+	void Reset();
+
+	const std::vector<ZoneTimingStats>& GetStats();
+	const ZoneTimingStats* FindStats(const std::string& name);
+
+private:
+	std::vector<ZoneTimingStats> stats;
+};
@@ -0,0 +1,135 @@
+#include "ProgressiveAccumulation.h"
+
+#include <algorithm>
+#include <cstring>
+
+ProgressiveAccumulation::ProgressiveAccumulation() :
+	enabled(true),
+	samplesPerFrame(1),
+	maxSamples(4096),
+	frameIndex(0),
+	accumulatedSamples(0),
+	hasCamera(false),
+	lastView{},
+	lastProjection{}
+{
+}
+
+void ProgressiveAccumulation::SetEnabled(bool enabled)
+{
+	if (this->enabled != enabled)
+		Reset();
+	this->enabled = enabled;
+}
+
+bool ProgressiveAccumulation::GetEnabled() const { return enabled; }
+
+void ProgressiveAccumulation::SetSamplesPerFrame(unsigned int samples)
+{
+	samplesPerFrame = std::max(samples, 1u);
+}
+
+unsigned int ProgressiveAccumulation::GetSamplesPerFrame() const { return samplesPerFrame; }
+
+void ProgressiveAccumulation::SetMaxSamples(unsigned int samples)
+{
+	maxSamples = std::max(samples, 1u);
+}
+
+unsigned int ProgressiveAccumulation::GetMaxSamples() const { return maxSamples; }
+
+// --------------------------------------------------------
+// Throws away the history, so the next frame starts over
+// --------------------------------------------------------
+void ProgressiveAccumulation::Reset()
+{
+	frameIndex = 0;
+	accumulatedSamples = 0;
+}
+
+// --------------------------------------------------------
+// Starts over if the view or projection differ at all from
+// the last ones checked.  Exact comparisons are fine, since
+// an idle camera produces identical matrices.
+// --------------------------------------------------------
+void ProgressiveAccumulation::CheckCamera(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection)
+{
+	if (!hasCamera ||
+		memcmp(&view, &lastView, sizeof(DirectX::XMFLOAT4X4)) != 0 ||
+		memcmp(&projection, &lastProjection, sizeof(DirectX::XMFLOAT4X4)) != 0)
+	{
+		Reset();
+	}
+
+	lastView = view;
+	lastProjection = projection;
+	hasCamera = true;
+}
+
+// --------------------------------------------------------
+// Starts over if any entity moved (or entities were added
+// or removed) since the last check
+// --------------------------------------------------------
+void ProgressiveAccumulation::CheckWorldMatrices(const std::vector<SceneFloat4x4>& worldMatrices)
+{
+	if (worldMatrices.size() != lastWorldMatrices.size() ||
+		(!worldMatrices.empty() && memcmp(worldMatrices.data(), lastWorldMatrices.data(), sizeof(SceneFloat4x4) * worldMatrices.size()) != 0))
+	{
+		Reset();
+		lastWorldMatrices = worldMatrices;
+	}
+}
+
+// --------------------------------------------------------
+// Starts over if any light changed (or lights were added
+// or removed) since the last check
+// --------------------------------------------------------
+void ProgressiveAccumulation::CheckLights(const Light* lights, unsigned int lightCount)
+{
+	if (lightCount != lastLights.size() ||
+		(lightCount > 0 && memcmp(lights, lastLights.data(), sizeof(Light) * lightCount) != 0))
+	{
+		Reset();
+		lastLights.assign(lights, lights + lightCount);
+	}
+}
+
+// --------------------------------------------------------
+// Converged images don't need any more rays
+// --------------------------------------------------------
+bool ProgressiveAccumulation::IsConverged() const
+{
+	return enabled && accumulatedSamples >= maxSamples;
+}
+
+unsigned int ProgressiveAccumulation::GetFrameIndex() const { return enabled ? frameIndex : 0; }
+
+unsigned int ProgressiveAccumulation::GetFrameSampleCount() const
+{
+	if (!enabled)
+		return SamplesWithoutAccumulation;
+
+	// Don't overshoot the maximum
+	return std::min(samplesPerFrame, maxSamples - std::min(accumulatedSamples, maxSamples));
+}
+
+// --------------------------------------------------------
+// Call after the frame's samples have been traced (or
+// skipped, once converged)
+// --------------------------------------------------------
+void ProgressiveAccumulation::EndFrame()
+{
+	if (!enabled)
+	{
+		accumulatedSamples = SamplesWithoutAccumulation;
+		return;
+	}
+
+	if (IsConverged())
+		return;
+
+	accumulatedSamples += GetFrameSampleCount();
+	frameIndex++;
+}
+
+unsigned int ProgressiveAccumulation::GetAccumulatedSampleCount() const { return accumulatedSamples; }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Light.h"
+#include "SceneSimulation.h"
+
+// --------------------------------------------------------
+// Decides how many samples per pixel to trace each frame
+// and when the running average of earlier frames is still
+// valid.
+//
+// While accumulating, each frame traces a few samples and
+// the shader blends them into an accumulation buffer.  Any
+// change to the camera, an entity's transform or a light
+// (or an explicit Reset(), like after a resize) makes the
+// history invalid, so the next frame starts over.  Once enough
+// samples have been gathered the image is converged and
+// nothing more needs to be traced until something changes.
+//
+// With accumulation off, every frame traces a full set of
+// samples from scratch, as before.
+//
+// Nothing here knows about D3D12.
+// --------------------------------------------------------
+class ProgressiveAccumulation
+{
+public:
+	// Samples per pixel per frame when not accumulating
+	static constexpr unsigned int SamplesWithoutAccumulation = 25;
+
+	ProgressiveAccumulation();
+
+	// Settings
+	void SetEnabled(bool enabled);
+	bool GetEnabled() const;
+	void SetSamplesPerFrame(unsigned int samples);
+	unsigned int GetSamplesPerFrame() const;
+	void SetMaxSamples(unsigned int samples);
+	unsigned int GetMaxSamples() const;
+
+	// Change detection - compares against the previous frame
+	void Reset();
+	void CheckCamera(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
+	void CheckWorldMatrices(const std::vector<SceneFloat4x4>& worldMatrices);
+	void CheckLights(const Light* lights, unsigned int lightCount);
+
+	// Per frame
+	bool IsConverged() const;
+	unsigned int GetFrameIndex() const;			// Frames blended so far (0 means start over)
+	unsigned int GetFrameSampleCount() const;	// Samples to trace this frame
+	void EndFrame();
+
+	// Samples averaged into the current image
+	unsigned int GetAccumulatedSampleCount() const;
+
+private:
+	bool enabled;
+	unsigned int samplesPerFrame;
+	unsigned int maxSamples;
+
+	unsigned int frameIndex;
+	unsigned int accumulatedSamples;
+
+	bool hasCamera;
+	DirectX::XMFLOAT4X4 lastView;
+	DirectX::XMFLOAT4X4 lastProjection;
+	std::vector<SceneFloat4x4> lastWorldMatrices;
+	std::vector<Light> lastLights;
+};
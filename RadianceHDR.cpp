@@ -0,0 +1,206 @@
+#include "RadianceHDR.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+// Annonymous namespace to hold variables/helpers
+// only accessible in this file
+namespace
+{
+	// Rows per job when converting pixels
+	const unsigned int RowsPerJob = 16;
+
+	// --------------------------------------------------------
+	// RGBE is mantissa * 2^(e - 136) and the GPU format is
+	// mantissa * 2^(exponent - 24), so doubling the 8-bit
+	// mantissas gives exactly the same value with an exponent
+	// of e - 113.  Only values too bright or too dark for the
+	// GPU format's exponent need the general conversion.
+	// --------------------------------------------------------
+	bool RepackRGBE(const uint8_t* pixel, uint32_t* packed)
+	{
+		int exponent = (int)pixel[3] - 113;
+		if (pixel[3] == 0)
+		{
+			*packed = 0;
+			return true;
+		}
+		if (exponent < 0 || exponent > 31)
+			return false;
+
+		*packed = ((uint32_t)pixel[0] << 1) | ((uint32_t)pixel[1] << 10) | ((uint32_t)pixel[2] << 19) | ((uint32_t)exponent << 27);
+		return true;
+	}
+
+	bool Fail(std::string* error, const char* message)
+	{
+		if (error)
+			*error = message;
+		return false;
+	}
+
+	// --------------------------------------------------------
+	// One scanline, which is either flat RGBE pixels or run
+	// length encoded one channel at a time (with a 2, 2,
+	// width marker in front)
+	// --------------------------------------------------------
+	bool ReadScanline(const uint8_t*& data, const uint8_t* end, unsigned int width, uint8_t* row)
+	{
+		if (end - data < 4)
+			return false;
+
+		bool encoded = width >= 8 && width < 32768 &&
+			data[0] == 2 && data[1] == 2 && ((data[2] << 8) | data[3]) == (int)width;
+		if (!encoded)
+		{
+			if ((size_t)(end - data) < (size_t)width * 4)
+				return false;
+			memcpy(row, data, (size_t)width * 4);
+			data += (size_t)width * 4;
+			return true;
+		}
+
+		data += 4;
+		for (unsigned int channel = 0; channel < 4; channel++)
+		{
+			unsigned int x = 0;
+			while (x < width)
+			{
+				if (data >= end)
+					return false;
+
+				// Above 128 is a run of one value, otherwise that many values
+				unsigned int count = *data++;
+				bool run = count > 128;
+				if (run)
+					count -= 128;
+				if (count == 0 || x + count > width || (end - data) < (run ? 1 : (ptrdiff_t)count))
+					return false;
+
+				for (unsigned int i = 0; i < count; i++)
+					row[(x + i) * 4 + channel] = run ? data[0] : data[i];
+				data += run ? 1 : count;
+				x += count;
+			}
+		}
+		return true;
+	}
+}
+
+bool RadianceHDR::Load(const std::wstring& file, Image& image, std::string* error)
+{
+	std::ifstream stream(std::filesystem::path(file), std::ios::binary);
+	if (!stream)
+		return Fail(error, "Could not open file");
+
+	stream.seekg(0, std::ios::end);
+	std::vector<uint8_t> contents((size_t)stream.tellg());
+	stream.seekg(0, std::ios::beg);
+	stream.read((char*)contents.data(), contents.size());
+	const uint8_t* data = contents.data();
+	const uint8_t* end = data + contents.size();
+
+	// Header lines, up to a blank line
+	auto readLine = [&](std::string& line)
+		{
+			line.clear();
+			while (data < end && *data != '\n')
+				line += (char)*data++;
+			if (data >= end)
+				return false;
+			data++;
+			return true;
+		};
+
+	std::string line;
+	if (!readLine(line) || (line.rfind("#?RADIANCE", 0) != 0 && line.rfind("#?RGBE", 0) != 0))
+		return Fail(error, "Not a Radiance HDR file");
+
+	bool rgbe = false;
+	while (readLine(line) && !line.empty())
+	{
+		if (line.rfind("FORMAT=", 0) == 0)
+			rgbe = line == "FORMAT=32-bit_rle_rgbe";
+	}
+	if (!rgbe)
+		return Fail(error, "Only RGBE pixels are supported");
+
+	// Resolution, top to bottom and left to right
+	std::string yAxis, xAxis;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	if (!readLine(line))
+		return Fail(error, "Missing resolution");
+	std::istringstream size(line);
+	if (!(size >> yAxis >> height >> xAxis >> width) || yAxis != "-Y" || xAxis != "+X" || width == 0 || height == 0)
+		return Fail(error, "Only -Y height +X width images are supported");
+
+	image.Width = width;
+	image.Height = height;
+	image.RGBE.resize((size_t)width * height * 4);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		if (!ReadScanline(data, end, width, &image.RGBE[(size_t)y * width * 4]))
+			return Fail(error, "Pixel data is cut short or corrupt");
+	}
+	return true;
+}
+
+RadianceHDR::Color RadianceHDR::Decode(const Image& image, unsigned int x, unsigned int y)
+{
+	const uint8_t* pixel = &image.RGBE[((size_t)y * image.Width + x) * 4];
+	if (pixel[3] == 0)
+		return Color{};
+
+	float scale = std::ldexp(1.0f, (int)pixel[3] - (128 + 8));
+	return Color{ pixel[0] * scale, pixel[1] * scale, pixel[2] * scale };
+}
+
+// --------------------------------------------------------
+// Follows the conversion in the D3D specs: 9-bit mantissas
+// without an implicit leading one, and a 5-bit exponent
+// with a bias of 15
+// --------------------------------------------------------
+uint32_t RadianceHDR::PackSharedExponent(const Color& color)
+{
+	const float MaxValue = 511.0f / 512.0f * 65536.0f;
+	float r = std::clamp(color.R, 0.0f, MaxValue);
+	float g = std::clamp(color.G, 0.0f, MaxValue);
+	float b = std::clamp(color.B, 0.0f, MaxValue);
+	float largest = std::max(r, std::max(g, b));
+
+	int exponent = largest > 0 ? std::max(-16, (int)std::floor(std::log2(largest))) + 16 : 0;
+	float denominator = std::ldexp(1.0f, exponent - 15 - 9);
+	if ((int)std::floor(largest / denominator + 0.5f) == 512)
+	{
+		denominator *= 2;
+		exponent++;
+	}
+
+	uint32_t red = (uint32_t)std::floor(r / denominator + 0.5f);
+	uint32_t green = (uint32_t)std::floor(g / denominator + 0.5f);
+	uint32_t blue = (uint32_t)std::floor(b / denominator + 0.5f);
+	return red | (green << 9) | (blue << 18) | ((uint32_t)exponent << 27);
+}
+
+void RadianceHDR::ConvertToSharedExponent(const Image& image, std::vector<uint32_t>& pixels)
+{
+	pixels.resize((size_t)image.Width * image.Height);
+	JobSystem::ParallelFor(image.Height, RowsPerJob, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int y = begin; y < end; y++)
+			{
+				for (unsigned int x = 0; x < image.Width; x++)
+				{
+					size_t index = (size_t)y * image.Width + x;
+					if (!RepackRGBE(&image.RGBE[index * 4], &pixels[index]))
+						pixels[index] = PackSharedExponent(Decode(image, x, y));
+				}
+			}
+		});
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Reads Radiance .hdr images (the usual format for HDR
+// environment maps), keeping the pixels in their packed
+// RGBE form: 8-bit red, green and blue mantissas sharing
+// one 8-bit exponent.  That's a quarter the size of
+// floats, which matters at 8K.
+//
+// Both run-length encoded and flat scanlines are read, in
+// the standard top-to-bottom orientation.
+//
+// Nothing here knows about D3D12.
+// --------------------------------------------------------
+namespace RadianceHDR
+{
+	struct Image
+	{
+		unsigned int Width = 0;
+		unsigned int Height = 0;
+		std::vector<uint8_t> RGBE;		// 4 bytes per pixel, row by row
+	};
+
+	// Plain color, so this doesn't depend on DirectXMath
+	struct Color
+	{
+		float R = 0;
+		float G = 0;
+		float B = 0;
+	};
+
+	// False (with a message in error) if the file can't be read
+	bool Load(const std::wstring& file, Image& image, std::string* error = 0);
+
+	Color Decode(const Image& image, unsigned int x, unsigned int y);
+
+	// DXGI_FORMAT_R9G9B9E5_SHAREDEXP, which the GPU can filter
+	// directly and is the same size as RGBE
+	uint32_t PackSharedExponent(const Color& color);
+	void ConvertToSharedExponent(const Image& image, std::vector<uint32_t>& pixels);
+}
@@ -1,8 +1,20 @@
 #include "RayTracing.h"
 #include "Graphics.h"
+#include "GPUMemory.h"
+#include "GPUProfiler.h"
+#include "Trace.h"
+#include "JobSystem.h"
 #include "BufferStructs.h"
 #include "Window.h"
-
+#include "BlueNoise.h"
+#include "LightTree.h"
+#include "RadianceHDR.h"
+#include "EnvironmentDistribution.h"
+#include "Denoiser.h"
+#include "CommandListPool.h"
+
+#include <algorithm>
+#include <mutex>
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 
@@ -23,7 +35,97 @@ namespace RayTracing
 		// in the event they need to be resized later
 		UINT64 tlasBufferSizeInBytes = 0;
 		UINT64 tlasScratchSizeInBytes = 0;
-		UINT64 tlasInstanceDataSizeInBytes = 0;
+
+		// The CPU rewrites the instance descriptions and the hit group
+		// records every frame, so each frame in flight gets its own
+		// instance buffer and its own section of the shader table
+		Microsoft::WRL::ComPtr<ID3D12Resource> tlasInstanceDescBuffers[Graphics::MaxFramesInFlight];
+		UINT64 tlasInstanceDataSizesInBytes[Graphics::MaxFramesInFlight]{};
+		UINT64 shaderTableSectionSize = 0;
+
+		// Each instance's world matrix from last frame (3x4, like the instance
+		// descriptions) for the motion vectors, one buffer per frame in flight
+		Microsoft::WRL::ComPtr<ID3D12Resource> previousTransformBuffers[Graphics::MaxFramesInFlight];
+		UINT64 previousTransformSizesInBytes[Graphics::MaxFramesInFlight]{};
+
+		// Last frame's camera, also for the motion vectors
+		DirectX::XMFLOAT4X4 previousViewProjection;
+		DirectX::XMFLOAT3 previousCameraPosition;
+		bool previousCameraValid = false;
+
+		// Light tree over the scene's point and spot lights, and a buffer per
+		// frame in flight holding its nodes followed by the (reordered) lights
+		LightTree lightTree;
+		std::vector<LightTreeLight> treeLights;
+		std::vector<Light> orderedLights;
+		Microsoft::WRL::ComPtr<ID3D12Resource> lightBuffers[Graphics::MaxFramesInFlight];
+		UINT64 lightBufferSizesInBytes[Graphics::MaxFramesInFlight]{};
+
+		// The HDR sky's place in the bindless table, and the size of
+		// its sampling distribution
+		unsigned int environmentMapIndex = (unsigned int)-1;
+		unsigned int environmentWidth = 0;
+		unsigned int environmentHeight = 0;
+
+		// Miss shaders in the shader table: regular rays, then shadow rays
+		const unsigned int MissShaderCount = 2;
+
+		// Entities per job when filling in instance descriptions
+		const unsigned int InstanceDescsPerJob = 64;
+
+		// Sizes of all acceleration structures, before and after compaction
+		AccelerationStructureMemory accelStructMemory;
+
+		// Where the GPU reports each BLAS's compacted size (one slot
+		// per hit group), and where we copy them so the CPU can read
+		// them back
+		Microsoft::WRL::ComPtr<ID3D12Resource> blasCompactedSizeBuffer;
+		Microsoft::WRL::ComPtr<ID3D12Resource> blasCompactedSizeReadback;
+
+		// BLAS builds still waiting to be compacted
+		struct UncompactedBLAS
+		{
+			unsigned int HitGroupIndex;
+			unsigned int MemoryIndex;
+		};
+		std::vector<UncompactedBLAS> uncompactedBLAS;
+
+		// BLAS builds may be recorded on several threads at once, so
+		// the BLAS count, descriptor slots, memory tracking and the
+		// list above are behind this
+		std::mutex blasMutex;
+
+		// This frame's instances, kept until the job uploading them is done
+		std::vector<D3D12_RAYTRACING_INSTANCE_DESC> instanceDescs;
+		std::vector<DirectX::XMFLOAT3X4> previousTransforms;
+
+		// Passes recorded on other threads this frame
+		JobSystem::JobCounter recordingJobs;
+
+		// One set of UAV slots (output, accumulation, moments, G-buffer, motion) per in-flight frame,
+		// so recreating the outputs never overwrites descriptors the GPU might still be reading
+		D3D12_CPU_DESCRIPTOR_HANDLE outputUAVSlots_CPU[Graphics::MaxFramesInFlight]{};
+		D3D12_GPU_DESCRIPTOR_HANDLE outputUAVSlots_GPU[Graphics::MaxFramesInFlight]{};
+		D3D12_CPU_DESCRIPTOR_HANDLE accumulationUAVSlots_CPU[Graphics::MaxFramesInFlight]{};
+		D3D12_CPU_DESCRIPTOR_HANDLE momentsUAVSlots_CPU[Graphics::MaxFramesInFlight]{};
+		D3D12_CPU_DESCRIPTOR_HANDLE normalDepthUAVSlots_CPU[Graphics::MaxFramesInFlight]{};
+		D3D12_CPU_DESCRIPTOR_HANDLE albedoUAVSlots_CPU[Graphics::MaxFramesInFlight]{};
+		D3D12_CPU_DESCRIPTOR_HANDLE motionVectorsUAVSlots_CPU[Graphics::MaxFramesInFlight]{};
+		unsigned int outputUAVSlotIndex = 0;
+
+		// Where the shader counts active pixels (for adaptive sampling),
+		// samples and rays traced, and a copy per frame in flight for the
+		// CPU.  Each copy remembers which accumulation run it belongs to,
+		// since active pixels from before the last restart say nothing
+		// about now.
+		const unsigned int PathCounterCount = 3;
+		PathTracingStats pathStats;
+		PathTracingStats totalPathStats;
+		Microsoft::WRL::ComPtr<ID3D12Resource> pathCounters;
+		Microsoft::WRL::ComPtr<ID3D12Resource> pathCountersReadback;
+		bool pathCountersPending[Graphics::MaxFramesInFlight]{};
+		unsigned int pathCountersRun[Graphics::MaxFramesInFlight]{};
+		unsigned int accumulationRun = 0;
 
 		// Error messages
 		const char* errorRaytracingNotSupported = "\nERROR: Raytracing not supported by the current graphics device.\n(On laptops, this may be due to battery saver mode.)\n";
@@ -71,6 +173,40 @@ HRESULT RayTracing::Initialize(
 	CreateShaderTable();
 	CreateRaytracingOutputUAV(outputWidth, outputHeight);
 
+	// Counters for adaptive sampling and stats, which start out zeroed each frame
+	pathCounters = Graphics::CreateBuffer(
+		sizeof(UINT) * PathCounterCount,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+	pathCountersReadback = Graphics::CreateBuffer(
+		sizeof(UINT) * PathCounterCount * Graphics::MaxFramesInFlight,
+		D3D12_HEAP_TYPE_READBACK,
+		D3D12_RESOURCE_STATE_COPY_DEST);
+
+	// Blue noise offsets for the random numbers, which never change
+	// and are tiny, so they're simply read from an upload buffer
+	{
+		std::vector<float> blueNoise = BlueNoise::RanksToOffsets(
+			BlueNoise::GenerateTile(BlueNoise::TileSize, 0));
+		BlueNoiseBuffer = Graphics::CreateBuffer(
+			sizeof(float) * blueNoise.size(),
+			D3D12_HEAP_TYPE_UPLOAD,
+			D3D12_RESOURCE_STATE_GENERIC_READ);
+
+		void* blueNoiseAddress = 0;
+		BlueNoiseBuffer->Map(0, 0, &blueNoiseAddress);
+		memcpy(blueNoiseAddress, blueNoise.data(), sizeof(float) * blueNoise.size());
+		BlueNoiseBuffer->Unmap(0, 0);
+	}
+
+	// Something for the environment CDF's root SRV to point at
+	// until an environment map is loaded
+	EnvironmentCDFBuffer = Graphics::CreateBuffer(
+		sizeof(float),
+		D3D12_HEAP_TYPE_UPLOAD,
+		D3D12_RESOURCE_STATE_GENERIC_READ);
+
 	// All set
 	dxrInitialized = true;
 	return S_OK;
@@ -90,22 +226,22 @@ void RayTracing::CreateRaytracingRootSignatures()
 
 	// Create a global root signature shared across all raytracing shaders
 	{
-		// Two descriptor ranges
-		// 1: The output texture, which is an unordered access view (UAV)
-		// 2: Two separate SRVs, which are the index and vertex data of the geometry
-		D3D12_DESCRIPTOR_RANGE outputUAVRange = {};
-		outputUAVRange.BaseShaderRegister = 0;
-		outputUAVRange.NumDescriptors = 1;
-		outputUAVRange.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
-		outputUAVRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
-		outputUAVRange.RegisterSpace = 0;
-
-		D3D12_DESCRIPTOR_RANGE cbufferRange = {};
-		cbufferRange.BaseShaderRegister = 0;
-		cbufferRange.NumDescriptors = 1;
-		cbufferRange.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
-		cbufferRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
-		cbufferRange.RegisterSpace = 0;
+		// Three descriptor ranges
+		// 1: The output, accumulation and moments textures, which are unordered access views (UAVs),
+		//    then the G-buffer and motion vector textures in the same table (after the root UAV's register)
+		// 2: All textures, for bindless access
+		// (The scene constant buffer is a root CBV, so it needs no range)
+		D3D12_DESCRIPTOR_RANGE outputUAVRanges[2] = {};
+		outputUAVRanges[0].BaseShaderRegister = 0;
+		outputUAVRanges[0].NumDescriptors = 3;
+		outputUAVRanges[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+		outputUAVRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+		outputUAVRanges[0].RegisterSpace = 0;
+		outputUAVRanges[1].BaseShaderRegister = 4;
+		outputUAVRanges[1].NumDescriptors = 3;
+		outputUAVRanges[1].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+		outputUAVRanges[1].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+		outputUAVRanges[1].RegisterSpace = 0;
 
 		// A single range (table) for ALL texture2Ds
 		D3D12_DESCRIPTOR_RANGE texture2DRange{};
@@ -115,15 +251,15 @@ void RayTracing::CreateRaytracingRootSignatures()
 		texture2DRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
 		texture2DRange.RegisterSpace = 1;
 
-		// Set up the root parameters for the global signature (of which there are four)
+		// Set up the root parameters for the global signature (of which there are ten)
 		// These need to match the shader(s) we'll be using
-		D3D12_ROOT_PARAMETER rootParams[4] = {};
+		D3D12_ROOT_PARAMETER rootParams[10] = {};
 		{
-			// First param is the UAV range for the output texture
+			// First param is the UAV ranges for the output, accumulation, moments, G-buffer and motion vector textures
 			rootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
 			rootParams[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
-			rootParams[0].DescriptorTable.NumDescriptorRanges = 1;
-			rootParams[0].DescriptorTable.pDescriptorRanges = &outputUAVRange;
+			rootParams[0].DescriptorTable.NumDescriptorRanges = ARRAYSIZE(outputUAVRanges);
+			rootParams[0].DescriptorTable.pDescriptorRanges = outputUAVRanges;
 
 			// Second param is an SRV for the acceleration structure
 			rootParams[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
@@ -132,16 +268,53 @@ void RayTracing::CreateRaytracingRootSignatures()
 			rootParams[1].Descriptor.RegisterSpace = 0;
 
 			// Third is constant buffer for the overall scene (camera matrices, lights, etc.)
-			rootParams[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+			// - This is a root CBV, so no descriptor needs to be created each frame
+			rootParams[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
 			rootParams[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
-			rootParams[2].DescriptorTable.NumDescriptorRanges = 1;
-			rootParams[2].DescriptorTable.pDescriptorRanges = &cbufferRange;
+			rootParams[2].Descriptor.ShaderRegister = 0;
+			rootParams[2].Descriptor.RegisterSpace = 0;
 
 			// For Texture2Ds
 			rootParams[3].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
 			rootParams[3].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
 			rootParams[3].DescriptorTable.NumDescriptorRanges = 1;
 			rootParams[3].DescriptorTable.pDescriptorRanges = &texture2DRange;
+
+			// Adaptive sampling counters, as a root UAV
+			rootParams[4].ParameterType = D3D12_ROOT_PARAMETER_TYPE_UAV;
+			rootParams[4].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+			rootParams[4].Descriptor.ShaderRegister = 3;
+			rootParams[4].Descriptor.RegisterSpace = 0;
+
+			// Blue noise tile, as a root SRV
+			rootParams[5].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+			rootParams[5].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+			rootParams[5].Descriptor.ShaderRegister = 3;
+			rootParams[5].Descriptor.RegisterSpace = 0;
+
+			// Lights, as a root SRV
+			rootParams[6].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+			rootParams[6].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+			rootParams[6].Descriptor.ShaderRegister = 4;
+			rootParams[6].Descriptor.RegisterSpace = 0;
+
+			// Light tree nodes, as a root SRV
+			rootParams[7].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+			rootParams[7].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+			rootParams[7].Descriptor.ShaderRegister = 5;
+			rootParams[7].Descriptor.RegisterSpace = 0;
+
+			// Environment map sampling CDFs, as a root SRV
+			rootParams[8].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+			rootParams[8].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+			rootParams[8].Descriptor.ShaderRegister = 6;
+			rootParams[8].Descriptor.RegisterSpace = 0;
+
+			// Last frame's instance transforms, as a root SRV
+			rootParams[9].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+			rootParams[9].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+			rootParams[9].Descriptor.ShaderRegister = 7;
+			rootParams[9].Descriptor.RegisterSpace = 0;
 		}
 
 		// Create a single static sampler (available to all shaders at the same slot)
@@ -180,15 +353,8 @@ void RayTracing::CreateRaytracingRootSignatures()
 		geometrySRVRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
 		geometrySRVRange.RegisterSpace = 0;
 
-		// cbuffer for hit group data
-		D3D12_DESCRIPTOR_RANGE cbufferRange = {};
-		cbufferRange.BaseShaderRegister = 1;
-		cbufferRange.NumDescriptors = 1;
-		cbufferRange.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
-		cbufferRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
-		cbufferRange.RegisterSpace = 0;
-
-		// One parameter: Descriptor table housing the index and vertex buffer descriptors
+		// Two parameters: Descriptor table housing the index and vertex buffer descriptors,
+		// and a root CBV for the hit group's entity data
 		D3D12_ROOT_PARAMETER rootParams[2] = {};
 
 		// Range of SRVs for geometry (verts & indices)
@@ -197,11 +363,12 @@ void RayTracing::CreateRaytracingRootSignatures()
 		rootParams[0].DescriptorTable.NumDescriptorRanges = 1;
 		rootParams[0].DescriptorTable.pDescriptorRanges = &geometrySRVRange;
 
-		// Range of SRVs for geometry (verts & indices)
-		rootParams[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+		// Local root CBV for hit group data at register(b1)
+		// - The shader table record holds its GPU virtual address directly
+		rootParams[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
 		rootParams[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
-		rootParams[1].DescriptorTable.NumDescriptorRanges = 1;
-		rootParams[1].DescriptorTable.pDescriptorRanges = &cbufferRange;
+		rootParams[1].Descriptor.ShaderRegister = 1;
+		rootParams[1].Descriptor.RegisterSpace = 0;
 
 		// Create the local root sig (ensure we denote it as a local sig)
 		Microsoft::WRL::ComPtr<ID3DBlob> blob;
@@ -235,7 +402,7 @@ void RayTracing::CreateRaytracingPipelineState(std::wstring raytracingShaderLibr
 
 	// There are ten subobjects that make up our raytracing pipeline object:
 	// - Ray generation shader
-	// - Miss shader
+	// - Miss shaders (regular and shadow)
 	// - Closest hit shader
 	// - Hit group (group of all "hit"-type shaders, which is just "closest hit" for us)
 	// - Payload configuration
@@ -263,16 +430,18 @@ void RayTracing::CreateRaytracingPipelineState(std::wstring raytracingShaderLibr
 
 	subobjects[0] = rayGenSubObj;
 
-	// === Miss shader ===
-	D3D12_EXPORT_DESC missExportDesc = {};
-	missExportDesc.Name = L"Miss";
-	missExportDesc.Flags = D3D12_EXPORT_FLAG_NONE;
+	// === Miss shaders ===
+	D3D12_EXPORT_DESC missExportDescs[2] = {};
+	missExportDescs[0].Name = L"Miss";
+	missExportDescs[0].Flags = D3D12_EXPORT_FLAG_NONE;
+	missExportDescs[1].Name = L"ShadowMiss";
+	missExportDescs[1].Flags = D3D12_EXPORT_FLAG_NONE;
 
 	D3D12_DXIL_LIBRARY_DESC	missLibDesc = {};
 	missLibDesc.DXILLibrary.BytecodeLength = blob->GetBufferSize();
 	missLibDesc.DXILLibrary.pShaderBytecode = blob->GetBufferPointer();
-	missLibDesc.NumExports = 1;
-	missLibDesc.pExports = &missExportDesc;
+	missLibDesc.NumExports = ARRAYSIZE(missExportDescs);
+	missLibDesc.pExports = missExportDescs;
 
 	D3D12_STATE_SUBOBJECT missSubObj = {};
 	missSubObj.Type = D3D12_STATE_SUBOBJECT_TYPE_DXIL_LIBRARY;
@@ -311,7 +480,7 @@ void RayTracing::CreateRaytracingPipelineState(std::wstring raytracingShaderLibr
 
 	// === Shader config (payload) ===
 	D3D12_RAYTRACING_SHADER_CONFIG shaderConfigDesc = {};
-	shaderConfigDesc.MaxPayloadSizeInBytes = sizeof(DirectX::XMFLOAT3) + sizeof(unsigned int) * 2;	// Assuming a float3 color for now
+	shaderConfigDesc.MaxPayloadSizeInBytes = sizeof(DirectX::XMFLOAT3) * 3 + sizeof(float) * 3;	// Surface color, roughness, normal, metal, hit distance and previous position
 	shaderConfigDesc.MaxAttributeSizeInBytes = sizeof(DirectX::XMFLOAT2); // Assuming a float2 for barycentric coords for now
 
 	D3D12_STATE_SUBOBJECT shaderConfigSubObj = {};
@@ -321,8 +490,8 @@ void RayTracing::CreateRaytracingPipelineState(std::wstring raytracingShaderLibr
 	subobjects[4] = shaderConfigSubObj;
 
 	// === Association - Payload and shaders ===
-	// Names of shaders that use the payload
-	const wchar_t* payloadShaderNames[] = { L"RayGen", L"Miss", L"HitGroup" };
+	// Names of shaders that use the payload (the shadow payload is smaller, so it fits too)
+	const wchar_t* payloadShaderNames[] = { L"RayGen", L"Miss", L"ShadowMiss", L"HitGroup" };
 
 	D3D12_SUBOBJECT_TO_EXPORTS_ASSOCIATION shaderPayloadAssociation = {};
 	shaderPayloadAssociation.NumExports = ARRAYSIZE(payloadShaderNames);
@@ -344,7 +513,7 @@ void RayTracing::CreateRaytracingPipelineState(std::wstring raytracingShaderLibr
 
 	// === Association - Shaders and local root sig ===
 	// Names of shaders that use the root sig
-	const wchar_t* rootSigShaderNames[] = { L"RayGen", L"Miss", L"HitGroup" };
+	const wchar_t* rootSigShaderNames[] = { L"RayGen", L"Miss", L"ShadowMiss", L"HitGroup" };
 
 	// Add a state subobject for the association between the RayGen shader and the local root signature
 	D3D12_SUBOBJECT_TO_EXPORTS_ASSOCIATION rootSigAssociation = {};
@@ -368,7 +537,7 @@ void RayTracing::CreateRaytracingPipelineState(std::wstring raytracingShaderLibr
 	// === Pipeline config ===
 	// Add a state subobject for the ray tracing pipeline config
 	D3D12_RAYTRACING_PIPELINE_CONFIG pipelineConfig = {};
-	pipelineConfig.MaxTraceRecursionDepth = D3D12_RAYTRACING_MAX_DECLARABLE_TRACE_RECURSION_DEPTH;
+	pipelineConfig.MaxTraceRecursionDepth = 1; // Only RayGen traces rays, so there's no recursion
 
 	D3D12_STATE_SUBOBJECT pipelineConfigSubObj = {};
 	pipelineConfigSubObj.Type = D3D12_STATE_SUBOBJECT_TYPE_RAYTRACING_PIPELINE_CONFIG;
@@ -403,14 +572,15 @@ void RayTracing::CreateShaderTable()
 	// Create the table of shaders and their data to use for rays
 	// 0 - Ray generation shader
 	// 1 - Miss shader
-	// 2 - Closest hit shader
+	// 2 - Shadow miss shader
+	// 3 - Closest hit shader
 	// Note: All records must have the same size, so we need to calculate
 	//       the size of the largest possible entry for our program
-	//       - This will be the default (32) + one descriptor table pointer (8)
+	//       - This will be the default (32) + one descriptor table pointer (8) + one root CBV address (8)
 	//       - This also must be aligned up to D3D12_RAYTRACING_SHADER_BINDING_TABLE_RECORD_BYTE_ALIGNMENT
 	UINT64 shaderTableRayGenRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
 	UINT64 shaderTableMissRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
-	UINT64 shaderTableHitGroupRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + sizeof(D3D12_GPU_DESCRIPTOR_HANDLE) * 2; // CBV & SRV
+	UINT64 shaderTableHitGroupRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + sizeof(D3D12_GPU_DESCRIPTOR_HANDLE) + sizeof(D3D12_GPU_VIRTUAL_ADDRESS); // SRV table & CBV
 
 	// Align them
 	shaderTableRayGenRecordSize = ALIGN(shaderTableRayGenRecordSize, D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT);
@@ -423,31 +593,42 @@ void RayTracing::CreateShaderTable()
 	// How big should the table be?
 	UINT64 shaderTableSize = 0;
 	shaderTableSize += ShaderTableRecordSize; // One ray gen shader
-	shaderTableSize += ShaderTableRecordSize; // One miss shader
+	shaderTableSize += ShaderTableRecordSize * MissShaderCount; // Regular and shadow miss shaders
 	shaderTableSize += ShaderTableRecordSize * MaxHitGroupsInShaderTable;
 	shaderTableSize =
 		ALIGN(shaderTableSize, D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
 
+	// Each frame in flight gets a full copy of the table
+	shaderTableSectionSize = shaderTableSize;
+
 	// Create the shader table buffer and map it so we can write to it
-	ShaderTable = Graphics::CreateBuffer(shaderTableSize, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
-	unsigned char* shaderTableData = 0;
-	ShaderTable->Map(0, 0, (void**)&shaderTableData);
+	ShaderTable = Graphics::CreateBuffer(shaderTableSectionSize * Graphics::MaxFramesInFlight, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+	unsigned char* shaderTableStart = 0;
+	ShaderTable->Map(0, 0, (void**)&shaderTableStart);
 
-	// Mem copy each record in: ray gen, miss and the overall hit group (from CreateRaytracingPipelineState() above)
-	memcpy(shaderTableData, RaytracingPipelineProperties->GetShaderIdentifier(L"RayGen"), D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
-	shaderTableData += ShaderTableRecordSize;
+	for (unsigned int frame = 0; frame < Graphics::MaxFramesInFlight; frame++)
+	{
+		unsigned char* shaderTableData = shaderTableStart + shaderTableSectionSize * frame;
 
-	memcpy(shaderTableData, RaytracingPipelineProperties->GetShaderIdentifier(L"Miss"), D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
-	shaderTableData += ShaderTableRecordSize;
+		// Mem copy each record in: ray gen, miss and the overall hit group (from CreateRaytracingPipelineState() above)
+		memcpy(shaderTableData, RaytracingPipelineProperties->GetShaderIdentifier(L"RayGen"), D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+		shaderTableData += ShaderTableRecordSize;
 
-	// Make sure each hit group also has the proper identifier
-	for (unsigned int i = 0; i < MaxHitGroupsInShaderTable; i++)
-	{
-		memcpy(
-			shaderTableData,
-			RaytracingPipelineProperties->GetShaderIdentifier(L"HitGroup"),
-			D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+		memcpy(shaderTableData, RaytracingPipelineProperties->GetShaderIdentifier(L"Miss"), D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+		shaderTableData += ShaderTableRecordSize;
+
+		memcpy(shaderTableData, RaytracingPipelineProperties->GetShaderIdentifier(L"ShadowMiss"), D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
 		shaderTableData += ShaderTableRecordSize;
+
+		// Make sure each hit group also has the proper identifier
+		for (unsigned int i = 0; i < MaxHitGroupsInShaderTable; i++)
+		{
+			memcpy(
+				shaderTableData,
+				RaytracingPipelineProperties->GetShaderIdentifier(L"HitGroup"),
+				D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+			shaderTableData += ShaderTableRecordSize;
+		}
 	}
 
 	// We'll eventually need to memcpy per-object data to the shader table, but we don't have that yet
@@ -465,14 +646,6 @@ void RayTracing::CreateShaderTable()
 // --------------------------------------------------------
 void RayTracing::CreateRaytracingOutputUAV(unsigned int width, unsigned int height)
 {
-	// Default heap for output buffer
-	D3D12_HEAP_PROPERTIES heapDesc = {};
-	heapDesc.Type = D3D12_HEAP_TYPE_DEFAULT;
-	heapDesc.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-	heapDesc.CreationNodeMask = 0;
-	heapDesc.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-	heapDesc.VisibleNodeMask = 0;
-
 	// Describe the final output resource (UAV)
 	D3D12_RESOURCE_DESC desc = {};
 	desc.DepthOrArraySize = 1;
@@ -486,24 +659,96 @@ void RayTracing::CreateRaytracingOutputUAV(unsigned int width, unsigned int heig
 	desc.SampleDesc.Count = 1;
 	desc.SampleDesc.Quality = 0;
 
-	DXRDevice->CreateCommittedResource(
-		&heapDesc,
-		D3D12_HEAP_FLAG_NONE,
-		&desc,
-		D3D12_RESOURCE_STATE_COPY_SOURCE,
-		0,
-		IID_PPV_ARGS(RaytracingOutput.GetAddressOf()));
+	// Frames in flight may still be writing to the old output
+	Graphics::ReleaseWhenFrameCompletes(RaytracingOutput);
+	RaytracingOutput = GPUMemory::CreatePlacedResource(
+		desc,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_COPY_SOURCE);
+
+	// The accumulation buffer needs more precision than the output, since
+	// it holds the average of many samples (and the sample count in alpha)
+	desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	Graphics::ReleaseWhenFrameCompletes(RaytracingAccumulation);
+	RaytracingAccumulation = GPUMemory::CreatePlacedResource(
+		desc,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	// Luminance moments for adaptive sampling only need two channels
+	desc.Format = DXGI_FORMAT_R32G32_FLOAT;
+	Graphics::ReleaseWhenFrameCompletes(RaytracingLuminanceMoments);
+	RaytracingLuminanceMoments = GPUMemory::CreatePlacedResource(
+		desc,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
-	// Do we have a UAV alrady?
-	if (!RaytracingOutputUAV_GPU.ptr)
+	// The denoiser's G-buffer only guides the filter, so half floats will do
+	desc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	Graphics::ReleaseWhenFrameCompletes(RaytracingNormalDepth);
+	RaytracingNormalDepth = GPUMemory::CreatePlacedResource(
+		desc,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	Graphics::ReleaseWhenFrameCompletes(RaytracingAlbedo);
+	RaytracingAlbedo = GPUMemory::CreatePlacedResource(
+		desc,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	// As are the motion vectors, which are only ever a frame's worth of movement
+	Graphics::ReleaseWhenFrameCompletes(RaytracingMotionVectors);
+	RaytracingMotionVectors = GPUMemory::CreatePlacedResource(
+		desc,
+		D3D12_HEAP_TYPE_DEFAULT,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	// Whatever was accumulated is gone
+	Accumulation.Reset();
+	AdaptiveSampling.SetPixelCount((uint64_t)width * height);
+
+	// Do we have UAV slots already?
+	if (!outputUAVSlots_GPU[0].ptr)
 	{
-		// Nope, so reserve a spot
-		Graphics::ReserveDescriptorHeapSlot(
-			&RaytracingOutputUAV_CPU,
-			&RaytracingOutputUAV_GPU);
+		// Nope, so reserve them - each set must be
+		// consecutive, since they're bound as one table
+		for (unsigned int i = 0; i < Graphics::MaxFramesInFlight; i++)
+		{
+			Graphics::ReserveDescriptorHeapSlot(
+				&outputUAVSlots_CPU[i],
+				&outputUAVSlots_GPU[i]);
+			Graphics::ReserveDescriptorHeapSlot(
+				&accumulationUAVSlots_CPU[i],
+				0);
+			Graphics::ReserveDescriptorHeapSlot(
+				&momentsUAVSlots_CPU[i],
+				0);
+			Graphics::ReserveDescriptorHeapSlot(
+				&normalDepthUAVSlots_CPU[i],
+				0);
+			Graphics::ReserveDescriptorHeapSlot(
+				&albedoUAVSlots_CPU[i],
+				0);
+			Graphics::ReserveDescriptorHeapSlot(
+				&motionVectorsUAVSlots_CPU[i],
+				0);
+		}
 	}
-
-	// Set up the UAV
+	else
+	{
+		// Move on to the next slot, which by the time we've
+		// cycled through all of them is no longer in use
+		outputUAVSlotIndex = (outputUAVSlotIndex + 1) % Graphics::MaxFramesInFlight;
+	}
+	RaytracingOutputUAV_CPU = outputUAVSlots_CPU[outputUAVSlotIndex];
+	RaytracingOutputUAV_GPU = outputUAVSlots_GPU[outputUAVSlotIndex];
+	RaytracingAccumulationUAV_CPU = accumulationUAVSlots_CPU[outputUAVSlotIndex];
+	RaytracingLuminanceMomentsUAV_CPU = momentsUAVSlots_CPU[outputUAVSlotIndex];
+	RaytracingNormalDepthUAV_CPU = normalDepthUAVSlots_CPU[outputUAVSlotIndex];
+	RaytracingAlbedoUAV_CPU = albedoUAVSlots_CPU[outputUAVSlotIndex];
+	RaytracingMotionVectorsUAV_CPU = motionVectorsUAVSlots_CPU[outputUAVSlotIndex];
+
+	// Set up the UAVs
 	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
 	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
 
@@ -512,6 +757,45 @@ void RayTracing::CreateRaytracingOutputUAV(unsigned int width, unsigned int heig
 		0,
 		&uavDesc,
 		RaytracingOutputUAV_CPU);
+
+	DXRDevice->CreateUnorderedAccessView(
+		RaytracingAccumulation.Get(),
+		0,
+		&uavDesc,
+		RaytracingAccumulationUAV_CPU);
+
+	DXRDevice->CreateUnorderedAccessView(
+		RaytracingLuminanceMoments.Get(),
+		0,
+		&uavDesc,
+		RaytracingLuminanceMomentsUAV_CPU);
+
+	DXRDevice->CreateUnorderedAccessView(
+		RaytracingNormalDepth.Get(),
+		0,
+		&uavDesc,
+		RaytracingNormalDepthUAV_CPU);
+
+	DXRDevice->CreateUnorderedAccessView(
+		RaytracingAlbedo.Get(),
+		0,
+		&uavDesc,
+		RaytracingAlbedoUAV_CPU);
+
+	DXRDevice->CreateUnorderedAccessView(
+		RaytracingMotionVectors.Get(),
+		0,
+		&uavDesc,
+		RaytracingMotionVectorsUAV_CPU);
+
+	// The denoiser filters what was just created
+	Denoiser::SetInputs(
+		RaytracingAccumulation,
+		RaytracingLuminanceMoments,
+		RaytracingNormalDepth,
+		RaytracingAlbedo,
+		RaytracingMotionVectors,
+		RaytracingOutput);
 }
 
 
@@ -525,20 +809,20 @@ void RayTracing::ResizeOutputUAV(
 	if (!dxrInitialized || !dxrAvailable)
 		return;
 
-	// Wait for the GPU to be done
-	Graphics::WaitForGPU();
-
-	// Reset and re-created the buffer
-	RaytracingOutput.Reset();
+	// Re-create the buffer; the old one is released
+	// once any in-flight frames are done with it
 	CreateRaytracingOutputUAV(outputWidth, outputHeight);
 }
 
 
 // --------------------------------------------------------
-// Creates a BLAS for a particular mesh.  
+// Creates a BLAS for a particular mesh, recording its build
+// on a pooled command list.  Thread safe, so meshes can be
+// loaded on several jobs at once.
 // 
-// NOTE: This demo assumes exactly one BLAS, so running this 
-// method more than once is not advised!
+// With CompactBLAS, the GPU reports how small the BLAS can
+// get, and it stays full size until a later call to
+// CompactBottomLevelAccelerationStructures().
 // --------------------------------------------------------
 MeshRaytracingData RayTracing::CreateBottomLevelAccelerationStructureForMesh(Mesh* mesh)
 {
@@ -548,9 +832,6 @@ MeshRaytracingData RayTracing::CreateBottomLevelAccelerationStructureForMesh(Mes
 	if (!dxrAvailable)
 		return rayTracingData;
 
-	// Create the Bottom Level accel structure for this mesh
-	// Note: Currently, this is the one and only BLAS in our simple implementation!
-
 	// Describe the geometry data we intend to store in this BLAS
 	D3D12_RAYTRACING_GEOMETRY_DESC geometryDesc = {};
 	geometryDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
@@ -571,6 +852,8 @@ MeshRaytracingData RayTracing::CreateBottomLevelAccelerationStructureForMesh(Mes
 	accelStructInputs.pGeometryDescs = &geometryDesc;
 	accelStructInputs.NumDescs = 1;
 	accelStructInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
+	if (CompactBLAS)
+		accelStructInputs.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION;
 
 	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO accelStructPrebuildInfo = {};
 	DXRDevice->GetRaytracingAccelerationStructurePrebuildInfo(&accelStructInputs, &accelStructPrebuildInfo);
@@ -579,13 +862,15 @@ MeshRaytracingData RayTracing::CreateBottomLevelAccelerationStructureForMesh(Mes
 	accelStructPrebuildInfo.ScratchDataSizeInBytes = ALIGN(accelStructPrebuildInfo.ScratchDataSizeInBytes, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
 	accelStructPrebuildInfo.ResultDataMaxSizeInBytes = ALIGN(accelStructPrebuildInfo.ResultDataMaxSizeInBytes, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
 
-	// Create a scratch buffer so the device has a place to temporarily store data
-	BLASScratchBuffer = Graphics::CreateBuffer(
+	// Create a scratch buffer so the device has a place to temporarily store data.
+	// Scratch memory is only needed during the build, so every BLAS build
+	// shares (aliases) the same transient memory.  Builds on other lists
+	// run one after another on the GPU, and the aliasing barrier below
+	// waits for the previous one.
+	Microsoft::WRL::ComPtr<ID3D12Resource> scratchBuffer = GPUMemory::CreateTransientBuffer(
 		accelStructPrebuildInfo.ScratchDataSizeInBytes,
-		D3D12_HEAP_TYPE_DEFAULT,
 		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-		max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
 
 	// Create the final buffer for the BLAS
 	rayTracingData.BLAS = Graphics::CreateBuffer(
@@ -595,26 +880,77 @@ MeshRaytracingData RayTracing::CreateBottomLevelAccelerationStructureForMesh(Mes
 		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
 		max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
 
+	// Hand out this mesh's hit group and descriptors, and track its memory
+	// Note: The SRVs must come one after the other in the descriptor heap, and index must come first
+	//       This is due to the way we've set up the root signature (expects a table of these)
+	D3D12_CPU_DESCRIPTOR_HANDLE ib_cpu, vb_cpu;
+	{
+		std::lock_guard<std::mutex> lock(blasMutex);
+
+		// Create the buffers for reading back the compacted sizes if we haven't
+		// yet, with a slot for each hit group so builds never share one
+		if (CompactBLAS && !blasCompactedSizeBuffer)
+		{
+			blasCompactedSizeBuffer = Graphics::CreateBuffer(
+				sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC) * MaxHitGroupsInShaderTable,
+				D3D12_HEAP_TYPE_DEFAULT,
+				D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+				D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+
+			blasCompactedSizeReadback = Graphics::CreateBuffer(
+				sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC) * MaxHitGroupsInShaderTable,
+				D3D12_HEAP_TYPE_READBACK,
+				D3D12_RESOURCE_STATE_COPY_DEST);
+		}
+
+		// Use the BLAS count as the hit group index for this mesh
+		rayTracingData.HitGroupIndex = blasCount;
+		blasCount++;
+
+		Graphics::ReserveDescriptorHeapSlot(&ib_cpu, &rayTracingData.IndexBufferSRV);
+		Graphics::ReserveDescriptorHeapSlot(&vb_cpu, &rayTracingData.VertexBufferSRV);
+
+		unsigned int memoryIndex = accelStructMemory.AddBLAS(accelStructPrebuildInfo.ResultDataMaxSizeInBytes);
+		if (CompactBLAS)
+			uncompactedBLAS.push_back({ rayTracingData.HitGroupIndex, memoryIndex });
+	}
+
+	// Record the build on a list of its own
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> commandList;
+	CommandListPool::Acquire(CommandListPool::BLASBuildCommandListOrder)->QueryInterface(IID_PPV_ARGS(commandList.GetAddressOf()));
+
+	// The scratch memory may have belonged to another buffer, so let
+	// the GPU know this buffer is the one using it from now on
+	D3D12_RESOURCE_BARRIER aliasingBarrier = {};
+	aliasingBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+	aliasingBarrier.Aliasing.pResourceBefore = 0;
+	aliasingBarrier.Aliasing.pResourceAfter = scratchBuffer.Get();
+	commandList->ResourceBarrier(1, &aliasingBarrier);
+
 	// Describe the final BLAS and set up the build
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc = {};
 	buildDesc.Inputs = accelStructInputs;
-	buildDesc.ScratchAccelerationStructureData = BLASScratchBuffer->GetGPUVirtualAddress();
+	buildDesc.ScratchAccelerationStructureData = scratchBuffer->GetGPUVirtualAddress();
 	buildDesc.DestAccelerationStructureData = rayTracingData.BLAS->GetGPUVirtualAddress();
-	DXRCommandList->BuildRaytracingAccelerationStructure(&buildDesc, 0, 0);
+
+	// If we're compacting, have the GPU tell us how small the BLAS can get
+	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC postbuildDesc = {};
+	postbuildDesc.InfoType = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE;
+	postbuildDesc.DestBuffer = CompactBLAS ?
+		blasCompactedSizeBuffer->GetGPUVirtualAddress() +
+		sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC) * rayTracingData.HitGroupIndex : 0;
+	commandList->BuildRaytracingAccelerationStructure(&buildDesc, CompactBLAS ? 1 : 0, &postbuildDesc);
 
 	// Set up a barrier to wait until the BLAS is actually built to proceed
 	D3D12_RESOURCE_BARRIER blasBarrier = {};
 	blasBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
 	blasBarrier.UAV.pResource = rayTracingData.BLAS.Get();
 	blasBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-	DXRCommandList->ResourceBarrier(1, &blasBarrier);
+	commandList->ResourceBarrier(1, &blasBarrier);
 
-	// Create two SRVs for the index and vertex buffers
-	// Note: These must come one after the other in the descriptor heap, and index must come first
-	//       This is due to the way we've set up the root signature (expects a table of these)
-	D3D12_CPU_DESCRIPTOR_HANDLE ib_cpu, vb_cpu;
-	Graphics::ReserveDescriptorHeapSlot(&ib_cpu, &rayTracingData.IndexBufferSRV);
-	Graphics::ReserveDescriptorHeapSlot(&vb_cpu, &rayTracingData.VertexBufferSRV);
+	// Nothing waits for the build, so keep the scratch buffer
+	// around until the GPU is done with this frame
+	Graphics::ReleaseWhenFrameCompletes(scratchBuffer);
 
 	// Index buffer SRV
 	D3D12_SHADER_RESOURCE_VIEW_DESC indexSRVDesc = {};
@@ -638,21 +974,15 @@ MeshRaytracingData RayTracing::CreateBottomLevelAccelerationStructureForMesh(Mes
 	vertexSRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 	DXRDevice->CreateShaderResourceView(mesh->GetVertexBuffer().Get(), &vertexSRVDesc, vb_cpu);
 
-	// Use the BLAS count as the hit group index for this mesh
-	rayTracingData.HitGroupIndex = blasCount;
-	blasCount++;
-	// Finish up before moving on
-	Graphics::CloseAndExecuteCommandList();
-	Graphics::WaitForGPU();
-	Graphics::ResetAllocatorAndCommandList(0);
-
-
-	// We need to put this mesh's SRVs into the shader table
+	// We need to put this mesh's SRVs into the shader table (every frame's copy of it)
 	// - In a larger application, each unique mesh will need its own entry in the shader table!
-	unsigned char* tablePointer = 0;
-	ShaderTable->Map(0, 0, (void**)&tablePointer);
+	// - Each mesh has its own hit group record, so other threads never write the same bytes
+	unsigned char* tableStart = 0;
+	ShaderTable->Map(0, 0, (void**)&tableStart);
+	for (unsigned int frame = 0; frame < Graphics::MaxFramesInFlight; frame++)
 	{
-		tablePointer += ShaderTableRecordSize * 2; // Get past raygen and miss shaders
+		unsigned char* tablePointer = tableStart + shaderTableSectionSize * frame;
+		tablePointer += ShaderTableRecordSize * (1 + MissShaderCount); // Get past raygen and miss shaders
 		tablePointer += ShaderTableRecordSize * rayTracingData.HitGroupIndex; // Hit group
 		tablePointer += D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES; // Get past the identifier
 
@@ -671,19 +1001,128 @@ MeshRaytracingData RayTracing::CreateBottomLevelAccelerationStructureForMesh(Mes
 }
 
 
+// --------------------------------------------------------
+// Copies each given mesh's BLAS into a tightly-sized buffer,
+// if it hasn't been already.  Builds recorded on other
+// threads all report their compacted sizes to their own
+// slot, so this submits everything recorded so far and
+// waits for the GPU once for all of them, rather than once
+// per mesh.  Call from the main thread, after the builds
+// have been recorded.
+// --------------------------------------------------------
+void RayTracing::CompactBottomLevelAccelerationStructures(const std::vector<std::shared_ptr<Mesh>>& meshes)
+{
+	if (!dxrAvailable || !CompactBLAS || uncompactedBLAS.empty())
+		return;
+
+	TRACE_ZONE("CompactBottomLevelAccelerationStructures");
+	const UINT64 sizeDescBytes = sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC);
+
+	// Copy every reported size somewhere the CPU can read it
+	D3D12_RESOURCE_BARRIER sizeBarrier = {};
+	sizeBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+	sizeBarrier.Transition.pResource = blasCompactedSizeBuffer.Get();
+	sizeBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+	sizeBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+	sizeBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+	DXRCommandList->ResourceBarrier(1, &sizeBarrier);
+
+	DXRCommandList->CopyBufferRegion(blasCompactedSizeReadback.Get(), 0, blasCompactedSizeBuffer.Get(), 0, sizeDescBytes * blasCount);
+
+	sizeBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
+	sizeBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+	DXRCommandList->ResourceBarrier(1, &sizeBarrier);
+
+	// Submit the builds (and the uploads they read) along with the copy
+	Graphics::CloseAndExecuteCommandList();
+	Graphics::WaitForGPU();
+	Graphics::ResetAllocatorAndCommandList(Graphics::FrameIndex());
+
+	// Every build is complete, so the sizes are ready to read
+	D3D12_RANGE readRange = { 0, (SIZE_T)(sizeDescBytes * blasCount) };
+	unsigned char* readbackAddress = 0;
+	blasCompactedSizeReadback->Map(0, &readRange, (void**)&readbackAddress);
+
+	// The copies must land before the TLAS build (on its own list) uses them
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> commandList;
+	CommandListPool::Acquire(CommandListPool::BLASBuildCommandListOrder)->QueryInterface(IID_PPV_ARGS(commandList.GetAddressOf()));
+
+	for (const std::shared_ptr<Mesh>& mesh : meshes)
+	{
+		MeshRaytracingData rayTracingData = mesh->GetRaytracingData();
+		std::vector<UncompactedBLAS>::iterator uncompacted = std::find_if(
+			uncompactedBLAS.begin(), uncompactedBLAS.end(),
+			[&](const UncompactedBLAS& blas) { return blas.HitGroupIndex == rayTracingData.HitGroupIndex; });
+		if (uncompacted == uncompactedBLAS.end())
+			continue;
+
+		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC compactedSizeDesc = {};
+		memcpy(&compactedSizeDesc, readbackAddress + sizeDescBytes * rayTracingData.HitGroupIndex, sizeof(compactedSizeDesc));
+		unsigned int memoryIndex = uncompacted->MemoryIndex;
+		uncompactedBLAS.erase(uncompacted);
+
+		UINT64 compactedSize = ALIGN(compactedSizeDesc.CompactedSizeInBytes, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+		if (!accelStructMemory.CompactBLAS(memoryIndex, compactedSize, Graphics::CurrentFrameFenceValue()))
+			continue;
+
+		// Create a tightly-sized buffer and copy the BLAS into it
+		Microsoft::WRL::ComPtr<ID3D12Resource> compactedBLAS = Graphics::CreateBuffer(
+			compactedSize,
+			D3D12_HEAP_TYPE_DEFAULT,
+			D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
+			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+			max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
+
+		commandList->CopyRaytracingAccelerationStructure(
+			compactedBLAS->GetGPUVirtualAddress(),
+			rayTracingData.BLAS->GetGPUVirtualAddress(),
+			D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_COMPACT);
+
+		// Anything using the compacted copy must wait for it
+		D3D12_RESOURCE_BARRIER copyBarrier = {};
+		copyBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+		copyBarrier.UAV.pResource = compactedBLAS.Get();
+		commandList->ResourceBarrier(1, &copyBarrier);
+
+		// The copy is submitted along with whatever's recorded next,
+		// so rather than waiting for it, keep the original around
+		// until this frame is done (which the memory stats match)
+		Graphics::ReleaseWhenFrameCompletes(rayTracingData.BLAS);
+		rayTracingData.BLAS = compactedBLAS;
+		mesh->SetRaytracingData(rayTracingData);
+	}
+
+	D3D12_RANGE writeRange = { 0, 0 };
+	blasCompactedSizeReadback->Unmap(0, &writeRange);
+
+	// Anything not passed in just stays full size
+	uncompactedBLAS.clear();
+}
+
+
 // --------------------------------------------------------
 // Creates the top level accel structure, which can be made
 // up of one or more BLAS instances, each with their own
 // unique transform.
+// 
+// Buffers are sized here, but the instances are uploaded
+// and the build recorded (on a pooled command list) by a
+// job, so the main thread can move on to Raytrace().  See
+// FinishRecording().
 // --------------------------------------------------------
-void RayTracing::CreateTopLevelAccelerationStructureForScene(std::vector<Entity> scene)
+void RayTracing::CreateTopLevelAccelerationStructureForScene(
+	const std::vector<Entity>& scene,
+	const std::vector<SceneFloat4x4>& worldMatrices,
+	const std::vector<SceneFloat4x4>& previousWorldMatrices)
 {
+	TRACE_ZONE("CreateTopLevelAccelerationStructureForScene");
+
 	// Don't bother if DXR isn't available or the AS is finalized already
 	if (!dxrAvailable)
 		return;
 
-	// Create vector of instance descriptions
-	std::vector<D3D12_RAYTRACING_INSTANCE_DESC> instanceDescs;
+	// Replaced acceleration structures the GPU has finished with are gone by now
+	accelStructMemory.Retire(Graphics::CompletedFrameFenceValue());
 
 	// Create a vector of instance IDs and another for per-BLAS entity data
 	std::vector<unsigned int> instanceIDs;
@@ -691,87 +1130,121 @@ void RayTracing::CreateTopLevelAccelerationStructureForScene(std::vector<Entity>
 	instanceIDs.resize(blasCount); // One per BLAS (mesh) - all starting at zero due to resize()
 	entityData.resize(blasCount);
 
-	// Create an instance description for each entity
+	// Anything moving invalidates the accumulated image
+	Accumulation.CheckWorldMatrices(worldMatrices);
+
+	// Each entity's instance ID counts up per mesh, so hand those
+	// out first and the rest of each description is independent
+	std::vector<unsigned int> entityInstanceIDs(scene.size());
 	for (size_t i = 0; i < scene.size(); i++)
 	{
-		// Grab this entity's transform and transpose to column major
-		DirectX::XMFLOAT4X4 transform = scene[i].GetTransform()->GetWorldMatrix();
-		XMStoreFloat4x4(&transform, XMMatrixTranspose(XMLoadFloat4x4(&transform)));
-
-		// Grab this mesh's index in the shader table
-		std::shared_ptr<Mesh> mesh = scene[i].GetMesh();
-		unsigned int meshBlasIndex = mesh->GetRaytracingData().HitGroupIndex;
-
-		// Create this description and add to our overall set of descriptions
-		D3D12_RAYTRACING_INSTANCE_DESC instDesc = {};
-		instDesc.InstanceContributionToHitGroupIndex = meshBlasIndex;
-		instDesc.InstanceID = instanceIDs[meshBlasIndex];
-		instDesc.InstanceMask = 0xFF;
-		memcpy(&instDesc.Transform, &transform, sizeof(float) * 3 * 4); // Copy first [3][4] elements
-		instDesc.AccelerationStructure = mesh->GetRaytracingData().BLAS->GetGPUVirtualAddress();
-		instDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-		instanceDescs.push_back(instDesc);
-
-		// Set up the entity data for this entity, too
-		// - mesh index tells us which cbuffer
-		// - instance ID tells us which instance in that cbuffer
-		std::shared_ptr<Material> mat = scene[i].GetMaterial();
-		entityData[meshBlasIndex].materials[instDesc.InstanceID].color = mat->GetColorTint();
-		entityData[meshBlasIndex].materials[instDesc.InstanceID].roughness = mat->GetRoughness();
-		entityData[meshBlasIndex].materials[instDesc.InstanceID].metal = mat->GetMetal();
-		entityData[meshBlasIndex].materials[instDesc.InstanceID].uvScale = mat->GetUVScale();
-		entityData[meshBlasIndex].materials[instDesc.InstanceID].uvOffset = mat->GetUVOffset();
-
-		// Texture indices
-		unsigned int texIdx[4] = {0};
-		// albedo, normal, roughness, metalness
-
-		// Get index of texture descriptors
-		D3D12_GPU_DESCRIPTOR_HANDLE texStart = mat->GetFinalGPUHandleForSRVs();
-		if (texStart.ptr)
+		unsigned int meshBlasIndex = scene[i].GetMesh()->GetRaytracingData().HitGroupIndex;
+		entityInstanceIDs[i] = instanceIDs[meshBlasIndex]++;
+	}
+
+	// Without last frame's matrices (say, the first frame), nothing has moved
+	const std::vector<SceneFloat4x4>& lastWorldMatrices =
+		previousWorldMatrices.size() == worldMatrices.size() ? previousWorldMatrices : worldMatrices;
+	previousTransforms.resize(scene.size());
+
+	// Create an instance description for each entity, spread over the job system
+	instanceDescs.resize(scene.size());
+	JobSystem::ParallelFor((unsigned int)scene.size(), InstanceDescsPerJob, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
 		{
-			UINT texDescIdx = Graphics::GetDescriptorIndex(texStart);
-			for (int i = 0; i < 4; i++)
+			// Grab this entity's transform, transposed to column major
+			// - Matrices come from the caller, since the entities' own
+			//   transforms may be mid-simulation on another thread
+			SceneInstanceTransform transform = SceneSimulation::InstanceTransform(worldMatrices[i]);
+
+			// Grab this mesh's index in the shader table
+			std::shared_ptr<Mesh> mesh = scene[i].GetMesh();
+			unsigned int meshBlasIndex = mesh->GetRaytracingData().HitGroupIndex;
+
+			// Create this description and add to our overall set of descriptions
+			D3D12_RAYTRACING_INSTANCE_DESC instDesc = {};
+			instDesc.InstanceContributionToHitGroupIndex = meshBlasIndex;
+			instDesc.InstanceID = entityInstanceIDs[i];
+			instDesc.InstanceMask = 0xFF;
+			memcpy(&instDesc.Transform, &transform, sizeof(float) * 3 * 4);
+
+			// Last frame's matrix goes in the same form, at the same index
+			SceneInstanceTransform previousTransform = SceneSimulation::InstanceTransform(lastWorldMatrices[i]);
+			memcpy(&previousTransforms[i], &previousTransform, sizeof(float) * 3 * 4);
+			instDesc.AccelerationStructure = mesh->GetRaytracingData().BLAS->GetGPUVirtualAddress();
+			instDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
+			instanceDescs[i] = instDesc;
+
+			// Set up the entity data for this entity, too
+			// - mesh index tells us which cbuffer
+			// - instance ID tells us which instance in that cbuffer
+			std::shared_ptr<Material> mat = scene[i].GetMaterial();
+			entityData[meshBlasIndex].materials[instDesc.InstanceID].color = mat->GetColorTint();
+			entityData[meshBlasIndex].materials[instDesc.InstanceID].roughness = mat->GetRoughness();
+			entityData[meshBlasIndex].materials[instDesc.InstanceID].metal = mat->GetMetal();
+			entityData[meshBlasIndex].materials[instDesc.InstanceID].uvScale = mat->GetUVScale();
+			entityData[meshBlasIndex].materials[instDesc.InstanceID].uvOffset = mat->GetUVOffset();
+
+			// Texture indices
+			unsigned int texIdx[4] = {0};
+			// albedo, normal, roughness, metalness
+
+			// Get index of texture descriptors
+			D3D12_GPU_DESCRIPTOR_HANDLE texStart = mat->GetFinalGPUHandleForSRVs();
+			if (texStart.ptr)
 			{
-				texIdx[i] = texDescIdx + i;
+				UINT texDescIdx = Graphics::GetDescriptorIndex(texStart);
+				for (int i = 0; i < 4; i++)
+				{
+					texIdx[i] = texDescIdx + i;
+				}
 			}
-		}
 
-		entityData[meshBlasIndex].materials[instDesc.InstanceID].albedoIndex = texIdx[0];
-		entityData[meshBlasIndex].materials[instDesc.InstanceID].normalMapIndex = texIdx[1];
-		entityData[meshBlasIndex].materials[instDesc.InstanceID].roughnessIndex = texIdx[2];
-		entityData[meshBlasIndex].materials[instDesc.InstanceID].metalnessIndex = texIdx[3];
+			entityData[meshBlasIndex].materials[instDesc.InstanceID].albedoIndex = texIdx[0];
+			entityData[meshBlasIndex].materials[instDesc.InstanceID].normalMapIndex = texIdx[1];
+			entityData[meshBlasIndex].materials[instDesc.InstanceID].roughnessIndex = texIdx[2];
+			entityData[meshBlasIndex].materials[instDesc.InstanceID].metalnessIndex = texIdx[3];
+		}
+	});
 
-		// On to the next instance for this mesh
-		instanceIDs[meshBlasIndex]++;
-	}
 
+	// This frame's instance buffer, which no frame still in flight is using
+	unsigned int frameIndex = Graphics::FrameIndex();
+	Microsoft::WRL::ComPtr<ID3D12Resource>& instanceDescBuffer = tlasInstanceDescBuffers[frameIndex];
 
 	// Is our current description buffer too small?
-	if (sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceDescs.size() > tlasInstanceDataSizeInBytes)
+	if (sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceDescs.size() > tlasInstanceDataSizesInBytes[frameIndex])
 	{
 		// Create a new buffer to hold instance descriptions, since they
 		// need to actually be on the GPU
-		TLASInstanceDescBuffer.Reset();
-		tlasInstanceDataSizeInBytes = sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceDescs.size();
+		Graphics::ReleaseWhenFrameCompletes(instanceDescBuffer);
+		tlasInstanceDataSizesInBytes[frameIndex] = sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceDescs.size();
 
-		TLASInstanceDescBuffer = Graphics::CreateBuffer(
-			tlasInstanceDataSizeInBytes,
+		instanceDescBuffer = Graphics::CreateBuffer(
+			tlasInstanceDataSizesInBytes[frameIndex],
 			D3D12_HEAP_TYPE_UPLOAD,
 			D3D12_RESOURCE_STATE_GENERIC_READ);
 	}
 
-	// Copy the description into the new buffer
-	unsigned char* mapped = 0;
-	TLASInstanceDescBuffer->Map(0, 0, (void**)&mapped);
-	memcpy(mapped, &instanceDescs[0], sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceDescs.size());
-	TLASInstanceDescBuffer->Unmap(0, 0);
+	// Same for last frame's matrices, which the hit shader looks up by instance index
+	Microsoft::WRL::ComPtr<ID3D12Resource>& previousTransformBuffer = previousTransformBuffers[frameIndex];
+	if (sizeof(DirectX::XMFLOAT3X4) * previousTransforms.size() > previousTransformSizesInBytes[frameIndex])
+	{
+		Graphics::ReleaseWhenFrameCompletes(previousTransformBuffer);
+		previousTransformSizesInBytes[frameIndex] = sizeof(DirectX::XMFLOAT3X4) * previousTransforms.size();
+
+		previousTransformBuffer = Graphics::CreateBuffer(
+			previousTransformSizesInBytes[frameIndex],
+			D3D12_HEAP_TYPE_UPLOAD,
+			D3D12_RESOURCE_STATE_GENERIC_READ);
+	}
 
 	// Describe our overall input so we can get sizing info
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS accelStructInputs = {};
 	accelStructInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
 	accelStructInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-	accelStructInputs.InstanceDescs = TLASInstanceDescBuffer->GetGPUVirtualAddress();
+	accelStructInputs.InstanceDescs = instanceDescBuffer->GetGPUVirtualAddress();
 	accelStructInputs.NumDescs = (unsigned int)instanceDescs.size();
 	accelStructInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
 
@@ -787,7 +1260,7 @@ void RayTracing::CreateTopLevelAccelerationStructureForScene(std::vector<Entity>
 	if (accelStructPrebuildInfo.ScratchDataSizeInBytes > tlasScratchSizeInBytes)
 	{
 		// Create a new scratch buffer
-		TLASScratchBuffer.Reset();
+		Graphics::ReleaseWhenFrameCompletes(TLASScratchBuffer);
 		tlasScratchSizeInBytes = accelStructPrebuildInfo.ScratchDataSizeInBytes;
 
 		TLASScratchBuffer = Graphics::CreateBuffer(
@@ -802,8 +1275,9 @@ void RayTracing::CreateTopLevelAccelerationStructureForScene(std::vector<Entity>
 	if (accelStructPrebuildInfo.ResultDataMaxSizeInBytes > tlasBufferSizeInBytes)
 	{
 		// Create a new tlas buffer
-		TLAS.Reset();
+		Graphics::ReleaseWhenFrameCompletes(TLAS);
 		tlasBufferSizeInBytes = accelStructPrebuildInfo.ResultDataMaxSizeInBytes;
+		accelStructMemory.SetTLASSize(tlasBufferSizeInBytes, Graphics::CurrentFrameFenceValue());
 
 		TLAS = Graphics::CreateBuffer(
 			accelStructPrebuildInfo.ResultDataMaxSizeInBytes,
@@ -819,19 +1293,46 @@ void RayTracing::CreateTopLevelAccelerationStructureForScene(std::vector<Entity>
 	buildDesc.Inputs = accelStructInputs;
 	buildDesc.ScratchAccelerationStructureData = TLASScratchBuffer->GetGPUVirtualAddress();
 	buildDesc.DestAccelerationStructureData = TLAS->GetGPUVirtualAddress();
-	DXRCommandList->BuildRaytracingAccelerationStructure(&buildDesc, 0, 0);
 
-	// Set up a barrier to wait until the TLAS is actually built to proceed
-	D3D12_RESOURCE_BARRIER tlasBarrier = {};
-	tlasBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-	tlasBarrier.UAV.pResource = TLAS.Get();
-	tlasBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-	DXRCommandList->ResourceBarrier(1, &tlasBarrier);
+	// Upload the instances and record the build on another thread.  The
+	// buffers stay put until this frame is submitted, and its list goes
+	// ahead of the main one (which traces against the TLAS).
+	ID3D12Resource* instanceBuffer = instanceDescBuffer.Get();
+	ID3D12Resource* transformBuffer = previousTransformBuffer.Get();
+	ID3D12Resource* tlas = TLAS.Get();
+	JobSystem::Run([=]()
+	{
+		TRACE_ZONE("Record TLAS Build");
+
+		// Copy the descriptions into this frame's buffer
+		unsigned char* mapped = 0;
+		instanceBuffer->Map(0, 0, (void**)&mapped);
+		memcpy(mapped, instanceDescs.data(), sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceDescs.size());
+		instanceBuffer->Unmap(0, 0);
+
+		transformBuffer->Map(0, 0, (void**)&mapped);
+		memcpy(mapped, previousTransforms.data(), sizeof(DirectX::XMFLOAT3X4) * previousTransforms.size());
+		transformBuffer->Unmap(0, 0);
+
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> commandList;
+		CommandListPool::Acquire(CommandListPool::TLASBuildCommandListOrder)->QueryInterface(IID_PPV_ARGS(commandList.GetAddressOf()));
+
+		GPUProfiler::ScopedZone zone("TLAS Build", commandList.Get());
+		commandList->BuildRaytracingAccelerationStructure(&buildDesc, 0, 0);
+
+		// Set up a barrier to wait until the TLAS is actually built to proceed
+		D3D12_RESOURCE_BARRIER tlasBarrier = {};
+		tlasBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+		tlasBarrier.UAV.pResource = tlas;
+		tlasBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+		commandList->ResourceBarrier(1, &tlasBarrier);
+	}, &recordingJobs);
 
 	// Finalize the entity data cbuffer stuff and copy descriptors to shader table
 	unsigned char* tablePointer = 0;
 	ShaderTable->Map(0, 0, (void**)&tablePointer);
-	tablePointer += ShaderTableRecordSize * 2; // Get past raygen and miss shaders
+	tablePointer += shaderTableSectionSize * frameIndex; // This frame's copy of the table
+	tablePointer += ShaderTableRecordSize * (1 + MissShaderCount); // Get past raygen and miss shaders
 	for (int i = 0; i < entityData.size(); i++)
 	{
 		// Need to get to the first descriptor in this hit group's record
@@ -839,9 +1340,9 @@ void RayTracing::CreateTopLevelAccelerationStructureForScene(std::vector<Entity>
 		hitGroupPointer += D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES; // Get past identifier
 		hitGroupPointer += sizeof(D3D12_GPU_DESCRIPTOR_HANDLE); // Get past geometry SRV
 
-		// Copy the data to the CB ring buffer and grab associated CBV to place in shader table
-		D3D12_GPU_DESCRIPTOR_HANDLE cbv = Graphics::FillNextConstantBufferAndGetGPUDescriptorHandle(&entityData[i], sizeof(RaytracingEntityData));
-		memcpy(hitGroupPointer, &cbv, sizeof(D3D12_GPU_DESCRIPTOR_HANDLE));
+		// Copy the data to the CB ring buffer and place its address in the shader table (local root CBV)
+		D3D12_GPU_VIRTUAL_ADDRESS cbAddress = Graphics::FillNextConstantBufferAndGetGPUVirtualAddress(&entityData[i], sizeof(RaytracingEntityData));
+		memcpy(hitGroupPointer, &cbAddress, sizeof(D3D12_GPU_VIRTUAL_ADDRESS));
 	}
 	ShaderTable->Unmap(0, 0);
 }
@@ -850,11 +1351,50 @@ void RayTracing::CreateTopLevelAccelerationStructureForScene(std::vector<Entity>
 // --------------------------------------------------------
 // Performs the actual raytracing work
 // --------------------------------------------------------
-void RayTracing::Raytrace(std::shared_ptr<Camera> camera, Microsoft::WRL::ComPtr<ID3D12Resource> currentBackBuffer)
+void RayTracing::Raytrace(
+	std::shared_ptr<Camera> camera,
+	Microsoft::WRL::ComPtr<ID3D12Resource> currentBackBuffer,
+	const Light* lights,
+	unsigned int lightCount)
 {
 	if (!dxrInitialized || !dxrAvailable)
 		return;
 
+	// Denoising and the copy to the back buffer only depend on the
+	// outputs, so record them on another thread while this one
+	// records the tracing, with their list going after the main one
+	JobSystem::Run([currentBackBuffer]()
+	{
+		TRACE_ZONE("Record Denoise");
+		ID3D12GraphicsCommandList* commandList = CommandListPool::Acquire(CommandListPool::DenoiseCommandListOrder);
+
+		// Filter the noise out of the output (which still holds the
+		// last result if nothing was traced, since the inputs haven't
+		// changed either)
+		Denoiser::Denoise(commandList);
+
+		// Final copy
+		GPUProfiler::ScopedZone zone("Copy To Back Buffer", commandList);
+
+		// Transition the raytracing output to COPY SOURCE
+		D3D12_RESOURCE_BARRIER copyBarriers[2] = {};
+		copyBarriers[0].Transition.pResource = RaytracingOutput.Get();
+		copyBarriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		copyBarriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+		copyBarriers[0].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		commandList->ResourceBarrier(1, &copyBarriers[0]);
+
+		// Copy the raytracing output into the back buffer
+		commandList->CopyResource(currentBackBuffer.Get(), RaytracingOutput.Get());
+
+		// Back buffer back to PRESENT
+		copyBarriers[1].Transition.pResource = currentBackBuffer.Get();
+		copyBarriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+		copyBarriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
+		copyBarriers[1].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		commandList->ResourceBarrier(1, &copyBarriers[1]);
+	}, &recordingJobs);
+
 	// Transition the output-related resources to the proper states
 	D3D12_RESOURCE_BARRIER outputBarriers[2] = {};
 	{
@@ -877,16 +1417,141 @@ void RayTracing::Raytrace(std::shared_ptr<Camera> camera, Microsoft::WRL::ComPtr
 	RaytracingSceneData sceneData = {};
 	sceneData.cameraPosition = camera->GetTransform().GetPosition();
 
+	// Start accumulating over if the camera changed at all
 	DirectX::XMFLOAT4X4 view = camera->GetViewMatrix();
 	DirectX::XMFLOAT4X4 proj = camera->GetProjectionMatrix();
+	Accumulation.CheckCamera(view, proj);
+
 	DirectX::XMMATRIX v = DirectX::XMLoadFloat4x4(&view);
 	DirectX::XMMATRIX p = DirectX::XMLoadFloat4x4(&proj);
 	DirectX::XMMATRIX vp = DirectX::XMMatrixMultiply(v, p);
 	DirectX::XMStoreFloat4x4(&sceneData.inverseViewProjection, XMMatrixInverse(0, vp));
 
-	D3D12_GPU_DESCRIPTOR_HANDLE cbuffer = Graphics::FillNextConstantBufferAndGetGPUDescriptorHandle(&sceneData, sizeof(RaytracingSceneData));
+	// Motion vectors measure from last frame's camera (this
+	// one's on the first frame, when nothing has moved)
+	if (!previousCameraValid)
+	{
+		DirectX::XMStoreFloat4x4(&previousViewProjection, vp);
+		previousCameraPosition = sceneData.cameraPosition;
+		previousCameraValid = true;
+	}
+	sceneData.previousViewProjection = previousViewProjection;
+	sceneData.previousCameraPosition = previousCameraPosition;
+	DirectX::XMStoreFloat4x4(&previousViewProjection, vp);
+	previousCameraPosition = sceneData.cameraPosition;
+	Accumulation.CheckLights(lights, lightCount);
+	{
+		TRACE_ZONE("Update Light Tree");
+		treeLights.resize(lightCount);
+		for (unsigned int i = 0; i < lightCount; i++)
+		{
+			const Light& light = lights[i];
+			LightTreeLight& treeLight = treeLights[i];
+			treeLight.Distant = light.Type == LIGHT_TYPE_DIR;
+			treeLight.Spot = light.Type == LIGHT_TYPE_SPOT;
+			treeLight.Position = { light.Position.x, light.Position.y, light.Position.z };
+			treeLight.Direction = { light.Direction.x, light.Direction.y, light.Direction.z };
+			treeLight.Range = light.Range;
+			treeLight.Power = light.Intensity * (0.2126f * light.Color.x + 0.7152f * light.Color.y + 0.0722f * light.Color.z);
+		}
+		lightTree.Update(treeLights.data(), lightCount);
+
+		// The shader indexes lights in the tree's order
+		const std::vector<unsigned int>& lightOrder = lightTree.GetLightOrder();
+		orderedLights.resize(lightOrder.size());
+		for (size_t i = 0; i < lightOrder.size(); i++)
+			orderedLights[i] = lights[lightOrder[i]];
+	}
+
+	// Read back the path counters from the last frame that
+	// used this slot, which has finished by now
+	unsigned int frameIndex = Graphics::FrameIndex();
+	if (pathCountersPending[frameIndex])
+	{
+		UINT counters[PathCounterCount] = {};
+		D3D12_RANGE readRange = { sizeof(counters) * frameIndex, sizeof(counters) * (frameIndex + 1) };
+		void* readbackAddress = 0;
+		pathCountersReadback->Map(0, &readRange, &readbackAddress);
+		memcpy(counters, (char*)readbackAddress + readRange.Begin, sizeof(counters));
+		D3D12_RANGE writeRange = { 0, 0 };
+		pathCountersReadback->Unmap(0, &writeRange);
+
+		if (pathCountersRun[frameIndex] == accumulationRun)
+			AdaptiveSampling.RecordFrame(counters[0], counters[1]);
+		pathCountersPending[frameIndex] = false;
+
+		for (PathTracingStats* stats : { &pathStats, &totalPathStats })
+		{
+			stats->FrameCount++;
+			stats->SampleCount += counters[1];
+			stats->RayCount += counters[2];
+		}
+	}
+
+	// Starting over means every pixel needs samples again
+	if (Accumulation.GetFrameIndex() == 0)
+	{
+		accumulationRun++;
+		AdaptiveSampling.SetPixelCount((uint64_t)Window::Width() * Window::Height());
+	}
+
+	// Spread this frame's ray budget over the pixels that still need it
+	// - Without accumulation there's no history to judge pixels by
+	//   before tracing, so each pixel just stops once it's good enough
+	const AdaptiveSamplingSettings& adaptiveSettings = AdaptiveSampling.GetSettings();
+	AdaptiveSampleAllocation allocation = AdaptiveSampling.GetAllocation();
+	if (adaptiveSettings.Enabled && Accumulation.GetEnabled())
+		Accumulation.SetSamplesPerFrame(allocation.SamplesPerActivePixel);
+
+	sceneData.accumulationFrameIndex = Accumulation.GetFrameIndex();
+	sceneData.samplesPerPixel = Accumulation.GetFrameSampleCount();
+	sceneData.adaptiveErrorThreshold = adaptiveSettings.Enabled ? adaptiveSettings.ErrorThreshold : 0.0f;
+	sceneData.adaptiveMinSamples = adaptiveSettings.MinSamples;
+	sceneData.activePixelFraction = Accumulation.GetEnabled() ? allocation.ActivePixelFraction : 1.0f;
+	sceneData.samplerType = (unsigned int)Sampler;
+	sceneData.blueNoiseOffsets = BlueNoiseOffsets;
+	sceneData.maxBounces = MaxBounces;
+	sceneData.russianRouletteStartBounce = RussianRoulette ? RussianRouletteStartBounce : MaxBounces + 1;
+	sceneData.lightCount = lightCount;
+	sceneData.nextEventEstimation = NextEventEstimation;
+	sceneData.distantLightCount = lightTree.GetDistantLightCount();
+	sceneData.lightTreeSampling = LightTreeSampling;
+	sceneData.environmentMapIndex = environmentMapIndex;
+	sceneData.environmentWidth = environmentWidth;
+	sceneData.environmentHeight = environmentHeight;
+	sceneData.environmentIntensity = EnvironmentIntensity;
+
+	D3D12_GPU_VIRTUAL_ADDRESS cbuffer = Graphics::FillNextConstantBufferAndGetGPUVirtualAddress(&sceneData, sizeof(RaytracingSceneData));
+
+	// Copy the tree's nodes and lights into this frame's light buffer
+	// - There can be far more lights than the constant buffer ring holds
+	// - With no lights the shader never reads them, but the root SRVs
+	//   still need somewhere valid to point
+	const std::vector<LightTreeNode>& treeNodes = lightTree.GetNodes();
+	UINT64 nodeBytes = sizeof(LightTreeNode) * treeNodes.size();
+	UINT64 lightBytes = sizeof(Light) * orderedLights.size();
+	Microsoft::WRL::ComPtr<ID3D12Resource>& lightBuffer = lightBuffers[frameIndex];
+	if (!lightBuffer || nodeBytes + lightBytes > lightBufferSizesInBytes[frameIndex])
+	{
+		Graphics::ReleaseWhenFrameCompletes(lightBuffer);
+		lightBufferSizesInBytes[frameIndex] = nodeBytes + lightBytes + sizeof(LightTreeNode) + sizeof(Light);
+		lightBuffer = Graphics::CreateBuffer(
+			lightBufferSizesInBytes[frameIndex],
+			D3D12_HEAP_TYPE_UPLOAD,
+			D3D12_RESOURCE_STATE_GENERIC_READ);
+	}
+
+	unsigned char* lightData = 0;
+	lightBuffer->Map(0, 0, (void**)&lightData);
+	if (nodeBytes > 0) memcpy(lightData, treeNodes.data(), nodeBytes);
+	if (lightBytes > 0) memcpy(lightData + nodeBytes, orderedLights.data(), lightBytes);
+	lightBuffer->Unmap(0, 0);
 
 	// ACTUAL RAYTRACING HERE
+	// - Nothing to trace once the accumulated image has converged
+	//   (or every pixel is below the error threshold), since the
+	//   output still holds it
+	if (!Accumulation.IsConverged() && !AdaptiveSampling.IsConverged())
 	{
 		// Set the CBV/SRV/UAV descriptor heap
 		ID3D12DescriptorHeap* heap[] = { Graphics::CBVSRVDescriptorHeap.Get() };
@@ -902,23 +1567,30 @@ void RayTracing::Raytrace(std::shared_ptr<Camera> camera, Microsoft::WRL::ComPtr
 			RaytracingOutputUAV_GPU);
 		DXRCommandList->SetComputeRootShaderResourceView(1,			// Second is SRV for accel structure (as root SRV, no table needed)
 			TLAS->GetGPUVirtualAddress());
-		DXRCommandList->SetComputeRootDescriptorTable(2, cbuffer);	// Third is CBV
+		DXRCommandList->SetComputeRootConstantBufferView(2, cbuffer);	// Third is CBV (as root CBV, no descriptor needed)
 		DXRCommandList->SetComputeRootDescriptorTable(3, heap[0]->GetGPUDescriptorHandleForHeapStart()); // Fourth is heap for bindless
+		DXRCommandList->SetComputeRootUnorderedAccessView(4, pathCounters->GetGPUVirtualAddress()); // Fifth is path counters
+		DXRCommandList->SetComputeRootShaderResourceView(5, BlueNoiseBuffer->GetGPUVirtualAddress()); // Sixth is blue noise
+		DXRCommandList->SetComputeRootShaderResourceView(6, lightBuffer->GetGPUVirtualAddress() + nodeBytes); // Seventh is lights
+		DXRCommandList->SetComputeRootShaderResourceView(7, lightBuffer->GetGPUVirtualAddress()); // Eighth is light tree nodes
+		DXRCommandList->SetComputeRootShaderResourceView(8, EnvironmentCDFBuffer->GetGPUVirtualAddress()); // Ninth is environment CDFs
+		DXRCommandList->SetComputeRootShaderResourceView(9, previousTransformBuffers[frameIndex]->GetGPUVirtualAddress()); // Tenth is last frame's transforms
 
 		// Dispatch rays
 		D3D12_DISPATCH_RAYS_DESC dispatchDesc = {};
+		D3D12_GPU_VIRTUAL_ADDRESS shaderTableStart = ShaderTable->GetGPUVirtualAddress() + shaderTableSectionSize * frameIndex;
 
 		// Ray gen shader location in shader table
-		dispatchDesc.RayGenerationShaderRecord.StartAddress = ShaderTable->GetGPUVirtualAddress();
+		dispatchDesc.RayGenerationShaderRecord.StartAddress = shaderTableStart;
 		dispatchDesc.RayGenerationShaderRecord.SizeInBytes = ShaderTableRecordSize;
 
-		// Miss shader location in shader table (we could have a whole sub-table of just these, but only 1 for this demo)
-		dispatchDesc.MissShaderTable.StartAddress = ShaderTable->GetGPUVirtualAddress() + ShaderTableRecordSize; // Offset by 1 record
-		dispatchDesc.MissShaderTable.SizeInBytes = ShaderTableRecordSize; // Assuming sizes here (might want to verify later)
+		// Miss shader location in shader table (regular rays use the first, shadow rays the second)
+		dispatchDesc.MissShaderTable.StartAddress = shaderTableStart + ShaderTableRecordSize; // Offset by 1 record
+		dispatchDesc.MissShaderTable.SizeInBytes = ShaderTableRecordSize * MissShaderCount; // Assuming sizes here (might want to verify later)
 		dispatchDesc.MissShaderTable.StrideInBytes = ShaderTableRecordSize;
 
 		// Hit group location in shader table (we could have multiple types of hit shaders, but only 1 for this demo)
-		dispatchDesc.HitGroupTable.StartAddress = ShaderTable->GetGPUVirtualAddress() + ShaderTableRecordSize * 2; // Offset by 2 records
+		dispatchDesc.HitGroupTable.StartAddress = shaderTableStart + ShaderTableRecordSize * (1 + MissShaderCount); // Offset by raygen and miss records
 		dispatchDesc.HitGroupTable.SizeInBytes = ShaderTableRecordSize; // Assuming sizes here (might want to verify later)
 		dispatchDesc.HitGroupTable.StrideInBytes = ShaderTableRecordSize;
 
@@ -927,25 +1599,163 @@ void RayTracing::Raytrace(std::shared_ptr<Camera> camera, Microsoft::WRL::ComPtr
 		dispatchDesc.Height = Window::Height();
 		dispatchDesc.Depth = 1; // Can have a 3D grid, but we don't need that
 
+		// Zero the counters, which rest in the copy destination state
+		D3D12_WRITEBUFFERIMMEDIATE_PARAMETER zeroCounters[PathCounterCount] = {};
+		for (unsigned int i = 0; i < PathCounterCount; i++)
+			zeroCounters[i].Dest = pathCounters->GetGPUVirtualAddress() + sizeof(UINT) * i;
+		DXRCommandList->WriteBufferImmediate(PathCounterCount, zeroCounters, 0);
+
+		// The last frame's accumulation, G-buffer and motion vector writes (and the
+		// denoiser's reads) must be done before we touch them, and the counters must be writable
+		D3D12_RESOURCE_BARRIER accumulationBarriers[6] = {};
+		accumulationBarriers[0].Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+		accumulationBarriers[0].UAV.pResource = RaytracingAccumulation.Get();
+		accumulationBarriers[1].Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+		accumulationBarriers[1].UAV.pResource = RaytracingLuminanceMoments.Get();
+		accumulationBarriers[2].Transition.pResource = pathCounters.Get();
+		accumulationBarriers[2].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+		accumulationBarriers[2].Transition.StateAfter = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		accumulationBarriers[2].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		accumulationBarriers[3].Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+		accumulationBarriers[3].UAV.pResource = RaytracingNormalDepth.Get();
+		accumulationBarriers[4].Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+		accumulationBarriers[4].UAV.pResource = RaytracingAlbedo.Get();
+		accumulationBarriers[5].Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+		accumulationBarriers[5].UAV.pResource = RaytracingMotionVectors.Get();
+		DXRCommandList->ResourceBarrier(ARRAYSIZE(accumulationBarriers), accumulationBarriers);
+
 		// GO!
-		DXRCommandList->DispatchRays(&dispatchDesc);
+		{
+			GPUProfiler::ScopedZone zone("DispatchRays");
+			DXRCommandList->DispatchRays(&dispatchDesc);
+		}
+
+		// Copy the counters where the CPU can read them once this frame is done
+		accumulationBarriers[2].Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		accumulationBarriers[2].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+		DXRCommandList->ResourceBarrier(1, &accumulationBarriers[2]);
+		DXRCommandList->CopyBufferRegion(
+			pathCountersReadback.Get(),
+			sizeof(UINT) * PathCounterCount * frameIndex,
+			pathCounters.Get(),
+			0,
+			sizeof(UINT) * PathCounterCount);
+		accumulationBarriers[2].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
+		accumulationBarriers[2].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+		DXRCommandList->ResourceBarrier(1, &accumulationBarriers[2]);
+
+		pathCountersPending[frameIndex] = true;
+		pathCountersRun[frameIndex] = accumulationRun;
+
+		Accumulation.EndFrame();
 	}
 
-	// Final copy
-	{
-		// Transition the raytracing output to COPY SOURCE
-		outputBarriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
-		outputBarriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
-		DXRCommandList->ResourceBarrier(1, &outputBarriers[1]);
+	// Assuming command list will be executed elsewhere, once
+	// FinishRecording() says the other threads are done
+}
 
-		// Copy the raytracing output into the back buffer
-		DXRCommandList->CopyResource(currentBackBuffer.Get(), RaytracingOutput.Get());
 
-		// Back buffer back to PRESENT
-		outputBarriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-		outputBarriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
-		DXRCommandList->ResourceBarrier(1, &outputBarriers[0]);
+// --------------------------------------------------------
+// Waits for the passes being recorded on other threads
+// (the TLAS build, denoising and the copy to the back
+// buffer).  Call before the frame is submitted.
+// --------------------------------------------------------
+void RayTracing::FinishRecording()
+{
+	JobSystem::Wait(recordingJobs);
+}
+
+
+// --------------------------------------------------------
+// Samples and rays the GPU has traced since the last reset,
+// or since startup for the totals (as of the latest frame
+// read back)
+// --------------------------------------------------------
+PathTracingStats RayTracing::GetPathTracingStats()
+{
+	return pathStats;
+}
+
+PathTracingStats RayTracing::GetTotalPathTracingStats()
+{
+	return totalPathStats;
+}
+
+void RayTracing::ResetPathTracingStats()
+{
+	pathStats = {};
+}
+
+
+// --------------------------------------------------------
+// Loads an equirectangular Radiance .hdr image to light the
+// scene in place of the constant sky color, along with the
+// distribution used to sample it by brightness.  Returns
+// false (keeping the current sky) if it can't be loaded.
+// 
+// Converting the pixels for the GPU and building the
+// distribution both run on the job system, side by side,
+// so even 8K maps load quickly.
+// --------------------------------------------------------
+bool RayTracing::LoadEnvironmentMap(const std::wstring& file)
+{
+	if (!dxrInitialized)
+		return false;
+
+	TRACE_ZONE("LoadEnvironmentMap");
+
+	RadianceHDR::Image image;
+	std::string error;
+	if (!RadianceHDR::Load(file, image, &error))
+	{
+		printf("\nEnvironment map not loaded (%s) - using a constant sky color.\n", error.c_str());
+		return false;
 	}
 
-	// Assuming command list will be executed elsewhere
+	std::vector<uint32_t> pixels;
+	EnvironmentDistribution distribution;
+	{
+		JobSystem::JobCounter converted;
+		JobSystem::Run([&]() { RadianceHDR::ConvertToSharedExponent(image, pixels); }, &converted);
+		distribution.Build(image);
+		JobSystem::Wait(converted);
+	}
+
+	// The pixels go in the bindless table with the material textures
+	D3D12_CPU_DESCRIPTOR_HANDLE srv = Graphics::CreateTexture(
+		image.Width,
+		image.Height,
+		DXGI_FORMAT_R9G9B9E5_SHAREDEXP,
+		pixels.data(),
+		sizeof(uint32_t));
+	environmentMapIndex = Graphics::GetDescriptorIndex(
+		Graphics::CopySRVsToDescriptorHeapAndGetGPUDescriptorHandle(srv, 1));
+
+	// The CDFs never change, so (like the blue noise) they're
+	// simply read from an upload buffer
+	const std::vector<float>& cdfs = distribution.GetCDFs();
+	Graphics::ReleaseWhenFrameCompletes(EnvironmentCDFBuffer);
+	EnvironmentCDFBuffer = Graphics::CreateBuffer(
+		sizeof(float) * cdfs.size(),
+		D3D12_HEAP_TYPE_UPLOAD,
+		D3D12_RESOURCE_STATE_GENERIC_READ);
+
+	void* cdfAddress = 0;
+	EnvironmentCDFBuffer->Map(0, 0, &cdfAddress);
+	memcpy(cdfAddress, cdfs.data(), sizeof(float) * cdfs.size());
+	EnvironmentCDFBuffer->Unmap(0, 0);
+
+	environmentWidth = distribution.GetWidth();
+	environmentHeight = distribution.GetHeight();
+	Accumulation.Reset();
+	return true;
+}
+
+// --------------------------------------------------------
+// Reports how much memory our acceleration structures use,
+// both as built and after compaction
+// --------------------------------------------------------
+AccelerationStructureMemoryStats RayTracing::GetAccelerationStructureMemoryStats()
+{
+	return accelStructMemory.GetStats();
 }
@@ -9,6 +9,13 @@
 #include "Entity.h"
 #include "Mesh.h"
 #include "Camera.h"
+#include "Light.h"
+#include "AccelerationStructureMemory.h"
+#include "ProgressiveAccumulation.h"
+#include "AdaptiveSampling.h"
+#include "PathSampler.h"
+#include "FrameStats.h"
+#include "SceneSimulation.h"
 
 namespace RayTracing
 {
@@ -42,14 +49,70 @@ namespace RayTracing
 
 	// Accel structure requirements
 	inline Microsoft::WRL::ComPtr<ID3D12Resource> TLASScratchBuffer;
-	inline Microsoft::WRL::ComPtr<ID3D12Resource> BLASScratchBuffer;
-	inline Microsoft::WRL::ComPtr<ID3D12Resource> TLASInstanceDescBuffer;
 	inline Microsoft::WRL::ComPtr<ID3D12Resource> TLAS;
 
+	// Should each BLAS be copied into a tightly-sized buffer
+	// after it's built (see CompactBottomLevelAccelerationStructures)?
+	// Must be set before meshes are created.
+	inline bool CompactBLAS = true;
+
 	// Actual output resource
 	inline Microsoft::WRL::ComPtr<ID3D12Resource> RaytracingOutput;
 	inline D3D12_CPU_DESCRIPTOR_HANDLE RaytracingOutputUAV_CPU;
-	inline D3D12_GPU_DESCRIPTOR_HANDLE RaytracingOutputUAV_GPU;
+	inline D3D12_GPU_DESCRIPTOR_HANDLE RaytracingOutputUAV_GPU;	// Table of output, accumulation, moments, then G-buffer and motion vectors
+
+	// Running average of samples from earlier frames, with its
+	// UAV directly after the output's in the descriptor heap
+	inline Microsoft::WRL::ComPtr<ID3D12Resource> RaytracingAccumulation;
+	inline D3D12_CPU_DESCRIPTOR_HANDLE RaytracingAccumulationUAV_CPU;
+
+	// Per-pixel luminance mean and mean square over the same
+	// samples, with its UAV directly after the accumulation's
+	inline Microsoft::WRL::ComPtr<ID3D12Resource> RaytracingLuminanceMoments;
+	inline D3D12_CPU_DESCRIPTOR_HANDLE RaytracingLuminanceMomentsUAV_CPU;
+
+	// Per-pixel first hit normal and distance, and albedo, averaged
+	// over the same samples for the denoiser, with their UAVs
+	// directly after the moments'
+	inline Microsoft::WRL::ComPtr<ID3D12Resource> RaytracingNormalDepth;
+	inline D3D12_CPU_DESCRIPTOR_HANDLE RaytracingNormalDepthUAV_CPU;
+	inline Microsoft::WRL::ComPtr<ID3D12Resource> RaytracingAlbedo;
+	inline D3D12_CPU_DESCRIPTOR_HANDLE RaytracingAlbedoUAV_CPU;
+
+	// Per-pixel motion vectors for the denoiser's reprojection,
+	// rewritten every frame, with the UAV after the albedo's
+	inline Microsoft::WRL::ComPtr<ID3D12Resource> RaytracingMotionVectors;
+	inline D3D12_CPU_DESCRIPTOR_HANDLE RaytracingMotionVectorsUAV_CPU;
+
+	// Accumulates samples over frames while nothing is moving
+	inline ProgressiveAccumulation Accumulation;
+
+	// Spends samples only on pixels that are still noisy
+	inline AdaptiveSampler AdaptiveSampling;
+
+	// How paths get their random numbers
+	inline PathSampler::SamplerType Sampler = PathSampler::SamplerType::Sobol;
+	inline bool BlueNoiseOffsets = true;
+	inline Microsoft::WRL::ComPtr<ID3D12Resource> BlueNoiseBuffer;
+
+	// HDR sky, sampled in proportion to its brightness (until one
+	// is loaded, the sky is a constant color)
+	inline Microsoft::WRL::ComPtr<ID3D12Resource> EnvironmentCDFBuffer;
+	inline float EnvironmentIntensity = 1.0f;
+
+	// How long paths may get - past the start bounce, Russian
+	// roulette ends paths at random based on their throughput
+	inline unsigned int MaxBounces = 10;
+	inline bool RussianRoulette = true;
+	inline unsigned int RussianRouletteStartBounce = 3;
+
+	// Sample a light (or the sky) with a shadow ray at each hit,
+	// weighted against hitting the sky by chance
+	inline bool NextEventEstimation = true;
+
+	// Pick point and spot lights by how much they could light each
+	// hit (with the light tree) rather than uniformly
+	inline bool LightTreeSampling = true;
 
 	// Other SRVs for geometry
 	// - Larger application will need these FOR EACH MESH
@@ -66,11 +129,23 @@ namespace RayTracing
 		unsigned int outputHeight);
 	void Raytrace(
 		std::shared_ptr<Camera> camera,
-		Microsoft::WRL::ComPtr<ID3D12Resource> currentBackBuffer);
+		Microsoft::WRL::ComPtr<ID3D12Resource> currentBackBuffer,
+		const Light* lights,
+		unsigned int lightCount);
+	void FinishRecording();
+	bool LoadEnvironmentMap(const std::wstring& file);
+	AccelerationStructureMemoryStats GetAccelerationStructureMemoryStats();
+	PathTracingStats GetPathTracingStats();
+	PathTracingStats GetTotalPathTracingStats();
+	void ResetPathTracingStats();
 
 	// Helper functions for each initalization step
 	MeshRaytracingData CreateBottomLevelAccelerationStructureForMesh(Mesh* mesh);
-	void CreateTopLevelAccelerationStructureForScene(std::vector<Entity> scene);
+	void CompactBottomLevelAccelerationStructures(const std::vector<std::shared_ptr<Mesh>>& meshes);
+	void CreateTopLevelAccelerationStructureForScene(
+		const std::vector<Entity>& scene,
+		const std::vector<SceneFloat4x4>& worldMatrices,
+		const std::vector<SceneFloat4x4>& previousWorldMatrices);
 	void CreateRaytracingRootSignatures();
 	void CreateRaytracingPipelineState(std::wstring raytracingShaderLibraryFile);
 	void CreateShaderTable();
@@ -2,6 +2,25 @@
 #define MAX_INSTANCES_PER_BLAS 100
 static const float PI = 3.14159265f;
 
+// Must match PathSampler.h
+static const uint SamplerPCG = 0;
+static const uint SamplerSobol = 1;
+static const uint CameraJitterDimension = 0;
+static const uint FirstBounceDimension = 2;
+static const uint DimensionsPerBounce = 8;
+static const uint BounceDirectionOffset = 0;
+static const uint BounceChoiceOffset = 2;
+static const uint LightChoiceOffset = 4;
+static const uint LightDirectionOffset = 6;
+static const uint BlueNoiseTileSize = 64;
+
+static const float3 SkyColor = float3(0.4f, 0.6f, 0.75f);
+
+// Must match Light.h
+#define LIGHT_TYPE_DIR		    0
+#define LIGHT_TYPE_POINT	    1
+#define LIGHT_TYPE_SPOT		    2
+
 // === Structs ===
 
 // Layout of data in the vertex buffer
@@ -19,11 +38,65 @@ static const uint VertexSizeInBytes = 11 * 4;
 
 // Payload for rays (data that is "sent along" with each ray during raytrace)
 // Note: This should be as small as possible, and must match our C++ size definition
+// - The hit shader fills in the surface it hit, and RayGen decides where the path
+//   goes next, so rays are never traced from a hit shader
 struct RayPayload
 {
-    float3 color;
-    uint recursionDepth;
-    uint rayPerPixelIndex;
+    float3 surfaceColor;
+    float roughness;
+    float3 normal; // World space, after normal mapping
+    float metal;
+    float hitDistance; // Negative for a miss
+    float3 previousPosition; // Where the hit was last frame, for motion vectors
+};
+
+// Payload for shadow rays, which only need to know if anything was in the way
+struct ShadowPayload
+{
+    bool visible; // Only set by the shadow miss shader
+};
+
+// What a path's first ray hit, for the denoiser's G-buffer
+struct FirstHit
+{
+    float3 albedo; // One for the sky
+    float3 normal; // Zero for the sky
+    float distance; // Zero for the sky
+    float3 previousPosition; // Where it was last frame
+};
+
+// Must match Light.h
+struct Light
+{
+    int Type;
+    float3 Direction;
+    float Range;
+    float3 Position;
+    float Intensity;
+    float3 Color;
+    float SpotFallOff;
+    float3 Padding;
+};
+
+// Must match LightTree.h
+struct LightTreeNode
+{
+    float3 boundsMin;
+    float power;
+    float3 boundsMax;
+    float range;
+    float3 axis;
+    float cosThetaO;
+    float cosThetaE;
+    uint index; // Second child, or light
+    uint isLeaf;
+    float padding;
+};
+
+// An instance's world matrix, as rows of the instance description's 3x4
+struct InstanceTransform
+{
+    float4 rows[3];
 };
 
 struct RaytracingMaterial
@@ -71,6 +144,25 @@ cbuffer SceneData : register(b0)
 {
     matrix inverseViewProjection;
     float3 cameraPosition;
+    uint accumulationFrameIndex; // Frames already accumulated (0 = start over)
+    uint samplesPerPixel; // Most samples any pixel traces this frame
+    float adaptiveErrorThreshold; // Relative error a pixel stops sampling at (0 = never stop)
+    uint adaptiveMinSamples; // Samples before the error estimate is trusted
+    float activePixelFraction; // Chance a pixel that needs samples gets them this frame
+    uint samplerType; // SamplerPCG or SamplerSobol
+    uint blueNoiseOffsets; // Offset each pixel's samples by a blue noise tile?
+    uint maxBounces; // Paths still going after this many hits contribute nothing
+    uint russianRouletteStartBounce; // Bounces before paths may be ended at random
+    uint lightCount; // Lights in the Lights buffer
+    uint nextEventEstimation; // Sample lights (and the sky) directly at each hit?
+    uint distantLightCount; // Directional lights, which come first in the Lights buffer
+    uint lightTreeSampling; // Pick point and spot lights with the light tree?
+    uint environmentMapIndex; // Equirectangular HDR sky in AllTextures (-1 for the constant SkyColor)
+    uint environmentWidth; // Size of the environment map's sampling distribution
+    uint environmentHeight;
+    float environmentIntensity; // Scale on the environment map's radiance
+    matrix previousViewProjection; // Last frame's camera, for motion vectors
+    float3 previousCameraPosition;
 };
 
 cbuffer ObjectData : register(b1)
@@ -92,6 +184,25 @@ cbuffer DrawData
 // Output UAV 
 RWTexture2D<float4> OutputColor : register(u0);
 
+// Running average of every sample so far (rgb) and how many samples that is (a)
+RWTexture2D<float4> AccumulationColor : register(u1);
+
+// Running averages of each pixel's luminance (x) and luminance squared (y),
+// over the same samples as the accumulation buffer
+RWTexture2D<float2> LuminanceMoments : register(u2);
+
+// Pixels that needed samples this frame (offset 0), samples traced (offset 4) and rays traced (offset 8)
+RWByteAddressBuffer PathCounters : register(u3);
+
+// Running averages of the first hit's normal (xyz) and distance (w), and
+// its albedo (rgb), over the same samples - these guide the denoiser
+RWTexture2D<float4> GBufferNormalDepth : register(u4);
+RWTexture2D<float4> GBufferAlbedo : register(u5);
+
+// How far each pixel's first hit moved on screen since last frame (xy, in
+// pixels) and its distance from last frame's camera (z), for reprojection
+RWTexture2D<float4> MotionVectors : register(u6);
+
 
 // The actual scene we want to trace through (a TLAS)
 RaytracingAccelerationStructure SceneTLAS : register(t0);
@@ -100,6 +211,21 @@ RaytracingAccelerationStructure SceneTLAS : register(t0);
 ByteAddressBuffer IndexBuffer : register(t1);
 ByteAddressBuffer VertexBuffer : register(t2);
 
+// Tileable blue noise offsets in [0, 1)
+StructuredBuffer<float> BlueNoise : register(t3);
+
+// The same lights the rasterizer uses, with directional lights first
+StructuredBuffer<Light> Lights : register(t4);
+
+// Tree over the point and spot lights, root first
+StructuredBuffer<LightTreeNode> LightTreeNodes : register(t5);
+
+// Environment map's marginal CDF (one per row), then each row's conditional CDF
+StructuredBuffer<float> EnvironmentCDF : register(t6);
+
+// Each instance's world matrix last frame, by instance index
+StructuredBuffer<InstanceTransform> PreviousTransforms : register(t7);
+
 // Textures 
 Texture2D AllTextures[] : register(t0, space1);
 
@@ -108,16 +234,90 @@ SamplerState BasicSampler : register(s0);
 
 
 // === Helpers ===
-float rand(float2 uv)
+
+// Random numbers - must match PathSampler.cpp
+uint PCGHash(uint value)
 {
-    return frac(sin(dot(uv, float2(12.9898, 78.233))) * 43758.5453);
+    uint state = value * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
 }
 
-float2 rand2(float2 uv)
+uint HashCombine(uint seed, uint value)
 {
-    return float2(
-rand(uv),
-rand(uv.yx));
+    return seed ^ (PCGHash(value) + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+uint LaineKarrasPermutation(uint value, uint seed)
+{
+    value += seed;
+    value ^= value * 0x6c50b47cu;
+    value ^= value * 0xb82f1e52u;
+    value ^= value * 0xc7afe638u;
+    value ^= value * 0x8d22f6e6u;
+    return value;
+}
+
+uint NestedUniformScramble(uint value, uint seed)
+{
+    return reversebits(LaineKarrasPermutation(reversebits(value), seed));
+}
+
+float ToUnitFloat(uint value)
+{
+    return (value >> 8) / 16777216.0f;
+}
+
+uint PixelSeed(uint2 pixel)
+{
+    return PCGHash(pixel.x ^ PCGHash(pixel.y));
+}
+
+// Owen-scrambled 2D Sobol or PCG hash, per pixel, sample and dimension
+float2 Sample2D(uint sampleIndex, uint dimension, uint pixelSeed)
+{
+    uint seed = HashCombine(pixelSeed, dimension);
+    float2 u;
+    if (samplerType == SamplerSobol)
+    {
+        uint index = NestedUniformScramble(sampleIndex, seed);
+        uint x = reversebits(index);
+        uint y = 0;
+        for (uint v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+        {
+            if (index & 1)
+                y ^= v;
+        }
+        u = float2(
+            ToUnitFloat(NestedUniformScramble(x, HashCombine(seed, 0))),
+            ToUnitFloat(NestedUniformScramble(y, HashCombine(seed, 1))));
+    }
+    else
+    {
+        uint hash = PCGHash(seed ^ PCGHash(sampleIndex));
+        u = float2(ToUnitFloat(hash), ToUnitFloat(PCGHash(hash)));
+    }
+    
+    // Shift by blue noise, with the tile moved around per dimension
+    // (along the R2 sequence) so dimensions don't share offsets
+    if (blueNoiseOffsets)
+    {
+        uint2 pixel = DispatchRaysIndex().xy;
+        float2 tileOffset0 = frac(dimension * float2(0.7548776662f, 0.5698402910f)) * BlueNoiseTileSize;
+        float2 tileOffset1 = frac((dimension + 1) * float2(0.7548776662f, 0.5698402910f)) * BlueNoiseTileSize;
+        uint2 texel0 = (pixel + (uint2) tileOffset0) % BlueNoiseTileSize;
+        uint2 texel1 = (pixel + (uint2) tileOffset1) % BlueNoiseTileSize;
+        u = frac(u + float2(
+            BlueNoise[texel0.y * BlueNoiseTileSize + texel0.x],
+            BlueNoise[texel1.y * BlueNoiseTileSize + texel1.x]));
+    }
+    return u;
+}
+
+// Chance a path carries on past Russian roulette - must match PathSampler::RouletteSurvival()
+float RouletteSurvival(float3 throughput)
+{
+    return min(max(throughput.r, max(throughput.g, throughput.b)), 1.0f);
 }
 
 float3 RandomVector(float u0, float u1)
@@ -142,6 +342,34 @@ float3 RandomCosineWeightedHemisphere(float u0, float u1, float3 unitNormal)
     return float3(x, y, z);
 }
 
+// Cheap integer hash mapped to [0, 1) - must match AdaptiveSampler::PixelHash01()
+float PixelHash01(uint2 pixel, uint frame)
+{
+    uint h = pixel.x * 1973u + pixel.y * 9277u + frame * 26699u;
+    h = (h ^ 61u) ^ (h >> 16);
+    h *= 9u;
+    h ^= h >> 4;
+    h *= 0x27d4eb2du;
+    h ^= h >> 15;
+    return (h >> 8) / 16777216.0f;
+}
+
+float Luminance(float3 color)
+{
+    return dot(color, float3(0.2126f, 0.7152f, 0.0722f));
+}
+
+// Relative standard error of a pixel's mean luminance - must match AdaptiveSampler::RelativeError()
+bool NeedsSamples(float2 moments, float sampleCount)
+{
+    if (adaptiveErrorThreshold <= 0 || sampleCount < adaptiveMinSamples || sampleCount <= 1)
+        return true;
+
+    float variance = max(moments.y - moments.x * moments.x, 0);
+    float standardError = sqrt(variance / sampleCount);
+    return standardError / max(moments.x, 0.01f) > adaptiveErrorThreshold;
+}
+
 // Loads the indices of the specified triangle from the index buffer
 uint3 LoadIndices(uint triangleIndex)
 {
@@ -238,6 +466,430 @@ float FresnelView(float3 n, float3 v, float f0)
     return f0 + (1 - f0) * pow(1 - NdotV, 5);
 }
 
+// Equirectangular mapping - must match EnvironmentDistribution.cpp
+float2 DirectionToEquirect(float3 direction)
+{
+    return float2(
+        (atan2(direction.z, direction.x) + PI) / (2 * PI),
+        acos(clamp(direction.y, -1, 1)) / PI);
+}
+
+float3 EquirectToDirection(float2 uv)
+{
+    float theta = uv.y * PI;
+    float phi = uv.x * 2 * PI - PI;
+    return float3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+}
+
+// First entry of a CDF above u, by binary search
+uint FindInCDF(uint start, uint count, float u)
+{
+    uint low = 0;
+    uint high = count - 1;
+    while (low < high)
+    {
+        uint middle = (low + high) / 2;
+        if (EnvironmentCDF[start + middle] > u)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    return low;
+}
+
+// Direction towards the environment map, picked in proportion to its
+// brightness, with a solid angle pdf - must match EnvironmentDistribution::Sample()
+// and the copy in Tests/EnvironmentDistributionTests.cpp
+float3 SampleEnvironment(float2 u, out float pdf)
+{
+    uint y = FindInCDF(0, environmentHeight, u.y);
+    float rowStart = y > 0 ? EnvironmentCDF[y - 1] : 0;
+    float rowEnd = EnvironmentCDF[y];
+
+    uint row = environmentHeight + y * environmentWidth;
+    uint x = FindInCDF(row, environmentWidth, u.x);
+    float columnStart = x > 0 ? EnvironmentCDF[row + x - 1] : 0;
+    float columnEnd = EnvironmentCDF[row + x];
+
+    float2 uv = float2(
+        (x + (u.x - columnStart) / max(columnEnd - columnStart, 1e-12f)) / environmentWidth,
+        (y + (u.y - rowStart) / max(rowEnd - rowStart, 1e-12f)) / environmentHeight);
+
+    float sinTheta = sin(uv.y * PI);
+    float pdfUV = (rowEnd - rowStart) * environmentHeight * (columnEnd - columnStart) * environmentWidth;
+    pdf = sinTheta > 0 ? pdfUV / (2 * PI * PI * sinTheta) : 0;
+    return EquirectToDirection(uv);
+}
+
+// Must match EnvironmentDistribution::Pdf() and the test's copy
+float EnvironmentPdf(float3 direction)
+{
+    float2 uv = DirectionToEquirect(direction);
+    uint x = min((uint) (uv.x * environmentWidth), environmentWidth - 1);
+    uint y = min((uint) (uv.y * environmentHeight), environmentHeight - 1);
+
+    uint row = environmentHeight + y * environmentWidth;
+    float rowProbability = EnvironmentCDF[y] - (y > 0 ? EnvironmentCDF[y - 1] : 0);
+    float columnProbability = EnvironmentCDF[row + x] - (x > 0 ? EnvironmentCDF[row + x - 1] : 0);
+
+    float sinTheta = sqrt(max(1 - direction.y * direction.y, 0));
+    float pdfUV = rowProbability * environmentHeight * columnProbability * environmentWidth;
+    return sinTheta > 0 ? pdfUV / (2 * PI * PI * sinTheta) : 0;
+}
+
+// Light arriving from the sky along a direction
+float3 SkyRadiance(float3 direction)
+{
+    if (environmentMapIndex == -1)
+        return SkyColor;
+
+    float2 uv = DirectionToEquirect(direction);
+    return AllTextures[environmentMapIndex].SampleLevel(BasicSampler, uv, 0).rgb * environmentIntensity;
+}
+
+// Direction to sample the sky from - by brightness with an environment
+// map, otherwise cosine-weighted around the normal (the constant sky
+// is the same everywhere, so that's the best there is)
+float3 SampleSky(float2 u, float3 normal, out float pdf)
+{
+    if (environmentMapIndex != -1)
+        return SampleEnvironment(u, pdf);
+
+    float3 direction = normalize(RandomCosineWeightedHemisphere(u.x, u.y, normal));
+    pdf = saturate(dot(normal, direction)) / PI;
+    return direction;
+}
+
+// Must match SampleSky()
+float SkyPdf(float3 direction, float3 normal)
+{
+    if (environmentMapIndex != -1)
+        return EnvironmentPdf(direction);
+
+    return saturate(dot(normal, direction)) / PI;
+}
+
+// Power heuristic weight for a strategy with the given pdf, against another
+float PowerHeuristic(float pdf, float otherPdf)
+{
+    return pdf * pdf / max(pdf * pdf + otherPdf * otherPdf, 0.000001f);
+}
+
+// Is there a clear line from the origin along the direction, out to maxDistance?
+// - Stops at the first thing hit and skips the hit shader, since any hit at all
+//   means the light is blocked
+bool Visible(float3 origin, float3 direction, float maxDistance, inout uint rayCount)
+{
+    RayDesc ray;
+    ray.Origin = origin;
+    ray.Direction = direction;
+    ray.TMin = 0.0001f;
+    ray.TMax = maxDistance;
+
+    rayCount++;
+    ShadowPayload payload = (ShadowPayload) 0;
+    TraceRay(
+        SceneTLAS,
+        RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER,
+        0xFF,
+        0,
+        0,
+        1, // Shadow miss shader
+        ray,
+        payload);
+    return payload.visible;
+}
+
+// Upper bound on what a light tree node's lights could contribute at a
+// point - must match LightTree::Importance()
+float LightTreeImportance(LightTreeNode node, float3 position, float3 normal)
+{
+    // Out of range of every light?
+    float3 toClosest = clamp(position, node.boundsMin, node.boundsMax) - position;
+    if (dot(toClosest, toClosest) > node.range * node.range)
+        return 0;
+
+    float3 center = (node.boundsMin + node.boundsMax) / 2;
+    float3 halfSize = node.boundsMax - center;
+    float radiusSquared = dot(halfSize, halfSize);
+    float3 toCenter = center - position;
+    float distanceSquared = dot(toCenter, toCenter);
+    float distance = sqrt(distanceSquared);
+
+    // Angle the bounds cover from here (all of it from inside)
+    float thetaU = distanceSquared > radiusSquared ? asin(sqrt(radiusSquared / distanceSquared)) : PI;
+    float3 direction = distance > 0 ? toCenter / distance : normal;
+
+    // Could the lights shine this way?
+    float theta = acos(clamp(-dot(node.axis, direction), -1, 1));
+    float thetaPrime = max(theta - acos(node.cosThetaO) - thetaU, 0);
+    if (thetaPrime >= acos(node.cosThetaE))
+        return 0;
+
+    // Could the surface face them?
+    float thetaI = acos(clamp(dot(normal, direction), -1, 1));
+    float thetaIPrime = max(thetaI - thetaU, 0);
+    if (thetaIPrime >= PI / 2)
+        return 0;
+
+    return node.power * cos(thetaPrime) * cos(thetaIPrime) / max(max(distanceSquared, radiusSquared), 0.000001f);
+}
+
+// Walks the light tree from the root, choosing each child by importance,
+// and returns the light it ends at (or -1) - must match LightTree::Sample()
+int SampleLightTree(float u, float3 position, float3 normal, out float pdf)
+{
+    pdf = 1.0f;
+    uint nodeIndex = 0;
+    while (!LightTreeNodes[nodeIndex].isLeaf)
+    {
+        uint second = LightTreeNodes[nodeIndex].index;
+        float first = LightTreeImportance(LightTreeNodes[nodeIndex + 1], position, normal);
+        float total = first + LightTreeImportance(LightTreeNodes[second], position, normal);
+        if (total <= 0)
+        {
+            pdf = 0;
+            return -1;
+        }
+
+        // Reuse the random number, rescaled into the chosen child's share
+        float firstProbability = first / total;
+        if (u < firstProbability)
+        {
+            u = min(u / firstProbability, 0.99999994f);
+            pdf *= firstProbability;
+            nodeIndex++;
+        }
+        else
+        {
+            u = min((u - firstProbability) / (1 - firstProbability), 0.99999994f);
+            pdf *= 1 - firstProbability;
+            nodeIndex = second;
+        }
+    }
+    return LightTreeNodes[nodeIndex].index;
+}
+
+// Chance of picking the sky to sample directly - the same with or
+// without the light tree, which only shares out the point and spot
+// lights' part differently
+float SkySelectionPdf()
+{
+    return 1.0f / (lightCount + 1);
+}
+
+// Light reaching a surface's diffuse lobe directly, from one light picked
+// at random (or the sky, which is one more choice).  The lights are all
+// infinitely small, so only this can ever find them, but the sky can also
+// be hit by a diffuse bounce - its sample is weighted against that.
+// - diffuseWeight is the chance the surface scatters diffusely (1 - fresnel)
+float3 SampleDirectLight(float3 position, float3 normal, float3 surfaceColor, float diffuseWeight, float2 choiceSample, float2 directionSample, inout uint rayCount)
+{
+    // Point and spot lights get the same overall chance with the tree as
+    // without it, but the tree shares that out by importance
+    float treeChance = lightTreeSampling ? (lightCount - distantLightCount) * SkySelectionPdf() : 0;
+    int choice;
+    float selectionPdf;
+    bool sky = false;
+    if (choiceSample.x < treeChance)
+    {
+        float treePdf;
+        choice = SampleLightTree(choiceSample.x / treeChance, position, normal, treePdf);
+        if (choice < 0)
+            return float3(0, 0, 0);
+        selectionPdf = treeChance * treePdf;
+    }
+    else
+    {
+        // Uniformly among the rest: directional lights and the sky
+        // (or every light, without the tree)
+        uint candidates = (lightTreeSampling ? distantLightCount : lightCount) + 1;
+        float u = (choiceSample.x - treeChance) / (1 - treeChance);
+        choice = min((uint) (u * candidates), candidates - 1);
+        selectionPdf = (1 - treeChance) / candidates;
+        sky = choice == candidates - 1;
+    }
+
+    // Diffuse BRDF: (1 - fresnel) * surfaceColor / PI
+    float3 brdf = diffuseWeight * surfaceColor / PI;
+
+    if (sky)
+    {
+        // Weighted against a diffuse bounce finding the same direction
+        float skyPdf;
+        float3 dir = SampleSky(directionSample, normal, skyPdf);
+        float cosTheta = dot(normal, dir);
+        if (skyPdf <= 0 || cosTheta <= 0 || !Visible(position, dir, 1000.0f, rayCount))
+            return float3(0, 0, 0);
+
+        float lightPdf = selectionPdf * skyPdf;
+        float misWeight = PowerHeuristic(lightPdf, diffuseWeight * cosTheta / PI);
+        return brdf * SkyRadiance(dir) * cosTheta * misWeight / lightPdf;
+    }
+
+    Light light = Lights[choice];
+    float3 toLight;
+    float distance;
+    float attenuation = 1.0f;
+    if (light.Type == LIGHT_TYPE_DIR)
+    {
+        toLight = normalize(-light.Direction);
+        distance = 1000.0f;
+    }
+    else
+    {
+        toLight = light.Position - position;
+        distance = length(toLight);
+        toLight /= distance;
+
+        // Same falloff as the rasterizer, reaching zero at the light's range
+        float falloff = saturate(1.0f - distance * distance / (light.Range * light.Range));
+        attenuation = falloff * falloff;
+        if (light.Type == LIGHT_TYPE_SPOT)
+            attenuation *= pow(saturate(dot(-toLight, normalize(light.Direction))), light.SpotFallOff);
+    }
+
+    float cosTheta = dot(normal, toLight);
+    if (cosTheta <= 0 || attenuation <= 0 || !Visible(position, toLight, distance, rayCount))
+        return float3(0, 0, 0);
+
+    float3 radiance = light.Color * light.Intensity * attenuation;
+    return brdf * radiance * cosTheta / selectionPdf;
+}
+
+// Follows one path from the camera, bouncing until it escapes to the sky,
+// returning the light it carries back.  Each bounce gets its own random
+// number dimensions, so the path is the same whichever order it's traced in.
+// - With next event estimation, each hit also samples a light directly
+// - The first ray's hit is also handed back, for the denoiser
+float3 TracePath(RayDesc ray, uint sampleIndex, uint pixelSeed, inout uint rayCount, out FirstHit firstHit)
+{
+    float3 radiance = float3(0, 0, 0);
+    float3 throughput = float3(1, 1, 1);
+    firstHit = (FirstHit) 0;
+    
+    // Pdf of the latest bounce, if it was diffuse and the sky was also
+    // sampled directly from that hit (0 otherwise), and the hit's normal
+    float diffusePdf = 0;
+    float3 lastNormal = float3(0, 1, 0);
+    for (uint bounce = 0; ; bounce++)
+    {
+        rayCount++;
+        RayPayload payload = (RayPayload) 0;
+        TraceRay(
+            SceneTLAS,
+            RAY_FLAG_NONE,
+            0xFF,
+            0,
+            0,
+            0,
+            ray,
+            payload);
+        
+        if (bounce == 0)
+        {
+            bool sky = payload.hitDistance < 0;
+            firstHit.albedo = sky ? float3(1, 1, 1) : payload.surfaceColor;
+            firstHit.normal = sky ? float3(0, 0, 0) : payload.normal;
+            firstHit.distance = sky ? 0 : payload.hitDistance;
+            firstHit.previousPosition = payload.previousPosition;
+        }
+        
+        // Nothing was hit, so the sky lights the path, weighted
+        // against sampling it directly from the last hit
+        if (payload.hitDistance < 0)
+        {
+            float skyWeight = diffusePdf > 0 ?
+                PowerHeuristic(diffusePdf, SkySelectionPdf() * SkyPdf(ray.Direction, lastNormal)) :
+                1.0f;
+            return radiance + throughput * SkyRadiance(ray.Direction) * skyWeight;
+        }
+        
+        // Too many bounces - give up on this path
+        if (bounce == maxBounces)
+            return radiance;
+        
+        // Random numbers for this bounce: a direction, whether it
+        // reflects, whether the path survives Russian roulette, and
+        // which light to sample and from where
+        uint dimension = FirstBounceDimension + bounce * DimensionsPerBounce;
+        float2 bounceSample = Sample2D(sampleIndex, dimension + BounceDirectionOffset, pixelSeed);
+        float2 choiceSample = Sample2D(sampleIndex, dimension + BounceChoiceOffset, pixelSeed);
+        float reflectionSample = choiceSample.x;
+        float3 hitPosition = ray.Origin + ray.Direction * payload.hitDistance;
+        
+        // Interpolate based on roughness & calc direction
+        float3 refl = reflect(ray.Direction, payload.normal);
+        float3 randomBounce = RandomCosineWeightedHemisphere(bounceSample.x, bounceSample.y, payload.normal);
+        float3 dir = normalize(lerp(refl, randomBounce, payload.roughness));
+        
+        // Interpolate between fully random bounce and roughness-based bounce based on fresnel/metal switch
+        // - If we're a "diffuse" ray, we need a random bounce
+        // - If we're a "specular" ray, we need the roughness-based bounce
+        // - Metals will have a fresnel result of 1.0, so this won't affect them
+        float fres = FresnelView(-ray.Direction, payload.normal, lerp(0.04f, 1.0f, payload.metal));
+        dir = normalize(lerp(randomBounce, dir, fres > reflectionSample));
+        
+        // Light this hit directly, through its diffuse lobe
+        diffusePdf = 0;
+        lastNormal = payload.normal;
+        if (nextEventEstimation && fres < 1.0f)
+        {
+            float2 lightChoiceSample = Sample2D(sampleIndex, dimension + LightChoiceOffset, pixelSeed);
+            float2 lightDirectionSample = Sample2D(sampleIndex, dimension + LightDirectionOffset, pixelSeed);
+            radiance += throughput * SampleDirectLight(hitPosition, payload.normal, payload.surfaceColor, 1.0f - fres, lightChoiceSample, lightDirectionSample, rayCount);
+            
+            // A diffuse bounce finding the sky shares it with the sample above
+            if (fres <= reflectionSample)
+                diffusePdf = (1.0f - fres) * saturate(dot(payload.normal, dir)) / PI;
+        }
+        
+        // Determine how we color the ray:
+        // - If this is a "diffuse" ray, use the surface color
+        // - If this is a "specular" ray, assume a bounce without tint
+        // - Metals always tint, so the final lerp below takes care of that
+        float3 roughnessBounceColor = lerp(float3(1, 1, 1), payload.surfaceColor, payload.roughness); // Dir is roughness-based, so color is too
+        float3 diffuseColor = lerp(payload.surfaceColor, roughnessBounceColor, fres > reflectionSample); // Diffuse "reflection" chance
+        float3 finalColor = lerp(diffuseColor, payload.surfaceColor, payload.metal); // Metal always tints
+        throughput *= finalColor;
+        
+        // Russian roulette: once the path is a few bounces long, end it with
+        // a chance based on how little light it can still carry, and boost
+        // the survivors by the same amount so the average is unchanged
+        if (bounce + 1 >= russianRouletteStartBounce)
+        {
+            float survival = RouletteSurvival(throughput);
+            if (choiceSample.y >= survival)
+                return radiance;
+            throughput /= survival;
+        }
+        
+        // Continue from the hit
+        ray.Origin = hitPosition;
+        ray.Direction = dir;
+        ray.TMin = 0.0001f;
+        ray.TMax = 1000.0f;
+    }
+}
+
+// Motion vector for a first hit seen from a (continuous) pixel position - must
+// match TemporalReprojection.cpp.  Points behind last frame's camera end up off
+// screen, and the sky only moves when the camera turns.
+float4 MotionVector(float2 screenPosition, float3 direction, FirstHit firstHit)
+{
+    bool sky = firstHit.distance == 0;
+    float4 previousClip = sky ?
+        mul(previousViewProjection, float4(direction, 0)) :
+        mul(previousViewProjection, float4(firstHit.previousPosition, 1));
+    
+    float2 previousScreen = float2(-1, -1);
+    if (previousClip.w > 0)
+        previousScreen = (previousClip.xy / previousClip.w * float2(0.5f, -0.5f) + 0.5f) * DispatchRaysDimensions().xy;
+    
+    float previousDistance = sky ? 0 : length(firstHit.previousPosition - previousCameraPosition);
+    return float4(previousScreen - screenPosition, previousDistance, 0);
+}
+
 
 // === Shaders ===
 
@@ -248,42 +900,84 @@ void RayGen()
 {
     // Get the ray indices
     uint2 rayIndices = DispatchRaysIndex().xy;
-    float3 totalColor = float3(0, 0, 0);
     
-    int raysPerPixel = 25;
-    for (int r = 0; r < raysPerPixel; r++)
+    // Pick up where earlier frames left off
+    bool startOver = accumulationFrameIndex == 0;
+    float4 history = startOver ? float4(0, 0, 0, 0) : AccumulationColor[rayIndices];
+    float2 moments = startOver ? float2(0, 0) : LuminanceMoments[rayIndices];
+    float4 normalDepth = startOver ? float4(0, 0, 0, 0) : GBufferNormalDepth[rayIndices];
+    float3 albedo = startOver ? float3(0, 0, 0) : GBufferAlbedo[rayIndices].rgb;
+    float3 accumulated = history.rgb;
+    float sampleCount = history.a;
+    
+    // Does this pixel still need samples, and is there budget for it?
+    // Pixels without any samples always get some, so there are no holes.
+    bool active = NeedsSamples(moments, sampleCount);
+    bool traced = active && (sampleCount == 0 || PixelHash01(rayIndices, accumulationFrameIndex) < activePixelFraction);
+    
+    // Every sample so far has its own index, so accumulated
+    // frames don't just repeat the same samples
+    int raysPerPixel = traced ? samplesPerPixel : 0;
+    uint pixelSeed = PixelSeed(rayIndices);
+    uint raysTraced = 0;
+    
+    // Pixels that aren't traced haven't moved, since anything
+    // moving starts every pixel over
+    float4 motion = float4(0, 0, normalDepth.w, 0);
+    int r = 0;
+    for (; r < raysPerPixel; r++)
     {
+        // Stop early once this frame's samples are enough
+        if (r > 0 && !NeedsSamples(moments, sampleCount))
+            break;
+        
+        // Jitter within the pixel (CalcRayFromCamera() aims at its center)
         float2 adjustedIndices = (float2) rayIndices;
-        float ray01 = (float) r / raysPerPixel;
-        adjustedIndices += rand2(rayIndices.xy * ray01);
+        adjustedIndices += Sample2D((uint) sampleCount, CameraJitterDimension, pixelSeed) - 0.5f;
 		
 		// Calculate the ray from the camera through a particular
 		// pixel of the output buffer using this shader's indices
         RayDesc ray = CalcRayFromCamera(adjustedIndices);
 
-		// Set up the payload for the ray
-        // This initializes the struct to all zeros
-        RayPayload payload = (RayPayload) 0;
-        payload.color = float3(1, 1, 1);
-        payload.recursionDepth = 0;
-        payload.rayPerPixelIndex = r;
+        // Follow this sample's path through the scene
+        FirstHit firstHit;
+        float3 color = TracePath(ray, (uint) sampleCount, pixelSeed, raysTraced, firstHit);
+        
+        // This frame's first sample says how the pixel moved
+        if (r == 0)
+            motion = MotionVector(adjustedIndices + 0.5f, ray.Direction, firstHit);
 
-	// Perform the ray trace for this ray
-        TraceRay(
-		SceneTLAS,
-		RAY_FLAG_NONE,
-		0xFF,
-		0,
-		0,
-		0,
-		ray,
-		payload);
-
-        totalColor += payload.color;
+        // Blend into the running averages, weighted by sample count
+        sampleCount += 1;
+        float luminance = Luminance(color);
+        accumulated = lerp(accumulated, color, 1.0f / sampleCount);
+        moments = lerp(moments, float2(luminance, luminance * luminance), 1.0f / sampleCount);
+        normalDepth = lerp(normalDepth, float4(firstHit.normal, firstHit.distance), 1.0f / sampleCount);
+        albedo = lerp(albedo, firstHit.albedo, 1.0f / sampleCount);
+    }
+    
+    if (r > 0)
+    {
+        AccumulationColor[rayIndices] = float4(accumulated, sampleCount);
+        LuminanceMoments[rayIndices] = moments;
+        GBufferNormalDepth[rayIndices] = normalDepth;
+        GBufferAlbedo[rayIndices] = float4(albedo, 1);
+    }
+    MotionVectors[rayIndices] = motion;
+    
+    // (The denoiser overwrites this when it's on)
+    OutputColor[rayIndices] = float4(pow(accumulated, 1.0f / 2.2f), 1);
+    
+    // Count for the CPU's budget - one atomic per wave rather than per pixel
+    uint activeInWave = WaveActiveCountBits(active);
+    uint samplesInWave = WaveActiveSum((uint) r);
+    uint raysInWave = WaveActiveSum(raysTraced);
+    if (WaveIsFirstLane())
+    {
+        PathCounters.InterlockedAdd(0, activeInWave);
+        PathCounters.InterlockedAdd(4, samplesInWave);
+        PathCounters.InterlockedAdd(8, raysInWave);
     }
-    // Average results
-    float3 avg = totalColor / raysPerPixel;
-    OutputColor[rayIndices] = float4(pow(avg,1.0f/2.2f), 1);
 
 }
 
@@ -292,22 +986,25 @@ void RayGen()
 [shader("miss")]
 void Miss(inout RayPayload payload)
 {
-	// Nothing was hit, so return black for now.
-	// Ideally this is where we would do skybox stuff!
-    payload.color *= float3(0.4f, 0.6f, 0.75f);
+	// Nothing was hit, so let RayGen know to use the sky
+    payload.hitDistance = -1;
+}
+
+
+// Shadow miss shader - Nothing was in the way of a shadow ray
+[shader("miss")]
+void ShadowMiss(inout ShadowPayload payload)
+{
+    payload.visible = true;
 }
 
 
 // Closest hit shader - Runs the first time a ray hits anything
+// - Only describes the surface, since the material data lives
+//   in this hit group's local root signature
 [shader("closesthit")]
 void ClosestHit(inout RayPayload payload, BuiltInTriangleIntersectionAttributes hitAttributes)
 {
-    if (payload.recursionDepth == 10)
-    {
-        payload.color = float3(0, 0, 0);
-        return;
-    }
-    
     // Get worldspace and tangent normals
     Vertex hit = InterpolateVertices(PrimitiveIndex(), hitAttributes.barycentrics);
     float3 normal_WS = normalize(mul(hit.normal, (float3x3) ObjectToWorld4x3()));
@@ -333,48 +1030,17 @@ void ClosestHit(inout RayPayload payload, BuiltInTriangleIntersectionAttributes
         normal_WS = NormalMapping(normalFromMap, normal_WS, tangent_WS);
     }
     
-    // RNG based on uniform 0-1 values
-    float2 pixelUV = (float2) DispatchRaysIndex().xy / DispatchRaysDimensions().xy;
-    float2 rng = rand2(pixelUV * (payload.recursionDepth + 1) + payload.rayPerPixelIndex + RayTCurrent());
-    
-    // Interpolate based on roughness & calc direction
-    float3 refl = reflect(WorldRayDirection(), normal_WS);
-    float3 randomBounce = RandomCosineWeightedHemisphere(rand(rng), rand(rng.yx), normal_WS);
-    float3 dir = normalize(lerp(refl, randomBounce, roughness));
-    
-	// Interpolate between fully random bounce and roughness-based bounce based on fresnel/metal switch
-	// - If we're a "diffuse" ray, we need a random bounce
-	// - If we're a "specular" ray, we need the roughness-based bounce
-	// - Metals will have a fresnel result of 1.0, so this won't affect them
-    float fres = FresnelView(-WorldRayDirection(), normal_WS, lerp(0.04f, 1.0f, metal));
-    dir = normalize(lerp(randomBounce, dir, fres > rng.x));
-    
-    
-    // Determine how we color the ray:
-	// - If this is a "diffuse" ray, use the surface color
-	// - If this is a "specular" ray, assume a bounce without tint
-	// - Metals always tint, so the final lerp below takes care of that
-    float3 roughnessBounceColor = lerp(float3(1, 1, 1), surfaceColor, roughness); // Dir is roughness-based, so color is too
-    float3 diffuseColor = lerp(surfaceColor, roughnessBounceColor, fres > rng.x); // Diffuse "reflection" chance
-    float3 finalColor = lerp(diffuseColor, surfaceColor, metal); // Metal always tints
-    payload.color *= finalColor;
+    payload.surfaceColor = surfaceColor;
+    payload.roughness = roughness;
+    payload.normal = normal_WS;
+    payload.metal = metal;
+    payload.hitDistance = RayTCurrent();
     
-    RayDesc ray;
-    ray.Origin = WorldRayOrigin() + WorldRayDirection() * RayTCurrent();
-    ray.Direction = dir;
-    ray.TMin = 0.0001f;
-    ray.TMax = 1000.0f;
-    
-    // Recursive ray trace
-    payload.recursionDepth++;
-    TraceRay(
-		SceneTLAS,
-		RAY_FLAG_NONE,
-		0xFF,
-		0,
-		0,
-		0,
-		ray,
-		payload);
-
-}
\ No newline at end of file
+    // Put the hit back where its instance was last frame
+    float4 objectPosition = float4(ObjectRayOrigin() + ObjectRayDirection() * RayTCurrent(), 1);
+    InstanceTransform previousTransform = PreviousTransforms[InstanceIndex()];
+    payload.previousPosition = float3(
+        dot(previousTransform.rows[0], objectPosition),
+        dot(previousTransform.rows[1], objectPosition),
+        dot(previousTransform.rows[2], objectPosition));
+}
@@ -0,0 +1,207 @@
+// Temporal reprojection of the path traced image, before the spatial filter
+// - Must match TemporalReprojection.cpp, which is the CPU reference for it
+
+// Darkest albedo the color is divided by (the same as Denoise.hlsl's)
+static const float MinAlbedo = 0.01f;
+
+// Less bilinear weight than this in the history means there's none
+static const float MinHistoryWeight = 1e-4f;
+
+// === Constant buffers ===
+
+cbuffer ReprojectData : register(b0)
+{
+    uint useHistory; // Is last frame's result there, and wanted?
+    float maxHistorySamples;
+    float clipGamma; // Size of the box history is clipped to, in standard deviations
+    float depthTolerance;
+    float normalThreshold;
+};
+
+
+// === Resources ===
+
+// Written by the path tracer
+RWTexture2D<float4> AccumulationColor : register(u0);
+RWTexture2D<float2> LuminanceMoments : register(u1);
+RWTexture2D<float4> GBufferNormalDepth : register(u2);
+RWTexture2D<float4> GBufferAlbedo : register(u3);
+RWTexture2D<float4> MotionVectors : register(u7);
+
+// This frame's result (for the spatial filter, and next frame's
+// history) and the G-buffer it was made with
+RWTexture2D<float4> TemporalColor : register(u8);
+RWTexture2D<float2> TemporalMoments : register(u9);
+RWTexture2D<float4> SavedNormalDepth : register(u10);
+RWTexture2D<float4> SavedAlbedo : register(u11);
+
+// The same from last frame
+RWTexture2D<float4> HistoryColor : register(u12);
+RWTexture2D<float2> HistoryMoments : register(u13);
+RWTexture2D<float4> HistoryNormalDepth : register(u14);
+RWTexture2D<float4> HistoryAlbedo : register(u15);
+
+
+// === Helpers ===
+
+float Luminance(float3 color)
+{
+    return dot(color, float3(0.2126f, 0.7152f, 0.0722f));
+}
+
+float3 DemodulationAlbedo(float4 albedo)
+{
+    return max(albedo.rgb, MinAlbedo);
+}
+
+float2 DemodulateMoments(float2 moments, float3 albedo)
+{
+    float albedoLuminance = Luminance(albedo);
+    return float2(moments.x / albedoLuminance, moments.y / (albedoLuminance * albedoLuminance));
+}
+
+// Averaged normals aren't unit length, and the sky's is zero
+float3 UnitNormal(float3 normal)
+{
+    float length = sqrt(dot(normal, normal));
+    return length > 0 ? normal / length : float3(0, 0, 0);
+}
+
+// Mean and standard deviation of this frame's illumination over the 3x3 pixels around one
+void NeighborhoodStatistics(int2 pixel, uint width, uint height, out float3 mean, out float3 deviation)
+{
+    float3 sum = float3(0, 0, 0);
+    float3 sumSquared = float3(0, 0, 0);
+    float count = 0;
+    for (int dy = -1; dy <= 1; dy++)
+    {
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            int2 tap = pixel + int2(dx, dy);
+            if (any(tap < 0) || tap.x >= (int) width || tap.y >= (int) height)
+                continue;
+
+            float3 illumination = AccumulationColor[tap].rgb / DemodulationAlbedo(GBufferAlbedo[tap]);
+            sum += illumination;
+            sumSquared += illumination * illumination;
+            count++;
+        }
+    }
+
+    mean = sum / count;
+    deviation = sqrt(max(sumSquared / count - mean * mean, 0.0f));
+}
+
+// Moves a color toward the center of a box until it's inside, keeping its hue
+float3 ClipToBox(float3 color, float3 center, float3 extents)
+{
+    float3 offset = color - center;
+    float3 units = abs(offset) / max(extents, 1e-6f);
+    float maxUnits = max(units.x, max(units.y, units.z));
+    return maxUnits > 1 ? center + offset / maxUnits : color;
+}
+
+// Follows a pixel's motion vector into the history and filters the bilinear
+// taps there that saw the same surface - returns false if none did
+bool Reproject(int2 pixel, uint width, uint height, float3 normal, out float3 illumination, out float2 moments, out float sampleCount)
+{
+    float4 motion = MotionVectors[pixel];
+
+    // Pixel centers are at half pixels on both sides, so they cancel out
+    float2 previous = pixel + motion.xy;
+    float2 base = floor(previous);
+    float2 fraction = previous - base;
+
+    illumination = float3(0, 0, 0);
+    moments = float2(0, 0);
+    sampleCount = 0;
+    float weightSum = 0;
+    for (int j = 0; j < 2; j++)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            int2 tap = (int2) base + int2(i, j);
+            if (any(tap < 0) || tap.x >= (int) width || tap.y >= (int) height)
+                continue;
+
+            // Did this tap see the same surface?
+            float4 tapNormalDepth = HistoryNormalDepth[tap];
+            if (dot(normal, UnitNormal(tapNormalDepth.xyz)) < normalThreshold ||
+                abs(tapNormalDepth.w - motion.z) > depthTolerance * motion.z)
+                continue;
+
+            float weight = (i ? fraction.x : 1 - fraction.x) * (j ? fraction.y : 1 - fraction.y);
+            float3 tapAlbedo = DemodulationAlbedo(HistoryAlbedo[tap]);
+            float4 tapColor = HistoryColor[tap];
+            illumination += tapColor.rgb / tapAlbedo * weight;
+            moments += DemodulateMoments(HistoryMoments[tap], tapAlbedo) * weight;
+            sampleCount += tapColor.a * weight;
+            weightSum += weight;
+        }
+    }
+
+    if (weightSum < MinHistoryWeight)
+        return false;
+
+    illumination /= weightSum;
+    moments /= weightSum;
+    sampleCount /= weightSum;
+    return true;
+}
+
+
+// === Shaders ===
+
+[numthreads(8, 8, 1)]
+void main(uint3 threadID : SV_DispatchThreadID)
+{
+    uint width, height;
+    TemporalColor.GetDimensions(width, height);
+    if (threadID.x >= width || threadID.y >= height)
+        return;
+
+    int2 pixel = (int2) threadID.xy;
+    float4 color = AccumulationColor[pixel];
+    float4 normalDepth = GBufferNormalDepth[pixel];
+    float4 albedo = GBufferAlbedo[pixel];
+
+    float3 demodulationAlbedo = DemodulationAlbedo(albedo);
+    float3 illumination = color.rgb / demodulationAlbedo;
+    float2 illuminationMoments = DemodulateMoments(LuminanceMoments[pixel], demodulationAlbedo);
+    float sampleCount = color.a;
+
+    // The sky is already noise free
+    // (Both sides of && are evaluated, so this can't be one condition)
+    float3 normal = UnitNormal(normalDepth.xyz);
+    float3 previousIllumination;
+    float2 previousMoments;
+    float previousSampleCount;
+    bool reprojected = false;
+    if (useHistory && any(normal != 0))
+        reprojected = Reproject(pixel, width, height, normal, previousIllumination, previousMoments, previousSampleCount);
+
+    if (reprojected)
+    {
+        float3 mean, deviation;
+        NeighborhoodStatistics(pixel, width, height, mean, deviation);
+        previousIllumination = ClipToBox(previousIllumination, mean, deviation * clipGamma);
+
+        // Each side counts for its samples, with history capped
+        float historySamples = min(previousSampleCount, maxHistorySamples);
+        float totalSamples = sampleCount + historySamples;
+        if (totalSamples > 0)
+        {
+            float historyWeight = historySamples / totalSamples;
+            illumination = lerp(illumination, previousIllumination, historyWeight);
+            illuminationMoments = lerp(illuminationMoments, previousMoments, historyWeight);
+            sampleCount = totalSamples;
+        }
+    }
+
+    // Back into the form the path tracer writes
+    float albedoLuminance = Luminance(demodulationAlbedo);
+    TemporalColor[pixel] = float4(illumination * demodulationAlbedo, sampleCount);
+    TemporalMoments[pixel] = illuminationMoments * float2(albedoLuminance, albedoLuminance * albedoLuminance);
+    SavedNormalDepth[pixel] = normalDepth;
+    SavedAlbedo[pixel] = albedo;
+}
@@ -0,0 +1,138 @@
+#include "RingAllocator.h"
+
+// Makes use of integer division to ensure we are aligned to the proper multiple of "alignment"
+#define ALIGN(value, alignment) (((value + alignment - 1) / alignment) * alignment)
+
+RingAllocator::RingAllocator(uint64_t capacity)
+{
+	Reset(capacity);
+}
+
+// --------------------------------------------------------
+// Clears all allocations and pending frames, and sets up
+// the ring with a new overall capacity.  Lifetime stats
+// (high-water mark, failures, stalls) are kept.
+// --------------------------------------------------------
+void RingAllocator::Reset(uint64_t capacity)
+{
+	this->capacity = capacity;
+	head = 0;
+	tail = 0;
+	used = 0;
+	currentFrameSize = 0;
+	pendingFrames.clear();
+	stats.Capacity = capacity;
+}
+
+// --------------------------------------------------------
+// Reserves a chunk of the ring and returns its offset, or
+// InvalidOffset if there isn't enough retired space.  If
+// the chunk won't fit before the end of the ring, the
+// leftover space is skipped and the chunk goes at the start.
+//
+// size      - How much space to reserve
+// alignment - Required alignment of the returned offset
+// --------------------------------------------------------
+uint64_t RingAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	if (alignment == 0)
+		alignment = 1;
+
+	// Completely empty?  Start over at the beginning so we have
+	// the largest possible contiguous chunk available
+	if (used == 0)
+	{
+		head = 0;
+		tail = 0;
+	}
+
+	uint64_t offset = InvalidOffset;
+	uint64_t reserved = 0;
+	uint64_t alignedHead = ALIGN(head, alignment);
+
+	if (size > 0 && size <= capacity && used < capacity)
+	{
+		if (head >= tail)
+		{
+			// Free space is [head, capacity) and [0, tail)
+			if (alignedHead + size <= capacity)
+			{
+				offset = alignedHead;
+				reserved = alignedHead + size - head;
+			}
+			else if (size <= tail)
+			{
+				// Skip the end of the ring and wrap around
+				offset = 0;
+				reserved = (capacity - head) + size;
+			}
+		}
+		else if (alignedHead + size <= tail)
+		{
+			// Free space is [head, tail)
+			offset = alignedHead;
+			reserved = alignedHead + size - head;
+		}
+	}
+
+	// Did it fit?
+	if (offset == InvalidOffset)
+	{
+		stats.FailedAllocations++;
+		return InvalidOffset;
+	}
+
+	// Move the head, wrapping back to zero if necessary
+	head = offset + size;
+	if (head == capacity)
+		head = 0;
+
+	used += reserved;
+	currentFrameSize += reserved;
+	if (used > stats.HighWaterMark)
+		stats.HighWaterMark = used;
+
+	return offset;
+}
+
+// --------------------------------------------------------
+// Tags everything allocated since the last call with the
+// given fence value.  Call this once per frame, right
+// before the fence is signaled.
+// --------------------------------------------------------
+void RingAllocator::FinishFrame(uint64_t fenceValue)
+{
+	// Nothing allocated, so nothing to track
+	if (currentFrameSize == 0)
+		return;
+
+	pendingFrames.push_back({ fenceValue, head, currentFrameSize });
+	currentFrameSize = 0;
+}
+
+// --------------------------------------------------------
+// Releases the space used by all frames whose fence value
+// is less than or equal to the given completed value
+// --------------------------------------------------------
+void RingAllocator::Retire(uint64_t completedFenceValue)
+{
+	while (!pendingFrames.empty() && pendingFrames.front().FenceValue <= completedFenceValue)
+	{
+		tail = pendingFrames.front().Head;
+		used -= pendingFrames.front().Size;
+		pendingFrames.pop_front();
+	}
+}
+
+bool RingAllocator::HasPendingFrames() { return !pendingFrames.empty(); }
+uint64_t RingAllocator::GetOldestPendingFenceValue() { return pendingFrames.empty() ? 0 : pendingFrames.front().FenceValue; }
+void RingAllocator::RecordStall() { stats.Stalls++; }
+
+// Getters
+uint64_t RingAllocator::GetCapacity() { return capacity; }
+uint64_t RingAllocator::GetUsedSize() { return used; }
+RingAllocatorStats RingAllocator::GetStats()
+{
+	stats.Used = used;
+	return stats;
+}
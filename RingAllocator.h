@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+// Usage statistics for a ring allocator
+struct RingAllocatorStats
+{
+	uint64_t Capacity = 0;			// Total size of the ring
+	uint64_t Used = 0;				// Space currently reserved (including wasted space at wraparound)
+	uint64_t HighWaterMark = 0;		// Largest "Used" value ever seen
+	uint64_t FailedAllocations = 0;	// How many times an allocation didn't fit
+	uint64_t Stalls = 0;			// How many times the owner had to wait for space to be retired
+};
+
+// --------------------------------------------------------
+// A ring allocator that hands out offsets into a fixed-size
+// range (bytes in an upload heap, slots in a descriptor heap,
+// etc.) and only reuses space once the GPU is done with it.
+//
+// Allocations made between calls to FinishFrame() are tagged
+// with that frame's fence value, and the space is released
+// once Retire() is called with a completed fence value that
+// is at least as large.
+//
+// This class knows nothing about D3D12, so the owner is
+// responsible for deciding what to do when it fills up
+// (and for reporting any waits with RecordStall()).
+// --------------------------------------------------------
+class RingAllocator
+{
+public:
+	static const uint64_t InvalidOffset = UINT64_MAX;
+
+	RingAllocator(uint64_t capacity = 0);
+
+	void Reset(uint64_t capacity);
+
+	// Returns InvalidOffset if there isn't enough retired space
+	uint64_t Allocate(uint64_t size, uint64_t alignment = 1);
+
+	// Frame tracking
+	void FinishFrame(uint64_t fenceValue);
+	void Retire(uint64_t completedFenceValue);
+	bool HasPendingFrames();
+	uint64_t GetOldestPendingFenceValue();
+	void RecordStall();
+
+	// Getters
+	uint64_t GetCapacity();
+	uint64_t GetUsedSize();
+	RingAllocatorStats GetStats();
+
+private:
+	// Space reserved by a single (finished) frame
+	struct FrameMarker
+	{
+		uint64_t FenceValue;
+		uint64_t Head;	// Where the head was at the end of the frame
+		uint64_t Size;	// Total space the frame reserved
+	};
+
+	uint64_t capacity;
+	uint64_t head;	// Next free spot
+	uint64_t tail;	// Oldest spot still in use
+	uint64_t used;
+
+	// Space reserved since the last FinishFrame()
+	uint64_t currentFrameSize;
+
+	std::deque<FrameMarker> pendingFrames;
+	RingAllocatorStats stats;
+};
@@ -0,0 +1,263 @@
+#include "SceneSimulation.h"
+#include "JobSystem.h"
+#include "Trace.h"
+
+#include <cmath>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	struct Quaternion
+	{
+		float x, y, z, w;
+	};
+
+	TimelineFloat3 Lerp(const TimelineFloat3& a, const TimelineFloat3& b, float t)
+	{
+		return TimelineFloat3{ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t };
+	}
+
+	TimelineFloat3 Cross(const TimelineFloat3& a, const TimelineFloat3& b)
+	{
+		return TimelineFloat3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	float Dot(const TimelineFloat3& a, const TimelineFloat3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	TimelineFloat3 Normalize(const TimelineFloat3& v)
+	{
+		float length = sqrtf(Dot(v, v));
+		if (length <= 0)
+			return v;
+		return TimelineFloat3{ v.x / length, v.y / length, v.z / length };
+	}
+
+	// --------------------------------------------------------
+	// Same as XMQuaternionRotationRollPitchYaw(): roll around
+	// Z, then pitch around X, then yaw around Y
+	// --------------------------------------------------------
+	Quaternion RotationFromPitchYawRoll(const TimelineFloat3& pitchYawRoll)
+	{
+		float sp = sinf(pitchYawRoll.x * 0.5f), cp = cosf(pitchYawRoll.x * 0.5f);
+		float sy = sinf(pitchYawRoll.y * 0.5f), cy = cosf(pitchYawRoll.y * 0.5f);
+		float sr = sinf(pitchYawRoll.z * 0.5f), cr = cosf(pitchYawRoll.z * 0.5f);
+
+		return Quaternion{
+			sp * cy * cr + cp * sy * sr,
+			cp * sy * cr - sp * cy * sr,
+			cp * cy * sr - sp * sy * cr,
+			cp * cy * cr + sp * sy * sr };
+	}
+
+	// --------------------------------------------------------
+	// Same as XMQuaternionSlerp(): takes the shorter way around,
+	// and falls back to a plain blend when the two are so close
+	// that the angle between them can't be trusted
+	// --------------------------------------------------------
+	Quaternion Slerp(const Quaternion& a, const Quaternion& b, float t)
+	{
+		float cosOmega = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+		float sign = 1;
+		if (cosOmega < 0)
+		{
+			cosOmega = -cosOmega;
+			sign = -1;
+		}
+
+		float weightA = 1 - t;
+		float weightB = t;
+		if (cosOmega < 1.0f - 0.00001f)
+		{
+			float sinOmega = sqrtf(1 - cosOmega * cosOmega);
+			float omega = atan2f(sinOmega, cosOmega);
+			weightA = sinf(weightA * omega) / sinOmega;
+			weightB = sinf(weightB * omega) / sinOmega;
+		}
+		weightB *= sign;
+
+		return Quaternion{
+			a.x * weightA + b.x * weightB,
+			a.y * weightA + b.y * weightB,
+			a.z * weightA + b.z * weightB,
+			a.w * weightA + b.w * weightB };
+	}
+
+	// Same rows as XMMatrixRotationQuaternion()
+	void RotationRows(const Quaternion& q, TimelineFloat3 rows[3])
+	{
+		rows[0] = { 1 - 2 * q.y * q.y - 2 * q.z * q.z, 2 * q.x * q.y + 2 * q.z * q.w, 2 * q.x * q.z - 2 * q.y * q.w };
+		rows[1] = { 2 * q.x * q.y - 2 * q.z * q.w, 1 - 2 * q.x * q.x - 2 * q.z * q.z, 2 * q.y * q.z + 2 * q.x * q.w };
+		rows[2] = { 2 * q.x * q.z + 2 * q.y * q.w, 2 * q.y * q.z - 2 * q.x * q.w, 1 - 2 * q.x * q.x - 2 * q.y * q.y };
+	}
+}
+
+
+SceneSimulation::SceneSimulation(const std::vector<SceneObjectState>& initialObjects) :
+	objects(initialObjects)
+{
+	// Nothing has moved yet
+	simulationSnapshot.Previous = objects;
+	simulationSnapshot.Current = objects;
+	PrepareRenderState();
+
+	// Identity view until the camera follows something
+	for (int i = 0; i < 4; i++)
+		viewMatrix.m[i][i] = 1;
+}
+
+// --------------------------------------------------------
+// Advances the objects by however many fixed steps fit in
+// the given frame time, then publishes where they were
+// before and after the last step.
+//
+// The animation itself lives in ScriptedScene, which also
+// applies the timeline (if any).
+// --------------------------------------------------------
+void SceneSimulation::Simulate(double frameSeconds, const BenchmarkTimeline* timeline)
+{
+	TRACE_ZONE("SceneSimulation::Simulate");
+
+	fixedTimestep.AddFrameTime(frameSeconds);
+	bool stepped = false;
+	while (fixedTimestep.Step())
+	{
+		// Remember where everything was before this step
+		simulationSnapshot.Previous = objects;
+
+		ScriptedScene::Step(objects, (float)fixedTimestep.GetStepSeconds(), (float)fixedTimestep.GetTime(), timeline);
+		stepped = true;
+	}
+
+	if (stepped)
+		simulationSnapshot.Current = objects;
+	simulationSnapshot.Alpha = fixedTimestep.GetAlpha();
+}
+
+// --------------------------------------------------------
+// Takes the latest snapshot for rendering and blends each
+// object between its last two steps, keeping last frame's
+// matrices for motion vectors
+// --------------------------------------------------------
+void SceneSimulation::PrepareRenderState()
+{
+	TRACE_ZONE("SceneSimulation::PrepareRenderState");
+
+	renderSnapshot = simulationSnapshot;
+	previousWorldMatrices.swap(worldMatrices);
+
+	// Every object is independent, so spread them over the job system
+	worldMatrices.resize(renderSnapshot.Current.size());
+	JobSystem::ParallelFor((unsigned int)worldMatrices.size(), WorldMatricesPerJob, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			worldMatrices[i] = InterpolateWorldMatrix(
+				renderSnapshot.Previous[i],
+				renderSnapshot.Current[i],
+				renderSnapshot.Alpha);
+		}
+	});
+}
+
+// --------------------------------------------------------
+// Moves the camera to where the timeline has it and builds
+// the matching view matrix
+// --------------------------------------------------------
+bool SceneSimulation::FollowCamera(const BenchmarkTimeline& timeline, float time)
+{
+	if (!timeline.SampleCamera(time, camera))
+		return false;
+
+	viewMatrix = ViewMatrix(camera.Position, camera.PitchYawRoll);
+	return true;
+}
+
+// Getters
+const std::vector<SceneObjectState>& SceneSimulation::GetObjects() const { return objects; }
+const std::vector<SceneObjectState>& SceneSimulation::GetRenderObjects() const { return renderSnapshot.Current; }
+const std::vector<SceneFloat4x4>& SceneSimulation::GetWorldMatrices() const { return worldMatrices; }
+const std::vector<SceneFloat4x4>& SceneSimulation::GetPreviousWorldMatrices() const { return previousWorldMatrices; }
+const TimelineKeyframe& SceneSimulation::GetCamera() const { return camera; }
+const SceneFloat4x4& SceneSimulation::GetViewMatrix() const { return viewMatrix; }
+
+
+// --------------------------------------------------------
+// Blends two placements (alpha 0 = from, 1 = to) into a
+// scale * rotation * translation world matrix.  Positions
+// and scales are blended linearly, while rotations are
+// blended as quaternions so they take the shortest path.
+// --------------------------------------------------------
+SceneFloat4x4 SceneSimulation::InterpolateWorldMatrix(const SceneObjectState& from, const SceneObjectState& to, float alpha)
+{
+	TimelineFloat3 translation = Lerp(from.Position, to.Position, alpha);
+	TimelineFloat3 scale = Lerp(from.Scale, to.Scale, alpha);
+	Quaternion rotation = Slerp(
+		RotationFromPitchYawRoll(from.PitchYawRoll),
+		RotationFromPitchYawRoll(to.PitchYawRoll),
+		alpha);
+
+	TimelineFloat3 rows[3];
+	RotationRows(rotation, rows);
+
+	// Scaling first just scales each row of the rotation
+	float scales[3] = { scale.x, scale.y, scale.z };
+	SceneFloat4x4 world;
+	for (int i = 0; i < 3; i++)
+	{
+		world.m[i][0] = rows[i].x * scales[i];
+		world.m[i][1] = rows[i].y * scales[i];
+		world.m[i][2] = rows[i].z * scales[i];
+	}
+	world.m[3][0] = translation.x;
+	world.m[3][1] = translation.y;
+	world.m[3][2] = translation.z;
+	world.m[3][3] = 1;
+	return world;
+}
+
+// --------------------------------------------------------
+// The camera's view matrix, the same as the Camera class
+// builds: XMMatrixLookToLH() along the rotated forward
+// axis with world up as +Y
+// --------------------------------------------------------
+SceneFloat4x4 SceneSimulation::ViewMatrix(const TimelineFloat3& position, const TimelineFloat3& pitchYawRoll)
+{
+	TimelineFloat3 rows[3];
+	RotationRows(RotationFromPitchYawRoll(pitchYawRoll), rows);
+
+	// Forward is +Z rotated, which is the rotation's last row
+	TimelineFloat3 forward = Normalize(rows[2]);
+	TimelineFloat3 right = Normalize(Cross(TimelineFloat3{ 0, 1, 0 }, forward));
+	TimelineFloat3 up = Cross(forward, right);
+
+	SceneFloat4x4 view;
+	TimelineFloat3 axes[3] = { right, up, forward };
+	for (int i = 0; i < 3; i++)
+	{
+		view.m[0][i] = axes[i].x;
+		view.m[1][i] = axes[i].y;
+		view.m[2][i] = axes[i].z;
+		view.m[3][i] = -Dot(axes[i], position);
+	}
+	view.m[3][3] = 1;
+	return view;
+}
+
+// --------------------------------------------------------
+// Transposes a world matrix to column major, keeping the
+// three rows a raytracing instance uses
+// --------------------------------------------------------
+SceneInstanceTransform SceneSimulation::InstanceTransform(const SceneFloat4x4& world)
+{
+	SceneInstanceTransform transform;
+	for (int row = 0; row < 3; row++)
+	{
+		for (int column = 0; column < 4; column++)
+			transform.m[row][column] = world.m[column][row];
+	}
+	return transform;
+}
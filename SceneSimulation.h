@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+
+#include "BenchmarkTimeline.h"
+#include "FixedTimestep.h"
+#include "ScriptedScene.h"
+
+// Row-major matrix laid out like XMFLOAT4X4, which points
+// are multiplied with as row vectors
+struct SceneFloat4x4
+{
+	float m[4][4] = {};
+};
+
+// The first three columns of a world matrix, transposed into
+// rows, as a raytracing instance description wants them
+// (laid out like XMFLOAT3X4)
+struct SceneInstanceTransform
+{
+	float m[3][4] = {};
+};
+
+// --------------------------------------------------------
+// The platform independent part of the game's update: the
+// scripted scene on a fixed time step, blended between its
+// last two steps into world matrices for rendering, and
+// the camera when it follows a timeline.
+//
+// Game applies the results to its entities and camera, and
+// the headless benchmark runs it on its own, so both time
+// the same work.
+//
+// Simulate() may run on another thread (see Game), so the
+// objects it steps are only published as a snapshot, which
+// PrepareRenderState() copies.  The two must not overlap.
+// World matrices are interpolated on the job system.
+//
+// The math matches DirectXMath's (quaternion slerp between
+// roll-pitch-yaw rotations, LookTo view matrices), which
+// the rest of the game uses, without depending on it.
+//
+// Nothing here touches the window, input or graphics API.
+// --------------------------------------------------------
+class SceneSimulation
+{
+public:
+	SceneSimulation(const std::vector<SceneObjectState>& initialObjects);
+
+	// Advances by however many fixed steps fit in the frame time
+	// (objects with a track in the timeline, if any, follow it)
+	void Simulate(double frameSeconds, const BenchmarkTimeline* timeline);
+
+	// Takes the latest snapshot for rendering, keeping last
+	// frame's matrices for motion vectors
+	void PrepareRenderState();
+
+	// Moves the camera to where the timeline has it at the given
+	// time, returning false if the timeline has no camera track
+	bool FollowCamera(const BenchmarkTimeline& timeline, float time);
+
+	// The simulation's own objects (only safe to read while
+	// Simulate() isn't running)
+	const std::vector<SceneObjectState>& GetObjects() const;
+
+	// Render state, from the last PrepareRenderState()
+	const std::vector<SceneObjectState>& GetRenderObjects() const;
+	const std::vector<SceneFloat4x4>& GetWorldMatrices() const;
+	const std::vector<SceneFloat4x4>& GetPreviousWorldMatrices() const;
+
+	// The camera, from the last FollowCamera()
+	const TimelineKeyframe& GetCamera() const;
+	const SceneFloat4x4& GetViewMatrix() const;
+
+	// Building blocks, also used on their own
+	static SceneFloat4x4 InterpolateWorldMatrix(const SceneObjectState& from, const SceneObjectState& to, float alpha);
+	static SceneFloat4x4 ViewMatrix(const TimelineFloat3& position, const TimelineFloat3& pitchYawRoll);
+	static SceneInstanceTransform InstanceTransform(const SceneFloat4x4& world);
+
+private:
+	// Objects before and after the last step
+	struct Snapshot
+	{
+		std::vector<SceneObjectState> Previous;
+		std::vector<SceneObjectState> Current;
+		float Alpha = 0;	// How far the frame is past Previous
+	};
+
+	FixedTimestep fixedTimestep;
+	std::vector<SceneObjectState> objects;	// Owned by Simulate()
+	Snapshot simulationSnapshot;			// Written by Simulate()
+	Snapshot renderSnapshot;				// Render state's copy
+	std::vector<SceneFloat4x4> worldMatrices;
+	std::vector<SceneFloat4x4> previousWorldMatrices;
+
+	TimelineKeyframe camera;
+	SceneFloat4x4 viewMatrix;
+
+	static constexpr unsigned int WorldMatricesPerJob = 256;	// Objects per job when interpolating
+};
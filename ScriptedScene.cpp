@@ -0,0 +1,42 @@
+#include "ScriptedScene.h"
+
+#include <cmath>
+
+
+// --------------------------------------------------------
+// The spinning sphere, sinking helix, stretching cube and
+// a second, still helix off to the side
+// --------------------------------------------------------
+std::vector<SceneObjectState> ScriptedScene::CreateInitialObjects()
+{
+	std::vector<SceneObjectState> objects(4);
+	objects[1].Position = { 2.5f, 0, 0 };
+	objects[2].Position = { -2.5f, 0, 0 };
+	objects[3].Position = { 5, 4, 0 };
+	return objects;
+}
+
+// --------------------------------------------------------
+// Animates the first three objects, then moves anything
+// with a timeline track to where the timeline says
+// --------------------------------------------------------
+void ScriptedScene::Step(std::vector<SceneObjectState>& objects, float stepSeconds, float time, const BenchmarkTimeline* timeline)
+{
+	if (objects.size() > 0)
+		objects[0].PitchYawRoll.z += stepSeconds * 2;
+	if (objects.size() > 1)
+		objects[1].Position.y += -.025f * stepSeconds;
+	if (objects.size() > 2)
+		objects[2].Scale = { 1, 1, (float)fabs(1 + sin(time)) };
+
+	TimelineKeyframe keyframe;
+	for (unsigned int i = 0; timeline && i < objects.size(); i++)
+	{
+		if (!timeline->SampleEntity(i, time, keyframe))
+			continue;
+
+		objects[i].Position = keyframe.Position;
+		objects[i].PitchYawRoll = keyframe.PitchYawRoll;
+		objects[i].Scale = keyframe.Scale;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+#include "BenchmarkTimeline.h"
+
+// Placement of a single animated object, in the same terms
+// as a Transform (which only the game itself deals with)
+struct SceneObjectState
+{
+	TimelineFloat3 Position{ 0, 0, 0 };
+	TimelineFloat3 PitchYawRoll{ 0, 0, 0 };
+	TimelineFloat3 Scale{ 1, 1, 1 };
+};
+
+// --------------------------------------------------------
+// The scene's scripted animation, one fixed simulation step
+// at a time.  Game applies the results to its entities, and
+// the headless benchmark runs it on its own.
+//
+// Each step only depends on the times given, so the same
+// steps always produce the same motion regardless of frame
+// rate or platform.  Objects with a track in the timeline
+// (if any) follow it instead of their scripted animation.
+//
+// Nothing here touches the window, input or graphics API.
+// --------------------------------------------------------
+namespace ScriptedScene
+{
+	// Where each of the scene's objects starts out
+	std::vector<SceneObjectState> CreateInitialObjects();
+
+	// Advances every object by a single simulation step
+	void Step(std::vector<SceneObjectState>& objects, float stepSeconds, float time, const BenchmarkTimeline* timeline);
+}
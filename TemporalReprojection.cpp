@@ -0,0 +1,313 @@
+#include "TemporalReprojection.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Annonymous namespace to hold variables/helpers
+// only accessible in this file
+namespace
+{
+	// Rows per job
+	const unsigned int RowsPerJob = 16;
+
+	// Darkest albedo the color is divided by (the same as the spatial filter's)
+	const float MinAlbedo = 0.01f;
+
+	// Less bilinear weight than this in the history means there's none
+	const float MinHistoryWeight = 1e-4f;
+
+	float Luminance(float r, float g, float b)
+	{
+		return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+	}
+
+	FilterFloat3 DemodulationAlbedo(const FilterFloat4& albedo)
+	{
+		return FilterFloat3{
+			std::max(albedo.x, MinAlbedo),
+			std::max(albedo.y, MinAlbedo),
+			std::max(albedo.z, MinAlbedo) };
+	}
+
+	// Averaged normals aren't unit length, and the sky's is zero
+	FilterFloat3 UnitNormal(const FilterFloat4& normalDepth)
+	{
+		float length = std::sqrt(normalDepth.x * normalDepth.x + normalDepth.y * normalDepth.y + normalDepth.z * normalDepth.z);
+		if (length <= 0)
+			return FilterFloat3{ 0, 0, 0 };
+		return FilterFloat3{ normalDepth.x / length, normalDepth.y / length, normalDepth.z / length };
+	}
+
+	// Row vector times matrix, as the shader's mul() does
+	// with the matrices the way they're uploaded
+	FilterFloat4 TransformVector(float x, float y, float z, float w, const FilterFloat4x4& m)
+	{
+		return FilterFloat4{
+			x * m.m[0][0] + y * m.m[1][0] + z * m.m[2][0] + w * m.m[3][0],
+			x * m.m[0][1] + y * m.m[1][1] + z * m.m[2][1] + w * m.m[3][1],
+			x * m.m[0][2] + y * m.m[1][2] + z * m.m[2][2] + w * m.m[3][2],
+			x * m.m[0][3] + y * m.m[1][3] + z * m.m[2][3] + w * m.m[3][3] };
+	}
+
+	// --------------------------------------------------------
+	// Offset from a pixel position to where a clip space
+	// position lands on screen, or off screen if it's behind
+	// the camera
+	// --------------------------------------------------------
+	FilterFloat2 ScreenOffset(FilterFloat2 screenPosition, const FilterFloat4& clip, unsigned int width, unsigned int height)
+	{
+		FilterFloat2 previousScreen{ -1, -1 };
+		if (clip.w > 0)
+		{
+			previousScreen.x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+			previousScreen.y = (clip.y / clip.w * -0.5f + 0.5f) * height;
+		}
+		return FilterFloat2{ previousScreen.x - screenPosition.x, previousScreen.y - screenPosition.y };
+	}
+
+	// Color divided by albedo, and its luminance moments to match
+	FilterFloat3 Demodulate(const FilterFloat4& color, const FilterFloat3& albedo)
+	{
+		return FilterFloat3{ color.x / albedo.x, color.y / albedo.y, color.z / albedo.z };
+	}
+
+	FilterFloat2 DemodulateMoments(const FilterFloat2& moments, const FilterFloat3& albedo)
+	{
+		float albedoLuminance = Luminance(albedo.x, albedo.y, albedo.z);
+		return FilterFloat2{ moments.x / albedoLuminance, moments.y / (albedoLuminance * albedoLuminance) };
+	}
+
+	// --------------------------------------------------------
+	// Mean and standard deviation of this frame's illumination
+	// over the 3x3 pixels around one
+	// --------------------------------------------------------
+	void NeighborhoodStatistics(const TemporalReprojection::Frame& frame, int x, int y, FilterFloat3& mean, FilterFloat3& deviation)
+	{
+		FilterFloat3 sum{ 0, 0, 0 };
+		FilterFloat3 sumSquared{ 0, 0, 0 };
+		float count = 0;
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				int tapX = x + dx;
+				int tapY = y + dy;
+				if (tapX < 0 || tapY < 0 || tapX >= (int)frame.Width || tapY >= (int)frame.Height)
+					continue;
+
+				size_t tapIndex = (size_t)tapY * frame.Width + tapX;
+				FilterFloat3 illumination = Demodulate(frame.Color[tapIndex], DemodulationAlbedo(frame.Albedo[tapIndex]));
+				sum.x += illumination.x;
+				sum.y += illumination.y;
+				sum.z += illumination.z;
+				sumSquared.x += illumination.x * illumination.x;
+				sumSquared.y += illumination.y * illumination.y;
+				sumSquared.z += illumination.z * illumination.z;
+				count++;
+			}
+		}
+
+		mean = FilterFloat3{ sum.x / count, sum.y / count, sum.z / count };
+		deviation = FilterFloat3{
+			std::sqrt(std::max(sumSquared.x / count - mean.x * mean.x, 0.0f)),
+			std::sqrt(std::max(sumSquared.y / count - mean.y * mean.y, 0.0f)),
+			std::sqrt(std::max(sumSquared.z / count - mean.z * mean.z, 0.0f)) };
+	}
+
+	// --------------------------------------------------------
+	// Moves a color toward the center of a box until it's
+	// inside, keeping its hue (unlike clamping each channel)
+	// --------------------------------------------------------
+	FilterFloat3 ClipToBox(const FilterFloat3& color, const FilterFloat3& center, const FilterFloat3& extents)
+	{
+		FilterFloat3 offset{ color.x - center.x, color.y - center.y, color.z - center.z };
+		float units = std::max(
+			std::abs(offset.x) / std::max(extents.x, 1e-6f), std::max(
+			std::abs(offset.y) / std::max(extents.y, 1e-6f),
+			std::abs(offset.z) / std::max(extents.z, 1e-6f)));
+		if (units <= 1)
+			return color;
+		return FilterFloat3{ center.x + offset.x / units, center.y + offset.y / units, center.z + offset.z / units };
+	}
+
+	// --------------------------------------------------------
+	// Follows a pixel's motion vector into the history and
+	// filters the bilinear taps there that saw the same
+	// surface.  Returns false if none did.
+	// --------------------------------------------------------
+	bool Reproject(
+		const TemporalReprojection::Frame& frame,
+		const TemporalReprojection::History& history,
+		const TemporalSettings& settings,
+		unsigned int x,
+		unsigned int y,
+		const FilterFloat3& normal,
+		FilterFloat3& illumination,
+		FilterFloat2& moments,
+		float& sampleCount)
+	{
+		const FilterFloat4& motion = frame.Motion[(size_t)y * frame.Width + x];
+
+		// Pixel centers are at half pixels on both sides, so
+		// they cancel out
+		float previousX = x + motion.x;
+		float previousY = y + motion.y;
+		float baseX = std::floor(previousX);
+		float baseY = std::floor(previousY);
+		float fractionX = previousX - baseX;
+		float fractionY = previousY - baseY;
+
+		illumination = FilterFloat3{ 0, 0, 0 };
+		moments = FilterFloat2{ 0, 0 };
+		sampleCount = 0;
+		float weightSum = 0;
+		for (int j = 0; j < 2; j++)
+		{
+			for (int i = 0; i < 2; i++)
+			{
+				int tapX = (int)baseX + i;
+				int tapY = (int)baseY + j;
+				if (tapX < 0 || tapY < 0 || tapX >= (int)frame.Width || tapY >= (int)frame.Height)
+					continue;
+
+				// Did this tap see the same surface?
+				size_t tapIndex = (size_t)tapY * frame.Width + tapX;
+				const FilterFloat4& tapNormalDepth = history.NormalDepth[tapIndex];
+				FilterFloat3 tapNormal = UnitNormal(tapNormalDepth);
+				float cosine = normal.x * tapNormal.x + normal.y * tapNormal.y + normal.z * tapNormal.z;
+				if (cosine < settings.NormalThreshold ||
+					std::abs(tapNormalDepth.w - motion.z) > settings.DepthTolerance * motion.z)
+					continue;
+
+				float weight = (i ? fractionX : 1 - fractionX) * (j ? fractionY : 1 - fractionY);
+				FilterFloat3 tapAlbedo = DemodulationAlbedo(history.Albedo[tapIndex]);
+				FilterFloat3 tapIllumination = Demodulate(history.Color[tapIndex], tapAlbedo);
+				FilterFloat2 tapMoments = DemodulateMoments(history.Moments[tapIndex], tapAlbedo);
+				illumination.x += tapIllumination.x * weight;
+				illumination.y += tapIllumination.y * weight;
+				illumination.z += tapIllumination.z * weight;
+				moments.x += tapMoments.x * weight;
+				moments.y += tapMoments.y * weight;
+				sampleCount += history.Color[tapIndex].w * weight;
+				weightSum += weight;
+			}
+		}
+
+		if (weightSum < MinHistoryWeight)
+			return false;
+
+		illumination = FilterFloat3{ illumination.x / weightSum, illumination.y / weightSum, illumination.z / weightSum };
+		moments = FilterFloat2{ moments.x / weightSum, moments.y / weightSum };
+		sampleCount /= weightSum;
+		return true;
+	}
+}
+
+FilterFloat3 TemporalReprojection::PreviousPosition(const FilterFloat3& objectPosition, const FilterFloat4x4& previousWorld)
+{
+	FilterFloat4 position = TransformVector(objectPosition.x, objectPosition.y, objectPosition.z, 1, previousWorld);
+	return FilterFloat3{ position.x, position.y, position.z };
+}
+
+FilterFloat4 TemporalReprojection::MotionVector(
+	FilterFloat2 screenPosition,
+	const FilterFloat3& previousPosition,
+	const FilterFloat4x4& previousViewProjection,
+	const FilterFloat3& previousCameraPosition,
+	unsigned int width,
+	unsigned int height)
+{
+	FilterFloat4 clip = TransformVector(previousPosition.x, previousPosition.y, previousPosition.z, 1, previousViewProjection);
+	FilterFloat2 offset = ScreenOffset(screenPosition, clip, width, height);
+
+	FilterFloat3 toCamera{
+		previousPosition.x - previousCameraPosition.x,
+		previousPosition.y - previousCameraPosition.y,
+		previousPosition.z - previousCameraPosition.z };
+	float distance = std::sqrt(toCamera.x * toCamera.x + toCamera.y * toCamera.y + toCamera.z * toCamera.z);
+	return FilterFloat4{ offset.x, offset.y, distance, 0 };
+}
+
+FilterFloat4 TemporalReprojection::SkyMotionVector(
+	FilterFloat2 screenPosition,
+	const FilterFloat3& direction,
+	const FilterFloat4x4& previousViewProjection,
+	unsigned int width,
+	unsigned int height)
+{
+	// No w, so the camera's position doesn't matter
+	FilterFloat4 clip = TransformVector(direction.x, direction.y, direction.z, 0, previousViewProjection);
+	FilterFloat2 offset = ScreenOffset(screenPosition, clip, width, height);
+	return FilterFloat4{ offset.x, offset.y, 0, 0 };
+}
+
+void TemporalReprojection::Accumulate(
+	const Frame& frame,
+	const History* history,
+	const TemporalSettings& settings,
+	std::vector<FilterFloat4>& color,
+	std::vector<FilterFloat2>& moments)
+{
+	size_t pixelCount = (size_t)frame.Width * frame.Height;
+	color.resize(pixelCount);
+	moments.resize(pixelCount);
+	if (pixelCount == 0)
+		return;
+
+	bool reuse = settings.Enabled && history;
+	JobSystem::ParallelFor(frame.Height, RowsPerJob, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int y = begin; y < end; y++)
+			{
+				for (unsigned int x = 0; x < frame.Width; x++)
+				{
+					size_t index = (size_t)y * frame.Width + x;
+					FilterFloat3 albedo = DemodulationAlbedo(frame.Albedo[index]);
+					FilterFloat3 illumination = Demodulate(frame.Color[index], albedo);
+					FilterFloat2 illuminationMoments = DemodulateMoments(frame.Moments[index], albedo);
+					float sampleCount = frame.Color[index].w;
+
+					// The sky is already noise free
+					FilterFloat3 normal = UnitNormal(frame.NormalDepth[index]);
+					bool sky = normal.x == 0 && normal.y == 0 && normal.z == 0;
+
+					FilterFloat3 previousIllumination;
+					FilterFloat2 previousMoments;
+					float previousSampleCount;
+					if (reuse && !sky &&
+						Reproject(frame, *history, settings, x, y, normal, previousIllumination, previousMoments, previousSampleCount))
+					{
+						FilterFloat3 mean, deviation;
+						NeighborhoodStatistics(frame, x, y, mean, deviation);
+						previousIllumination = ClipToBox(
+							previousIllumination,
+							mean,
+							FilterFloat3{ deviation.x * settings.ClipGamma, deviation.y * settings.ClipGamma, deviation.z * settings.ClipGamma });
+
+						// Each side counts for its samples, with history capped
+						float historySamples = std::min(previousSampleCount, (float)settings.MaxHistorySamples);
+						float totalSamples = sampleCount + historySamples;
+						if (totalSamples > 0)
+						{
+							float historyWeight = historySamples / totalSamples;
+							float currentWeight = 1 - historyWeight;
+							illumination = FilterFloat3{
+								illumination.x * currentWeight + previousIllumination.x * historyWeight,
+								illumination.y * currentWeight + previousIllumination.y * historyWeight,
+								illumination.z * currentWeight + previousIllumination.z * historyWeight };
+							illuminationMoments = FilterFloat2{
+								illuminationMoments.x * currentWeight + previousMoments.x * historyWeight,
+								illuminationMoments.y * currentWeight + previousMoments.y * historyWeight };
+							sampleCount = totalSamples;
+						}
+					}
+
+					// Back into the form the path tracer writes
+					float albedoLuminance = Luminance(albedo.x, albedo.y, albedo.z);
+					color[index] = FilterFloat4{ illumination.x * albedo.x, illumination.y * albedo.y, illumination.z * albedo.z, sampleCount };
+					moments[index] = FilterFloat2{ illuminationMoments.x * albedoLuminance, illuminationMoments.y * albedoLuminance * albedoLuminance };
+				}
+			}
+		});
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vector>
+
+#include "ATrousFilter.h"
+
+// Row-major matrix laid out like XMFLOAT4X4, which points
+// are multiplied with as row vectors
+struct FilterFloat4x4
+{
+	float m[4][4] = {};
+};
+
+struct TemporalSettings
+{
+	bool Enabled = true;
+	unsigned int MaxHistorySamples = 16;	// Most samples of history a pixel may reuse
+	float ClipGamma = 1.25f;				// Size of the box history is clipped to, in standard deviations
+	float DepthTolerance = 0.1f;			// Relative hit distance difference that counts as a disocclusion
+	float NormalThreshold = 0.9f;			// Least cosine between normals that's still the same surface
+};
+
+// --------------------------------------------------------
+// Temporal reprojection for the denoiser, as in SVGF
+// (Schied et al., "Spatiotemporal Variance-Guided
+// Filtering", 2017), so the path tracer's samples aren't
+// all thrown away whenever the camera or anything in the
+// scene moves.
+//
+// The path tracer writes a motion vector per pixel: how
+// far its first hit has moved on screen since last frame,
+// found by putting the hit back where its instance was
+// last frame and projecting that with last frame's camera,
+// and how far that was from last frame's camera.
+//
+// Each pixel follows its motion vector back into last
+// frame's result and takes the (bilinear) history from the
+// taps there that saw the same surface - similar normal
+// and the expected hit distance.  Anything else has just
+// come into view (a disocclusion), and starts over.
+//
+// History is clipped to the box of colors around the
+// pixel this frame (the mean, give or take a few standard
+// deviations, as in Salvi's variance clipping) so what's
+// left of a moving shadow or highlight doesn't linger,
+// then blended with this frame's samples weighted by
+// sample count.  History counts for at most a few samples,
+// so when nothing moves the accumulated image takes over.
+//
+// Everything is done on illumination (the color divided by
+// the albedo), the same as the spatial filter, so textures
+// aren't smeared by resampling.  The result is put back in
+// the form the path tracer writes - color, sample count and
+// luminance moments - for the spatial filter.
+//
+// Implemented here on the CPU as a reference for the
+// shader (and tested on known frames), with rows in
+// parallel on the job system.
+//
+// Nothing here knows about D3D12.
+// --------------------------------------------------------
+namespace TemporalReprojection
+{
+	// Inputs, one entry per pixel, row by row (the same
+	// as ATrousFilter::Frame, plus the motion vectors)
+	struct Frame
+	{
+		unsigned int Width = 0;
+		unsigned int Height = 0;
+		const FilterFloat4* Color = 0;			// Accumulated linear color (sample count in w)
+		const FilterFloat2* Moments = 0;		// Mean luminance and luminance squared
+		const FilterFloat4* NormalDepth = 0;
+		const FilterFloat4* Albedo = 0;
+		const FilterFloat4* Motion = 0;			// Pixels to last frame's position (xy) and distance from last frame's camera (z)
+	};
+
+	// Last frame's result and the G-buffer it was made with
+	struct History
+	{
+		const FilterFloat4* Color = 0;
+		const FilterFloat2* Moments = 0;
+		const FilterFloat4* NormalDepth = 0;
+		const FilterFloat4* Albedo = 0;
+	};
+
+	// A point's position last frame, given where it is on its
+	// instance and the instance's world matrix last frame
+	FilterFloat3 PreviousPosition(const FilterFloat3& objectPosition, const FilterFloat4x4& previousWorld);
+
+	// Motion vector for a point at a (continuous) pixel position this
+	// frame, given its position last frame, or off screen (negative)
+	// if it was behind last frame's camera
+	FilterFloat4 MotionVector(
+		FilterFloat2 screenPosition,
+		const FilterFloat3& previousPosition,
+		const FilterFloat4x4& previousViewProjection,
+		const FilterFloat3& previousCameraPosition,
+		unsigned int width,
+		unsigned int height);
+
+	// Motion vector for the sky, which is infinitely far away so
+	// only turning the camera moves it (distance is zero)
+	FilterFloat4 SkyMotionVector(
+		FilterFloat2 screenPosition,
+		const FilterFloat3& direction,
+		const FilterFloat4x4& previousViewProjection,
+		unsigned int width,
+		unsigned int height);
+
+	// Blends the frame with its history (if there is any), writing
+	// what the shader hands to the spatial filter
+	void Accumulate(
+		const Frame& frame,
+		const History* history,
+		const TemporalSettings& settings,
+		std::vector<FilterFloat4>& color,
+		std::vector<FilterFloat2>& moments);
+}
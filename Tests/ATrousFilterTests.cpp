@@ -0,0 +1,274 @@
+#include "TestFramework.h"
+#include "ATrousFilter.h"
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// --------------------------------------------------------
+	// The filter's inputs for a small gray image, starting as
+	// a flat white surface facing the camera, one unit away,
+	// with no noise.  Gray keeps luminance equal to the color.
+	// --------------------------------------------------------
+	struct TestImage
+	{
+		unsigned int Width;
+		unsigned int Height;
+		std::vector<FilterFloat4> Color;
+		std::vector<FilterFloat2> Moments;
+		std::vector<FilterFloat4> NormalDepth;
+		std::vector<FilterFloat4> Albedo;
+
+		TestImage(unsigned int width, unsigned int height) :
+			Width(width),
+			Height(height),
+			Color((size_t)width * height),
+			Moments((size_t)width * height),
+			NormalDepth((size_t)width * height, FilterFloat4{ 0, 0, -1, 1 }),
+			Albedo((size_t)width * height, FilterFloat4{ 1, 1, 1, 1 })
+		{
+		}
+
+		// Gray color, averaged from sampleCount samples with the given
+		// variance, with the luminance moments to match
+		void SetColor(unsigned int x, unsigned int y, float value, float sampleVariance = 0, float sampleCount = 16)
+		{
+			size_t index = (size_t)y * Width + x;
+			float albedo = Albedo[index].x;
+			Color[index] = FilterFloat4{ value * albedo, value * albedo, value * albedo, sampleCount };
+			Moments[index] = FilterFloat2{ value * albedo, (value * value + sampleVariance) * albedo * albedo };
+		}
+
+		void Fill(const std::function<float(unsigned int, unsigned int)>& value, float sampleVariance = 0)
+		{
+			for (unsigned int y = 0; y < Height; y++)
+			{
+				for (unsigned int x = 0; x < Width; x++)
+					SetColor(x, y, value(x, y), sampleVariance);
+			}
+		}
+
+		ATrousFilter::Frame Frame() const
+		{
+			ATrousFilter::Frame frame;
+			frame.Width = Width;
+			frame.Height = Height;
+			frame.Color = Color.data();
+			frame.Moments = Moments.data();
+			frame.NormalDepth = NormalDepth.data();
+			frame.Albedo = Albedo.data();
+			return frame;
+		}
+
+		// Filtered, and back to linear (from the output's gamma)
+		std::vector<float> Filter(const ATrousSettings& settings) const
+		{
+			std::vector<FilterFloat3> output;
+			ATrousFilter::Filter(Frame(), settings, output);
+
+			std::vector<float> linear(output.size());
+			for (size_t i = 0; i < output.size(); i++)
+				linear[i] = std::pow(output[i].y, 2.2f);
+			return linear;
+		}
+	};
+
+	// Repeatable noise in [-1, 1]
+	float Noise(unsigned int x, unsigned int y)
+	{
+		uint32_t hash = (x * 73856093u) ^ (y * 19349663u);
+		hash = (hash ^ (hash >> 13)) * 1274126177u;
+		return (hash >> 8) / 8388608.0f - 1;
+	}
+
+	double Mean(const std::vector<float>& values, unsigned int width, unsigned int left, unsigned int right, unsigned int height)
+	{
+		double sum = 0;
+		for (unsigned int y = 0; y < height; y++)
+		{
+			for (unsigned int x = left; x < right; x++)
+				sum += values[(size_t)y * width + x];
+		}
+		return sum / ((right - left) * height);
+	}
+
+	double RMSError(const std::vector<float>& values, unsigned int width, unsigned int left, unsigned int right, unsigned int height, double expected)
+	{
+		double sum = 0;
+		for (unsigned int y = 0; y < height; y++)
+		{
+			for (unsigned int x = left; x < right; x++)
+			{
+				double error = values[(size_t)y * width + x] - expected;
+				sum += error * error;
+			}
+		}
+		return std::sqrt(sum / ((right - left) * height));
+	}
+}
+
+// --------------------------------------------------------
+// ATrousFilter on small known images, for Denoise.hlsl to
+// stay in step with: noise should be smoothed away, but not
+// across edges in the normals, hit distances or (noise free)
+// lighting, and not into textures or the sky
+// --------------------------------------------------------
+
+TEST_CASE(DisabledOnlyEncodesGamma)
+{
+	TestImage image(8, 8);
+	image.Fill([](unsigned int x, unsigned int y) { return 0.5f + 0.4f * Noise(x, y); }, 0.1f);
+
+	ATrousSettings settings;
+	settings.Enabled = false;
+	std::vector<FilterFloat3> output;
+	ATrousFilter::Filter(image.Frame(), settings, output);
+	REQUIRE(output.size() == 64);
+	for (size_t i = 0; i < output.size(); i++)
+		CHECK_NEAR(output[i].x, std::pow(image.Color[i].x, 1 / 2.2f), 1e-6f);
+
+	settings.Enabled = true;
+	settings.Iterations = 0;
+	std::vector<FilterFloat3> noIterations;
+	ATrousFilter::Filter(image.Frame(), settings, noIterations);
+	for (size_t i = 0; i < output.size(); i++)
+		CHECK_EQUAL(noIterations[i].x, output[i].x);
+}
+
+TEST_CASE(SmoothsNoiseOnAFlatSurface)
+{
+	// Noise as strong as its variance says
+	TestImage image(32, 32);
+	image.Fill([](unsigned int x, unsigned int y) { return 0.5f + 0.3f * Noise(x, y); }, 16 * 0.03f);
+
+	std::vector<float> input(image.Color.size());
+	for (size_t i = 0; i < input.size(); i++)
+		input[i] = image.Color[i].x;
+	std::vector<float> filtered = image.Filter(ATrousSettings());
+
+	double inputError = RMSError(input, 32, 0, 32, 32, Mean(input, 32, 0, 32, 32));
+	double filteredError = RMSError(filtered, 32, 0, 32, 32, Mean(input, 32, 0, 32, 32));
+	CHECK(filteredError < 0.25 * inputError);
+
+	// Without moving the average
+	CHECK_NEAR(Mean(filtered, 32, 0, 32, 32), Mean(input, 32, 0, 32, 32), 0.02);
+}
+
+TEST_CASE(ImpulseSpreadsFurtherEachPass)
+{
+	// The taps of pass n are 2^n pixels apart, so one pass
+	// reaches 2 pixels and two reach 2 + 4.  A huge luminance
+	// allowance leaves just the spline kernel.
+	TestImage image(31, 1);
+	image.Fill([](unsigned int x, unsigned int) { return x == 15 ? 1.0f : 0.0f; }, 16);
+
+	ATrousSettings settings;
+	settings.LuminancePhi = 1e6f;
+
+	settings.Iterations = 1;
+	std::vector<float> once = image.Filter(settings);
+	CHECK(once[15 + 2] > 0);
+	CHECK_EQUAL(once[15 + 3], 0.0f);
+	CHECK_EQUAL(once[15 - 3], 0.0f);
+
+	settings.Iterations = 2;
+	std::vector<float> twice = image.Filter(settings);
+	CHECK(twice[15 + 6] > 0);
+	CHECK(twice[15 - 6] > 0);
+	CHECK_EQUAL(twice[15 + 7], 0.0f);
+	CHECK_EQUAL(twice[15 - 7], 0.0f);
+}
+
+TEST_CASE(StopsAtNormalEdges)
+{
+	// Two walls meeting at a right angle, one darker, with
+	// enough noise that luminance alone wouldn't keep them apart
+	TestImage image(32, 16);
+	for (unsigned int y = 0; y < 16; y++)
+	{
+		for (unsigned int x = 16; x < 32; x++)
+			image.NormalDepth[y * 32 + x] = FilterFloat4{ 1, 0, 0, 1 };
+	}
+	image.Fill([](unsigned int x, unsigned int y) { return (x < 16 ? 0.2f : 0.8f) + 0.05f * Noise(x, y); }, 16 * 0.5f);
+
+	std::vector<float> filtered = image.Filter(ATrousSettings());
+	CHECK_NEAR(Mean(filtered, 32, 14, 16, 16), 0.2, 0.02);
+	CHECK_NEAR(Mean(filtered, 32, 16, 18, 16), 0.8, 0.02);
+
+	// Ignoring normals, the walls bleed into each other
+	ATrousSettings settings;
+	settings.NormalPhi = 0;
+	std::vector<float> blurred = image.Filter(settings);
+	CHECK(Mean(blurred, 32, 14, 16, 16) > 0.3);
+	CHECK(Mean(blurred, 32, 16, 18, 16) < 0.7);
+}
+
+TEST_CASE(StopsAtDepthEdges)
+{
+	// The same wall, with the right half much farther away
+	TestImage image(32, 16);
+	for (unsigned int y = 0; y < 16; y++)
+	{
+		for (unsigned int x = 16; x < 32; x++)
+			image.NormalDepth[y * 32 + x].w = 10;
+	}
+	image.Fill([](unsigned int x, unsigned int y) { return (x < 16 ? 0.2f : 0.8f) + 0.05f * Noise(x, y); }, 16 * 0.5f);
+
+	std::vector<float> filtered = image.Filter(ATrousSettings());
+	CHECK_NEAR(Mean(filtered, 32, 14, 16, 16), 0.2, 0.02);
+	CHECK_NEAR(Mean(filtered, 32, 16, 18, 16), 0.8, 0.02);
+
+	// A slope in depth isn't an edge, since the allowance
+	// grows with the distance between pixels
+	TestImage slope(32, 16);
+	for (unsigned int i = 0; i < slope.NormalDepth.size(); i++)
+		slope.NormalDepth[i].w = 1 + 0.002f * (i % 32);
+	slope.Fill([](unsigned int x, unsigned int y) { return 0.5f + 0.3f * Noise(x, y); }, 16 * 0.03f);
+	std::vector<float> smoothed = slope.Filter(ATrousSettings());
+	CHECK(RMSError(smoothed, 32, 0, 32, 16, 0.5) < 0.05);
+}
+
+TEST_CASE(StopsAtLightingEdgesWithoutNoise)
+{
+	// A shadow edge on a flat wall - with no variance there's
+	// no noise to remove, so it's kept exactly
+	TestImage image(32, 16);
+	image.Fill([](unsigned int x, unsigned int) { return x < 16 ? 0.2f : 0.8f; });
+	std::vector<float> filtered = image.Filter(ATrousSettings());
+	for (size_t i = 0; i < filtered.size(); i++)
+		CHECK_NEAR(filtered[i], i % 32 < 16 ? 0.2f : 0.8f, 1e-4f);
+
+	// But a noisy enough one is blurred over
+	image.Fill([](unsigned int x, unsigned int) { return x < 16 ? 0.2f : 0.8f; }, 16 * 4.0f);
+	std::vector<float> blurred = image.Filter(ATrousSettings());
+	CHECK(blurred[8 * 32 + 15] > 0.3f);
+}
+
+TEST_CASE(KeepsTexturesAndTheSky)
+{
+	// Even lighting on a checkerboard texture: the noise is in
+	// the lighting, so the texture comes through untouched
+	TestImage image(16, 16);
+	for (unsigned int i = 0; i < image.Albedo.size(); i++)
+	{
+		float albedo = ((i % 16) / 2 + (i / 16) / 2) % 2 ? 0.9f : 0.1f;
+		image.Albedo[i] = FilterFloat4{ albedo, albedo, albedo, 1 };
+	}
+
+	// With the top rows sky (a zero normal and one albedo)
+	for (unsigned int i = 0; i < 16 * 4; i++)
+	{
+		image.NormalDepth[i] = FilterFloat4{ 0, 0, 0, 0 };
+		image.Albedo[i] = FilterFloat4{ 1, 1, 1, 1 };
+	}
+	image.Fill([](unsigned int x, unsigned int y) { return y < 4 ? 5.0f + Noise(x, y) : 0.5f; }, 16 * 0.1f);
+
+	std::vector<float> filtered = image.Filter(ATrousSettings());
+	for (size_t i = 0; i < filtered.size(); i++)
+		CHECK_NEAR(filtered[i], image.Color[i].x, 1e-4f * image.Color[i].x + 1e-6f);
+}
@@ -0,0 +1,134 @@
+#include "TestFramework.h"
+#include "AccelerationStructureMemory.h"
+
+// --------------------------------------------------------
+// AccelerationStructureMemory, with sizes and fence values
+// as RayTracing would report them
+// --------------------------------------------------------
+
+TEST_CASE(BuiltBLASesAddUp)
+{
+	AccelerationStructureMemory memory;
+	CHECK_EQUAL(memory.AddBLAS(1000), 0u);
+	CHECK_EQUAL(memory.AddBLAS(3000), 1u);
+	memory.SetTLASSize(500, 1);
+
+	AccelerationStructureMemoryStats stats = memory.GetStats();
+	CHECK_EQUAL(stats.BLASCount, 2u);
+	CHECK_EQUAL(stats.CompactedBLASCount, 0u);
+	CHECK_EQUAL(stats.TotalBytesBeforeCompaction(), 4500u);
+	CHECK_EQUAL(stats.TotalBytes(), 4500u);
+
+	// The first TLAS doesn't replace anything
+	CHECK_EQUAL(stats.PendingReleaseBytes, 0u);
+	CHECK_EQUAL(stats.ResidentBytes(), 4500u);
+}
+
+TEST_CASE(CompactionShrinksTheTotal)
+{
+	AccelerationStructureMemory memory;
+	unsigned int a = memory.AddBLAS(1000);
+	unsigned int b = memory.AddBLAS(3000);
+	memory.SetTLASSize(500, 1);
+
+	CHECK(memory.CompactBLAS(a, 400, 1));
+	CHECK(memory.CompactBLAS(b, 1000, 1));
+
+	// Before stays as built, after reflects the compacted sizes
+	AccelerationStructureMemoryStats stats = memory.GetStats();
+	CHECK_EQUAL(stats.CompactedBLASCount, 2u);
+	CHECK_EQUAL(stats.BLASBytesBeforeCompaction, 4000u);
+	CHECK_EQUAL(stats.BLASBytes, 1400u);
+	CHECK_EQUAL(stats.TotalBytesBeforeCompaction(), 4500u);
+	CHECK_EQUAL(stats.TotalBytes(), 1900u);
+}
+
+TEST_CASE(CompactionThatDoesntHelpIsRefused)
+{
+	AccelerationStructureMemory memory;
+	unsigned int a = memory.AddBLAS(1000);
+
+	CHECK(!memory.CompactBLAS(a, 1000, 1));
+	CHECK(!memory.CompactBLAS(a, 2000, 1));
+	CHECK(!memory.CompactBLAS(a, 0, 1));
+	CHECK(!memory.CompactBLAS(5, 10, 1));
+
+	// Only once
+	CHECK(memory.CompactBLAS(a, 600, 1));
+	CHECK(!memory.CompactBLAS(a, 300, 1));
+
+	AccelerationStructureMemoryStats stats = memory.GetStats();
+	CHECK_EQUAL(stats.CompactedBLASCount, 1u);
+	CHECK_EQUAL(stats.BLASBytes, 600u);
+	CHECK_EQUAL(stats.PendingReleaseBytes, 1000u);
+}
+
+TEST_CASE(OriginalsStayResidentUntilTheirFenceCompletes)
+{
+	AccelerationStructureMemory memory;
+	unsigned int a = memory.AddBLAS(1000);
+	unsigned int b = memory.AddBLAS(2000);
+
+	// Compacted in frames 1 and 2
+	memory.CompactBLAS(a, 400, 1);
+	memory.CompactBLAS(b, 500, 2);
+
+	AccelerationStructureMemoryStats stats = memory.GetStats();
+	CHECK_EQUAL(stats.TotalBytes(), 900u);
+	CHECK_EQUAL(stats.PendingReleaseBytes, 3000u);
+	CHECK_EQUAL(stats.ResidentBytes(), 3900u);
+
+	// The GPU hasn't finished either frame
+	memory.Retire(0);
+	CHECK_EQUAL(memory.GetStats().PendingReleaseBytes, 3000u);
+
+	// Frame 1 is done, so only its original goes
+	memory.Retire(1);
+	CHECK_EQUAL(memory.GetStats().PendingReleaseBytes, 2000u);
+	CHECK_EQUAL(memory.GetStats().ResidentBytes(), 2900u);
+
+	// Retiring the same value again changes nothing
+	memory.Retire(1);
+	CHECK_EQUAL(memory.GetStats().PendingReleaseBytes, 2000u);
+
+	memory.Retire(5);
+	stats = memory.GetStats();
+	CHECK_EQUAL(stats.PendingReleaseBytes, 0u);
+	CHECK_EQUAL(stats.ResidentBytes(), stats.TotalBytes());
+}
+
+TEST_CASE(ReplacedTLASIsPendingUntilItsFence)
+{
+	AccelerationStructureMemory memory;
+	memory.SetTLASSize(500, 1);
+
+	// Grows in frame 3, then again in frame 4
+	memory.SetTLASSize(800, 3);
+	memory.SetTLASSize(1200, 4);
+
+	AccelerationStructureMemoryStats stats = memory.GetStats();
+	CHECK_EQUAL(stats.TLASBytes, 1200u);
+	CHECK_EQUAL(stats.PendingReleaseBytes, 1300u);
+
+	memory.Retire(3);
+	CHECK_EQUAL(memory.GetStats().PendingReleaseBytes, 800u);
+	memory.Retire(4);
+	CHECK_EQUAL(memory.GetStats().PendingReleaseBytes, 0u);
+	CHECK_EQUAL(memory.GetStats().ResidentBytes(), 1200u);
+}
+
+TEST_CASE(ClearForgetsPendingReleases)
+{
+	AccelerationStructureMemory memory;
+	unsigned int a = memory.AddBLAS(1000);
+	memory.CompactBLAS(a, 100, 7);
+	memory.Clear();
+
+	AccelerationStructureMemoryStats stats = memory.GetStats();
+	CHECK_EQUAL(stats.BLASCount, 0u);
+	CHECK_EQUAL(stats.ResidentBytes(), 0u);
+
+	// Nothing left to retire, and nothing goes negative
+	memory.Retire(7);
+	CHECK_EQUAL(memory.GetStats().PendingReleaseBytes, 0u);
+}
@@ -0,0 +1,308 @@
+#include "TestFramework.h"
+#include "AdaptiveSampling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	const unsigned int Width = 32;
+	const unsigned int Height = 32;
+
+	// Kinds of pixel in the test image
+	enum PixelKind
+	{
+		PIXEL_SKY,			// The same luminance every sample
+		PIXEL_DIFFUSE,		// Moderate, even noise
+		PIXEL_CAUSTIC		// Mostly dark with rare, very bright samples
+	};
+
+	// Top half sky, bottom half diffuse, with a patch of caustic
+	PixelKind KindAt(unsigned int x, unsigned int y)
+	{
+		if (y < Height / 2)
+			return PIXEL_SKY;
+		if (x >= 12 && x < 16 && y >= 24 && y < 28)
+			return PIXEL_CAUSTIC;
+		return PIXEL_DIFFUSE;
+	}
+
+	// Deterministic random numbers in [0, 1), so each run of the
+	// tests sees exactly the same samples
+	struct Random
+	{
+		uint32_t State;
+		float Next()
+		{
+			State ^= State << 13;
+			State ^= State >> 17;
+			State ^= State << 5;
+			return (State >> 8) / 16777216.0f;
+		}
+	};
+
+	float SampleLuminance(PixelKind kind, Random& random)
+	{
+		switch (kind)
+		{
+		case PIXEL_SKY: return 1.0f;
+		case PIXEL_DIFFUSE: return 0.1f + 0.8f * random.Next();
+		default: return random.Next() < 0.05f ? 10.0f : 0.2f;
+		}
+	}
+
+	// Folds new samples into a pixel's moments, like the shader
+	void AddSamples(PixelMoments& pixel, PixelKind kind, unsigned int count, Random& random)
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			float luminance = SampleLuminance(kind, random);
+			float weight = 1.0f / (pixel.SampleCount + 1);
+			pixel.MeanLuminance += (luminance - pixel.MeanLuminance) * weight;
+			pixel.MeanLuminanceSquared += (luminance * luminance - pixel.MeanLuminanceSquared) * weight;
+			pixel.SampleCount++;
+		}
+	}
+
+	// What happened over a simulated run
+	struct RunResult
+	{
+		std::vector<PixelMoments> Pixels;
+		std::vector<uint64_t> SamplesPerFrame;
+		std::vector<uint64_t> BudgetPerFrame;
+		bool Converged = false;
+	};
+
+	// --------------------------------------------------------
+	// Renders the test image frame by frame the way the ray
+	// tracer does: allocate from the sampler, trace that many
+	// samples per pixel, then feed back the counts.  Feedback
+	// arrives feedbackDelay frames late, like the readback.
+	// --------------------------------------------------------
+	RunResult Run(const AdaptiveSamplingSettings& settings, unsigned int maxFrames, unsigned int feedbackDelay = 2)
+	{
+		AdaptiveSampler sampler;
+		sampler.SetSettings(settings);
+		sampler.SetPixelCount(Width * Height);
+
+		RunResult result;
+		result.Pixels.resize(Width * Height);
+		Random random = { 12345 };
+		std::vector<uint64_t> activePerFrame;
+		std::vector<unsigned int> samples;
+
+		for (unsigned int frame = 0; frame < maxFrames && !sampler.IsConverged(); frame++)
+		{
+			if (frame >= feedbackDelay)
+			{
+				unsigned int finished = frame - feedbackDelay;
+				sampler.RecordFrame(activePerFrame[finished], result.SamplesPerFrame[finished]);
+			}
+
+			AdaptiveSampleAllocation allocation = sampler.GetAllocation();
+			uint64_t active = 0;
+			for (const PixelMoments& pixel : result.Pixels)
+				active += AdaptiveSampler::IsActive(pixel, settings) ? 1 : 0;
+
+			uint64_t total = AdaptiveSampler::AllocateImage(result.Pixels, Width, frame, settings, allocation, samples);
+			for (unsigned int i = 0; i < Width * Height; i++)
+				AddSamples(result.Pixels[i], KindAt(i % Width, i / Width), samples[i], random);
+
+			activePerFrame.push_back(active);
+			result.SamplesPerFrame.push_back(total);
+			result.BudgetPerFrame.push_back(sampler.GetRayBudget());
+		}
+
+		result.Converged = sampler.IsConverged();
+		return result;
+	}
+
+	AdaptiveSamplingSettings TestSettings(float rayBudgetPerPixel)
+	{
+		AdaptiveSamplingSettings settings;
+		settings.ErrorThreshold = 0.05f;
+		settings.RayBudgetPerPixel = rayBudgetPerPixel;
+		return settings;
+	}
+
+	PixelMoments MakePixel(float mean, float meanSquared, float sampleCount)
+	{
+		PixelMoments pixel;
+		pixel.MeanLuminance = mean;
+		pixel.MeanLuminanceSquared = meanSquared;
+		pixel.SampleCount = sampleCount;
+		return pixel;
+	}
+}
+
+// --------------------------------------------------------
+// AdaptiveSampler's CPU reference of the shader's policy,
+// on hand-made pixels and then on a simulated image of
+// sky, diffuse and caustic pixels that's rendered until it
+// converges
+// --------------------------------------------------------
+
+TEST_CASE(RelativeErrorOfTheMean)
+{
+	// Variance 0.25 - 0.09 = 0.16 over 16 samples is a standard
+	// error of 0.1, relative to the mean of 0.3
+	CHECK_NEAR(AdaptiveSampler::RelativeError(MakePixel(0.3f, 0.25f, 16)), 0.1 / 0.3, 1e-5);
+
+	// Near-black pixels are measured against a floor instead
+	CHECK_NEAR(AdaptiveSampler::RelativeError(MakePixel(0.001f, 0.000401f, 4)), 0.01 / 0.01, 1e-3);
+
+	// Flat pixels have no error, and one sample says nothing
+	CHECK_EQUAL(AdaptiveSampler::RelativeError(MakePixel(2, 4, 10)), 0.0f);
+	CHECK(std::isinf(AdaptiveSampler::RelativeError(MakePixel(2, 4, 1))));
+}
+
+TEST_CASE(PixelsStayActiveUntilTrusted)
+{
+	AdaptiveSamplingSettings settings = TestSettings(1);
+	settings.MinSamples = 8;
+
+	// Flat, but too few samples to believe it yet
+	CHECK(AdaptiveSampler::IsActive(MakePixel(1, 1, 7), settings));
+	CHECK(!AdaptiveSampler::IsActive(MakePixel(1, 1, 8), settings));
+
+	// Noisy
+	CHECK(AdaptiveSampler::IsActive(MakePixel(0.3f, 0.25f, 16), settings));
+
+	// Everything's active with adaptive sampling off
+	settings.Enabled = false;
+	CHECK(AdaptiveSampler::IsActive(MakePixel(1, 1, 100), settings));
+}
+
+TEST_CASE(AllocationSharesTheBudget)
+{
+	AdaptiveSampler sampler;
+	sampler.SetSettings(TestSettings(1));
+	sampler.SetPixelCount(1000);
+	CHECK_EQUAL(sampler.GetRayBudget(), 1000u);
+
+	// Before any feedback, everything is assumed active
+	AdaptiveSampleAllocation allocation = sampler.GetAllocation();
+	CHECK_EQUAL(allocation.SamplesPerActivePixel, 1u);
+	CHECK_EQUAL(allocation.ActivePixelFraction, 1.0f);
+
+	// Few active pixels get more samples each, up to the limit
+	sampler.RecordFrame(300, 1000);
+	CHECK_EQUAL(sampler.GetAllocation().SamplesPerActivePixel, 3u);
+	sampler.RecordFrame(10, 100);
+	CHECK_EQUAL(sampler.GetAllocation().SamplesPerActivePixel, 8u);
+
+	// More active pixels than the budget: a subset is traced
+	sampler.SetSettings(TestSettings(0.25f));
+	sampler.RecordFrame(1000, 250);
+	allocation = sampler.GetAllocation();
+	CHECK_EQUAL(allocation.SamplesPerActivePixel, 1u);
+	CHECK_NEAR(allocation.ActivePixelFraction, 0.25, 1e-6);
+
+	// Nothing active, nothing to do
+	CHECK(!sampler.IsConverged());
+	sampler.RecordFrame(0, 0);
+	CHECK(sampler.IsConverged());
+
+	// Until the resolution changes
+	sampler.SetPixelCount(2000);
+	CHECK(!sampler.IsConverged());
+	CHECK_EQUAL(sampler.GetLastActivePixelCount(), 2000u);
+}
+
+TEST_CASE(PixelHashIsPinnedAndEven)
+{
+	// The shader has its own copy, so the values can't change
+	CHECK_EQUAL(AdaptiveSampler::PixelHash01(0, 0, 0), 0.752583086f);
+	CHECK_EQUAL(AdaptiveSampler::PixelHash01(17, 3, 9), 0.55410254f);
+
+	// And a quarter of pixels fall below a quarter
+	unsigned int below = 0;
+	for (unsigned int y = 0; y < 64; y++)
+	{
+		for (unsigned int x = 0; x < 64; x++)
+			below += AdaptiveSampler::PixelHash01(x, y, 5) < 0.25f ? 1 : 0;
+	}
+	CHECK_NEAR(below / 4096.0, 0.25, 0.02);
+}
+
+TEST_CASE(ConvergedPixelsStopCostingRays)
+{
+	AdaptiveSamplingSettings settings = TestSettings(1);
+	RunResult run = Run(settings, 5000);
+	REQUIRE(run.Converged);
+
+	// Every pixel ends up under the threshold
+	float maxError = 0;
+	for (const PixelMoments& pixel : run.Pixels)
+		maxError = std::max(maxError, AdaptiveSampler::RelativeError(pixel));
+	CHECK(maxError <= settings.ErrorThreshold);
+
+	// Sky stops as soon as it's trusted, and the caustic, being
+	// the noisiest, takes far more samples than the diffuse
+	float sky = run.Pixels[0].SampleCount;
+	float diffuse = run.Pixels[(Height - 2) * Width + 2].SampleCount;
+	float caustic = run.Pixels[25 * Width + 13].SampleCount;
+	CHECK(sky < settings.MinSamples + settings.MaxSamplesPerPixelPerFrame);
+	CHECK(diffuse > 20 * sky);
+	CHECK(caustic > 10 * diffuse);
+}
+
+TEST_CASE(NeverTracesMoreThanTheBudget)
+{
+	// With plenty of budget, a generous one, and a tight one
+	for (float budgetPerPixel : { 4.0f, 1.0f, 0.25f })
+	{
+		RunResult run = Run(TestSettings(budgetPerPixel), 5000);
+		CHECK(run.Converged);
+
+		// Pixels without any samples are always traced, so the
+		// first frame can go over
+		CHECK(run.SamplesPerFrame[0] >= (uint64_t)Width * Height);
+
+		// After that the active count only shrinks, so the
+		// predicted allocation stays within the budget.  Tracing
+		// a hashed subset is only right on average, so allow for
+		// the spread of a coin flip per pixel (four deviations).
+		uint64_t overBudget = 0;
+		uint64_t samples = 0, budget = 0;
+		for (size_t frame = 1; frame < run.SamplesPerFrame.size(); frame++)
+		{
+			double frameBudget = (double)run.BudgetPerFrame[frame];
+			if (run.SamplesPerFrame[frame] > frameBudget + 4 * std::sqrt(frameBudget))
+				overBudget++;
+			samples += run.SamplesPerFrame[frame];
+			budget += run.BudgetPerFrame[frame];
+		}
+		CHECK_EQUAL(overBudget, 0u);
+		CHECK(samples <= budget * 1.01);
+	}
+}
+
+TEST_CASE(TighterBudgetsTakeLonger)
+{
+	// The same image, with less to spend per frame
+	RunResult generous = Run(TestSettings(1), 5000);
+	RunResult tight = Run(TestSettings(0.25f), 5000);
+	REQUIRE(generous.Converged && tight.Converged);
+	CHECK(tight.SamplesPerFrame.size() > generous.SamplesPerFrame.size());
+
+	// Spending much the same number of samples overall
+	uint64_t generousTotal = 0, tightTotal = 0;
+	for (uint64_t samples : generous.SamplesPerFrame) generousTotal += samples;
+	for (uint64_t samples : tight.SamplesPerFrame) tightTotal += samples;
+	CHECK(tightTotal < generousTotal * 1.25 && generousTotal < tightTotal * 1.25);
+}
+
+TEST_CASE(DisabledTracesEverythingAtTheLimit)
+{
+	AdaptiveSamplingSettings settings = TestSettings(1);
+	settings.Enabled = false;
+	RunResult run = Run(settings, 10);
+	CHECK(!run.Converged);
+	CHECK_EQUAL(run.SamplesPerFrame.size(), 10u);
+	CHECK_EQUAL(run.SamplesPerFrame[9], (uint64_t)Width * Height * settings.MaxSamplesPerPixelPerFrame);
+}
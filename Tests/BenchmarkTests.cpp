@@ -0,0 +1,204 @@
+#include "TestFramework.h"
+#include "Benchmark.h"
+#include "BenchmarkTimeline.h"
+#include "FixedTimestep.h"
+#include "ScriptedScene.h"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	TimelineKeyframe MakeKeyframe(float time, float x, float yaw, float scale = 1)
+	{
+		TimelineKeyframe keyframe;
+		keyframe.Time = time;
+		keyframe.Position = { x, 0, 0 };
+		keyframe.PitchYawRoll = { 0, yaw, 0 };
+		keyframe.Scale = { scale, scale, scale };
+		return keyframe;
+	}
+
+	// Runs the scripted scene for the given frame times
+	std::vector<SceneObjectState> Simulate(const std::vector<double>& frameSeconds, const BenchmarkTimeline* timeline)
+	{
+		FixedTimestep fixedTimestep;
+		std::vector<SceneObjectState> objects = ScriptedScene::CreateInitialObjects();
+		for (double frame : frameSeconds)
+		{
+			fixedTimestep.AddFrameTime(frame);
+			while (fixedTimestep.Step())
+				ScriptedScene::Step(objects, (float)fixedTimestep.GetStepSeconds(), (float)fixedTimestep.GetTime(), timeline);
+		}
+		return objects;
+	}
+
+	bool SameFloat3(const TimelineFloat3& a, const TimelineFloat3& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+}
+
+// --------------------------------------------------------
+// BenchmarkTimeline, the scripted scene and headless runs
+// --------------------------------------------------------
+
+TEST_CASE(TimelineInterpolatesAndHoldsItsEnds)
+{
+	BenchmarkTimeline timeline;
+	CHECK(timeline.IsEmpty());
+
+	// Added out of order on purpose
+	timeline.AddCameraKeyframe(MakeKeyframe(2, 10, 1));
+	timeline.AddCameraKeyframe(MakeKeyframe(0, 0, 0));
+	CHECK(!timeline.IsEmpty());
+	CHECK_EQUAL(timeline.GetDuration(), 2.0f);
+
+	TimelineKeyframe result;
+	REQUIRE(timeline.SampleCamera(0.5f, result));
+	CHECK_NEAR(result.Position.x, 2.5, 1e-6);
+	CHECK_NEAR(result.PitchYawRoll.y, 0.25, 1e-6);
+
+	timeline.SampleCamera(-1, result);
+	CHECK_EQUAL(result.Position.x, 0.0f);
+	timeline.SampleCamera(5, result);
+	CHECK_EQUAL(result.Position.x, 10.0f);
+
+	// A keyframe at an existing time replaces it
+	timeline.AddCameraKeyframe(MakeKeyframe(2, 20, 1));
+	timeline.SampleCamera(1, result);
+	CHECK_NEAR(result.Position.x, 10, 1e-6);
+}
+
+TEST_CASE(TimelineEntityTracksAreSeparate)
+{
+	BenchmarkTimeline timeline;
+	timeline.AddEntityKeyframe(2, MakeKeyframe(0, 1, 0, 1));
+	timeline.AddEntityKeyframe(2, MakeKeyframe(4, 1, 0, 3));
+	CHECK_EQUAL(timeline.GetEntityTrackCount(), 3u);
+	CHECK_EQUAL(timeline.GetDuration(), 4.0f);
+
+	TimelineKeyframe result;
+	CHECK(!timeline.SampleCamera(0, result));
+	CHECK(!timeline.SampleEntity(0, 0, result));
+	CHECK(!timeline.SampleEntity(7, 0, result));
+	REQUIRE(timeline.SampleEntity(2, 1, result));
+	CHECK_NEAR(result.Scale.y, 1.5, 1e-6);
+}
+
+TEST_CASE(TimelineSurvivesASaveAndLoad)
+{
+	BenchmarkTimeline timeline;
+	timeline.AddCameraKeyframe(MakeKeyframe(0, 1.25f, 0.1f));
+	timeline.AddCameraKeyframe(MakeKeyframe(3, -7.5f, 3.14159274f));
+	timeline.AddEntityKeyframe(1, MakeKeyframe(0.5f, 2, 0, 0.333333343f));
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "BenchmarkTests.timeline";
+	REQUIRE(timeline.Save(path.wstring()));
+
+	BenchmarkTimeline loaded;
+	std::string error;
+	bool loadedOk = loaded.Load(path.wstring(), &error);
+	std::filesystem::remove(path);
+	REQUIRE(loadedOk);
+
+	TimelineKeyframe a, b;
+	for (float time : { 0.0f, 1.0f, 3.0f })
+	{
+		timeline.SampleCamera(time, a);
+		loaded.SampleCamera(time, b);
+		CHECK(SameFloat3(a.Position, b.Position));
+		CHECK(SameFloat3(a.PitchYawRoll, b.PitchYawRoll));
+	}
+
+	timeline.SampleEntity(1, 0, a);
+	loaded.SampleEntity(1, 0, b);
+	CHECK(SameFloat3(a.Scale, b.Scale));
+}
+
+TEST_CASE(TimelineRejectsBadLines)
+{
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "BenchmarkTests-bad.timeline";
+	{
+		std::ofstream file(path);
+		file << "# fine\n\ncamera 0 0 0 0 0 0 0\ncamera 1 0 0\n";
+	}
+
+	BenchmarkTimeline timeline;
+	std::string error;
+	CHECK(!timeline.Load(path.wstring(), &error));
+	CHECK_EQUAL(error, std::string("Invalid keyframe on line 4"));
+	CHECK(timeline.IsEmpty());
+	std::filesystem::remove(path);
+
+	CHECK(!timeline.Load(path.wstring(), &error));
+}
+
+TEST_CASE(ScriptedSceneDoesntDependOnFrameRate)
+{
+	// Two seconds at 60fps, at 30fps, and in uneven frames
+	std::vector<double> even60(120, 1.0 / 60.0);
+	std::vector<double> even30(60, 1.0 / 30.0);
+	std::vector<double> uneven;
+	for (int i = 0; i < 80; i++)
+		uneven.push_back(i % 2 ? 1.0 / 30.0 : 1.0 / 60.0);
+
+	std::vector<SceneObjectState> a = Simulate(even60, 0);
+	std::vector<SceneObjectState> b = Simulate(even30, 0);
+	std::vector<SceneObjectState> c = Simulate(uneven, 0);
+	REQUIRE(a.size() == b.size() && a.size() == c.size());
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		CHECK(SameFloat3(a[i].Position, b[i].Position) && SameFloat3(a[i].Position, c[i].Position));
+		CHECK(SameFloat3(a[i].PitchYawRoll, b[i].PitchYawRoll) && SameFloat3(a[i].PitchYawRoll, c[i].PitchYawRoll));
+		CHECK(SameFloat3(a[i].Scale, b[i].Scale) && SameFloat3(a[i].Scale, c[i].Scale));
+	}
+
+	// The sphere spins, the helix sinks and the cube stretches
+	CHECK_NEAR(a[0].PitchYawRoll.z, 4.0, 1e-4);
+	CHECK_NEAR(a[1].Position.y, -0.05, 1e-5);
+	CHECK_NEAR(a[2].Scale.z, std::fabs(1 + std::sin(2.0)), 1e-5);
+	CHECK_EQUAL(a[3].Position.x, 5.0f);
+}
+
+TEST_CASE(ScriptedSceneFollowsTheTimeline)
+{
+	BenchmarkTimeline timeline;
+	timeline.AddEntityKeyframe(0, MakeKeyframe(0, 0, 0));
+	timeline.AddEntityKeyframe(0, MakeKeyframe(1, 3, 2));
+
+	std::vector<SceneObjectState> objects = Simulate(std::vector<double>(30, 1.0 / 60.0), &timeline);
+	CHECK_NEAR(objects[0].Position.x, 1.5, 1e-5);
+	CHECK_NEAR(objects[0].PitchYawRoll.y, 1.0, 1e-5);
+
+	// Its scripted spin is overridden, while the others still animate
+	CHECK_EQUAL(objects[0].PitchYawRoll.z, 0.0f);
+	CHECK(objects[1].Position.y < 0);
+}
+
+TEST_CASE(HeadlessRunRecordsEveryFrame)
+{
+	BenchmarkTimeline timeline;
+	timeline.AddCameraKeyframe(MakeKeyframe(0, 0, 0));
+	timeline.AddCameraKeyframe(MakeKeyframe(1, 5, 1));
+
+	Benchmark::Options options;
+	std::string error;
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "BenchmarkTests.json";
+	REQUIRE(Benchmark::ParseCommandLine("-benchmark x.timeline -headless -frames 90 -objects 20 -max-mean 1000 -out \"" + path.string() + "\"", options, &error));
+	CHECK(options.Headless);
+	CHECK_EQUAL(options.FrameCount, 90u);
+	CHECK_EQUAL(options.ObjectCount, 20u);
+
+	CHECK_EQUAL(Benchmark::RunHeadless(options, timeline), Benchmark::ExitCodePassed);
+
+	std::ifstream file(path);
+	std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+	std::filesystem::remove(path);
+	CHECK(contents.find("\"frameCount\": 90,") != std::string::npos);
+}
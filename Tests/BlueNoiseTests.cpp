@@ -0,0 +1,142 @@
+#include "TestFramework.h"
+#include "BlueNoise.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Generating a tile takes a moment, so share one
+	const std::vector<uint16_t>& RendererTile()
+	{
+		static const std::vector<uint16_t> tile = BlueNoise::GenerateTile(BlueNoise::TileSize, 0);
+		return tile;
+	}
+
+	// Average rank difference to the four direct neighbors,
+	// wrapping around the edges like the renderer does.  Blue
+	// noise puts similar ranks far apart, so it scores higher
+	// than white noise (about a third of the texel count).
+	double MeanNeighborDifference(const std::vector<uint16_t>& ranks, unsigned int size)
+	{
+		double total = 0;
+		for (unsigned int y = 0; y < size; y++)
+		{
+			for (unsigned int x = 0; x < size; x++)
+			{
+				int rank = ranks[y * size + x];
+				total += std::abs(rank - ranks[y * size + (x + 1) % size]);
+				total += std::abs(rank - ranks[((y + 1) % size) * size + x]);
+			}
+		}
+		return total / (2.0 * size * size);
+	}
+
+	// How far the texels below a threshold are from the nearest
+	// other one, at minimum, wrapping around the edges
+	double MinimumSpacing(const std::vector<uint16_t>& ranks, unsigned int size, unsigned int threshold)
+	{
+		std::vector<unsigned int> texels;
+		for (unsigned int i = 0; i < ranks.size(); i++)
+		{
+			if (ranks[i] < threshold)
+				texels.push_back(i);
+		}
+
+		double closest = INFINITY;
+		for (size_t i = 0; i < texels.size(); i++)
+		{
+			for (size_t j = i + 1; j < texels.size(); j++)
+			{
+				int dx = std::abs((int)(texels[i] % size) - (int)(texels[j] % size));
+				int dy = std::abs((int)(texels[i] / size) - (int)(texels[j] / size));
+				dx = std::min(dx, (int)size - dx);
+				dy = std::min(dy, (int)size - dy);
+				closest = std::min(closest, std::sqrt((double)(dx * dx + dy * dy)));
+			}
+		}
+		return closest;
+	}
+}
+
+// --------------------------------------------------------
+// BlueNoise, on the tile the renderer generates at startup
+// --------------------------------------------------------
+
+TEST_CASE(EveryTexelGetsItsOwnRank)
+{
+	const std::vector<uint16_t>& ranks = RendererTile();
+	REQUIRE(ranks.size() == BlueNoise::TileSize * BlueNoise::TileSize);
+
+	std::vector<unsigned int> uses(ranks.size(), 0);
+	for (uint16_t rank : ranks)
+	{
+		REQUIRE(rank < ranks.size());
+		uses[rank]++;
+	}
+
+	bool unique = true;
+	for (unsigned int count : uses)
+		unique = unique && count == 1;
+	CHECK(unique);
+}
+
+TEST_CASE(TileIsPinned)
+{
+	// The same seed always makes the same tile, since samples
+	// are offset by it and images should be reproducible
+	const std::vector<uint16_t>& ranks = RendererTile();
+	CHECK_EQUAL(ranks[0], 773u);
+	CHECK_EQUAL(ranks[1], 1602u);
+	CHECK_EQUAL(ranks[ranks.size() - 1], 1443u);
+	CHECK(BlueNoise::GenerateTile(BlueNoise::TileSize, 0) == ranks);
+	CHECK(BlueNoise::GenerateTile(BlueNoise::TileSize, 1) != ranks);
+}
+
+TEST_CASE(NeighborsHaveDistantRanks)
+{
+	const unsigned int size = BlueNoise::TileSize;
+	const std::vector<uint16_t>& ranks = RendererTile();
+	double blue = MeanNeighborDifference(ranks, size);
+
+	// The same ranks shuffled into white noise
+	std::vector<uint16_t> white = ranks;
+	uint32_t state = 1;
+	for (size_t i = white.size() - 1; i > 0; i--)
+	{
+		state = state * 1664525u + 1013904223u;
+		std::swap(white[i], white[(state >> 8) % (i + 1)]);
+	}
+
+	CHECK(MeanNeighborDifference(white, size) < size * size * 0.36);
+	CHECK(blue > 1.15 * MeanNeighborDifference(white, size));
+}
+
+TEST_CASE(LowRanksAreSpreadOut)
+{
+	// The lowest ranks form even patterns, with no two texels
+	// closer than half the average spacing (white noise would
+	// have some right next to each other)
+	const unsigned int size = BlueNoise::TileSize;
+	const std::vector<uint16_t>& ranks = RendererTile();
+	for (unsigned int threshold : { 16u, 64u, 256u })
+		CHECK(MinimumSpacing(ranks, size, threshold) >= 0.5 * std::sqrt((double)size * size / threshold));
+}
+
+TEST_CASE(OffsetsAreCentredInTheirRank)
+{
+	std::vector<float> offsets = BlueNoise::RanksToOffsets({ 0, 3, 1, 2 });
+	REQUIRE(offsets.size() == 4);
+	CHECK_EQUAL(offsets[0], 0.125f);
+	CHECK_EQUAL(offsets[1], 0.875f);
+	CHECK_EQUAL(offsets[2], 0.375f);
+	CHECK_EQUAL(offsets[3], 0.625f);
+
+	// Small tiles still work
+	CHECK(BlueNoise::GenerateTile(0, 0).empty());
+	CHECK_EQUAL(BlueNoise::GenerateTile(1, 0)[0], 0u);
+}
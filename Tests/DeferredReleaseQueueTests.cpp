@@ -0,0 +1,166 @@
+#include "TestFramework.h"
+#include "DeferredReleaseQueue.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Stands in for the frame fence: values are handed out as
+	// frames are submitted, and completed (in order) later on
+	struct FakeFence
+	{
+		uint64_t Signaled = 0;
+		uint64_t Completed = 0;
+
+		uint64_t Signal() { return ++Signaled; }
+		void Complete(uint64_t value) { Completed = value; }
+	};
+
+	// Stands in for a GPU resource, noting its id when it's
+	// destroyed (and optionally doing more, like a destructor
+	// that hands its own children to the queue)
+	struct Resource
+	{
+		int Id = 0;
+		std::vector<int>* Released = 0;
+		std::function<void()> OnRelease;
+
+		Resource(int id, std::vector<int>& released, std::function<void()> onRelease = 0) :
+			Id(id),
+			Released(&released),
+			OnRelease(onRelease)
+		{
+		}
+
+		Resource(Resource&& other) noexcept :
+			Id(other.Id),
+			Released(other.Released),
+			OnRelease(std::move(other.OnRelease))
+		{
+			other.Released = 0;
+		}
+
+		Resource& operator=(Resource&& other) = delete;
+		Resource(const Resource&) = delete;
+
+		~Resource()
+		{
+			if (!Released)
+				return;
+			Released->push_back(Id);
+			if (OnRelease)
+				OnRelease();
+		}
+	};
+}
+
+// --------------------------------------------------------
+// DeferredReleaseQueue, with a made up fence standing in
+// for the frame fence Graphics tags replaced resources with
+// --------------------------------------------------------
+
+TEST_CASE(ObjectsAreHeldUntilTheirFenceCompletes)
+{
+	FakeFence fence;
+	std::vector<int> released;
+	DeferredReleaseQueue<Resource> queue;
+
+	queue.Enqueue(Resource(1, released), fence.Signal());
+	queue.Enqueue(Resource(2, released), fence.Signal());
+	CHECK_EQUAL(queue.GetPendingCount(), 2u);
+
+	// Nothing has finished yet
+	CHECK_EQUAL(queue.Release(fence.Completed), 0u);
+	CHECK(released.empty());
+
+	fence.Complete(1);
+	CHECK_EQUAL(queue.Release(fence.Completed), 1u);
+	CHECK(released == std::vector<int>{ 1 });
+	CHECK_EQUAL(queue.GetPendingCount(), 1u);
+
+	// Releasing again with the same value does nothing more
+	CHECK_EQUAL(queue.Release(fence.Completed), 0u);
+
+	fence.Complete(2);
+	CHECK_EQUAL(queue.Release(fence.Completed), 1u);
+	CHECK((released == std::vector<int>{ 1, 2 }));
+	CHECK_EQUAL(queue.GetPendingCount(), 0u);
+}
+
+TEST_CASE(ObjectsFromTheSameFrameGoTogether)
+{
+	FakeFence fence;
+	std::vector<int> released;
+	DeferredReleaseQueue<Resource> queue;
+
+	uint64_t first = fence.Signal();
+	for (int id = 0; id < 3; id++)
+		queue.Enqueue(Resource(id, released), first);
+	uint64_t second = fence.Signal();
+	queue.Enqueue(Resource(3, released), second);
+
+	fence.Complete(first);
+	CHECK_EQUAL(queue.Release(fence.Completed), 3u);
+	CHECK((released == std::vector<int>{ 0, 1, 2 }));
+	CHECK_EQUAL(queue.GetPendingCount(), 1u);
+}
+
+TEST_CASE(SeveralFencesCanCompleteAtOnce)
+{
+	FakeFence fence;
+	std::vector<int> released;
+	DeferredReleaseQueue<Resource> queue;
+
+	// Five frames in flight, of which the GPU finishes three
+	// before the CPU next looks
+	for (int id = 0; id < 5; id++)
+		queue.Enqueue(Resource(id, released), fence.Signal());
+	fence.Complete(3);
+	CHECK_EQUAL(queue.Release(fence.Completed), 3u);
+	CHECK((released == std::vector<int>{ 0, 1, 2 }));
+
+	// And the rest, with the fence past the last of them
+	fence.Complete(7);
+	CHECK_EQUAL(queue.Release(fence.Completed), 2u);
+	CHECK_EQUAL(released.size(), (size_t)5);
+}
+
+TEST_CASE(FlushReleasesEverything)
+{
+	FakeFence fence;
+	std::vector<int> released;
+	DeferredReleaseQueue<Resource> queue;
+	for (int id = 0; id < 4; id++)
+		queue.Enqueue(Resource(id, released), fence.Signal());
+
+	queue.Flush();
+	CHECK((released == std::vector<int>{ 0, 1, 2, 3 }));
+	CHECK_EQUAL(queue.GetPendingCount(), 0u);
+	CHECK_EQUAL(queue.Release(fence.Signaled), 0u);
+}
+
+TEST_CASE(ObjectsEnqueuedDuringAReleaseAreKept)
+{
+	FakeFence fence;
+	std::vector<int> released;
+	DeferredReleaseQueue<Resource> queue;
+
+	// Releasing the first object hands another one to the queue,
+	// for a frame that hasn't finished yet
+	uint64_t first = fence.Signal();
+	uint64_t later = fence.Signal();
+	queue.Enqueue(Resource(1, released, [&]() { queue.Enqueue(Resource(2, released), later); }), first);
+
+	fence.Complete(first);
+	CHECK_EQUAL(queue.Release(fence.Completed), 1u);
+	CHECK(released == std::vector<int>{ 1 });
+	CHECK_EQUAL(queue.GetPendingCount(), 1u);
+
+	fence.Complete(later);
+	CHECK_EQUAL(queue.Release(fence.Completed), 1u);
+	CHECK((released == std::vector<int>{ 1, 2 }));
+}
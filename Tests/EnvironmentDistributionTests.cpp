@@ -0,0 +1,329 @@
+#include "TestFramework.h"
+#include "EnvironmentDistribution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	const float Pi = 3.14159265f;
+
+	// A gray map with the given brightness per texel
+	RadianceHDR::Image MakeImage(unsigned int width, unsigned int height, const std::function<float(unsigned int, unsigned int)>& brightness)
+	{
+		RadianceHDR::Image image;
+		image.Width = width;
+		image.Height = height;
+		image.RGBE.resize((size_t)width * height * 4);
+		for (unsigned int y = 0; y < height; y++)
+		{
+			for (unsigned int x = 0; x < width; x++)
+			{
+				// Exactly representable, so luminance is exactly the brightness
+				uint8_t* pixel = &image.RGBE[((size_t)y * width + x) * 4];
+				int exponent;
+				float mantissa = std::frexp(brightness(x, y), &exponent);
+				pixel[0] = pixel[1] = pixel[2] = (uint8_t)(mantissa * 256);
+				pixel[3] = mantissa > 0 ? (uint8_t)(exponent + 128) : 0;
+			}
+		}
+		return image;
+	}
+
+	// Dim sky with a bright sun and a brighter horizon band
+	RadianceHDR::Image MakeSky(unsigned int width, unsigned int height)
+	{
+		return MakeImage(width, height, [=](unsigned int x, unsigned int y)
+			{
+				if (x == width / 4 && y == height / 5)
+					return 2000.0f;
+				return y > height / 2 && y < height * 3 / 5 ? 2.0f : 0.25f + (x % 8) / 16.0f;
+			});
+	}
+
+	float Luminance(const RadianceHDR::Color& color)
+	{
+		return 0.2126f * color.R + 0.7152f * color.G + 0.0722f * color.B;
+	}
+
+	// --------------------------------------------------------
+	// SampleEnvironment() and EnvironmentPdf() from
+	// RayTracing.hlsl, line for line, reading the flat buffer
+	// of CDFs the shader is given.  Keep these in sync.
+	// --------------------------------------------------------
+	struct ShaderEnvironment
+	{
+		const std::vector<float>& EnvironmentCDF;
+		unsigned int environmentWidth;
+		unsigned int environmentHeight;
+
+		uint32_t FindInCDF(uint32_t start, uint32_t count, float u) const
+		{
+			uint32_t low = 0;
+			uint32_t high = count - 1;
+			while (low < high)
+			{
+				uint32_t middle = (low + high) / 2;
+				if (EnvironmentCDF[start + middle] > u)
+					high = middle;
+				else
+					low = middle + 1;
+			}
+			return low;
+		}
+
+		EnvironmentFloat3 SampleEnvironment(float ux, float uy, float& pdf) const
+		{
+			uint32_t y = FindInCDF(0, environmentHeight, uy);
+			float rowStart = y > 0 ? EnvironmentCDF[y - 1] : 0;
+			float rowEnd = EnvironmentCDF[y];
+
+			uint32_t row = environmentHeight + y * environmentWidth;
+			uint32_t x = FindInCDF(row, environmentWidth, ux);
+			float columnStart = x > 0 ? EnvironmentCDF[row + x - 1] : 0;
+			float columnEnd = EnvironmentCDF[row + x];
+
+			EnvironmentFloat2 uv{
+				(x + (ux - columnStart) / std::max(columnEnd - columnStart, 1e-12f)) / environmentWidth,
+				(y + (uy - rowStart) / std::max(rowEnd - rowStart, 1e-12f)) / environmentHeight };
+
+			float sinTheta = std::sin(uv.y * Pi);
+			float pdfUV = (rowEnd - rowStart) * environmentHeight * (columnEnd - columnStart) * environmentWidth;
+			pdf = sinTheta > 0 ? pdfUV / (2 * Pi * Pi * sinTheta) : 0;
+			return EnvironmentDistribution::UVToDirection(uv);
+		}
+
+		float EnvironmentPdf(const EnvironmentFloat3& direction) const
+		{
+			EnvironmentFloat2 uv = EnvironmentDistribution::DirectionToUV(direction);
+			uint32_t x = std::min((uint32_t)(uv.x * environmentWidth), environmentWidth - 1);
+			uint32_t y = std::min((uint32_t)(uv.y * environmentHeight), environmentHeight - 1);
+
+			uint32_t row = environmentHeight + y * environmentWidth;
+			float rowProbability = EnvironmentCDF[y] - (y > 0 ? EnvironmentCDF[y - 1] : 0);
+			float columnProbability = EnvironmentCDF[row + x] - (x > 0 ? EnvironmentCDF[row + x - 1] : 0);
+
+			float sinTheta = std::sqrt(std::max(1 - direction.y * direction.y, 0.0f));
+			float pdfUV = rowProbability * environmentHeight * columnProbability * environmentWidth;
+			return sinTheta > 0 ? pdfUV / (2 * Pi * Pi * sinTheta) : 0;
+		}
+	};
+}
+
+// --------------------------------------------------------
+// EnvironmentDistribution, on small generated maps: the
+// CDFs it builds, the solid angle pdfs (which have to allow
+// for the sin(theta) weighting) and the copy of the
+// shader's sampler
+// --------------------------------------------------------
+
+TEST_CASE(CDFsEndAtOne)
+{
+	EnvironmentDistribution distribution;
+	distribution.Build(MakeSky(64, 32));
+	REQUIRE(distribution.GetWidth() == 64);
+	REQUIRE(distribution.GetHeight() == 32);
+
+	const std::vector<float>& cdfs = distribution.GetCDFs();
+	REQUIRE(cdfs.size() == 32 + 64 * 32);
+
+	// The marginal CDF, then each row's
+	bool increasing = true;
+	for (unsigned int row = 0; row <= 32; row++)
+	{
+		unsigned int start = row == 0 ? 0 : 32 + (row - 1) * 64;
+		unsigned int count = row == 0 ? 32 : 64;
+		for (unsigned int i = 1; i < count; i++)
+			increasing = increasing && cdfs[start + i] >= cdfs[start + i - 1];
+		CHECK(cdfs[start] >= 0);
+		CHECK_EQUAL(cdfs[start + count - 1], 1.0f);
+	}
+	CHECK(increasing);
+
+	// A black map falls back to even CDFs, rather than
+	// dividing by zero
+	distribution.Build(MakeImage(4, 2, [](unsigned int, unsigned int) { return 0.0f; }));
+	CHECK_EQUAL(distribution.GetCDFs()[0], 0.5f);
+	CHECK_EQUAL(distribution.GetCDFs()[2], 0.25f);
+
+	// And there's nothing to build from an empty one
+	distribution.Build(RadianceHDR::Image());
+	CHECK(distribution.GetCDFs().empty());
+	float pdf = 1;
+	distribution.Sample(0.5f, 0.5f, &pdf);
+	CHECK_EQUAL(pdf, 0.0f);
+}
+
+TEST_CASE(RowsAreWeightedBySinTheta)
+{
+	// Rows near the poles cover less of the sphere, so even a
+	// constant map picks them less often...
+	const unsigned int width = 64;
+	const unsigned int height = 32;
+	EnvironmentDistribution distribution;
+	distribution.Build(MakeImage(width, height, [](unsigned int, unsigned int) { return 1.0f; }));
+	const std::vector<float>& cdfs = distribution.GetCDFs();
+
+	double sinTotal = 0;
+	for (unsigned int y = 0; y < height; y++)
+		sinTotal += std::sin((y + 0.5) / height * Pi);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		float rowProbability = cdfs[y] - (y > 0 ? cdfs[y - 1] : 0);
+		CHECK_NEAR(rowProbability, std::sin((y + 0.5) / height * Pi) / sinTotal, 1e-6);
+		CHECK_NEAR(cdfs[height + y * width], 1.0f / width, 1e-6f);
+	}
+
+	// ...which the solid angle pdf cancels out, leaving the
+	// same pdf as sampling the sphere uniformly
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x += 7)
+		{
+			EnvironmentFloat3 direction = EnvironmentDistribution::UVToDirection({ (x + 0.5f) / width, (y + 0.5f) / height });
+			CHECK_NEAR(distribution.Pdf(direction), 1 / (4 * Pi), 2e-3f / (4 * Pi));
+		}
+	}
+}
+
+TEST_CASE(PdfIntegratesToOne)
+{
+	EnvironmentDistribution distribution;
+	distribution.Build(MakeSky(64, 32));
+
+	// Midpoint rule over the sphere, finely enough that every
+	// texel gets plenty of points
+	const unsigned int steps = 1024;
+	double integral = 0;
+	for (unsigned int j = 0; j < steps / 2; j++)
+	{
+		double theta = (j + 0.5) / (steps / 2) * Pi;
+		for (unsigned int i = 0; i < steps; i++)
+		{
+			double phi = (i + 0.5) / steps * 2 * Pi - Pi;
+			EnvironmentFloat3 direction{
+				(float)(std::sin(theta) * std::cos(phi)),
+				(float)std::cos(theta),
+				(float)(std::sin(theta) * std::sin(phi)) };
+			integral += distribution.Pdf(direction) * std::sin(theta);
+		}
+	}
+	integral *= (Pi / (steps / 2)) * (2 * Pi / steps);
+	CHECK_NEAR(integral, 1.0, 2e-3);
+}
+
+TEST_CASE(SampledPdfMatchesPdf)
+{
+	EnvironmentDistribution distribution;
+	distribution.Build(MakeSky(64, 32));
+
+	const unsigned int steps = 256;
+	unsigned int mismatches = 0;
+	for (unsigned int j = 0; j < steps; j++)
+	{
+		for (unsigned int i = 0; i < steps; i++)
+		{
+			float pdf = 0;
+			EnvironmentFloat3 direction = distribution.Sample((i + 0.5f) / steps, (j + 0.5f) / steps, &pdf);
+			CHECK(pdf > 0);
+			CHECK_NEAR(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z, 1.0f, 1e-5f);
+
+			// Directions right on a texel's edge can round into its
+			// neighbor when turned back into coordinates
+			if (std::abs(distribution.Pdf(direction) - pdf) > 1e-3f * pdf)
+				mismatches++;
+		}
+	}
+	CHECK(mismatches <= steps * steps / 1000);
+}
+
+TEST_CASE(MatchesTheShader)
+{
+	EnvironmentDistribution distribution;
+	distribution.Build(MakeSky(64, 32));
+	ShaderEnvironment shader{ distribution.GetCDFs(), distribution.GetWidth(), distribution.GetHeight() };
+
+	const unsigned int steps = 128;
+	for (unsigned int j = 0; j < steps; j++)
+	{
+		for (unsigned int i = 0; i < steps; i++)
+		{
+			float u0 = (i + 0.37f) / steps;
+			float u1 = (j + 0.61f) / steps;
+			float pdf = 0;
+			float shaderPdf = 0;
+			EnvironmentFloat3 direction = distribution.Sample(u0, u1, &pdf);
+			EnvironmentFloat3 shaderDirection = shader.SampleEnvironment(u0, u1, shaderPdf);
+			CHECK_NEAR(shaderPdf, pdf, 1e-6f * pdf);
+			CHECK_NEAR(shaderDirection.x, direction.x, 1e-6f);
+			CHECK_NEAR(shaderDirection.y, direction.y, 1e-6f);
+			CHECK_NEAR(shaderDirection.z, direction.z, 1e-6f);
+			CHECK_NEAR(shader.EnvironmentPdf(direction), distribution.Pdf(direction), 1e-6f * pdf);
+		}
+	}
+}
+
+TEST_CASE(SamplingFindsTheIntegral)
+{
+	// Importance sampling the map itself (looked up by texel)
+	// should give the sky's total radiance, which is each
+	// texel's luminance times the solid angle it covers
+	const unsigned int width = 64;
+	const unsigned int height = 32;
+	RadianceHDR::Image image = MakeSky(width, height);
+	EnvironmentDistribution distribution;
+	distribution.Build(image);
+
+	double expected = 0;
+	for (unsigned int y = 0; y < height; y++)
+	{
+		double solidAngle = 2 * Pi / width * (std::cos((double)y / height * Pi) - std::cos((y + 1.0) / height * Pi));
+		for (unsigned int x = 0; x < width; x++)
+			expected += Luminance(RadianceHDR::Decode(image, x, y)) * solidAngle;
+	}
+
+	const unsigned int steps = 512;
+	double estimate = 0;
+	for (unsigned int j = 0; j < steps; j++)
+	{
+		for (unsigned int i = 0; i < steps; i++)
+		{
+			float pdf = 0;
+			EnvironmentFloat3 direction = distribution.Sample((i + 0.5f) / steps, (j + 0.5f) / steps, &pdf);
+			EnvironmentFloat2 uv = EnvironmentDistribution::DirectionToUV(direction);
+			unsigned int x = std::min((unsigned int)(uv.x * width), width - 1);
+			unsigned int y = std::min((unsigned int)(uv.y * height), height - 1);
+			estimate += Luminance(RadianceHDR::Decode(image, x, y)) / pdf;
+		}
+	}
+	estimate /= steps * steps;
+	CHECK_NEAR(estimate, expected, 5e-3 * expected);
+
+	// Most samples head for the sun, which has most of the energy
+	float pdf = 0;
+	EnvironmentFloat3 direction = distribution.Sample(0.5f, 0.5f, &pdf);
+	EnvironmentFloat2 uv = EnvironmentDistribution::DirectionToUV(direction);
+	CHECK_EQUAL((unsigned int)(uv.x * width), width / 4);
+	CHECK_EQUAL((unsigned int)(uv.y * height), height / 5);
+}
+
+TEST_CASE(LargeMapsAreAveragedDown)
+{
+	// Three texels wide blocks, with a partial one at the end
+	const unsigned int width = EnvironmentDistribution::MaxWidth * 2 + 4;
+	EnvironmentDistribution distribution;
+	distribution.Build(MakeImage(width, 4, [](unsigned int x, unsigned int) { return x < 3 ? 4.0f : 1.0f; }));
+	CHECK_EQUAL(distribution.GetWidth(), (width + 2) / 3);
+	CHECK_EQUAL(distribution.GetHeight(), 2u);
+
+	// The first block averages to 4, the rest to 1
+	const std::vector<float>& cdfs = distribution.GetCDFs();
+	float first = cdfs[2];
+	float second = cdfs[3] - cdfs[2];
+	CHECK_NEAR(first / second, 4.0f, 1e-3f);
+}
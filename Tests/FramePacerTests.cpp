@@ -0,0 +1,290 @@
+#include "TestFramework.h"
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	struct FrameCost
+	{
+		double CPUMs;
+		double GPUMs;
+	};
+
+	// What happened over a replayed trace
+	struct ReplayResult
+	{
+		FramePacerStats Stats;
+		double TotalMs = 0;
+		double GPUIdleMs = 0;
+		double MaxSleepMs = 0;
+		std::vector<double> LatencyMs;
+	};
+
+	// Reads "<cpu_ms> <gpu_ms>" lines, skipping # comments
+	std::vector<FrameCost> LoadTrace(const std::string& name)
+	{
+		std::vector<FrameCost> trace;
+		std::ifstream file(std::string(TEST_DATA_DIR) + "/" + name);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			FrameCost cost;
+			std::istringstream values(line);
+			if (values >> cost.CPUMs >> cost.GPUMs)
+				trace.push_back(cost);
+		}
+		return trace;
+	}
+
+	// --------------------------------------------------------
+	// Plays the trace back through a pacer the way Graphics
+	// drives it: sleep, sample input, record for the frame's
+	// CPU cost, submit, then wait if framesInFlight frames are
+	// already queued.  GPU timings are reported at the start
+	// of the first frame after the GPU finishes them.
+	// --------------------------------------------------------
+	ReplayResult Replay(const std::vector<FrameCost>& trace, bool pacing, unsigned int framesInFlight = 2)
+	{
+		FramePacer pacer;
+		pacer.SetEnabled(pacing);
+
+		ReplayResult result;
+		std::vector<double> gpuStart(trace.size() + 1, 0);
+		std::vector<double> gpuEnd(trace.size() + 1, 0);
+		std::vector<double> inputSample(trace.size() + 1, 0);
+		uint64_t completed = 0;
+		uint64_t reported = 0;
+		double now = 0;
+
+		for (uint64_t frame = 1; frame <= trace.size(); frame++)
+		{
+			while (completed + 1 < frame && gpuEnd[completed + 1] <= now)
+				completed++;
+			for (; reported < completed; reported++)
+				pacer.RecordGPUFrame(reported + 1, gpuStart[reported + 1], gpuEnd[reported + 1]);
+
+			double sleepMs = pacer.GetSleepMs(now, completed);
+			result.MaxSleepMs = std::max(result.MaxSleepMs, sleepMs);
+			now += sleepMs;
+			inputSample[frame] = now;
+			pacer.BeginFrame(frame, now, sleepMs);
+
+			now += trace[frame - 1].CPUMs;
+			pacer.EndFrame(frame, now);
+
+			// The GPU starts as soon as it's both submitted and the GPU is free
+			gpuStart[frame] = std::max(now, gpuEnd[frame - 1]);
+			gpuEnd[frame] = gpuStart[frame] + trace[frame - 1].GPUMs;
+			if (frame > 1)
+				result.GPUIdleMs += gpuStart[frame] - gpuEnd[frame - 1];
+
+			if (frame >= framesInFlight)
+				now = std::max(now, gpuEnd[frame - framesInFlight + 1]);
+		}
+
+		for (uint64_t frame = reported + 1; frame <= trace.size(); frame++)
+			pacer.RecordGPUFrame(frame, gpuStart[frame], gpuEnd[frame]);
+		for (uint64_t frame = 1; frame <= trace.size(); frame++)
+			result.LatencyMs.push_back(gpuEnd[frame] - inputSample[frame]);
+
+		result.Stats = pacer.GetStats();
+		result.TotalMs = gpuEnd[trace.size()];
+		return result;
+	}
+
+	double Average(const std::vector<double>& values, size_t begin, size_t end)
+	{
+		double sum = 0;
+		for (size_t i = begin; i < end; i++)
+			sum += values[i];
+		return end > begin ? sum / (end - begin) : 0;
+	}
+}
+
+// --------------------------------------------------------
+// FramePacer, first with hand-worked sleep decisions, then
+// replaying recorded frame costs from Tests/Data with and
+// without pacing
+// --------------------------------------------------------
+
+TEST_CASE(SleepsUntilTheGPUIsAboutToRunOut)
+{
+	FramePacer pacer;
+	pacer.SetEnabled(true);
+
+	// Frame 1 costs 4ms of CPU and 10ms of GPU, and frame 2 has
+	// just been submitted.  No variance yet, so no extra headroom.
+	pacer.BeginFrame(1, 0, 0);
+	pacer.EndFrame(1, 4);
+	pacer.BeginFrame(2, 4, 0);
+	pacer.EndFrame(2, 8);
+	pacer.RecordGPUFrame(1, 4, 14);
+
+	// Frame 2 should end at 14 + 10, so frame 3's input is
+	// sampled 4ms of CPU and the 0.5ms margin before that
+	CHECK_NEAR(pacer.GetSleepMs(8, 1), 24 - 4 - 0.5 - 8, 1e-9);
+	CHECK_NEAR(pacer.GetSleepMs(12, 1), 24 - 4 - 0.5 - 12, 1e-9);
+	CHECK_EQUAL(pacer.GetSleepMs(30, 1), 0.0);
+
+	// A larger margin samples earlier
+	pacer.SetSafetyMarginMs(2);
+	CHECK_NEAR(pacer.GetSleepMs(8, 1), 24 - 4 - 2 - 8, 1e-9);
+	pacer.SetSafetyMarginMs(-1);
+	CHECK_EQUAL(pacer.GetSafetyMarginMs(), 0.0);
+
+	// Turned off, it never sleeps
+	pacer.SetEnabled(false);
+	CHECK_EQUAL(pacer.GetSleepMs(8, 1), 0.0);
+}
+
+TEST_CASE(FinishedFramesDontEndInTheFuture)
+{
+	FramePacer pacer;
+	pacer.SetEnabled(true);
+	pacer.BeginFrame(1, 0, 0);
+	pacer.EndFrame(1, 4);
+	pacer.BeginFrame(2, 4, 0);
+	pacer.EndFrame(2, 8);
+	pacer.RecordGPUFrame(1, 4, 14);
+
+	// Frame 2 is known to be done at 16, before its predicted
+	// end at 24, so the GPU is already free
+	CHECK_EQUAL(pacer.GetSleepMs(16, 2), 0.0);
+}
+
+TEST_CASE(WaitsForSamplesBeforeSleeping)
+{
+	FramePacer pacer;
+	pacer.SetEnabled(true);
+	CHECK_EQUAL(pacer.GetSleepMs(0, 0), 0.0);
+
+	// CPU costs alone aren't enough
+	pacer.BeginFrame(1, 0, 0);
+	pacer.EndFrame(1, 4);
+	CHECK_EQUAL(pacer.GetSleepMs(4, 0), 0.0);
+}
+
+TEST_CASE(SleepIsLimited)
+{
+	// A 200ms GPU frame would call for a very long sleep
+	FramePacer pacer;
+	pacer.SetEnabled(true);
+	pacer.BeginFrame(1, 0, 0);
+	pacer.EndFrame(1, 1);
+	pacer.BeginFrame(2, 1, 0);
+	pacer.EndFrame(2, 2);
+	pacer.RecordGPUFrame(1, 1, 201);
+	CHECK_EQUAL(pacer.GetSleepMs(2, 0), FramePacer::MaxSleepMs);
+}
+
+TEST_CASE(GivesUpWhenTheGPUIsTooFarBehind)
+{
+	// GPU timings stop arriving for more frames than the pacer
+	// remembers, so it can't tell when the GPU will be free
+	FramePacer pacer;
+	pacer.SetEnabled(true);
+	pacer.BeginFrame(1, 0, 0);
+	pacer.EndFrame(1, 4);
+	pacer.RecordGPUFrame(1, 4, 14);
+
+	uint64_t lastFrame = FramePacer::HistorySize + 2;
+	for (uint64_t frame = 2; frame <= lastFrame; frame++)
+	{
+		pacer.BeginFrame(frame, frame * 4.0, 0);
+		pacer.EndFrame(frame, frame * 4.0 + 4);
+	}
+	CHECK_EQUAL(pacer.GetSleepMs(lastFrame * 4.0 + 4, 1), 0.0);
+}
+
+TEST_CASE(PacingCutsLatencyWhenGPUBound)
+{
+	std::vector<FrameCost> trace = LoadTrace("GPUBound.frametrace");
+	REQUIRE(trace.size() == 240);
+	ReplayResult unpaced = Replay(trace, false);
+	ReplayResult paced = Replay(trace, true);
+
+	// Unpaced, each frame waits behind a whole queued frame
+	CHECK_EQUAL(unpaced.Stats.SleepMs, 0.0);
+	CHECK(unpaced.Stats.AverageLatencyMs() > 20);
+
+	// Paced, input is sampled shortly before the GPU needs the
+	// frame, so latency is closer to one CPU plus one GPU frame
+	CHECK(paced.Stats.AverageSleepMs() > 4);
+	CHECK(paced.MaxSleepMs <= FramePacer::MaxSleepMs);
+	CHECK(paced.Stats.AverageLatencyMs() < 0.8 * unpaced.Stats.AverageLatencyMs());
+	CHECK(paced.Stats.AverageLatencyMs() < 20);
+	CHECK_EQUAL(paced.Stats.LatencySampleCount, 240u);
+
+	// Without costing throughput, since the GPU barely idles
+	CHECK(paced.TotalMs < unpaced.TotalMs * 1.01);
+	CHECK(paced.GPUIdleMs < 0.01 * paced.TotalMs);
+
+	// The predictions settle near the trace's costs, with the
+	// headroom on the side that sleeps less
+	CHECK(paced.Stats.PredictedCPUMs > 4 && paced.Stats.PredictedCPUMs < 6);
+	CHECK(paced.Stats.PredictedGPUMs > 10 && paced.Stats.PredictedGPUMs < 12);
+}
+
+TEST_CASE(PacingStaysOutOfTheWayWhenCPUBound)
+{
+	// The GPU is always waiting on the CPU, so there's no
+	// queue to shorten and nothing to gain from sleeping
+	std::vector<FrameCost> trace = LoadTrace("CPUBound.frametrace");
+	REQUIRE(trace.size() == 240);
+	ReplayResult unpaced = Replay(trace, false);
+	ReplayResult paced = Replay(trace, true);
+
+	CHECK_EQUAL(paced.Stats.SleepMs, 0.0);
+	CHECK_NEAR(paced.TotalMs, unpaced.TotalMs, 1e-9);
+	CHECK_NEAR(paced.Stats.AverageLatencyMs(), unpaced.Stats.AverageLatencyMs(), 1e-9);
+}
+
+TEST_CASE(PacingRecoversFromAGPUHitch)
+{
+	// Three 120ms GPU frames at frame 101
+	std::vector<FrameCost> trace = LoadTrace("GPUHitch.frametrace");
+	REQUIRE(trace.size() == 240);
+	ReplayResult unpaced = Replay(trace, false);
+	ReplayResult paced = Replay(trace, true);
+
+	// The hitch doesn't have it oversleeping afterwards,
+	// which would leave the GPU idle
+	CHECK(paced.MaxSleepMs <= FramePacer::MaxSleepMs);
+	CHECK(paced.TotalMs < unpaced.TotalMs * 1.01);
+	CHECK(paced.GPUIdleMs < 0.01 * paced.TotalMs);
+
+	// Latency is back down a hundred frames after the hitch
+	double before = Average(paced.LatencyMs, 50, 100);
+	double after = Average(paced.LatencyMs, 200, 240);
+	CHECK(after < before * 1.1);
+	CHECK(after < 0.8 * Average(unpaced.LatencyMs, 200, 240));
+}
+
+TEST_CASE(ResetKeepsPredictions)
+{
+	std::vector<FrameCost> trace = LoadTrace("GPUBound.frametrace");
+	REQUIRE(trace.size() > 0);
+
+	FramePacer pacer;
+	pacer.BeginFrame(1, 0, 2);
+	pacer.EndFrame(1, trace[0].CPUMs);
+	pacer.RecordGPUFrame(1, trace[0].CPUMs, trace[0].CPUMs + trace[0].GPUMs);
+	pacer.ResetStats();
+
+	FramePacerStats stats = pacer.GetStats();
+	CHECK_EQUAL(stats.FrameCount, 0u);
+	CHECK_EQUAL(stats.SleepMs, 0.0);
+	CHECK_EQUAL(stats.LatencySampleCount, 0u);
+	CHECK_NEAR(stats.PredictedCPUMs, trace[0].CPUMs, 1e-9);
+	CHECK_NEAR(stats.PredictedGPUMs, trace[0].GPUMs, 1e-9);
+}
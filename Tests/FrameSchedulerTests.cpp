@@ -0,0 +1,72 @@
+#include "TestFramework.h"
+#include "FrameScheduler.h"
+
+// --------------------------------------------------------
+// FrameScheduler, with made up fence values and GPU frame
+// times the way Graphics reports them
+// --------------------------------------------------------
+
+TEST_CASE(WaitsForTheFrameFramesInFlightBack)
+{
+	FrameScheduler scheduler(3, 2);
+	CHECK_EQUAL(scheduler.GetCurrentFenceValue(), 1u);
+	CHECK_EQUAL(scheduler.GetCurrentFrameIndex(), 0u);
+
+	// Frame 2 can start right away, frame 3 needs frame 1 done
+	CHECK_EQUAL(scheduler.EndFrame(0), 0u);
+	CHECK_EQUAL(scheduler.EndFrame(0), 1u);
+	CHECK_EQUAL(scheduler.GetCurrentFrameIndex(), 2u);
+
+	// Deeper queues wait further back, up to the maximum
+	scheduler.SetFramesInFlight(10);
+	CHECK_EQUAL(scheduler.GetFramesInFlight(), 3u);
+	CHECK_EQUAL(scheduler.EndFrame(1), 1u);
+	CHECK_EQUAL(scheduler.GetCurrentFrameIndex(), 0u);
+}
+
+TEST_CASE(GapsBetweenGPUFramesAreIdleTime)
+{
+	FrameScheduler scheduler(3, 2);
+	scheduler.RecordGPUFrame(0, 10);
+	scheduler.RecordGPUFrame(10.05, 20);	// Just switching lists
+	scheduler.RecordGPUFrame(25, 30);		// Starved for 5ms
+	scheduler.RecordGPUFrame(28, 40);		// Overlaps, so no gap
+
+	FrameSchedulerStats stats = scheduler.GetStats();
+	CHECK_EQUAL(stats.GPUFrameCount, 4u);
+	CHECK_NEAR(stats.GPUBusyMs, 10 + 9.95 + 5 + 12, 1e-9);
+	CHECK_NEAR(stats.GPUIdleMs, 5.05, 1e-9);
+	CHECK_NEAR(stats.MaxGPUIdleMs, 5, 1e-9);
+	CHECK_NEAR(stats.AverageGPUIdleMs(), 5.05 / 4, 1e-9);
+	CHECK_EQUAL(stats.StarvedFrames, 1u);
+	CHECK_NEAR(stats.GPUUtilization(), 36.95 / 42.0, 1e-9);
+}
+
+TEST_CASE(ResetStartsANewWindowButKeepsTotals)
+{
+	FrameScheduler scheduler(3, 2);
+	scheduler.EndFrame(0);
+	scheduler.RecordCPUWait(2);
+	scheduler.RecordGPUFrame(0, 10);
+	scheduler.RecordGPUFrame(12, 20);
+
+	scheduler.ResetStats();
+	FrameSchedulerStats window = scheduler.GetStats();
+	CHECK_EQUAL(window.FrameCount, 0u);
+	CHECK_EQUAL(window.GPUFrameCount, 0u);
+	CHECK_EQUAL(window.FramesInFlight, 2u);
+
+	// The gap across the reset still counts
+	scheduler.RecordGPUFrame(23, 30);
+	window = scheduler.GetStats();
+	CHECK_NEAR(window.GPUIdleMs, 3, 1e-9);
+	CHECK_EQUAL(window.StarvedFrames, 1u);
+
+	FrameSchedulerStats total = scheduler.GetTotalStats();
+	CHECK_EQUAL(total.FrameCount, 1u);
+	CHECK_NEAR(total.CPUWaitMs, 2, 1e-9);
+	CHECK_EQUAL(total.GPUFrameCount, 3u);
+	CHECK_NEAR(total.GPUIdleMs, 5, 1e-9);
+	CHECK_NEAR(total.MaxGPUIdleMs, 3, 1e-9);
+	CHECK_EQUAL(total.StarvedFrames, 2u);
+}
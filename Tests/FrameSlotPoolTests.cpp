@@ -0,0 +1,104 @@
+#include "TestFramework.h"
+#include "FrameSlotPool.h"
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Stands in for an allocator and its list, counting how
+	// many times it's been handed out
+	struct FakeCommandList
+	{
+		int Uses = 0;
+	};
+}
+
+// --------------------------------------------------------
+// FrameSlotPool, the recycling behind CommandListPool, with
+// made up fence values in place of the GPU's
+// --------------------------------------------------------
+
+TEST_CASE(GrowsWhileEveryObjectIsInFlight)
+{
+	FrameSlotPool<FakeCommandList> pool;
+	bool created = false;
+
+	// Frame 1 needs two lists, and frame 2 starts before it's done
+	pool.Acquire(1, 0, &created);
+	CHECK(created);
+	pool.Acquire(1, 0, &created);
+	CHECK(created);
+	pool.Acquire(2, 0, &created);
+	CHECK(created);
+
+	CHECK_EQUAL(pool.GetSize(), 3u);
+	CHECK_EQUAL(pool.GetFreeCount(0), 0u);
+}
+
+TEST_CASE(ReusesObjectsOnceTheirFrameCompletes)
+{
+	FrameSlotPool<FakeCommandList> pool;
+	FakeCommandList* first = &pool.Acquire(1, 0);
+	first->Uses++;
+	FakeCommandList* second = &pool.Acquire(2, 0);
+	second->Uses++;
+
+	// Frame 1 is done, but frame 2 isn't
+	CHECK_EQUAL(pool.GetFreeCount(1), 1u);
+
+	// The same object comes back, contents and all, so its
+	// allocator can be reset rather than recreated
+	bool created = true;
+	FakeCommandList& reused = pool.Acquire(3, 1, &created);
+	CHECK(!created);
+	CHECK(&reused == first);
+	CHECK_EQUAL(reused.Uses, 1);
+	CHECK_EQUAL(pool.GetSize(), 2u);
+
+	// Now used by frame 3, so it's not free until that completes
+	CHECK_EQUAL(pool.GetFreeCount(2), 1u);
+	CHECK_EQUAL(pool.GetFreeCount(3), 2u);
+}
+
+TEST_CASE(SteadyFramesStopGrowing)
+{
+	// Two frames in flight, each using three lists
+	FrameSlotPool<FakeCommandList> pool;
+	for (uint64_t frame = 1; frame <= 100; frame++)
+	{
+		uint64_t completed = frame > 2 ? frame - 2 : 0;
+		for (int list = 0; list < 3; list++)
+			pool.Acquire(frame, completed).Uses++;
+	}
+
+	CHECK_EQUAL(pool.GetSize(), 6u);
+	CHECK_EQUAL(pool.GetFreeCount(100), 6u);
+}
+
+TEST_CASE(ReferencesSurviveGrowth)
+{
+	FrameSlotPool<FakeCommandList> pool;
+	FakeCommandList* first = &pool.Acquire(1, 0);
+	first->Uses = 42;
+
+	// Lists are handed to other threads, so adding more mustn't move them
+	for (int i = 0; i < 1000; i++)
+		pool.Acquire(1, 0);
+
+	CHECK_EQUAL(pool.GetSize(), 1001u);
+	CHECK(&pool.Acquire(2, 1) == first);
+	CHECK_EQUAL(first->Uses, 42);
+}
+
+TEST_CASE(ClearEmptiesThePool)
+{
+	FrameSlotPool<FakeCommandList> pool;
+	pool.Acquire(1, 0);
+	pool.Acquire(1, 0);
+	pool.Clear();
+	CHECK_EQUAL(pool.GetSize(), 0u);
+
+	bool created = false;
+	CHECK_EQUAL(pool.Acquire(2, 1, &created).Uses, 0);
+	CHECK(created);
+}
@@ -0,0 +1,254 @@
+#include "TestFramework.h"
+#include "FrameStats.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// A frame whose phases add up to the total
+	FrameTiming MakeFrame(double totalMs)
+	{
+		FrameTiming frame;
+		frame.TotalMs = totalMs;
+		frame.PhaseMs[FRAME_PHASE_UPDATE] = totalMs * 0.25;
+		frame.PhaseMs[FRAME_PHASE_PRESENT_WAIT] = totalMs * 0.75;
+		return frame;
+	}
+
+	// The ring alone is too big to comfortably put on the stack
+	std::unique_ptr<FrameStats> MakeStats()
+	{
+		return std::make_unique<FrameStats>();
+	}
+
+	std::string ReadFile(const std::filesystem::path& path)
+	{
+		std::ifstream file(path);
+		std::stringstream contents;
+		contents << file.rdbuf();
+		return contents.str();
+	}
+}
+
+// --------------------------------------------------------
+// FrameStats, fed synthetic frame timings
+// --------------------------------------------------------
+
+TEST_CASE(PercentilesUseTheNearestRank)
+{
+	// Frame times of 1 to 100ms, out of order
+	std::vector<FrameTiming> frames;
+	for (int i = 0; i < 100; i++)
+		frames.push_back(MakeFrame((i * 37) % 100 + 1));
+
+	FrameStatsSummary summary = FrameStats::SummarizeFrames(frames.data(), (unsigned int)frames.size());
+	CHECK_EQUAL(summary.FrameCount, 100u);
+	CHECK_NEAR(summary.Total.Mean, 50.5, 1e-9);
+	CHECK_EQUAL(summary.Total.P50, 50.0);
+	CHECK_EQUAL(summary.Total.P95, 95.0);
+	CHECK_EQUAL(summary.Total.P99, 99.0);
+	CHECK_EQUAL(summary.Total.Max, 100.0);
+
+	// Phases are summarized on their own
+	CHECK_EQUAL(summary.Phases[FRAME_PHASE_UPDATE].P50, 12.5);
+	CHECK_EQUAL(summary.Phases[FRAME_PHASE_PRESENT_WAIT].Max, 75.0);
+	CHECK_EQUAL(summary.Phases[FRAME_PHASE_SUBMIT].Max, 0.0);
+}
+
+TEST_CASE(PercentilesOfSmallWindows)
+{
+	// With only a few frames, the high percentiles are the slowest frame
+	FrameTiming frames[] = { MakeFrame(4), MakeFrame(2), MakeFrame(3) };
+	FrameStatsSummary summary = FrameStats::SummarizeFrames(frames, 3);
+	CHECK_EQUAL(summary.Total.P50, 3.0);
+	CHECK_EQUAL(summary.Total.P95, 4.0);
+	CHECK_EQUAL(summary.Total.P99, 4.0);
+
+	FrameStatsSummary one = FrameStats::SummarizeFrames(frames, 1);
+	CHECK_EQUAL(one.Total.P50, 4.0);
+	CHECK_EQUAL(one.Total.Max, 4.0);
+
+	FrameStatsSummary none = FrameStats::SummarizeFrames(frames, 0);
+	CHECK_EQUAL(none.FrameCount, 0u);
+	CHECK_EQUAL(none.Total.Max, 0.0);
+}
+
+TEST_CASE(HitchesAreFramesWellAboveTheMedian)
+{
+	// 10ms frames, one just at the hitch threshold and two above it
+	std::vector<FrameTiming> frames(20, MakeFrame(10));
+	frames[5] = MakeFrame(10 * FrameStats::HitchMultiplier);
+	frames[9] = MakeFrame(21);
+	frames[15] = MakeFrame(50);
+
+	FrameStatsSummary summary = FrameStats::SummarizeFrames(frames.data(), (unsigned int)frames.size());
+	CHECK_EQUAL(summary.HitchCount, 2u);
+}
+
+TEST_CASE(HitchesSlideOutOfTheWindow)
+{
+	std::unique_ptr<FrameStats> stats = MakeStats();
+	for (int i = 0; i < 50; i++)
+		stats->RecordFrame(MakeFrame(10));
+	stats->RecordFrame(MakeFrame(40));
+	CHECK_EQUAL(stats->Summarize(60).HitchCount, 1u);
+
+	// Still in the last 30 frames after another 29
+	for (int i = 0; i < 29; i++)
+		stats->RecordFrame(MakeFrame(10));
+	CHECK_EQUAL(stats->Summarize(30).HitchCount, 1u);
+
+	// But not after one more, even though a longer window sees it
+	stats->RecordFrame(MakeFrame(10));
+	CHECK_EQUAL(stats->Summarize(30).HitchCount, 0u);
+	CHECK_EQUAL(stats->Summarize(31).HitchCount, 1u);
+	CHECK_EQUAL(stats->Summarize(30).FrameCount, 30u);
+}
+
+TEST_CASE(WindowsLargerThanTheHistory)
+{
+	std::unique_ptr<FrameStats> stats = MakeStats();
+	CHECK_EQUAL(stats->Summarize(100).FrameCount, 0u);
+
+	for (int i = 0; i < 10; i++)
+		stats->RecordFrame(MakeFrame(i + 1));
+	FrameStatsSummary summary = stats->Summarize(100);
+	CHECK_EQUAL(summary.FrameCount, 10u);
+	CHECK_EQUAL(summary.Total.Max, 10.0);
+}
+
+TEST_CASE(TheRingKeepsTheMostRecentFrames)
+{
+	// Go round the ring one and a half times
+	std::unique_ptr<FrameStats> stats = MakeStats();
+	const unsigned int recorded = FrameStats::Capacity + FrameStats::Capacity / 2;
+	for (unsigned int i = 0; i < recorded; i++)
+		stats->RecordFrame(MakeFrame(i));
+	CHECK_EQUAL(stats->GetRecordedFrameCount(), (uint64_t)recorded);
+
+	// Only a full ring's worth comes back, oldest first
+	std::vector<FrameTiming> frames(FrameStats::Capacity + 10);
+	unsigned int count = stats->CopyRecentFrames(frames.data(), (unsigned int)frames.size());
+	REQUIRE(count == FrameStats::Capacity);
+	CHECK_EQUAL(frames[0].FrameIndex, (uint64_t)(recorded - FrameStats::Capacity));
+	CHECK_EQUAL(frames[0].TotalMs, (double)(recorded - FrameStats::Capacity));
+	CHECK_EQUAL(frames[count - 1].FrameIndex, (uint64_t)(recorded - 1));
+
+	bool inOrder = true;
+	for (unsigned int i = 1; i < count; i++)
+		inOrder = inOrder && frames[i].FrameIndex == frames[i - 1].FrameIndex + 1;
+	CHECK(inOrder);
+
+	// A window straddling the wrap point
+	count = stats->CopyRecentFrames(frames.data(), FrameStats::Capacity / 2 + 5);
+	CHECK_EQUAL(frames[0].FrameIndex, (uint64_t)(FrameStats::Capacity - 5));
+	CHECK_EQUAL(frames[4].FrameIndex, (uint64_t)(FrameStats::Capacity - 1));
+	CHECK_EQUAL(frames[5].FrameIndex, (uint64_t)FrameStats::Capacity);
+	CHECK_EQUAL(frames[count - 1].FrameIndex, (uint64_t)(recorded - 1));
+}
+
+TEST_CASE(ExportsCSV)
+{
+	std::unique_ptr<FrameStats> stats = MakeStats();
+	for (int i = 0; i < 5; i++)
+		stats->RecordFrame(MakeFrame(i + 1));
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "FrameStatsTests.csv";
+	REQUIRE(stats->ExportCSV(path.wstring(), 2));
+	std::string csv = ReadFile(path);
+	std::filesystem::remove(path);
+
+	// A header, then only the last two frames
+	CHECK_EQUAL(csv,
+		std::string("frame,total_ms,update_ms,tlas_build_ms,raytrace_record_ms,submit_ms,present_wait_ms\n") +
+		"3,4,1,0,0,0,3\n" +
+		"4,5,1.25,0,0,0,3.75\n");
+}
+
+TEST_CASE(ExportsJSON)
+{
+	std::unique_ptr<FrameStats> stats = MakeStats();
+	stats->RecordFrame(MakeFrame(10));
+	stats->RecordFrame(MakeFrame(10));
+	stats->RecordFrame(MakeFrame(30));
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "FrameStatsTests.json";
+	REQUIRE(stats->ExportJSON(path.wstring()));
+	std::string json = ReadFile(path);
+	std::filesystem::remove(path);
+
+	CHECK(json.find("\"frameCount\": 3,") != std::string::npos);
+	CHECK(json.find("\"hitchCount\": 1,") != std::string::npos);
+	CHECK(json.find("\"total_ms\": { \"mean\": 16.6667, \"p50\": 10, \"p95\": 30, \"p99\": 30, \"max\": 30 }") != std::string::npos);
+	CHECK(json.find("\"present_wait\": { \"mean\": 12.5, \"p50\": 7.5, \"p95\": 22.5, \"p99\": 22.5, \"max\": 22.5 }") != std::string::npos);
+	CHECK(json.find("\"frames_ms\": [10, 10, 30]") != std::string::npos);
+	CHECK(json.front() == '{');
+	CHECK(json.find("}\n", json.size() - 2) != std::string::npos);
+}
+
+TEST_CASE(ExportsGPUIdleGapsToJSON)
+{
+	std::unique_ptr<FrameStats> stats = MakeStats();
+	stats->RecordFrame(MakeFrame(10));
+
+	FrameSchedulerStats gpu;
+	gpu.GPUFrameCount = 4;
+	gpu.GPUBusyMs = 30;
+	gpu.GPUIdleMs = 10;
+	gpu.MaxGPUIdleMs = 6;
+	gpu.StarvedFrames = 2;
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "FrameStatsTests-gpu.json";
+	REQUIRE(stats->ExportJSON(path.wstring(), FrameStats::Capacity, &gpu));
+	std::string json = ReadFile(path);
+	std::filesystem::remove(path);
+
+	CHECK(json.find("\"gpu\": { \"frameCount\": 4, \"busy_ms\": 30, \"idle_ms\": 10, \"mean_idle_ms\": 2.5, \"max_idle_ms\": 6, \"starvedFrames\": 2, \"utilization\": 0.75 },") != std::string::npos);
+
+	// Left out entirely without a GPU
+	REQUIRE(stats->ExportJSON(path.wstring()));
+	json = ReadFile(path);
+	std::filesystem::remove(path);
+	CHECK(json.find("\"gpu\"") == std::string::npos);
+}
+
+TEST_CASE(ExportsPathStatsToJSON)
+{
+	// 20ms frames, with 4 rays per sample and 2M rays a frame
+	std::unique_ptr<FrameStats> stats = MakeStats();
+	for (int i = 0; i < 4; i++)
+		stats->RecordFrame(MakeFrame(20));
+
+	PathTracingStats paths;
+	paths.FrameCount = 3;
+	paths.SampleCount = 1500000;
+	paths.RayCount = 6000000;
+	CHECK_EQUAL(paths.AveragePathLength(), 4.0);
+	CHECK_EQUAL(paths.RaysPerFrame(), 2000000.0);
+	CHECK_EQUAL(PathTracingStats().AveragePathLength(), 0.0);
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "FrameStatsTests-paths.json";
+	REQUIRE(stats->ExportJSON(path.wstring(), FrameStats::Capacity, 0, &paths));
+	std::string json = ReadFile(path);
+	std::filesystem::remove(path);
+
+	CHECK(json.find("\"paths\": { \"frameCount\": 3, \"samples\": 1500000, \"rays\": 6000000, \"average_path_length\": 4, \"rays_per_second\": 1e+08 },") != std::string::npos);
+	CHECK(json.find("\"gpu\"") == std::string::npos);
+}
+
+TEST_CASE(ExportFailsOnABadPath)
+{
+	std::unique_ptr<FrameStats> stats = MakeStats();
+	stats->RecordFrame(MakeFrame(10));
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "FrameStatsTests-missing" / "frames.csv";
+	CHECK(!stats->ExportCSV(path.wstring()));
+	CHECK(!stats->ExportJSON(path.wstring()));
+}
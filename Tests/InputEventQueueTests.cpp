@@ -0,0 +1,193 @@
+#include "TestFramework.h"
+#include "InputEventQueue.h"
+
+#include <memory>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	const int KeyW = 'W';
+	const int KeyA = 'A';
+
+	InputEvent MakeKey(InputEvent::EventType type, int key, double time)
+	{
+		InputEvent inputEvent;
+		inputEvent.Type = type;
+		inputEvent.Key = key;
+		inputEvent.Time = time;
+		return inputEvent;
+	}
+
+	InputEvent MakeMouse(InputEvent::EventType type, int x, int y, double time)
+	{
+		InputEvent inputEvent;
+		inputEvent.Type = type;
+		inputEvent.X = x;
+		inputEvent.Y = y;
+		inputEvent.Time = time;
+		return inputEvent;
+	}
+}
+
+// --------------------------------------------------------
+// InputEventQueue and the InputState derived from it, fed
+// with hand-timed events instead of window messages
+// --------------------------------------------------------
+
+TEST_CASE(QueueKeepsOrderAndDropsWhenFull)
+{
+	// Too big for the stack
+	std::unique_ptr<InputEventQueue> queue = std::make_unique<InputEventQueue>();
+
+	for (unsigned int i = 0; i < InputEventQueue::Capacity; i++)
+		CHECK(queue->Push(MakeKey(InputEvent::KeyDown, (int)(i % 256), i)));
+	CHECK(!queue->Push(MakeKey(InputEvent::KeyDown, 0, 0)));
+	CHECK_EQUAL(queue->GetDroppedCount(), (uint64_t)1);
+
+	InputEvent inputEvent;
+	for (unsigned int i = 0; i < InputEventQueue::Capacity; i++)
+	{
+		REQUIRE(queue->Pop(inputEvent));
+		CHECK_EQUAL(inputEvent.Time, (double)i);
+	}
+	CHECK(!queue->Pop(inputEvent));
+}
+
+TEST_CASE(PressesAndReleasesApplyInOrderWithinAFrame)
+{
+	std::unique_ptr<InputEventQueue> queue = std::make_unique<InputEventQueue>();
+	InputState state;
+	state.Update(*queue, 1.0);
+
+	queue->Push(MakeKey(InputEvent::KeyDown, KeyW, 1.1));
+	queue->Push(MakeKey(InputEvent::KeyDown, KeyA, 1.2));
+	state.Update(*queue, 1.3);
+	CHECK(state.IsKeyDown(KeyW));
+	CHECK(state.IsKeyDown(KeyA));
+
+	// W is released and pressed again, and A is released
+	queue->Push(MakeKey(InputEvent::KeyUp, KeyW, 1.4));
+	queue->Push(MakeKey(InputEvent::KeyDown, KeyW, 1.5));
+	queue->Push(MakeKey(InputEvent::KeyUp, KeyA, 1.55));
+	state.Update(*queue, 1.6);
+
+	CHECK(state.IsKeyDown(KeyW));
+	CHECK(state.WasKeyPressed(KeyW));
+	CHECK(state.WasKeyReleased(KeyW));
+	CHECK(!state.IsKeyDown(KeyA));
+	CHECK(!state.WasKeyPressed(KeyA));
+	CHECK(state.WasKeyReleased(KeyA));
+	CHECK_EQUAL(state.GetLastEventCount(), 3u);
+
+	// A is tapped and then W released, so both end up
+	queue->Push(MakeKey(InputEvent::KeyDown, KeyA, 1.7));
+	queue->Push(MakeKey(InputEvent::KeyUp, KeyA, 1.8));
+	queue->Push(MakeKey(InputEvent::KeyUp, KeyW, 1.85));
+	state.Update(*queue, 1.9);
+	CHECK(!state.IsKeyDown(KeyW));
+	CHECK(!state.IsKeyDown(KeyA));
+	CHECK(state.WasKeyPressed(KeyA));
+	CHECK(state.WasKeyReleased(KeyA));
+
+	// Nothing carries over into a quiet frame
+	state.Update(*queue, 2.0);
+	CHECK(!state.WasKeyPressed(KeyA));
+	CHECK(!state.WasKeyReleased(KeyA));
+	CHECK(!state.WasKeyReleased(KeyW));
+}
+
+TEST_CASE(TapBetweenUpdatesStillRegisters)
+{
+	std::unique_ptr<InputEventQueue> queue = std::make_unique<InputEventQueue>();
+	InputState state;
+	state.Update(*queue, 0.0);
+
+	// Down and up again before the game ever looked
+	queue->Push(MakeKey(InputEvent::KeyDown, KeyW, 0.004));
+	queue->Push(MakeKey(InputEvent::KeyUp, KeyW, 0.006));
+	state.Update(*queue, 0.016);
+
+	CHECK(!state.IsKeyDown(KeyW));
+	CHECK(state.WasKeyPressed(KeyW));
+	CHECK(state.WasKeyReleased(KeyW));
+	CHECK_NEAR(state.GetKeyDownSeconds(KeyW), 0.002, 1e-9);
+}
+
+TEST_CASE(KeyDownFractionCoversPartialFrames)
+{
+	std::unique_ptr<InputEventQueue> queue = std::make_unique<InputEventQueue>();
+	InputState state;
+	state.Update(*queue, 10.0);
+
+	// Pressed a quarter of the way into the frame
+	queue->Push(MakeKey(InputEvent::KeyDown, KeyW, 10.025));
+	state.Update(*queue, 10.1);
+	CHECK_NEAR(state.GetIntervalSeconds(), 0.1, 1e-9);
+	CHECK_NEAR(state.GetKeyDownFraction(KeyW), 0.75, 1e-5);
+
+	// Held the whole frame
+	state.Update(*queue, 10.2);
+	CHECK_NEAR(state.GetKeyDownFraction(KeyW), 1.0, 1e-5);
+
+	// Released 40% of the way in, then tapped for another 10%
+	queue->Push(MakeKey(InputEvent::KeyUp, KeyW, 10.24));
+	queue->Push(MakeKey(InputEvent::KeyDown, KeyW, 10.26));
+	queue->Push(MakeKey(InputEvent::KeyUp, KeyW, 10.27));
+	state.Update(*queue, 10.3);
+	CHECK_NEAR(state.GetKeyDownFraction(KeyW), 0.5, 1e-5);
+
+	// Late events count from the start of the interval they arrive in
+	queue->Push(MakeKey(InputEvent::KeyDown, KeyW, 9.0));
+	state.Update(*queue, 10.4);
+	CHECK_NEAR(state.GetKeyDownFraction(KeyW), 1.0, 1e-5);
+
+	// Losing focus releases everything at that point
+	queue->Push(MakeKey(InputEvent::ReleaseAllKeys, 0, 10.45));
+	state.Update(*queue, 10.5);
+	CHECK(!state.IsKeyDown(KeyW));
+	CHECK(state.WasKeyReleased(KeyW));
+	CHECK_NEAR(state.GetKeyDownFraction(KeyW), 0.5, 1e-5);
+	CHECK_NEAR(state.GetKeyDownFraction(KeyA), 0.0, 1e-9);
+}
+
+TEST_CASE(MouseDeltasSumEveryEvent)
+{
+	std::unique_ptr<InputEventQueue> queue = std::make_unique<InputEventQueue>();
+	InputState state;
+
+	// The first position isn't movement
+	queue->Push(MakeMouse(InputEvent::MouseMove, 100, 100, 0.0));
+	state.Update(*queue, 0.0);
+	CHECK_EQUAL(state.GetMouseXDelta(), 0);
+	CHECK_EQUAL(state.GetMouseYDelta(), 0);
+
+	// Out and partway back within one frame still adds up
+	queue->Push(MakeMouse(InputEvent::MouseMove, 110, 95, 0.002));
+	queue->Push(MakeMouse(InputEvent::MouseMove, 130, 90, 0.004));
+	queue->Push(MakeMouse(InputEvent::MouseMove, 120, 92, 0.006));
+	queue->Push(MakeMouse(InputEvent::RawMouseMove, 4, -2, 0.003));
+	queue->Push(MakeMouse(InputEvent::RawMouseMove, 6, -3, 0.005));
+	queue->Push(MakeMouse(InputEvent::RawMouseMove, -1, 1, 0.007));
+	InputEvent wheel;
+	wheel.Type = InputEvent::MouseWheel;
+	wheel.Wheel = 1;
+	queue->Push(wheel);
+	queue->Push(wheel);
+	state.Update(*queue, 0.016);
+
+	CHECK_EQUAL(state.GetMouseX(), 120);
+	CHECK_EQUAL(state.GetMouseY(), 92);
+	CHECK_EQUAL(state.GetMouseXDelta(), 20);
+	CHECK_EQUAL(state.GetMouseYDelta(), -8);
+	CHECK_EQUAL(state.GetRawMouseXDelta(), 9);
+	CHECK_EQUAL(state.GetRawMouseYDelta(), -4);
+	CHECK_EQUAL(state.GetWheelDelta(), 2.0f);
+
+	// A frame without movement has none
+	state.Update(*queue, 0.032);
+	CHECK_EQUAL(state.GetMouseXDelta(), 0);
+	CHECK_EQUAL(state.GetRawMouseXDelta(), 0);
+	CHECK_EQUAL(state.GetWheelDelta(), 0.0f);
+	CHECK_EQUAL(state.GetMouseX(), 120);
+}
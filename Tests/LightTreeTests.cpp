@@ -0,0 +1,340 @@
+#include "TestFramework.h"
+#include "LightTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Small deterministic generator, so failures are repeatable
+	struct Random
+	{
+		uint32_t State = 1;
+		float Next()
+		{
+			State = State * 1664525u + 1013904223u;
+			return (State >> 8) / 16777216.0f;
+		}
+		float Range(float low, float high) { return low + (high - low) * Next(); }
+	};
+
+	LightTreeFloat3 RandomDirection(Random& random)
+	{
+		float z = random.Range(-1, 1);
+		float phi = random.Range(0, 6.2831853f);
+		float r = std::sqrt(std::max(1 - z * z, 0.0f));
+		return { r * std::cos(phi), r * std::sin(phi), z };
+	}
+
+	// --------------------------------------------------------
+	// A room's worth of point and spot lights scattered over a
+	// 40 unit cube, with a couple of directional lights mixed
+	// in (at 3 and 17) that the tree should leave out
+	// --------------------------------------------------------
+	std::vector<LightTreeLight> MakeLights(unsigned int count, uint32_t seed)
+	{
+		Random random;
+		random.State = seed;
+
+		std::vector<LightTreeLight> lights(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			LightTreeLight& light = lights[i];
+			light.Distant = i == 3 || i == 17;
+			light.Spot = !light.Distant && i % 3 == 0;
+			light.Position = { random.Range(-20, 20), random.Range(-20, 20), random.Range(-20, 20) };
+			light.Direction = RandomDirection(random);
+			light.Range = random.Range(5, 30);
+			light.Power = random.Range(0.1f, 10);
+		}
+		return lights;
+	}
+
+	// Point lights all above the y = 0 plane and in range of
+	// the whole 40 unit square beneath them
+	std::vector<LightTreeLight> MakeOverheadLights(unsigned int count, uint32_t seed)
+	{
+		Random random;
+		random.State = seed;
+
+		std::vector<LightTreeLight> lights(count);
+		for (LightTreeLight& light : lights)
+		{
+			light = {};
+			light.Position = { random.Range(-20, 20), random.Range(1, 20), random.Range(-20, 20) };
+			light.Range = 100;
+			light.Power = random.Range(0.1f, 10);
+		}
+		return lights;
+	}
+
+	float TotalPdf(const LightTree& tree, const LightTreeFloat3& position, const LightTreeFloat3& normal)
+	{
+		unsigned int lightCount = tree.GetDistantLightCount() + tree.GetLocalLightCount();
+		float total = 0;
+		for (unsigned int i = 0; i < lightCount; i++)
+			total += tree.Pdf(i, position, normal);
+		return total;
+	}
+}
+
+// --------------------------------------------------------
+// LightTree, checking that Sample() and Pdf() (which the
+// shader's SampleLightTree() mirrors) agree, and that they
+// sum to one over the lights, less the chance of picking
+// nothing
+// --------------------------------------------------------
+
+TEST_CASE(DistantLightsComeFirst)
+{
+	std::vector<LightTreeLight> lights = MakeLights(40, 7);
+	LightTree tree;
+	tree.Update(lights.data(), (unsigned int)lights.size());
+
+	CHECK_EQUAL(tree.GetDistantLightCount(), 2u);
+	CHECK_EQUAL(tree.GetLocalLightCount(), 38u);
+	CHECK_EQUAL(tree.GetNodes().size(), 2 * 38u - 1);
+
+	// Every light appears once, directional ones first
+	const std::vector<unsigned int>& order = tree.GetLightOrder();
+	REQUIRE(order.size() == lights.size());
+	CHECK_EQUAL(order[0], 3u);
+	CHECK_EQUAL(order[1], 17u);
+	std::vector<unsigned int> sorted = order;
+	std::sort(sorted.begin(), sorted.end());
+	for (unsigned int i = 0; i < sorted.size(); i++)
+		CHECK_EQUAL(sorted[i], i);
+
+	// Each leaf holds a different local light
+	std::vector<unsigned int> leafLights;
+	for (const LightTreeNode& node : tree.GetNodes())
+	{
+		if (node.IsLeaf)
+			leafLights.push_back(node.Index);
+	}
+	std::sort(leafLights.begin(), leafLights.end());
+	REQUIRE(leafLights.size() == 38);
+	for (unsigned int i = 0; i < leafLights.size(); i++)
+		CHECK_EQUAL(leafLights[i], i + 2);
+}
+
+TEST_CASE(PickProbabilitiesSumToOne)
+{
+	// Every light can reach every point on the plane, so
+	// every walk ends at a light
+	std::vector<LightTreeLight> lights = MakeOverheadLights(64, 5);
+	LightTree tree;
+	tree.Update(lights.data(), (unsigned int)lights.size());
+	CHECK_EQUAL(tree.GetDistantLightCount(), 0u);
+
+	Random random;
+	for (int i = 0; i < 1000; i++)
+	{
+		LightTreeFloat3 position = { random.Range(-20, 20), 0, random.Range(-20, 20) };
+		LightTreeFloat3 normal = { 0, 1, 0 };
+		CHECK_NEAR(TotalPdf(tree, position, normal), 1.0f, 1e-4f);
+
+		float pdf = 0;
+		CHECK(tree.Sample(random.Next(), position, normal, &pdf) >= 0);
+		CHECK(pdf > 0);
+	}
+
+	// Directional lights are never picked by the tree
+	std::vector<LightTreeLight> mixed = MakeLights(40, 7);
+	tree.Update(mixed.data(), (unsigned int)mixed.size());
+	CHECK_EQUAL(tree.Pdf(0, { 0, 0, 0 }, { 0, 1, 0 }), 0.0f);
+	CHECK_EQUAL(tree.Pdf(1, { 0, 0, 0 }, { 0, 1, 0 }), 0.0f);
+	CHECK_EQUAL(tree.Pdf(40, { 0, 0, 0 }, { 0, 1, 0 }), 0.0f);
+
+	// Where only some lights reach, the total can fall short
+	// of one but never goes over
+	unsigned int reachable = 0;
+	for (int i = 0; i < 2000; i++)
+	{
+		LightTreeFloat3 position = { random.Range(-30, 30), random.Range(-30, 30), random.Range(-30, 30) };
+		float total = TotalPdf(tree, position, RandomDirection(random));
+		CHECK(total <= 1.0f + 1e-4f);
+		if (total > 0)
+			reachable++;
+	}
+
+	// Most of the points should have had something to check
+	CHECK(reachable > 1000);
+}
+
+TEST_CASE(LightsThatCanReachArePickable)
+{
+	// A leaf's importance is exact for its one light, and every
+	// node above it has to allow for that light, or a light
+	// that can contribute would never be picked (and the
+	// image would be too dark)
+	std::vector<LightTreeLight> lights = MakeLights(40, 13);
+	LightTree tree;
+	tree.Update(lights.data(), (unsigned int)lights.size());
+
+	Random random;
+	unsigned int reaching = 0;
+	for (int i = 0; i < 2000; i++)
+	{
+		LightTreeFloat3 position = { random.Range(-30, 30), random.Range(-30, 30), random.Range(-30, 30) };
+		LightTreeFloat3 normal = RandomDirection(random);
+		for (const LightTreeNode& node : tree.GetNodes())
+		{
+			if (!node.IsLeaf)
+				continue;
+
+			bool reaches = LightTree::Importance(node, position, normal) > 0;
+			CHECK_EQUAL(tree.Pdf(node.Index, position, normal) > 0, reaches);
+			reaching += reaches;
+		}
+	}
+	CHECK(reaching > 2000);
+}
+
+TEST_CASE(SampledPdfMatchesPdf)
+{
+	std::vector<LightTreeLight> lights = MakeLights(40, 11);
+	LightTree tree;
+	tree.Update(lights.data(), (unsigned int)lights.size());
+
+	Random random;
+	for (int i = 0; i < 5000; i++)
+	{
+		LightTreeFloat3 position = { random.Range(-20, 20), random.Range(-20, 20), random.Range(-20, 20) };
+		LightTreeFloat3 normal = RandomDirection(random);
+
+		float pdf = 0;
+		int light = tree.Sample(random.Next(), position, normal, &pdf);
+		if (light < 0)
+		{
+			CHECK_EQUAL(pdf, 0.0f);
+			continue;
+		}
+
+		REQUIRE(light >= (int)tree.GetDistantLightCount());
+		CHECK(pdf > 0);
+		CHECK_NEAR(pdf, tree.Pdf(light, position, normal), 1e-5f * pdf);
+	}
+}
+
+TEST_CASE(PickFrequenciesMatchPdf)
+{
+	// Sample() splits [0, 1) into one interval per light, each
+	// as long as its pdf (and what's left over for picking
+	// nothing), so evenly spaced u should land in each light
+	// in proportion to it
+	std::vector<LightTreeLight> lights = MakeLights(40, 7);
+	LightTree tree;
+	tree.Update(lights.data(), (unsigned int)lights.size());
+
+	const unsigned int sampleCount = 200000;
+	LightTreeFloat3 positions[] = { { 0, 0, 0 }, { 15, -5, 10 }, { -18, 18, -2 } };
+	LightTreeFloat3 normals[] = { { 0, 1, 0 }, { 0.6f, 0, 0.8f }, { 0, 0, -1 } };
+	for (int p = 0; p < 3; p++)
+	{
+		REQUIRE(TotalPdf(tree, positions[p], normals[p]) > 0);
+
+		std::vector<unsigned int> picks(lights.size(), 0);
+		unsigned int misses = 0;
+		for (unsigned int i = 0; i < sampleCount; i++)
+		{
+			float pdf = 0;
+			int light = tree.Sample((i + 0.5f) / sampleCount, positions[p], normals[p], &pdf);
+			if (light < 0)
+				misses++;
+			else
+				picks[light]++;
+		}
+
+		for (unsigned int light = 0; light < lights.size(); light++)
+			CHECK_NEAR((float)picks[light] / sampleCount, tree.Pdf(light, positions[p], normals[p]), 1e-4f);
+		CHECK_NEAR((float)misses / sampleCount, 1 - TotalPdf(tree, positions[p], normals[p]), 1e-3f);
+	}
+}
+
+TEST_CASE(UnreachableLightsAreNeverPicked)
+{
+	// A point light behind the surface and a spot light
+	// facing away from it can't contribute anything
+	std::vector<LightTreeLight> lights(3);
+	lights[0] = { false, false, { 0, -5, 0 }, { 0, 0, 1 }, 20, 1 };
+	lights[1] = { false, true, { 0, 5, 0 }, { 0, 1, 0 }, 20, 1 };
+	lights[2] = { false, false, { 3, 4, 0 }, { 0, 0, 1 }, 20, 1 };
+	LightTree tree;
+	tree.Update(lights.data(), (unsigned int)lights.size());
+
+	LightTreeFloat3 position = { 0, 0, 0 };
+	LightTreeFloat3 normal = { 0, 1, 0 };
+	unsigned int reachable = 0;
+	for (unsigned int light = 0; light < 3; light++)
+	{
+		if (tree.GetLightOrder()[light] == 2)
+			reachable = light;
+		else
+			CHECK_EQUAL(tree.Pdf(light, position, normal), 0.0f);
+	}
+	CHECK(tree.Pdf(reachable, position, normal) > 0);
+
+	// Only the last light can be picked
+	for (int i = 0; i < 100; i++)
+	{
+		float u = (i + 0.5f) / 100;
+		float pdf = 0;
+		int light = tree.Sample(u, position, normal, &pdf);
+		if (light >= 0)
+		{
+			CHECK_EQUAL(light, (int)reachable);
+			CHECK_NEAR(pdf, tree.Pdf(reachable, position, normal), 1e-6f);
+		}
+	}
+
+	// Nothing reaches that far
+	float pdf = 0;
+	CHECK_EQUAL(tree.Sample(0.5f, { 100, 0, 0 }, normal, &pdf), -1);
+	CHECK_EQUAL(pdf, 0.0f);
+	CHECK_EQUAL(TotalPdf(tree, { 100, 0, 0 }, normal), 0.0f);
+}
+
+TEST_CASE(MovingLightsRefits)
+{
+	std::vector<LightTreeLight> lights = MakeLights(40, 7);
+	LightTree tree;
+	tree.Update(lights.data(), (unsigned int)lights.size());
+	CHECK_EQUAL(tree.GetRebuildCount(), 1u);
+
+	// Nothing changed, nothing to do
+	tree.Update(lights.data(), (unsigned int)lights.size());
+	CHECK_EQUAL(tree.GetRebuildCount(), 1u);
+
+	// Moving and dimming lights keeps the tree's structure,
+	// and sampling still matches the pdfs
+	for (LightTreeLight& light : lights)
+	{
+		light.Position.x += 3;
+		light.Power *= 0.5f;
+	}
+	tree.Update(lights.data(), (unsigned int)lights.size());
+	CHECK_EQUAL(tree.GetRebuildCount(), 1u);
+
+	Random random;
+	for (int i = 0; i < 500; i++)
+	{
+		LightTreeFloat3 position = { random.Range(-20, 20), random.Range(-20, 20), random.Range(-20, 20) };
+		LightTreeFloat3 normal = RandomDirection(random);
+		float pdf = 0;
+		int light = tree.Sample(random.Next(), position, normal, &pdf);
+		CHECK(TotalPdf(tree, position, normal) <= 1.0f + 1e-4f);
+		if (light >= 0)
+			CHECK_NEAR(pdf, tree.Pdf(light, position, normal), 1e-5f * pdf);
+	}
+
+	// Turning a point light directional means a rebuild
+	lights[5].Distant = true;
+	tree.Update(lights.data(), (unsigned int)lights.size());
+	CHECK_EQUAL(tree.GetRebuildCount(), 2u);
+	CHECK_EQUAL(tree.GetDistantLightCount(), 3u);
+}
@@ -0,0 +1,229 @@
+#include "TestFramework.h"
+#include "OffsetAllocator.h"
+
+#include <algorithm>
+#include <vector>
+
+// --------------------------------------------------------
+// OffsetAllocator, the best-fit allocator behind each of
+// GPUMemory's heaps
+// --------------------------------------------------------
+
+TEST_CASE(FillsAHeapExactly)
+{
+	OffsetAllocator allocator(1024);
+	CHECK_EQUAL(allocator.Allocate(256), 0u);
+	CHECK_EQUAL(allocator.Allocate(256), 256u);
+	CHECK_EQUAL(allocator.Allocate(512), 512u);
+
+	CHECK_EQUAL(allocator.GetUsedSize(), 1024u);
+	CHECK_EQUAL(allocator.GetFreeSize(), 0u);
+	CHECK_EQUAL(allocator.GetLargestFreeBlock(), 0u);
+	CHECK_EQUAL(allocator.GetAllocationCount(), 3u);
+
+	// Full, so nothing fits, not even a single byte
+	CHECK_EQUAL(allocator.Allocate(1), OffsetAllocator::InvalidOffset);
+	CHECK_EQUAL(allocator.GetAllocationCount(), 3u);
+}
+
+TEST_CASE(RejectsWhatCouldNeverFit)
+{
+	OffsetAllocator allocator(1024);
+	CHECK_EQUAL(allocator.Allocate(0), OffsetAllocator::InvalidOffset);
+	CHECK_EQUAL(allocator.Allocate(1025), OffsetAllocator::InvalidOffset);
+
+	OffsetAllocator empty;
+	CHECK_EQUAL(empty.Allocate(1), OffsetAllocator::InvalidOffset);
+	CHECK_EQUAL(empty.GetLargestFreeBlock(), 0u);
+}
+
+TEST_CASE(AlignmentPaddingStaysFree)
+{
+	OffsetAllocator allocator(4096);
+	CHECK_EQUAL(allocator.Allocate(100), 0u);
+	CHECK_EQUAL(allocator.Allocate(100, 1024), 1024u);
+
+	// Only the allocations themselves are used, and the space
+	// skipped for alignment can still be handed out
+	CHECK_EQUAL(allocator.GetUsedSize(), 200u);
+	CHECK_EQUAL(allocator.Allocate(900), 100u);
+	CHECK_EQUAL(allocator.Allocate(24), 1000u);
+	CHECK_EQUAL(allocator.GetFreeSize(), 4096u - 1124u);
+}
+
+TEST_CASE(PicksTheSmallestBlockThatFits)
+{
+	OffsetAllocator allocator(1000);
+	uint64_t a = allocator.Allocate(100);	// [0, 100)
+	allocator.Allocate(10);					// [100, 110)
+	uint64_t b = allocator.Allocate(300);	// [110, 410)
+	allocator.Allocate(10);					// [410, 420)
+	uint64_t c = allocator.Allocate(50);	// [420, 470)
+	allocator.Allocate(10);					// [470, 480), then 520 free
+
+	allocator.Free(a, 100);
+	allocator.Free(b, 300);
+	allocator.Free(c, 50);
+
+	// Free blocks of 100, 300, 50 and 520 bytes, so each of these
+	// goes in the tightest one rather than the first or largest
+	CHECK_EQUAL(allocator.Allocate(40), c);
+	CHECK_EQUAL(allocator.Allocate(90), a);
+	CHECK_EQUAL(allocator.Allocate(250), b);
+	CHECK_EQUAL(allocator.Allocate(500), 480u);
+}
+
+TEST_CASE(SkipsBlocksThatAlignmentRulesOut)
+{
+	OffsetAllocator allocator(4096);
+	allocator.Allocate(1);					// [0, 1)
+	uint64_t small = allocator.Allocate(300);	// [1, 301)
+	allocator.Allocate(1);					// [301, 302)
+	allocator.Free(small, 300);
+
+	// The 300 byte block is the best fit by size, but once it's
+	// aligned to 256 there's only 45 bytes left in it
+	CHECK_EQUAL(allocator.Allocate(100, 256), 512u);
+
+	// Unaligned, it still fits there
+	CHECK_EQUAL(allocator.Allocate(250), 1u);
+}
+
+TEST_CASE(FreeingMergesWithTheNextBlock)
+{
+	OffsetAllocator allocator(1024);
+	allocator.Allocate(256);
+	uint64_t b = allocator.Allocate(256);
+	uint64_t c = allocator.Allocate(256);
+	allocator.Allocate(256);
+
+	allocator.Free(c, 256);
+	allocator.Free(b, 256);
+	CHECK_EQUAL(allocator.GetLargestFreeBlock(), 512u);
+	CHECK_EQUAL(allocator.Allocate(512), b);
+}
+
+TEST_CASE(FreeingMergesWithThePreviousBlock)
+{
+	OffsetAllocator allocator(1024);
+	allocator.Allocate(256);
+	uint64_t b = allocator.Allocate(256);
+	uint64_t c = allocator.Allocate(256);
+	allocator.Allocate(256);
+
+	allocator.Free(b, 256);
+	allocator.Free(c, 256);
+	CHECK_EQUAL(allocator.GetLargestFreeBlock(), 512u);
+	CHECK_EQUAL(allocator.Allocate(512), b);
+}
+
+TEST_CASE(FreeingMergesWithBothSides)
+{
+	OffsetAllocator allocator(1024);
+	uint64_t a = allocator.Allocate(256);
+	uint64_t b = allocator.Allocate(256);
+	uint64_t c = allocator.Allocate(256);
+	uint64_t d = allocator.Allocate(256);
+
+	allocator.Free(a, 256);
+	allocator.Free(c, 256);
+	CHECK_EQUAL(allocator.GetLargestFreeBlock(), 256u);
+
+	// b joins the blocks on either side of it into one
+	allocator.Free(b, 256);
+	CHECK_EQUAL(allocator.GetLargestFreeBlock(), 768u);
+	CHECK_EQUAL(allocator.GetAllocationCount(), 1u);
+
+	// Then with the last one, the heap is whole again
+	allocator.Free(d, 256);
+	CHECK_EQUAL(allocator.GetLargestFreeBlock(), 1024u);
+	CHECK_EQUAL(allocator.GetUsedSize(), 0u);
+	CHECK_EQUAL(allocator.GetAllocationCount(), 0u);
+	CHECK_EQUAL(allocator.Allocate(1024), 0u);
+}
+
+TEST_CASE(FragmentationLimitsTheLargestAllocation)
+{
+	// Every other 64 byte allocation freed leaves half the heap
+	// free, but in pieces too small for anything bigger
+	OffsetAllocator allocator(64 * 32);
+	std::vector<uint64_t> offsets;
+	for (int i = 0; i < 32; i++)
+		offsets.push_back(allocator.Allocate(64));
+	for (int i = 0; i < 32; i += 2)
+		allocator.Free(offsets[i], 64);
+
+	CHECK_EQUAL(allocator.GetFreeSize(), 64u * 16);
+	CHECK_EQUAL(allocator.GetLargestFreeBlock(), 64u);
+	CHECK_EQUAL(allocator.Allocate(65), OffsetAllocator::InvalidOffset);
+
+	// Freeing the rest merges everything back together
+	for (int i = 1; i < 32; i += 2)
+		allocator.Free(offsets[i], 64);
+	CHECK_EQUAL(allocator.GetLargestFreeBlock(), 64u * 32);
+}
+
+TEST_CASE(RandomAllocationsNeverOverlap)
+{
+	const uint64_t size = 1 << 20;
+	OffsetAllocator allocator(size);
+
+	struct Live { uint64_t Offset, Size; };
+	std::vector<Live> live;
+
+	uint64_t seed = 99;
+	auto next = [&]() { seed = seed * 6364136223846793005ull + 1442695040888963407ull; return seed >> 33; };
+
+	for (int step = 0; step < 20000; step++)
+	{
+		if (live.empty() || next() % 3 != 0)
+		{
+			uint64_t allocationSize = 1 + next() % 8192;
+			uint64_t alignment = 1ull << (next() % 9);
+			uint64_t offset = allocator.Allocate(allocationSize, alignment);
+			if (offset == OffsetAllocator::InvalidOffset)
+				continue;
+
+			CHECK(offset % alignment == 0);
+			CHECK(offset + allocationSize <= size);
+			live.push_back({ offset, allocationSize });
+		}
+		else
+		{
+			size_t index = next() % live.size();
+			allocator.Free(live[index].Offset, live[index].Size);
+			live[index] = live.back();
+			live.pop_back();
+		}
+	}
+
+	// Sorted by offset, each allocation must end before the next begins
+	std::sort(live.begin(), live.end(), [](const Live& a, const Live& b) { return a.Offset < b.Offset; });
+	uint64_t used = 0;
+	for (size_t i = 0; i < live.size(); i++)
+	{
+		used += live[i].Size;
+		if (i > 0)
+			CHECK(live[i - 1].Offset + live[i - 1].Size <= live[i].Offset);
+	}
+	CHECK_EQUAL(allocator.GetUsedSize(), used);
+	CHECK_EQUAL(allocator.GetAllocationCount(), (unsigned int)live.size());
+
+	// Everything freed leaves a single block again
+	for (const Live& l : live)
+		allocator.Free(l.Offset, l.Size);
+	CHECK_EQUAL(allocator.GetLargestFreeBlock(), size);
+}
+
+TEST_CASE(ResetForgetsEverything)
+{
+	OffsetAllocator allocator(1024);
+	allocator.Allocate(100);
+	allocator.Allocate(200);
+
+	allocator.Reset(2048);
+	CHECK_EQUAL(allocator.GetSize(), 2048u);
+	CHECK_EQUAL(allocator.GetUsedSize(), 0u);
+	CHECK_EQUAL(allocator.GetAllocationCount(), 0u);
+	CHECK_EQUAL(allocator.Allocate(2048), 0u);
+}
@@ -0,0 +1,623 @@
+#include "TestFramework.h"
+#include "PathSampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace PathSampler;
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	struct Point
+	{
+		float U0;
+		float U1;
+	};
+
+	std::vector<Point> Samples(SamplerType type, unsigned int count, uint32_t dimension, uint32_t pixelSeed)
+	{
+		std::vector<Point> points(count);
+		for (unsigned int i = 0; i < count; i++)
+			Sample2D(type, i, dimension, pixelSeed, &points[i].U0, &points[i].U1);
+		return points;
+	}
+
+	// --------------------------------------------------------
+	// Whether every elementary interval of area 1/count (all
+	// 2^a by 2^b grids with a + b = log2(count)) holds exactly
+	// one point, which is what makes a set a (0,m,2)-net
+	// --------------------------------------------------------
+	bool IsZeroNet(const std::vector<Point>& points)
+	{
+		unsigned int log2Count = 0;
+		while ((1u << log2Count) < points.size())
+			log2Count++;
+
+		for (unsigned int a = 0; a <= log2Count; a++)
+		{
+			unsigned int columns = 1u << a;
+			unsigned int rows = 1u << (log2Count - a);
+			std::vector<unsigned int> counts(columns * rows, 0);
+			for (const Point& point : points)
+				counts[(unsigned int)(point.U1 * rows) * columns + (unsigned int)(point.U0 * columns)]++;
+
+			for (unsigned int count : counts)
+			{
+				if (count != 1)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// Chi-square of the points over a grid of equal cells
+	double ChiSquare(const std::vector<Point>& points, unsigned int gridSize)
+	{
+		std::vector<unsigned int> counts(gridSize * gridSize, 0);
+		for (const Point& point : points)
+			counts[(unsigned int)(point.U1 * gridSize) * gridSize + (unsigned int)(point.U0 * gridSize)]++;
+
+		double expected = (double)points.size() / counts.size();
+		double chiSquare = 0;
+		for (unsigned int count : counts)
+			chiSquare += (count - expected) * (count - expected) / expected;
+		return chiSquare;
+	}
+
+	double Correlation(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		double meanA = 0, meanB = 0;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			meanA += a[i] / a.size();
+			meanB += b[i] / b.size();
+		}
+
+		double covariance = 0, varianceA = 0, varianceB = 0;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			covariance += (a[i] - meanA) * (b[i] - meanB);
+			varianceA += (a[i] - meanA) * (a[i] - meanA);
+			varianceB += (b[i] - meanB) * (b[i] - meanB);
+		}
+		return covariance / std::sqrt(varianceA * varianceB);
+	}
+
+	// --------------------------------------------------------
+	// A furnace-like scene for checking Russian roulette: every
+	// bounce escapes to a white sky with chance EscapeChance
+	// (using the bounce direction's sample), or hits a surface
+	// with the albedo below.  The loop mirrors TracePath() in
+	// RayTracing.hlsl, down to which dimension each choice uses.
+	// --------------------------------------------------------
+	const float EscapeChance = 0.3f;
+	const float Albedo[3] = { 0.9f, 0.7f, 0.5f };
+	const unsigned int MaxBounces = 10;
+	const unsigned int RouletteStartBounce = 3;
+
+	struct PathResult
+	{
+		float Radiance[3] = {};
+		unsigned int Rays = 0;
+	};
+
+	PathResult TraceFurnacePath(SamplerType type, uint32_t sampleIndex, uint32_t pixelSeed, bool roulette)
+	{
+		PathResult result;
+		float throughput[3] = { 1, 1, 1 };
+		for (unsigned int bounce = 0; ; bounce++)
+		{
+			float bounceSample[2], choiceSample[2];
+			Sample2D(type, sampleIndex, BounceDimension(bounce) + BounceDirectionOffset, pixelSeed, &bounceSample[0], &bounceSample[1]);
+			Sample2D(type, sampleIndex, BounceDimension(bounce) + BounceChoiceOffset, pixelSeed, &choiceSample[0], &choiceSample[1]);
+
+			result.Rays++;
+			if (bounceSample[0] < EscapeChance)
+			{
+				for (int c = 0; c < 3; c++)
+					result.Radiance[c] = throughput[c];
+				return result;
+			}
+
+			if (bounce == MaxBounces)
+				return result;
+
+			for (int c = 0; c < 3; c++)
+				throughput[c] *= Albedo[c];
+
+			if (roulette && bounce + 1 >= RouletteStartBounce)
+			{
+				float survival = RouletteSurvival(throughput[0], throughput[1], throughput[2]);
+				if (choiceSample[1] >= survival)
+					return result;
+				for (int c = 0; c < 3; c++)
+					throughput[c] /= survival;
+			}
+		}
+	}
+
+	// What the furnace converges to without roulette: the sky,
+	// seen after k hits, for up to MaxBounces hits
+	double FurnaceReference(int channel)
+	{
+		double total = 0;
+		for (unsigned int hits = 0; hits <= MaxBounces; hits++)
+			total += EscapeChance * std::pow((1 - EscapeChance) * Albedo[channel], (double)hits);
+		return total;
+	}
+
+	// Error of each pixel's estimate after some samples
+	struct FurnaceError
+	{
+		double Bias[3] = {};			// Mean error over all pixels
+		double StandardError[3] = {};	// Of that mean
+		double RMSE[3] = {};			// Of a single pixel
+		double RaysPerSample = 0;
+	};
+
+	FurnaceError MeasureFurnace(SamplerType type, unsigned int pixels, unsigned int samplesPerPixel, bool roulette)
+	{
+		FurnaceError error;
+		double squaredError[3] = {};
+		unsigned int rays = 0;
+		for (unsigned int pixel = 0; pixel < pixels; pixel++)
+		{
+			uint32_t seed = PixelSeed(pixel % 16, pixel / 16);
+			double sum[3] = {};
+			for (uint32_t i = 0; i < samplesPerPixel; i++)
+			{
+				PathResult path = TraceFurnacePath(type, i, seed, roulette);
+				rays += path.Rays;
+				for (int c = 0; c < 3; c++)
+					sum[c] += path.Radiance[c];
+			}
+
+			for (int c = 0; c < 3; c++)
+			{
+				double difference = sum[c] / samplesPerPixel - FurnaceReference(c);
+				error.Bias[c] += difference / pixels;
+				squaredError[c] += difference * difference;
+			}
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			error.RMSE[c] = std::sqrt(squaredError[c] / pixels);
+			error.StandardError[c] = error.RMSE[c] / std::sqrt((double)pixels);
+		}
+		error.RaysPerSample = (double)rays / (pixels * samplesPerPixel);
+		return error;
+	}
+
+	struct Vector3
+	{
+		float x, y, z;
+
+		Vector3 operator+(const Vector3& v) const { return { x + v.x, y + v.y, z + v.z }; }
+		Vector3 operator-(const Vector3& v) const { return { x - v.x, y - v.y, z - v.z }; }
+		Vector3 operator*(const Vector3& v) const { return { x * v.x, y * v.y, z * v.z }; }
+		Vector3 operator*(float s) const { return { x * s, y * s, z * s }; }
+	};
+
+	float Dot(const Vector3& a, const Vector3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	Vector3 Normalize(const Vector3& v) { return v * (1.0f / std::sqrt(Dot(v, v))); }
+	Vector3 Lerp(const Vector3& a, const Vector3& b, float t) { return a + (b - a) * t; }
+	Vector3 Reflect(const Vector3& i, const Vector3& n) { return i - n * (2 * Dot(i, n)); }
+
+	const Vector3 SkyColor = { 0.4f, 0.6f, 0.75f };
+
+	// What a ray finds: the sky, or a surface
+	struct SceneHit
+	{
+		bool Sky = false;
+		Vector3 Normal{};
+		Vector3 Color{};
+		float Roughness = 0;
+		float Metal = 0;
+	};
+
+	// --------------------------------------------------------
+	// A made-up scene for comparing the path tracer's two
+	// integrators.  Each path gets its own surfaces, one per
+	// bounce, and a bounce escapes to the sky when it heads up
+	// more steeply than that bounce allows, so where a path
+	// goes depends on the directions it samples.
+	// --------------------------------------------------------
+	struct RandomScene
+	{
+		uint32_t Seed;
+
+		float Random(unsigned int bounce, unsigned int which) const
+		{
+			return ToUnitFloat(PCGHash(HashCombine(HashCombine(Seed, bounce), which)));
+		}
+
+		Vector3 CameraDirection() const
+		{
+			return Normalize({ Random(MaxBounces + 1, 0) * 2 - 1, Random(MaxBounces + 1, 1) * 2 - 1, 1 });
+		}
+
+		SceneHit Intersect(const Vector3& direction, unsigned int bounce) const
+		{
+			SceneHit hit;
+			hit.Sky = direction.y > 0.3f + Random(bounce, 0) * 0.7f;
+
+			// Facing the incoming ray
+			hit.Normal = Normalize({ Random(bounce, 1) * 2 - 1, Random(bounce, 2) * 2 - 1, Random(bounce, 3) * 2 - 1 });
+			if (Dot(hit.Normal, direction) > 0)
+				hit.Normal = hit.Normal * -1;
+
+			hit.Color = { Random(bounce, 4), Random(bounce, 5), Random(bounce, 6) };
+			hit.Roughness = Random(bounce, 7);
+			hit.Metal = Random(bounce, 8) < 0.3f ? 1.0f : 0.0f;
+			return hit;
+		}
+	};
+
+	// Where a bounce goes, and how it tints the path
+	struct Bounce
+	{
+		Vector3 Direction;
+		Vector3 Color;
+	};
+
+	// --------------------------------------------------------
+	// The shading both integrators do at each hit, which the
+	// loop kept from the old closest hit shader unchanged:
+	// a rough reflection or a diffuse bounce, chosen by the
+	// Fresnel term, and the matching tint
+	// --------------------------------------------------------
+	Bounce Shade(const SceneHit& hit, const Vector3& incoming, float u0, float u1, float reflectionSample)
+	{
+		Vector3 refl = Reflect(incoming, hit.Normal);
+		float a = u0 * 2 - 1;
+		float b = std::sqrt(1 - a * a);
+		float phi = 2.0f * 3.14159265f * u1;
+		Vector3 randomBounce = { hit.Normal.x + b * std::cos(phi), hit.Normal.y + b * std::sin(phi), hit.Normal.z + a };
+		Vector3 dir = Normalize(Lerp(refl, randomBounce, hit.Roughness));
+
+		float f0 = 0.04f + (1.0f - 0.04f) * hit.Metal;
+		float NdotV = std::clamp(Dot(incoming * -1, hit.Normal), 0.0f, 1.0f);
+		float fres = f0 + (1 - f0) * std::pow(1 - NdotV, 5.0f);
+		bool reflected = fres > reflectionSample;
+		dir = Normalize(Lerp(randomBounce, dir, reflected ? 1.0f : 0.0f));
+
+		Vector3 roughnessBounceColor = Lerp({ 1, 1, 1 }, hit.Color, hit.Roughness);
+		Vector3 diffuseColor = Lerp(hit.Color, roughnessBounceColor, reflected ? 1.0f : 0.0f);
+		return { dir, Lerp(diffuseColor, hit.Color, hit.Metal) };
+	}
+
+	// --------------------------------------------------------
+	// TracePath() in RayTracing.hlsl, without next event
+	// estimation (which the old integrator didn't have)
+	// --------------------------------------------------------
+	Vector3 TraceLoopPath(const RandomScene& scene, SamplerType type, uint32_t sampleIndex, uint32_t pixelSeed, unsigned int rouletteStartBounce)
+	{
+		Vector3 direction = scene.CameraDirection();
+		Vector3 throughput = { 1, 1, 1 };
+		for (unsigned int bounce = 0; ; bounce++)
+		{
+			SceneHit hit = scene.Intersect(direction, bounce);
+			if (hit.Sky)
+				return throughput * SkyColor;
+
+			if (bounce == MaxBounces)
+				return { 0, 0, 0 };
+
+			float bounceSample[2], choiceSample[2];
+			Sample2D(type, sampleIndex, BounceDimension(bounce) + BounceDirectionOffset, pixelSeed, &bounceSample[0], &bounceSample[1]);
+			Sample2D(type, sampleIndex, BounceDimension(bounce) + BounceChoiceOffset, pixelSeed, &choiceSample[0], &choiceSample[1]);
+
+			Bounce next = Shade(hit, direction, bounceSample[0], bounceSample[1], choiceSample[0]);
+			throughput = throughput * next.Color;
+
+			if (bounce + 1 >= rouletteStartBounce)
+			{
+				float survival = RouletteSurvival(throughput.x, throughput.y, throughput.z);
+				if (choiceSample[1] >= survival)
+					return { 0, 0, 0 };
+				throughput = throughput * (1.0f / survival);
+			}
+
+			direction = next.Direction;
+		}
+	}
+
+	// --------------------------------------------------------
+	// The recursive integrator TracePath() replaced: the old
+	// ClosestHit() and Miss() shaders, where each hit tints
+	// the payload and traces the next ray itself.  Random
+	// numbers come from the same dimensions as the loop's.
+	// --------------------------------------------------------
+	struct RecursivePayload
+	{
+		Vector3 Color;
+		unsigned int RecursionDepth;
+		uint32_t RayPerPixelIndex;
+	};
+
+	void TraceRecursiveRay(const RandomScene& scene, const Vector3& direction, SamplerType type, uint32_t pixelSeed, RecursivePayload& payload)
+	{
+		SceneHit hit = scene.Intersect(direction, payload.RecursionDepth);
+
+		// Miss()
+		if (hit.Sky)
+		{
+			payload.Color = payload.Color * SkyColor;
+			return;
+		}
+
+		// ClosestHit()
+		if (payload.RecursionDepth == MaxBounces)
+		{
+			payload.Color = { 0, 0, 0 };
+			return;
+		}
+
+		float bounceSample[2], choiceSample[2];
+		uint32_t dimension = BounceDimension(payload.RecursionDepth);
+		Sample2D(type, payload.RayPerPixelIndex, dimension + BounceDirectionOffset, pixelSeed, &bounceSample[0], &bounceSample[1]);
+		Sample2D(type, payload.RayPerPixelIndex, dimension + BounceChoiceOffset, pixelSeed, &choiceSample[0], &choiceSample[1]);
+
+		Bounce next = Shade(hit, direction, bounceSample[0], bounceSample[1], choiceSample[0]);
+		payload.Color = payload.Color * next.Color;
+
+		payload.RecursionDepth++;
+		TraceRecursiveRay(scene, next.Direction, type, pixelSeed, payload);
+	}
+
+	RecursivePayload TraceRecursivePath(const RandomScene& scene, SamplerType type, uint32_t sampleIndex, uint32_t pixelSeed)
+	{
+		RecursivePayload payload = { { 1, 1, 1 }, 0, sampleIndex };
+		TraceRecursiveRay(scene, scene.CameraDirection(), type, pixelSeed, payload);
+		return payload;
+	}
+}
+
+// --------------------------------------------------------
+// The CPU port of the shader's random numbers.  The pinned
+// values guard against the two drifting apart, so if one
+// changes on purpose, RayTracing.hlsl must change with it.
+// --------------------------------------------------------
+
+TEST_CASE(BuildingBlocksArePinned)
+{
+	// The reference PCG hash (Jarzynski & Olano 2020)
+	CHECK_EQUAL(PCGHash(0), 129708002u);
+	CHECK_EQUAL(PCGHash(1), 2831084092u);
+	CHECK_EQUAL(PCGHash(0xdeadbeefu), 1730779506u);
+
+	CHECK_EQUAL(ReverseBits(1), 0x80000000u);
+	CHECK_EQUAL(ReverseBits(0x12345678u), 0x1e6a2c48u);
+	CHECK_EQUAL(ToUnitFloat(0xffffffffu), 16777215.0f / 16777216.0f);
+	CHECK_EQUAL(ToUnitFloat(0x80000000u), 0.5f);
+
+	CHECK_EQUAL(PixelSeed(3, 7), 925619080u);
+}
+
+TEST_CASE(SamplesArePinned)
+{
+	float u0, u1;
+	Sample2D(SamplerType::PCG, 5, 2, PixelSeed(3, 7), &u0, &u1);
+	CHECK_EQUAL(u0, 0.139329851f);
+	CHECK_EQUAL(u1, 0.392713904f);
+
+	Sample2D(SamplerType::Sobol, 5, 2, PixelSeed(3, 7), &u0, &u1);
+	CHECK_EQUAL(u0, 0.28292346f);
+	CHECK_EQUAL(u1, 0.556789875f);
+
+	Sample2D(SamplerType::Sobol, 0, 0, PixelSeed(0, 0), &u0, &u1);
+	CHECK_EQUAL(u0, 0.802269161f);
+	CHECK_EQUAL(u1, 0.370527267f);
+	CHECK_EQUAL(Sample1D(SamplerType::Sobol, 0, 0, PixelSeed(0, 0)), u0);
+}
+
+TEST_CASE(OwenScrambledSobolIsStratified)
+{
+	// Every power-of-two prefix is a (0,m,2)-net, for any pixel
+	// and dimension, even with the shuffled order
+	bool stratified = true;
+	for (unsigned int pixel = 0; pixel < 16; pixel++)
+	{
+		uint32_t seed = PixelSeed(pixel * 37, pixel * 11);
+		for (uint32_t dimension = 0; dimension < 24; dimension += 2)
+		{
+			std::vector<Point> points = Samples(SamplerType::Sobol, 256, dimension, seed);
+			for (unsigned int count = 1; count <= 256; count *= 2)
+				stratified = stratified && IsZeroNet(std::vector<Point>(points.begin(), points.begin() + count));
+		}
+	}
+	CHECK(stratified);
+}
+
+TEST_CASE(ScramblingDiffersPerPixelAndDimension)
+{
+	// The same sample index lands somewhere else in each
+	std::vector<Point> a = Samples(SamplerType::Sobol, 4, 2, PixelSeed(0, 0));
+	std::vector<Point> b = Samples(SamplerType::Sobol, 4, 2, PixelSeed(1, 0));
+	std::vector<Point> c = Samples(SamplerType::Sobol, 4, 4, PixelSeed(0, 0));
+	unsigned int same = 0;
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		same += a[i].U0 == b[i].U0 ? 1 : 0;
+		same += a[i].U0 == c[i].U0 ? 1 : 0;
+	}
+	CHECK_EQUAL(same, 0u);
+}
+
+TEST_CASE(PCGIsUniform)
+{
+	// 4096 points in 16 cells: chi-square on 15 degrees of
+	// freedom stays under 37.7 (p = 0.001) if it's uniform
+	for (uint32_t dimension = 0; dimension < 8; dimension += 2)
+	{
+		std::vector<Point> points = Samples(SamplerType::PCG, 4096, dimension, PixelSeed(5, 9));
+		CHECK(ChiSquare(points, 4) < 37.7);
+	}
+}
+
+TEST_CASE(DimensionsAreIndependent)
+{
+	// Numbers for different uses of the same sample shouldn't
+	// move together
+	for (SamplerType type : { SamplerType::PCG, SamplerType::Sobol })
+	{
+		std::vector<float> direction, choice, light, nextDirection;
+		for (unsigned int pixel = 0; pixel < 64; pixel++)
+		{
+			uint32_t seed = PixelSeed(pixel, 0);
+			for (uint32_t i = 0; i < 64; i++)
+			{
+				direction.push_back(Sample1D(type, i, BounceDimension(0) + BounceDirectionOffset, seed));
+				choice.push_back(Sample1D(type, i, BounceDimension(0) + BounceChoiceOffset, seed));
+				light.push_back(Sample1D(type, i, BounceDimension(0) + LightChoiceOffset, seed));
+				nextDirection.push_back(Sample1D(type, i, BounceDimension(1) + BounceDirectionOffset, seed));
+			}
+		}
+		CHECK(std::fabs(Correlation(direction, choice)) < 0.05);
+		CHECK(std::fabs(Correlation(direction, light)) < 0.05);
+		CHECK(std::fabs(Correlation(direction, nextDirection)) < 0.05);
+	}
+}
+
+TEST_CASE(PathDimensionsDontOverlap)
+{
+	// The layout RayTracing.hlsl relies on: the camera gets the
+	// first pair, then each bounce its own block of eight
+	CHECK_EQUAL(CameraJitterDimension, 0u);
+	CHECK_EQUAL(BounceDimension(0), 2u);
+	CHECK_EQUAL(BounceDimension(1), 10u);
+	CHECK_EQUAL(BounceDimension(5), 42u);
+
+	// Every pair used along a path, for as many bounces as
+	// the settings allow, is used only once
+	const unsigned int bounces = 32;
+	std::vector<unsigned int> uses(FirstBounceDimension + bounces * DimensionsPerBounce, 0);
+	uses[CameraJitterDimension]++;
+	uses[CameraJitterDimension + 1]++;
+	for (unsigned int bounce = 0; bounce < bounces; bounce++)
+	{
+		for (unsigned int offset : { BounceDirectionOffset, BounceChoiceOffset, LightChoiceOffset, LightDirectionOffset })
+		{
+			REQUIRE(offset % 2 == 0 && offset + 2 <= DimensionsPerBounce);
+			uses[BounceDimension(bounce) + offset]++;
+			uses[BounceDimension(bounce) + offset + 1]++;
+		}
+	}
+
+	bool eachOnce = true;
+	for (unsigned int count : uses)
+		eachOnce = eachOnce && count == 1;
+	CHECK(eachOnce);
+}
+
+TEST_CASE(RouletteSurvivalFollowsTheBrightestChannel)
+{
+	CHECK_EQUAL(RouletteSurvival(0.2f, 0.5f, 0.1f), 0.5f);
+	CHECK_EQUAL(RouletteSurvival(0.2f, 0.1f, 0.7f), 0.7f);
+	CHECK_EQUAL(RouletteSurvival(3.0f, 0.1f, 0.1f), 1.0f);
+	CHECK_EQUAL(RouletteSurvival(0, 0, 0), 0.0f);
+}
+
+TEST_CASE(HighSampleReferenceMatchesTheFurnace)
+{
+	// Without roulette, enough samples land on the exact answer
+	FurnaceError error = MeasureFurnace(SamplerType::Sobol, 16, 4096, false);
+	for (int c = 0; c < 3; c++)
+		CHECK(std::fabs(error.Bias[c]) < 0.001 * FurnaceReference(c));
+}
+
+TEST_CASE(RouletteAddsNoBias)
+{
+	// Roulette ends paths early but boosts the survivors, so the
+	// average over many pixels still matches the reference.  Each
+	// pixel does get noisier, most of all in the brightest channel
+	// with Sobol (whose stratification the random ends break up),
+	// but within bounds.
+	for (SamplerType type : { SamplerType::PCG, SamplerType::Sobol })
+	{
+		FurnaceError without = MeasureFurnace(type, 256, 64, false);
+		FurnaceError with = MeasureFurnace(type, 256, 64, true);
+		for (int c = 0; c < 3; c++)
+		{
+			CHECK(std::fabs(with.Bias[c]) < 4 * with.StandardError[c]);
+			CHECK(with.RMSE[c] < 2.5 * without.RMSE[c]);
+		}
+
+		// And spends fewer rays doing it
+		CHECK(with.RaysPerSample < 0.9 * without.RaysPerSample);
+	}
+}
+
+TEST_CASE(LoopMatchesTheRecursiveIntegrator)
+{
+	// Without roulette the loop is the old recursion unrolled, so
+	// every path carries exactly the same light however it ends
+	unsigned int mismatches = 0;
+	unsigned int depths[MaxBounces + 1] = {};
+	unsigned int cutOff = 0;
+	for (SamplerType type : { SamplerType::PCG, SamplerType::Sobol })
+	{
+		for (unsigned int pixel = 0; pixel < 64; pixel++)
+		{
+			uint32_t pixelSeed = PixelSeed(pixel % 8, pixel / 8);
+			for (uint32_t i = 0; i < 64; i++)
+			{
+				RandomScene scene{ HashCombine(pixelSeed, i) };
+				Vector3 loop = TraceLoopPath(scene, type, i, pixelSeed, MaxBounces + 1);
+				RecursivePayload recursive = TraceRecursivePath(scene, type, i, pixelSeed);
+
+				if (loop.x != recursive.Color.x || loop.y != recursive.Color.y || loop.z != recursive.Color.z)
+					mismatches++;
+				depths[recursive.RecursionDepth]++;
+				if (recursive.RecursionDepth == MaxBounces && recursive.Color.x == 0)
+					cutOff++;
+			}
+		}
+	}
+	CHECK_EQUAL(mismatches, 0u);
+
+	// Paths of every length were compared, including ones
+	// that never escaped
+	for (unsigned int depth = 0; depth <= MaxBounces; depth++)
+		CHECK(depths[depth] > 0);
+	CHECK(cutOff > 0);
+}
+
+TEST_CASE(LoopWithRouletteAveragesToTheRecursiveIntegrator)
+{
+	// Roulette changes single paths, but not what they converge to
+	for (SamplerType type : { SamplerType::PCG, SamplerType::Sobol })
+	{
+		double sum[3] = {}, squaredDifference[3] = {};
+		const unsigned int paths = 64 * 256;
+		for (unsigned int pixel = 0; pixel < 64; pixel++)
+		{
+			uint32_t pixelSeed = PixelSeed(pixel % 8, pixel / 8);
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				RandomScene scene{ HashCombine(pixelSeed, i) };
+				Vector3 loop = TraceLoopPath(scene, type, i, pixelSeed, RouletteStartBounce);
+				Vector3 recursive = TraceRecursivePath(scene, type, i, pixelSeed).Color;
+
+				double difference[3] = { loop.x - recursive.x, loop.y - recursive.y, loop.z - recursive.z };
+				for (int c = 0; c < 3; c++)
+				{
+					sum[c] += difference[c];
+					squaredDifference[c] += difference[c] * difference[c];
+				}
+			}
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			double mean = sum[c] / paths;
+			double standardError = std::sqrt((squaredDifference[c] / paths - mean * mean) / paths);
+			CHECK(standardError > 0);
+			CHECK(std::fabs(mean) < 4 * standardError);
+		}
+	}
+}
@@ -0,0 +1,171 @@
+#include "TestFramework.h"
+#include "ProfileZones.h"
+
+#include <cstdint>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// A GPU ticking at 1MHz (so one tick is a microsecond), whose
+	// tick 5000 was read at the same moment as the CPU's 2 seconds
+	// (at 10MHz), which puts GPU tick 5000 at 2000ms
+	ClockCalibration Calibration()
+	{
+		ClockCalibration calibration;
+		calibration.GPUTimestamp = 5000;
+		calibration.GPUFrequency = 1000000;
+		calibration.CPUTimestamp = 20000000;
+		calibration.CPUFrequency = 10000000;
+		return calibration;
+	}
+
+	ProfileZone Zone(const char* name, double startMs, double durationMs, unsigned int depth = 0, bool gpu = false)
+	{
+		ProfileZone zone;
+		zone.Name = name;
+		zone.StartMs = startMs;
+		zone.DurationMs = durationMs;
+		zone.Depth = depth;
+		zone.GPU = gpu;
+		return zone;
+	}
+}
+
+// --------------------------------------------------------
+// Resolving GPU zones from made up timestamps and clock
+// calibration, the way GPUProfiler reads them back, and
+// averaging zone timings across frames
+// --------------------------------------------------------
+
+TEST_CASE(TicksAreConvertedToCPUMilliseconds)
+{
+	// One zone from tick 6000 to 6500
+	std::vector<TimestampZoneRecord> records = { { "Frame", 0, 1, 0 } };
+	uint64_t timestamps[] = { 6000, 6500 };
+
+	std::vector<ProfileZone> zones = ResolveTimestampZones(records, timestamps, Calibration());
+	REQUIRE(zones.size() == 1);
+	CHECK_EQUAL(zones[0].Name, std::string("Frame"));
+	CHECK_NEAR(zones[0].StartMs, 2001.0, 1e-9);
+	CHECK_NEAR(zones[0].DurationMs, 0.5, 1e-9);
+	CHECK(zones[0].GPU);
+
+	// Work from before the calibration point lands before it
+	timestamps[0] = 3000;
+	zones = ResolveTimestampZones(records, timestamps, Calibration());
+	CHECK_NEAR(zones[0].StartMs, 1998.0, 1e-9);
+	CHECK_NEAR(zones[0].DurationMs, 3.5, 1e-9);
+}
+
+TEST_CASE(NestedZonesKeepTheirDepthAndStayInsideTheirParents)
+{
+	// Recorded the way GPUProfiler numbers its queries: each
+	// begin and end takes the next one, so children's queries
+	// are inside their parent's
+	//   Frame       0 ............................ 7
+	//     Shadows     1 ........ 4
+	//       Cull        2 .. 3
+	//     Lighting                 5 .. 6
+	std::vector<TimestampZoneRecord> records = {
+		{ "Frame", 0, 7, 0 },
+		{ "Shadows", 1, 4, 1 },
+		{ "Cull", 2, 3, 2 },
+		{ "Lighting", 5, 6, 1 } };
+	uint64_t timestamps[] = { 5000, 5100, 5150, 5300, 5400, 5400, 6400, 7000 };
+
+	std::vector<ProfileZone> zones = ResolveTimestampZones(records, timestamps, Calibration());
+	REQUIRE(zones.size() == 4);
+	unsigned int parents[] = { 0, 0, 1, 0 };
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		CHECK_EQUAL(zones[i].Name, std::string(records[i].Name));
+		CHECK_EQUAL(zones[i].Depth, records[i].Depth);
+		if (i == 0)
+			continue;
+
+		const ProfileZone& parent = zones[parents[i]];
+		CHECK_EQUAL(parent.Depth + 1, zones[i].Depth);
+		CHECK(zones[i].StartMs >= parent.StartMs);
+		CHECK(zones[i].StartMs + zones[i].DurationMs <= parent.StartMs + parent.DurationMs);
+	}
+	CHECK_NEAR(zones[0].DurationMs, 2.0, 1e-9);
+	CHECK_NEAR(zones[2].DurationMs, 0.15, 1e-9);
+	CHECK_NEAR(zones[3].StartMs, 2000.4, 1e-9);
+
+	// Merged with CPU zones, a parent starting at the same time
+	// as its child still comes first
+	std::vector<ProfileZone> cpuZones = { Zone("Render", 1999.5, 3) };
+	std::vector<ProfileZone> merged = MergeProfileZones(cpuZones, zones);
+	REQUIRE(merged.size() == 5);
+	const char* order[] = { "Render", "Frame", "Shadows", "Cull", "Lighting" };
+	for (unsigned int i = 0; i < 5; i++)
+		CHECK_EQUAL(merged[i].Name, std::string(order[i]));
+
+	zones[1].StartMs = zones[0].StartMs;
+	merged = MergeProfileZones(zones, {});
+	CHECK_EQUAL(merged[0].Name, std::string("Frame"));
+	CHECK_EQUAL(merged[1].Name, std::string("Shadows"));
+}
+
+TEST_CASE(UnfinishedZonesHaveNoDuration)
+{
+	// A zone that never closed still has its end query pointing
+	// at its begin, and one whose end is earlier than its begin
+	// (the GPU's clock was reset) is treated the same way
+	std::vector<TimestampZoneRecord> records = {
+		{ "Never Closed", 0, 0, 0 },
+		{ "Clock Reset", 1, 2, 0 } };
+	uint64_t timestamps[] = { 6000, 9000, 100 };
+
+	std::vector<ProfileZone> zones = ResolveTimestampZones(records, timestamps, Calibration());
+	REQUIRE(zones.size() == 2);
+	CHECK_NEAR(zones[0].StartMs, 2001.0, 1e-9);
+	CHECK_EQUAL(zones[0].DurationMs, 0.0);
+	CHECK_NEAR(zones[1].StartMs, 2004.0, 1e-9);
+	CHECK_EQUAL(zones[1].DurationMs, 0.0);
+}
+
+TEST_CASE(AggregatorAveragesByNameAcrossFrames)
+{
+	ZoneTimingAggregator aggregator;
+	aggregator.AddFrame({ Zone("Frame", 0, 10), Zone("Shadows", 0, 2, 1), Zone("Frame", 0, 4, 0, true) });
+	aggregator.AddFrame({ Zone("Frame", 16, 14), Zone("Shadows", 16, 1, 1), Zone("Shadows", 20, 3, 1) });
+	aggregator.AddFrame({ Zone("Frame", 32, 12), Zone("Post", 40, 1, 1) });
+
+	// In the order each was first seen, with CPU and GPU zones
+	// of the same name kept apart
+	const std::vector<ZoneTimingStats>& stats = aggregator.GetStats();
+	REQUIRE(stats.size() == 4);
+	CHECK_EQUAL(stats[0].Name, std::string("Frame"));
+	CHECK(!stats[0].GPU);
+	CHECK_EQUAL(stats[1].Name, std::string("Shadows"));
+	CHECK_EQUAL(stats[1].Depth, 1u);
+	CHECK_EQUAL(stats[2].Name, std::string("Frame"));
+	CHECK(stats[2].GPU);
+	CHECK_EQUAL(stats[3].Name, std::string("Post"));
+
+	CHECK_EQUAL(stats[0].SampleCount, 3u);
+	CHECK_NEAR(stats[0].AverageMs(), 12.0, 1e-9);
+	CHECK_EQUAL(stats[0].MaxMs, 14.0);
+	CHECK_EQUAL(stats[0].LastMs, 12.0);
+	CHECK_EQUAL(stats[2].SampleCount, 1u);
+	CHECK_EQUAL(stats[2].AverageMs(), 4.0);
+
+	// Twice in one frame counts as two samples
+	CHECK_EQUAL(stats[1].SampleCount, 3u);
+	CHECK_NEAR(stats[1].AverageMs(), 2.0, 1e-9);
+	CHECK_EQUAL(stats[1].LastMs, 3.0);
+
+	const ZoneTimingStats* post = aggregator.FindStats("Post");
+	REQUIRE(post != 0);
+	CHECK_EQUAL(post->TotalMs, 1.0);
+	CHECK(aggregator.FindStats("Missing") == 0);
+
+	// Starting over forgets everything
+	aggregator.Reset();
+	CHECK(aggregator.GetStats().empty());
+	CHECK(aggregator.FindStats("Frame") == 0);
+	CHECK_EQUAL(ZoneTimingStats().AverageMs(), 0.0);
+}
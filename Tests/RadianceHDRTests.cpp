@@ -0,0 +1,278 @@
+#include "TestFramework.h"
+#include "RadianceHDR.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Writes the bytes to a file in the temp directory, returning its path
+	std::wstring WriteFile(const char* name, const std::vector<uint8_t>& bytes)
+	{
+		std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+		std::ofstream file(path, std::ios::binary);
+		file.write((const char*)bytes.data(), bytes.size());
+		return path.wstring();
+	}
+
+	void Append(std::vector<uint8_t>& bytes, const std::string& text)
+	{
+		bytes.insert(bytes.end(), text.begin(), text.end());
+	}
+
+	std::vector<uint8_t> Header(unsigned int width, unsigned int height, const char* format = "32-bit_rle_rgbe")
+	{
+		std::vector<uint8_t> bytes;
+		Append(bytes, "#?RADIANCE\n# Made by RadianceHDRTests\nFORMAT=");
+		Append(bytes, format);
+		Append(bytes, "\n\n-Y " + std::to_string(height) + " +X " + std::to_string(width) + "\n");
+		return bytes;
+	}
+
+	// The usual float to RGBE conversion (Greg Ward's float2rgbe)
+	void ToRGBE(float r, float g, float b, uint8_t* pixel)
+	{
+		float largest = std::max(r, std::max(g, b));
+		if (largest < 1e-32f)
+		{
+			pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
+			return;
+		}
+
+		int exponent;
+		float scale = std::frexp(largest, &exponent) * 256.0f / largest;
+		pixel[0] = (uint8_t)(r * scale);
+		pixel[1] = (uint8_t)(g * scale);
+		pixel[2] = (uint8_t)(b * scale);
+		pixel[3] = (uint8_t)(exponent + 128);
+	}
+
+	// --------------------------------------------------------
+	// Encodes one scanline the way Radiance's writer does:
+	// each channel in turn, as runs of 4 or more repeats and
+	// literal stretches of up to 128 values in between
+	// --------------------------------------------------------
+	void AppendEncodedScanline(std::vector<uint8_t>& bytes, const uint8_t* row, unsigned int width)
+	{
+		bytes.insert(bytes.end(), { 2, 2, (uint8_t)(width >> 8), (uint8_t)(width & 255) });
+		for (unsigned int channel = 0; channel < 4; channel++)
+		{
+			unsigned int x = 0;
+			while (x < width)
+			{
+				unsigned int run = 1;
+				while (x + run < width && run < 127 && row[(x + run) * 4 + channel] == row[x * 4 + channel])
+					run++;
+				if (run >= 4)
+				{
+					bytes.push_back((uint8_t)(128 + run));
+					bytes.push_back(row[x * 4 + channel]);
+					x += run;
+					continue;
+				}
+
+				// Literals up to the next run of 4 (or 128 values)
+				unsigned int count = 0;
+				while (x + count < width && count < 128)
+				{
+					unsigned int repeats = 1;
+					while (x + count + repeats < width && repeats < 4 &&
+						row[(x + count + repeats) * 4 + channel] == row[(x + count) * 4 + channel])
+						repeats++;
+					if (repeats >= 4)
+						break;
+					count++;
+				}
+				bytes.push_back((uint8_t)count);
+				for (unsigned int i = 0; i < count; i++)
+					bytes.push_back(row[(x + i) * 4 + channel]);
+				x += count;
+			}
+		}
+	}
+
+	// A sky-like test image: smooth gradients (which make
+	// literals), flat bands (which make runs) and a bright sun
+	std::vector<uint8_t> MakePixels(unsigned int width, unsigned int height)
+	{
+		std::vector<uint8_t> pixels((size_t)width * height * 4);
+		for (unsigned int y = 0; y < height; y++)
+		{
+			for (unsigned int x = 0; x < width; x++)
+			{
+				float value = y % 3 == 0 ? 0.5f : 0.1f + 0.02f * x;
+				if (x == width / 3 && y == height / 2)
+					value = 5000;
+				ToRGBE(value, value * 0.8f, value * 0.6f, &pixels[((size_t)y * width + x) * 4]);
+			}
+		}
+		return pixels;
+	}
+
+	bool LoadBytes(const std::vector<uint8_t>& bytes, RadianceHDR::Image& image, std::string* error = 0)
+	{
+		return RadianceHDR::Load(WriteFile("RadianceHDRTests.hdr", bytes), image, error);
+	}
+}
+
+// --------------------------------------------------------
+// RadianceHDR, loading files written here byte by byte:
+// run length encoded scanlines (both by a reference
+// encoder and by hand), flat ones, and broken ones
+// --------------------------------------------------------
+
+TEST_CASE(ReadsRunLengthEncodedScanlines)
+{
+	const unsigned int width = 300;
+	const unsigned int height = 7;
+	std::vector<uint8_t> pixels = MakePixels(width, height);
+
+	std::vector<uint8_t> bytes = Header(width, height);
+	for (unsigned int y = 0; y < height; y++)
+		AppendEncodedScanline(bytes, &pixels[(size_t)y * width * 4], width);
+
+	// Make sure the encoding is actually compressing
+	CHECK(bytes.size() < pixels.size());
+
+	RadianceHDR::Image image;
+	std::string error;
+	REQUIRE(LoadBytes(bytes, image, &error));
+	CHECK_EQUAL(image.Width, width);
+	CHECK_EQUAL(image.Height, height);
+	CHECK(image.RGBE == pixels);
+}
+
+TEST_CASE(ReadsRunsAndLiteralsByHand)
+{
+	// One 8 pixel scanline:
+	// - red is a run of eight 10s
+	// - green is eight literal values
+	// - blue is a run of three 5s then five literals
+	// - exponents are two runs of four
+	std::vector<uint8_t> bytes = Header(8, 1);
+	bytes.insert(bytes.end(), {
+		2, 2, 0, 8,
+		128 + 8, 10,
+		8, 0, 1, 2, 3, 4, 5, 6, 7,
+		128 + 3, 5, 5, 20, 21, 22, 23, 24,
+		128 + 4, 129, 128 + 4, 130 });
+
+	RadianceHDR::Image image;
+	REQUIRE(LoadBytes(bytes, image));
+	REQUIRE(image.RGBE.size() == 32);
+
+	uint8_t expected[8][4] = {
+		{ 10, 0, 5, 129 }, { 10, 1, 5, 129 }, { 10, 2, 5, 129 }, { 10, 3, 20, 129 },
+		{ 10, 4, 21, 130 }, { 10, 5, 22, 130 }, { 10, 6, 23, 130 }, { 10, 7, 24, 130 } };
+	for (unsigned int x = 0; x < 8; x++)
+	{
+		for (unsigned int channel = 0; channel < 4; channel++)
+			CHECK_EQUAL((int)image.RGBE[x * 4 + channel], (int)expected[x][channel]);
+	}
+}
+
+TEST_CASE(ReadsFlatScanlines)
+{
+	// Too narrow to encode, and a wide one that just isn't
+	for (unsigned int width : { 5u, 40u })
+	{
+		std::vector<uint8_t> pixels = MakePixels(width, 3);
+		std::vector<uint8_t> bytes = Header(width, 3);
+		bytes.insert(bytes.end(), pixels.begin(), pixels.end());
+
+		RadianceHDR::Image image;
+		REQUIRE(LoadBytes(bytes, image));
+		CHECK(image.RGBE == pixels);
+	}
+}
+
+TEST_CASE(RejectsBrokenFiles)
+{
+	RadianceHDR::Image image;
+	std::string error;
+	CHECK(!RadianceHDR::Load(L"/no/such/file.hdr", image, &error));
+	CHECK(!error.empty());
+
+	std::vector<uint8_t> bytes;
+	Append(bytes, "P6\n8 1\n255\n");
+	CHECK(!LoadBytes(bytes, image));
+
+	// XYZ pixels and flipped images aren't supported
+	CHECK(!LoadBytes(Header(8, 1, "32-bit_rle_xyze"), image));
+	bytes.clear();
+	Append(bytes, "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n+Y 1 +X 8\n");
+	CHECK(!LoadBytes(bytes, image));
+
+	// Cut short, in flat and encoded scanlines
+	bytes = Header(4, 2);
+	bytes.insert(bytes.end(), 12, 128);
+	CHECK(!LoadBytes(bytes, image));
+
+	std::vector<uint8_t> encoded = Header(8, 1);
+	encoded.insert(encoded.end(), { 2, 2, 0, 8, 128 + 8, 10, 8, 0, 1, 2 });
+	CHECK(!LoadBytes(encoded, image, &error));
+	CHECK_EQUAL(error, std::string("Pixel data is cut short or corrupt"));
+
+	// A run past the end of the scanline, and an empty run
+	encoded = Header(8, 1);
+	encoded.insert(encoded.end(), { 2, 2, 0, 8, 128 + 9, 10 });
+	CHECK(!LoadBytes(encoded, image));
+	encoded = Header(8, 1);
+	encoded.insert(encoded.end(), { 2, 2, 0, 8, 0, 128 + 8, 10 });
+	CHECK(!LoadBytes(encoded, image));
+}
+
+TEST_CASE(DecodesRGBE)
+{
+	RadianceHDR::Image image;
+	image.Width = 2;
+	image.Height = 1;
+	image.RGBE = { 128, 64, 32, 129, 200, 100, 50, 0 };
+
+	RadianceHDR::Color color = RadianceHDR::Decode(image, 0, 0);
+	CHECK_EQUAL(color.R, 1.0f);
+	CHECK_EQUAL(color.G, 0.5f);
+	CHECK_EQUAL(color.B, 0.25f);
+
+	// A zero exponent is black, whatever the mantissas
+	color = RadianceHDR::Decode(image, 1, 0);
+	CHECK_EQUAL(color.R, 0.0f);
+	CHECK_EQUAL(color.G, 0.0f);
+	CHECK_EQUAL(color.B, 0.0f);
+}
+
+TEST_CASE(PacksSharedExponent)
+{
+	// 1 is 256/512 * 2^(16 - 15)
+	CHECK_EQUAL(RadianceHDR::PackSharedExponent({ 1, 0, 0 }), 256u | (16u << 27));
+	CHECK_EQUAL(RadianceHDR::PackSharedExponent({ 0, 0, 0 }), 0u);
+
+	// Too bright for the format saturates at its largest value
+	CHECK_EQUAL(RadianceHDR::PackSharedExponent({ 1e9f, 0, 0 }), 511u | (31u << 27));
+
+	// The quick repacking matches the general conversion, for
+	// pixels both inside and outside the format's range
+	const unsigned int width = 64;
+	RadianceHDR::Image image;
+	image.Width = width;
+	image.Height = 1;
+	image.RGBE.resize(width * 4);
+	for (unsigned int x = 0; x < width; x++)
+	{
+		float value = std::ldexp(1.3f, (int)x - 40);
+		ToRGBE(value, value * 0.7f, value * 0.01f, &image.RGBE[x * 4]);
+	}
+
+	std::vector<uint32_t> packed;
+	RadianceHDR::ConvertToSharedExponent(image, packed);
+	REQUIRE(packed.size() == width);
+	for (unsigned int x = 0; x < width; x++)
+		CHECK_EQUAL(packed[x], RadianceHDR::PackSharedExponent(RadianceHDR::Decode(image, x, 0)));
+}
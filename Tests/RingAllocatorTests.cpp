@@ -0,0 +1,216 @@
+#include "TestFramework.h"
+#include "RingAllocator.h"
+
+#include <vector>
+
+// --------------------------------------------------------
+// RingAllocator, driven by made up fence values the way
+// Graphics drives it with the frame fence
+// --------------------------------------------------------
+
+TEST_CASE(AllocationsAreHandedOutInOrder)
+{
+	RingAllocator ring(1024);
+	CHECK_EQUAL(ring.Allocate(256), 0u);
+	CHECK_EQUAL(ring.Allocate(256), 256u);
+	CHECK_EQUAL(ring.Allocate(512), 512u);
+	CHECK_EQUAL(ring.GetUsedSize(), 1024u);
+
+	// Completely full, so nothing else fits
+	CHECK_EQUAL(ring.Allocate(1), RingAllocator::InvalidOffset);
+	CHECK_EQUAL(ring.GetStats().FailedAllocations, 1u);
+}
+
+TEST_CASE(AlignmentPaddingCountsAsUsed)
+{
+	RingAllocator ring(1024);
+	CHECK_EQUAL(ring.Allocate(10), 0u);
+	CHECK_EQUAL(ring.Allocate(16, 256), 256u);
+
+	// The 246 bytes skipped to align the second allocation
+	// are reserved until the frame is retired
+	CHECK_EQUAL(ring.GetUsedSize(), 272u);
+
+	CHECK_EQUAL(ring.Allocate(1, 256), 512u);
+	CHECK_EQUAL(ring.Allocate(4, 4), 516u);
+	CHECK_EQUAL(ring.GetUsedSize(), 520u);
+
+	ring.FinishFrame(1);
+	ring.Retire(1);
+	CHECK_EQUAL(ring.GetUsedSize(), 0u);
+}
+
+TEST_CASE(BadSizesFail)
+{
+	RingAllocator ring(1024);
+	CHECK_EQUAL(ring.Allocate(0), RingAllocator::InvalidOffset);
+	CHECK_EQUAL(ring.Allocate(1025), RingAllocator::InvalidOffset);
+	CHECK_EQUAL(ring.GetStats().FailedAllocations, 2u);
+	CHECK_EQUAL(ring.GetUsedSize(), 0u);
+
+	// The whole ring at once is fine
+	CHECK_EQUAL(ring.Allocate(1024), 0u);
+}
+
+TEST_CASE(SpaceIsOnlyReusedOnceItsFenceCompletes)
+{
+	RingAllocator ring(1024);
+	CHECK_EQUAL(ring.Allocate(512), 0u);
+	ring.FinishFrame(1);
+	CHECK_EQUAL(ring.Allocate(512), 512u);
+	ring.FinishFrame(2);
+	CHECK(ring.HasPendingFrames());
+	CHECK_EQUAL(ring.GetOldestPendingFenceValue(), 1u);
+
+	// Nothing has completed yet
+	ring.Retire(0);
+	CHECK_EQUAL(ring.GetUsedSize(), 1024u);
+	CHECK_EQUAL(ring.Allocate(256), RingAllocator::InvalidOffset);
+
+	// Frame 1's space comes back, and only that
+	ring.Retire(1);
+	CHECK_EQUAL(ring.GetUsedSize(), 512u);
+	CHECK_EQUAL(ring.GetOldestPendingFenceValue(), 2u);
+	CHECK_EQUAL(ring.Allocate(512), 0u);
+	CHECK_EQUAL(ring.Allocate(1), RingAllocator::InvalidOffset);
+	ring.FinishFrame(3);
+
+	// Several frames can complete at once
+	ring.Retire(3);
+	CHECK(!ring.HasPendingFrames());
+	CHECK_EQUAL(ring.GetUsedSize(), 0u);
+	CHECK_EQUAL(ring.GetOldestPendingFenceValue(), 0u);
+}
+
+TEST_CASE(FramesWithoutAllocationsAreNotTracked)
+{
+	RingAllocator ring(1024);
+	ring.FinishFrame(1);
+	CHECK(!ring.HasPendingFrames());
+
+	ring.Allocate(64);
+	ring.FinishFrame(2);
+	ring.FinishFrame(3);
+	CHECK(ring.HasPendingFrames());
+	CHECK_EQUAL(ring.GetOldestPendingFenceValue(), 2u);
+
+	ring.Retire(2);
+	CHECK(!ring.HasPendingFrames());
+}
+
+TEST_CASE(AllocationsThatDontFitAtTheEndWrapAround)
+{
+	RingAllocator ring(1024);
+	ring.Allocate(512);
+	ring.FinishFrame(1);
+	ring.Allocate(256);
+	ring.FinishFrame(2);
+	ring.Retire(1);
+
+	// Free space is [768, 1024) and [0, 512), so 512 bytes only
+	// fit at the start, and the end of the ring is skipped
+	CHECK_EQUAL(ring.Allocate(512), 0u);
+	CHECK_EQUAL(ring.GetUsedSize(), 1024u);
+	ring.FinishFrame(3);
+
+	// The skipped space belongs to frame 3, so it isn't free
+	// until frame 3 is
+	ring.Retire(2);
+	CHECK_EQUAL(ring.GetUsedSize(), 768u);
+	CHECK_EQUAL(ring.Allocate(256), 512u);
+	CHECK_EQUAL(ring.Allocate(1), RingAllocator::InvalidOffset);
+	ring.FinishFrame(4);
+
+	ring.Retire(3);
+	CHECK_EQUAL(ring.GetUsedSize(), 256u);
+	CHECK_EQUAL(ring.Allocate(512), 0u);
+}
+
+TEST_CASE(WrappingNeverOverlapsLiveAllocations)
+{
+	// Frames of varying sizes go round the ring many times, and
+	// every live allocation is checked against every other one
+	const uint64_t capacity = 4096;
+	RingAllocator ring(capacity);
+
+	struct Live { uint64_t Offset, Size, Fence; };
+	std::vector<Live> live;
+
+	uint64_t fence = 0;
+	uint64_t seed = 12345;
+	for (int frame = 0; frame < 2000; frame++)
+	{
+		fence++;
+		unsigned int count = 1 + (unsigned int)(seed % 5);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+			uint64_t size = 1 + (seed >> 33) % 700;
+			uint64_t alignment = (seed >> 20) % 2 ? 256 : 1;
+			uint64_t offset = ring.Allocate(size, alignment);
+			if (offset == RingAllocator::InvalidOffset)
+				continue;
+
+			CHECK(offset % alignment == 0);
+			CHECK(offset + size <= capacity);
+			for (const Live& other : live)
+				CHECK(offset + size <= other.Offset || other.Offset + other.Size <= offset);
+			live.push_back({ offset, size, fence });
+		}
+		ring.FinishFrame(fence);
+
+		// The GPU runs two frames behind
+		if (fence > 2)
+		{
+			ring.Retire(fence - 2);
+			std::erase_if(live, [&](const Live& l) { return l.Fence <= fence - 2; });
+		}
+	}
+
+	CHECK(ring.GetStats().HighWaterMark <= capacity);
+}
+
+TEST_CASE(HighWaterMarkTracksTheMostEverUsed)
+{
+	RingAllocator ring(1024);
+	ring.Allocate(300);
+	ring.Allocate(200);
+	ring.FinishFrame(1);
+	CHECK_EQUAL(ring.GetStats().HighWaterMark, 500u);
+
+	ring.Retire(1);
+	ring.Allocate(100);
+	RingAllocatorStats stats = ring.GetStats();
+	CHECK_EQUAL(stats.Used, 100u);
+	CHECK_EQUAL(stats.HighWaterMark, 500u);
+	CHECK_EQUAL(stats.Capacity, 1024u);
+
+	// Padding counts too
+	ring.FinishFrame(2);
+	ring.Retire(2);
+	ring.Allocate(10);
+	ring.Allocate(10, 512);
+	CHECK_EQUAL(ring.GetStats().HighWaterMark, 522u);
+}
+
+TEST_CASE(ResetKeepsLifetimeStats)
+{
+	RingAllocator ring(256);
+	ring.Allocate(200);
+	ring.Allocate(100);
+	ring.RecordStall();
+	ring.RecordStall();
+	ring.FinishFrame(1);
+
+	// As when the upload heap is replaced with a bigger one
+	ring.Reset(1024);
+	CHECK(!ring.HasPendingFrames());
+	RingAllocatorStats stats = ring.GetStats();
+	CHECK_EQUAL(stats.Capacity, 1024u);
+	CHECK_EQUAL(stats.Used, 0u);
+	CHECK_EQUAL(stats.HighWaterMark, 200u);
+	CHECK_EQUAL(stats.FailedAllocations, 1u);
+	CHECK_EQUAL(stats.Stalls, 2u);
+
+	CHECK_EQUAL(ring.Allocate(1024), 0u);
+}
@@ -0,0 +1,173 @@
+#include "TestFramework.h"
+#include "SceneSimulation.h"
+
+#include <cmath>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	const float Pi = 3.14159265f;
+
+	SceneObjectState MakeObject(TimelineFloat3 position, float yaw, TimelineFloat3 scale = { 1, 1, 1 })
+	{
+		SceneObjectState object;
+		object.Position = position;
+		object.PitchYawRoll = { 0, yaw, 0 };
+		object.Scale = scale;
+		return object;
+	}
+
+	// A point multiplied as a row vector, like XMVector3TransformCoord()
+	TimelineFloat3 TransformPoint(const TimelineFloat3& p, const SceneFloat4x4& m)
+	{
+		return TimelineFloat3{
+			p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0],
+			p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1],
+			p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2] };
+	}
+
+	void CheckFloat3(const TimelineFloat3& actual, const TimelineFloat3& expected)
+	{
+		CHECK_NEAR(actual.x, expected.x, 1e-4);
+		CHECK_NEAR(actual.y, expected.y, 1e-4);
+		CHECK_NEAR(actual.z, expected.z, 1e-4);
+	}
+
+	void CheckMatrix(const SceneFloat4x4& actual, const SceneFloat4x4& expected)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+				CHECK_NEAR(actual.m[row][column], expected.m[row][column], 1e-4);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// SceneSimulation's fixed steps, interpolated world
+// matrices and camera, against rotations worked out by hand
+// --------------------------------------------------------
+
+TEST_CASE(WorldMatricesScaleThenRotateThenTranslate)
+{
+	// A quarter turn of yaw takes +X to -Z and +Z to +X
+	SceneObjectState object = MakeObject({ 1, 2, 3 }, Pi / 2, { 2, 3, 4 });
+	SceneFloat4x4 world = SceneSimulation::InterpolateWorldMatrix(object, object, 0.5f);
+
+	CheckFloat3(TransformPoint({ 0, 0, 0 }, world), { 1, 2, 3 });
+	CheckFloat3(TransformPoint({ 1, 0, 0 }, world), { 1, 2, 1 });
+	CheckFloat3(TransformPoint({ 0, 1, 0 }, world), { 1, 5, 3 });
+	CheckFloat3(TransformPoint({ 0, 0, 1 }, world), { 5, 2, 3 });
+	CHECK_EQUAL(world.m[3][3], 1.0f);
+}
+
+TEST_CASE(InterpolationBlendsBetweenTheTwoStates)
+{
+	SceneObjectState from = MakeObject({ 0, 0, 0 }, 0, { 1, 1, 1 });
+	SceneObjectState to = MakeObject({ 4, 0, -2 }, Pi / 2, { 3, 3, 3 });
+
+	CheckMatrix(SceneSimulation::InterpolateWorldMatrix(from, to, 0), SceneSimulation::InterpolateWorldMatrix(from, from, 0));
+	CheckMatrix(SceneSimulation::InterpolateWorldMatrix(from, to, 1), SceneSimulation::InterpolateWorldMatrix(to, to, 0));
+
+	// Halfway is halfway in position, scale and angle
+	SceneObjectState halfway = MakeObject({ 2, 0, -1 }, Pi / 4, { 2, 2, 2 });
+	CheckMatrix(SceneSimulation::InterpolateWorldMatrix(from, to, 0.5f), SceneSimulation::InterpolateWorldMatrix(halfway, halfway, 0));
+}
+
+TEST_CASE(RotationsTakeTheShortestPath)
+{
+	// Three quarters of a turn one way is a quarter the other
+	SceneObjectState from = MakeObject({ 0, 0, 0 }, 0);
+	SceneObjectState to = MakeObject({ 0, 0, 0 }, 3 * Pi / 2);
+	SceneObjectState halfway = MakeObject({ 0, 0, 0 }, -Pi / 4);
+
+	CheckMatrix(SceneSimulation::InterpolateWorldMatrix(from, to, 0.5f), SceneSimulation::InterpolateWorldMatrix(halfway, halfway, 0));
+}
+
+TEST_CASE(ViewMatrixLooksAlongTheCamerasForward)
+{
+	// Unrotated, the view just moves the camera to the origin
+	SceneFloat4x4 view = SceneSimulation::ViewMatrix({ 1, 2, 3 }, { 0, 0, 0 });
+	CheckFloat3(TransformPoint({ 1, 2, 8 }, view), { 0, 0, 5 });
+	CheckFloat3(TransformPoint({ 2, 3, 3 }, view), { 1, 1, 0 });
+
+	// Turned a quarter to the right, +X is straight ahead and +Z is to the left
+	view = SceneSimulation::ViewMatrix({ 0, 0, 0 }, { 0, Pi / 2, 0 });
+	CheckFloat3(TransformPoint({ 5, 0, 0 }, view), { 0, 0, 5 });
+	CheckFloat3(TransformPoint({ 0, 0, 1 }, view), { -1, 0, 0 });
+	CheckFloat3(TransformPoint({ 0, 1, 0 }, view), { 0, 1, 0 });
+
+	// Pitched down, things below are ahead
+	view = SceneSimulation::ViewMatrix({ 0, 0, 0 }, { Pi / 2 - 0.01f, 0, 0 });
+	CHECK(TransformPoint({ 0, -5, 0 }, view).z > 4.9f);
+}
+
+TEST_CASE(InstanceTransformsAreTransposed)
+{
+	SceneFloat4x4 world = SceneSimulation::InterpolateWorldMatrix(
+		MakeObject({ 7, 8, 9 }, 1), MakeObject({ 7, 8, 9 }, 1), 0);
+	SceneInstanceTransform instance = SceneSimulation::InstanceTransform(world);
+
+	for (int row = 0; row < 3; row++)
+	{
+		for (int column = 0; column < 4; column++)
+			CHECK_EQUAL(instance.m[row][column], world.m[column][row]);
+	}
+	CHECK_EQUAL(instance.m[0][3], 7.0f);
+	CHECK_EQUAL(instance.m[1][3], 8.0f);
+	CHECK_EQUAL(instance.m[2][3], 9.0f);
+}
+
+TEST_CASE(SimulationPublishesBothSidesOfTheLastStep)
+{
+	std::vector<SceneObjectState> objects = ScriptedScene::CreateInitialObjects();
+	SceneSimulation simulation(objects);
+
+	// Nothing has moved before the first frame
+	REQUIRE(simulation.GetWorldMatrices().size() == objects.size());
+	CheckMatrix(simulation.GetWorldMatrices()[1], SceneSimulation::InterpolateWorldMatrix(objects[1], objects[1], 0));
+
+	// Two and a half steps: rendered halfway between the first and second
+	double step = 1.0 / 60.0;
+	simulation.Simulate(step * 2.5, 0);
+	simulation.PrepareRenderState();
+
+	std::vector<SceneObjectState> first = objects;
+	ScriptedScene::Step(first, (float)step, (float)step, 0);
+	std::vector<SceneObjectState> second = first;
+	ScriptedScene::Step(second, (float)step, (float)(step * 2), 0);
+
+	CHECK_NEAR(simulation.GetRenderObjects()[0].PitchYawRoll.z, second[0].PitchYawRoll.z, 1e-6);
+	CHECK_NEAR(simulation.GetObjects()[1].Position.y, second[1].Position.y, 1e-6);
+	for (size_t i = 0; i < objects.size(); i++)
+		CheckMatrix(simulation.GetWorldMatrices()[i], SceneSimulation::InterpolateWorldMatrix(first[i], second[i], 0.5f));
+
+	// Last frame's matrices are kept for motion vectors
+	REQUIRE(simulation.GetPreviousWorldMatrices().size() == objects.size());
+	CheckMatrix(simulation.GetPreviousWorldMatrices()[0], SceneSimulation::InterpolateWorldMatrix(objects[0], objects[0], 0));
+}
+
+TEST_CASE(SimulationFollowsTheTimelinesCamera)
+{
+	SceneSimulation simulation(ScriptedScene::CreateInitialObjects());
+	SceneFloat4x4 identity = simulation.GetViewMatrix();
+
+	// No camera track leaves the view alone
+	BenchmarkTimeline timeline;
+	CHECK(!simulation.FollowCamera(timeline, 0));
+	CheckMatrix(simulation.GetViewMatrix(), identity);
+
+	TimelineKeyframe keyframe;
+	timeline.AddCameraKeyframe(keyframe);
+	keyframe.Time = 2;
+	keyframe.Position = { 10, 0, 0 };
+	keyframe.PitchYawRoll = { 0, Pi / 2, 0 };
+	timeline.AddCameraKeyframe(keyframe);
+
+	REQUIRE(simulation.FollowCamera(timeline, 1));
+	CHECK_NEAR(simulation.GetCamera().Position.x, 5, 1e-5);
+	CHECK_NEAR(simulation.GetCamera().PitchYawRoll.y, Pi / 4, 1e-5);
+	CheckMatrix(simulation.GetViewMatrix(), SceneSimulation::ViewMatrix({ 5, 0, 0 }, { 0, Pi / 4, 0 }));
+}
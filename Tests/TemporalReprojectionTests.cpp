@@ -0,0 +1,400 @@
+#include "TestFramework.h"
+#include "TemporalReprojection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// --------------------------------------------------------
+	// One frame's worth of inputs for a small gray image: a
+	// flat white wall facing the camera one unit away, with
+	// nothing moving.  Used for both this frame and history.
+	// --------------------------------------------------------
+	struct TestFrame
+	{
+		unsigned int Width;
+		unsigned int Height;
+		std::vector<FilterFloat4> Color;
+		std::vector<FilterFloat2> Moments;
+		std::vector<FilterFloat4> NormalDepth;
+		std::vector<FilterFloat4> Albedo;
+		std::vector<FilterFloat4> Motion;
+
+		TestFrame(unsigned int width, unsigned int height) :
+			Width(width),
+			Height(height),
+			Color((size_t)width * height),
+			Moments((size_t)width * height),
+			NormalDepth((size_t)width * height, FilterFloat4{ 0, 0, -1, 1 }),
+			Albedo((size_t)width * height, FilterFloat4{ 1, 1, 1, 1 }),
+			Motion((size_t)width * height, FilterFloat4{ 0, 0, 1, 0 })
+		{
+		}
+
+		// Gray color from sampleCount samples, with moments to match
+		void Fill(const std::function<float(unsigned int, unsigned int)>& value, float sampleCount, float sampleVariance = 0.01f)
+		{
+			for (unsigned int y = 0; y < Height; y++)
+			{
+				for (unsigned int x = 0; x < Width; x++)
+				{
+					float v = value(x, y);
+					Color[(size_t)y * Width + x] = FilterFloat4{ v, v, v, sampleCount };
+					Moments[(size_t)y * Width + x] = FilterFloat2{ v, v * v + sampleVariance };
+				}
+			}
+		}
+
+		TemporalReprojection::Frame Frame() const
+		{
+			TemporalReprojection::Frame frame;
+			frame.Width = Width;
+			frame.Height = Height;
+			frame.Color = Color.data();
+			frame.Moments = Moments.data();
+			frame.NormalDepth = NormalDepth.data();
+			frame.Albedo = Albedo.data();
+			frame.Motion = Motion.data();
+			return frame;
+		}
+
+		TemporalReprojection::History History() const
+		{
+			TemporalReprojection::History history;
+			history.Color = Color.data();
+			history.Moments = Moments.data();
+			history.NormalDepth = NormalDepth.data();
+			history.Albedo = Albedo.data();
+			return history;
+		}
+	};
+
+	struct Result
+	{
+		std::vector<FilterFloat4> Color;
+		std::vector<FilterFloat2> Moments;
+	};
+
+	Result Accumulate(const TestFrame& frame, const TestFrame* history, const TemporalSettings& settings = TemporalSettings())
+	{
+		Result result;
+		TemporalReprojection::History previous;
+		if (history)
+			previous = history->History();
+		TemporalReprojection::Accumulate(frame.Frame(), history ? &previous : 0, settings, result.Color, result.Moments);
+		return result;
+	}
+
+	// A little noise, so each pixel's neighborhood has a box to
+	// clip history to (about 1, give or take 0.1)
+	float Checkerboard(unsigned int x, unsigned int y)
+	{
+		return (x + y) % 2 ? 1.1f : 0.9f;
+	}
+
+	// Mean and standard deviation of the 3x3 pixels around one
+	void Neighborhood(const TestFrame& frame, int x, int y, float& mean, float& deviation)
+	{
+		float sum = 0;
+		float sumSquared = 0;
+		float count = 0;
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				if (x + dx < 0 || y + dy < 0 || x + dx >= (int)frame.Width || y + dy >= (int)frame.Height)
+					continue;
+				float value = frame.Color[(size_t)(y + dy) * frame.Width + x + dx].x;
+				sum += value;
+				sumSquared += value * value;
+				count++;
+			}
+		}
+		mean = sum / count;
+		deviation = std::sqrt(std::max(sumSquared / count - mean * mean, 0.0f));
+	}
+}
+
+// --------------------------------------------------------
+// TemporalReprojection on small known frames, for
+// Reproject.hlsl to stay in step with: history is blended
+// in by sample count, rejected where the depth or normal
+// doesn't match, and clipped to this frame's color box
+// --------------------------------------------------------
+
+TEST_CASE(WithoutHistoryNothingChanges)
+{
+	TestFrame frame(8, 8);
+	frame.Fill(Checkerboard, 4);
+
+	for (bool enabled : { true, false })
+	{
+		TestFrame history = frame;
+		TemporalSettings settings;
+		settings.Enabled = enabled;
+		Result result = Accumulate(frame, enabled ? 0 : &history, settings);
+		for (size_t i = 0; i < frame.Color.size(); i++)
+		{
+			CHECK_NEAR(result.Color[i].x, frame.Color[i].x, 1e-6f);
+			CHECK_EQUAL(result.Color[i].w, 4.0f);
+			CHECK_NEAR(result.Moments[i].y, frame.Moments[i].y, 1e-6f);
+		}
+	}
+}
+
+TEST_CASE(BlendsHistoryBySampleCount)
+{
+	TestFrame frame(8, 8);
+	frame.Fill(Checkerboard, 4);
+	TestFrame history(8, 8);
+	history.Fill([](unsigned int, unsigned int) { return 1.02f; }, 32);
+
+	// History is inside every pixel's box, and counts for
+	// at most 16 samples against this frame's 4
+	Result result = Accumulate(frame, &history);
+	for (size_t i = 0; i < frame.Color.size(); i++)
+	{
+		CHECK_NEAR(result.Color[i].x, (4 * frame.Color[i].x + 16 * 1.02f) / 20, 1e-5f);
+		CHECK_EQUAL(result.Color[i].w, 20.0f);
+		CHECK_NEAR(result.Moments[i].x, (4 * frame.Moments[i].x + 16 * history.Moments[i].x) / 20, 1e-5f);
+		CHECK_NEAR(result.Moments[i].y, (4 * frame.Moments[i].y + 16 * history.Moments[i].y) / 20, 1e-5f);
+	}
+
+	// A shorter cap, and history only as long as it has
+	TemporalSettings settings;
+	settings.MaxHistorySamples = 4;
+	CHECK_NEAR(Accumulate(frame, &history, settings).Color[0].x, (frame.Color[0].x + 1.02f) / 2, 1e-5f);
+	history.Fill([](unsigned int, unsigned int) { return 1.02f; }, 2);
+	CHECK_EQUAL(Accumulate(frame, &history).Color[0].w, 6.0f);
+}
+
+TEST_CASE(RejectsHistoryAtDifferentDepth)
+{
+	TestFrame frame(8, 8);
+	frame.Fill(Checkerboard, 4);
+	TestFrame history(8, 8);
+	history.Fill([](unsigned int, unsigned int) { return 1.02f; }, 16);
+
+	// Something closer covered the left half last frame
+	for (unsigned int i = 0; i < history.NormalDepth.size(); i++)
+	{
+		if (i % 8 < 4)
+			history.NormalDepth[i].w = 0.5f;
+	}
+
+	// Within tolerance on the right, a little farther away
+	for (unsigned int i = 0; i < frame.Motion.size(); i++)
+	{
+		if (i % 8 >= 4)
+			frame.Motion[i].z = 1.05f;
+	}
+
+	Result result = Accumulate(frame, &history);
+	for (size_t i = 0; i < frame.Color.size(); i++)
+	{
+		bool disoccluded = i % 8 < 4;
+		CHECK_EQUAL(result.Color[i].w, disoccluded ? 4.0f : 20.0f);
+		CHECK_NEAR(result.Color[i].x, disoccluded ? frame.Color[i].x : (4 * frame.Color[i].x + 16 * 1.02f) / 20, 1e-5f);
+	}
+}
+
+TEST_CASE(RejectsHistoryWithDifferentNormals)
+{
+	TestFrame frame(8, 8);
+	frame.Fill(Checkerboard, 4);
+	TestFrame history(8, 8);
+	history.Fill([](unsigned int, unsigned int) { return 1.02f; }, 16);
+
+	// The top half was a wall at right angles last frame, and
+	// the bottom half only slightly turned (cosine 0.95)
+	for (unsigned int i = 0; i < history.NormalDepth.size(); i++)
+	{
+		history.NormalDepth[i] = i / 8 < 4 ?
+			FilterFloat4{ 1, 0, 0, 1 } :
+			FilterFloat4{ std::sqrt(1 - 0.95f * 0.95f), 0, -0.95f, 1 };
+	}
+
+	Result result = Accumulate(frame, &history);
+	for (size_t i = 0; i < frame.Color.size(); i++)
+		CHECK_EQUAL(result.Color[i].w, i / 8 < 4 ? 4.0f : 20.0f);
+
+	// A stricter threshold rejects the bottom half too
+	TemporalSettings settings;
+	settings.NormalThreshold = 0.99f;
+	result = Accumulate(frame, &history, settings);
+	for (size_t i = 0; i < frame.Color.size(); i++)
+		CHECK_EQUAL(result.Color[i].w, 4.0f);
+}
+
+TEST_CASE(ReweightsTheBilinearTapsThatMatch)
+{
+	// Half way between two history pixels, only one of which
+	// saw the same surface: that one gets all the weight
+	TestFrame frame(8, 1);
+	frame.Fill(Checkerboard, 4);
+	for (FilterFloat4& motion : frame.Motion)
+		motion.x = -0.5f;
+
+	TestFrame history(8, 1);
+	history.Fill([](unsigned int x, unsigned int) { return x % 2 ? 1.05f : 0.95f; }, 16);
+	Result blended = Accumulate(frame, &history);
+	CHECK_NEAR(blended.Color[4].x, (4 * frame.Color[4].x + 16 * 1.0f) / 20, 1e-5f);
+
+	history.NormalDepth[3].w = 3;
+	Result reweighted = Accumulate(frame, &history);
+	CHECK_NEAR(reweighted.Color[4].x, (4 * frame.Color[4].x + 16 * 0.95f) / 20, 1e-5f);
+	CHECK_EQUAL(reweighted.Color[4].w, 20.0f);
+
+	// Off the left edge there's only one tap, and it's fine
+	CHECK_EQUAL(reweighted.Color[0].w, 20.0f);
+	CHECK_NEAR(reweighted.Color[0].x, (4 * frame.Color[0].x + 16 * 0.95f) / 20, 1e-5f);
+}
+
+TEST_CASE(FollowsMotionVectors)
+{
+	// Everything moved one pixel right, so each pixel's history
+	// is one to the left (and the left column is new)
+	TestFrame history(8, 4);
+	history.Fill([](unsigned int x, unsigned int y) { return Checkerboard(x, y) + 0.01f * x; }, 16);
+	TestFrame frame(8, 4);
+	frame.Fill([](unsigned int x, unsigned int y) { return Checkerboard(x + 1, y) + 0.01f * ((float)x - 1); }, 4);
+	for (FilterFloat4& motion : frame.Motion)
+		motion.x = -1;
+
+	Result result = Accumulate(frame, &history);
+	for (unsigned int y = 0; y < 4; y++)
+	{
+		for (unsigned int x = 0; x < 8; x++)
+		{
+			size_t index = (size_t)y * 8 + x;
+			CHECK_EQUAL(result.Color[index].w, x == 0 ? 4.0f : 20.0f);
+			CHECK_NEAR(result.Color[index].x, frame.Color[index].x, 1e-5f);
+		}
+	}
+}
+
+TEST_CASE(ClipsHistoryToTheBox)
+{
+	// Last frame the wall was lit much more brightly, and more
+	// red than anything else.  History is pulled back to the
+	// edge of the box around each pixel, in a straight line
+	// toward the box's center.
+	TestFrame frame(8, 8);
+	frame.Fill(Checkerboard, 4);
+	TestFrame history(8, 8);
+	history.Fill([](unsigned int, unsigned int) { return 10.0f; }, 16);
+	for (FilterFloat4& color : history.Color)
+		color.x = 30;
+
+	TemporalSettings settings;
+	Result result = Accumulate(frame, &history, settings);
+	for (int y = 0; y < 8; y++)
+	{
+		for (int x = 0; x < 8; x++)
+		{
+			float mean, deviation;
+			Neighborhood(frame, x, y, mean, deviation);
+			float extent = deviation * settings.ClipGamma;
+
+			// Red is farthest out, so it lands on the box's face
+			// and green and blue come in by the same proportion
+			float scale = extent / (30 - mean);
+			float red = mean + extent;
+			float green = mean + (10 - mean) * scale;
+
+			size_t index = (size_t)y * 8 + x;
+			CHECK_NEAR(result.Color[index].x, (4 * frame.Color[index].x + 16 * red) / 20, 1e-4f);
+			CHECK_NEAR(result.Color[index].y, (4 * frame.Color[index].y + 16 * green) / 20, 1e-4f);
+			CHECK_NEAR(result.Color[index].z, result.Color[index].y, 1e-6f);
+		}
+	}
+
+	// A bigger box lets more of the old lighting through
+	settings.ClipGamma = 3;
+	CHECK(Accumulate(frame, &history, settings).Color[27].x > result.Color[27].x);
+
+	// With no noise there's no box, and history can only agree
+	frame.Fill([](unsigned int, unsigned int) { return 1.0f; }, 4);
+	result = Accumulate(frame, &history);
+	CHECK_NEAR(result.Color[27].x, 1.0f, 1e-5f);
+	CHECK_EQUAL(result.Color[27].w, 20.0f);
+}
+
+TEST_CASE(WorksOnIllumination)
+{
+	// A texture that's the same in both frames, under lighting
+	// that's in the box: the texture isn't blended
+	TestFrame frame(8, 8);
+	TestFrame history(8, 8);
+	for (unsigned int i = 0; i < frame.Albedo.size(); i++)
+	{
+		float albedo = i % 3 ? 0.8f : 0.2f;
+		frame.Albedo[i] = history.Albedo[i] = FilterFloat4{ albedo, albedo, albedo, 1 };
+	}
+	frame.Fill([&](unsigned int x, unsigned int y) { return Checkerboard(x, y) * frame.Albedo[y * 8 + x].x; }, 4);
+	history.Fill([&](unsigned int x, unsigned int y) { return 1.0f * history.Albedo[y * 8 + x].x; }, 16);
+
+	Result result = Accumulate(frame, &history);
+	for (size_t i = 0; i < frame.Color.size(); i++)
+	{
+		float albedo = frame.Albedo[i].x;
+		float illumination = frame.Color[i].x / albedo;
+		CHECK_NEAR(result.Color[i].x, albedo * (4 * illumination + 16 * 1.0f) / 20, 1e-5f);
+	}
+
+	// And the sky (no normal) never takes history
+	for (unsigned int i = 0; i < 8; i++)
+		frame.NormalDepth[i] = FilterFloat4{ 0, 0, 0, 0 };
+	result = Accumulate(frame, &history);
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		CHECK_EQUAL(result.Color[i].w, 4.0f);
+		CHECK_NEAR(result.Color[i].x, frame.Color[i].x, 1e-6f);
+	}
+}
+
+TEST_CASE(MotionVectorsProjectWithLastFramesCamera)
+{
+	// An identity view-projection maps clip space straight to
+	// the screen: x from -1 to 1 across, y from 1 to -1 down
+	FilterFloat4x4 identity;
+	for (int i = 0; i < 4; i++)
+		identity.m[i][i] = 1;
+
+	FilterFloat4 motion = TemporalReprojection::MotionVector({ 10, 10 }, { 0.5f, 0.5f, 0.5f }, identity, { 0.5f, 0.5f, -1.5f }, 100, 50);
+	CHECK_NEAR(motion.x, 75 - 10, 1e-4f);
+	CHECK_NEAR(motion.y, 12.5f - 10, 1e-4f);
+	CHECK_NEAR(motion.z, 2.0f, 1e-6f);
+
+	// Points are row vectors, so translation is the last row
+	FilterFloat4x4 translation = identity;
+	translation.m[3][0] = 1;
+	translation.m[3][2] = -2;
+	FilterFloat3 previous = TemporalReprojection::PreviousPosition({ 1, 2, 3 }, translation);
+	CHECK_EQUAL(previous.x, 2.0f);
+	CHECK_EQUAL(previous.y, 2.0f);
+	CHECK_EQUAL(previous.z, 1.0f);
+
+	// Behind last frame's camera means off screen
+	FilterFloat4x4 flipped = identity;
+	flipped.m[3][3] = -1;
+	motion = TemporalReprojection::MotionVector({ 10, 10 }, { 0, 0, 0 }, flipped, { 0, 0, -1 }, 100, 50);
+	CHECK_EQUAL(motion.x, -1 - 10.0f);
+	CHECK_EQUAL(motion.y, -1 - 10.0f);
+
+	// The sky only moves when the camera turns, so with w taken
+	// from z (as a perspective projection does) straight ahead
+	// is the middle of the screen wherever the camera is
+	FilterFloat4x4 perspective = identity;
+	perspective.m[2][3] = 1;
+	perspective.m[3][3] = 0;
+	motion = TemporalReprojection::SkyMotionVector({ 50, 25 }, { 0, 0, 1 }, perspective, 100, 50);
+	CHECK_NEAR(motion.x, 0.0f, 1e-5f);
+	CHECK_NEAR(motion.y, 0.0f, 1e-5f);
+	CHECK_EQUAL(motion.z, 0.0f);
+}
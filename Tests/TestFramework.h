@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cmath>
+#include <sstream>
+#include <string>
+
+// --------------------------------------------------------
+// Just enough of a unit test framework for the parts of
+// the engine that don't touch the window or graphics API,
+// so they can be tested on any platform (see the
+// CMakeLists.txt at the root of the repo).
+//
+// Each test file becomes its own executable, linked with
+// TestMain.cpp, which runs every TEST_CASE in it (or only
+// those whose names contain the first argument) and exits
+// with a non-zero code if any check failed.
+//
+// CHECK macros report the failure and keep going, while
+// REQUIRE macros also end the current test case.
+// --------------------------------------------------------
+namespace TestFramework
+{
+	typedef void (*TestFunction)();
+
+	// Adds a test case to the list RunAll() goes through
+	struct Registration
+	{
+		Registration(const char* name, TestFunction function);
+	};
+
+	// Thrown by REQUIRE macros to end the current test case
+	struct AbortTest {};
+
+	void ReportFailure(const char* file, int line, const std::string& message);
+	int RunAll(int argc, char** argv);
+
+	template<typename A, typename B>
+	std::string DescribeMismatch(const char* expression, const A& actual, const B& expected)
+	{
+		std::ostringstream text;
+		text << expression << " (got " << actual << ", expected " << expected << ")";
+		return text.str();
+	}
+}
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static TestFramework::Registration name##Registration(#name, name); \
+	static void name()
+
+#define CHECK(expression) \
+	do { if (!(expression)) TestFramework::ReportFailure(__FILE__, __LINE__, #expression); } while (0)
+
+#define CHECK_EQUAL(actual, expected) \
+	do { \
+		auto checkActual = (actual); auto checkExpected = (expected); \
+		if (!(checkActual == checkExpected)) \
+			TestFramework::ReportFailure(__FILE__, __LINE__, TestFramework::DescribeMismatch(#actual " == " #expected, checkActual, checkExpected)); \
+	} while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+	do { \
+		double checkActual = (double)(actual); double checkExpected = (double)(expected); \
+		if (!(std::abs(checkActual - checkExpected) <= (double)(tolerance))) \
+			TestFramework::ReportFailure(__FILE__, __LINE__, TestFramework::DescribeMismatch(#actual " ~= " #expected, checkActual, checkExpected)); \
+	} while (0)
+
+#define REQUIRE(expression) \
+	do { if (!(expression)) { TestFramework::ReportFailure(__FILE__, __LINE__, #expression); throw TestFramework::AbortTest(); } } while (0)
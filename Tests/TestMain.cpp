@@ -0,0 +1,83 @@
+#include "TestFramework.h"
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <vector>
+
+// Annonymous namespace to hold variables
+// only accessible in this file
+namespace
+{
+	struct TestCase
+	{
+		const char* Name;
+		TestFramework::TestFunction Function;
+	};
+
+	// Built up by static Registrations, so it can't be a plain
+	// global (which may not be constructed before they run)
+	std::vector<TestCase>& GetTestCases()
+	{
+		static std::vector<TestCase> testCases;
+		return testCases;
+	}
+
+	unsigned int currentFailures = 0;
+}
+
+TestFramework::Registration::Registration(const char* name, TestFunction function)
+{
+	GetTestCases().push_back({ name, function });
+}
+
+void TestFramework::ReportFailure(const char* file, int line, const std::string& message)
+{
+	printf("  %s(%d): FAILED %s\n", file, line, message.c_str());
+	currentFailures++;
+}
+
+// --------------------------------------------------------
+// Runs every registered test case (or only the ones whose
+// names contain the filter), returning the process exit
+// code: zero if everything passed
+// --------------------------------------------------------
+int TestFramework::RunAll(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : 0;
+	unsigned int run = 0;
+	unsigned int failed = 0;
+
+	for (const TestCase& test : GetTestCases())
+	{
+		if (filter && !strstr(test.Name, filter))
+			continue;
+
+		printf("%s\n", test.Name);
+		currentFailures = 0;
+		try
+		{
+			test.Function();
+		}
+		catch (const AbortTest&)
+		{
+			// Already reported
+		}
+		catch (const std::exception& e)
+		{
+			ReportFailure(__FILE__, __LINE__, std::string("unexpected exception: ") + e.what());
+		}
+
+		run++;
+		if (currentFailures > 0)
+			failed++;
+	}
+
+	printf("%u of %u test cases passed\n", run - failed, run);
+	return failed == 0 && run > 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	return TestFramework::RunAll(argc, argv);
+}
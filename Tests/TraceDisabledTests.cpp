@@ -0,0 +1,43 @@
+#include "TestFramework.h"
+
+// Built the way a project with tracing turned off would be
+#define TRACING_ENABLED 0
+#include "Trace.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Turns a macro's expansion into a string
+#define TRACE_TEST_STRING_INNER(x) #x
+#define TRACE_TEST_STRING(x) TRACE_TEST_STRING_INNER(x)
+
+	// Nothing at all is left of a zone
+	static_assert(sizeof(TRACE_TEST_STRING(TRACE_ZONE("Zone"))) == 1, "TRACE_ZONE() should compile to nothing");
+}
+
+// --------------------------------------------------------
+// Trace with TRACING_ENABLED set to 0 (in this file), where
+// zones shouldn't be compiled in at all
+// --------------------------------------------------------
+
+TEST_CASE(ZonesAreCompiledOut)
+{
+	for (int i = 0; i < 100; i++)
+	{
+		TRACE_ZONE("Disabled Zone");
+	}
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "TraceDisabledTests.json";
+	REQUIRE(Trace::Flush(path.wstring()));
+	std::ifstream file(path);
+	std::stringstream text;
+	text << file.rdbuf();
+	CHECK(text.str().find("Disabled Zone") == std::string::npos);
+	CHECK_EQUAL(Trace::GetDroppedEventCount(), 0u);
+}
@@ -0,0 +1,113 @@
+#include "TestFramework.h"
+#include "Trace.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Flushes to a file in the temp directory and reads it back
+	std::string FlushToString()
+	{
+		std::filesystem::path path = std::filesystem::temp_directory_path() / "TraceTests.json";
+		REQUIRE(Trace::Flush(path.wstring()));
+
+		std::ifstream file(path);
+		std::stringstream text;
+		text << file.rdbuf();
+		return text.str();
+	}
+
+	// How many times a zone shows up in a trace file
+	unsigned int CountZones(const std::string& trace, const std::string& name)
+	{
+		std::string pattern = "{\"name\":\"" + name + "\",\"ph\":\"X\"";
+		unsigned int count = 0;
+		for (size_t at = trace.find(pattern); at != std::string::npos; at = trace.find(pattern, at + 1))
+			count++;
+		return count;
+	}
+
+	std::vector<ProfileZone> GPUZones(const char* name, unsigned int count)
+	{
+		std::vector<ProfileZone> zones(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			zones[i].Name = name;
+			zones[i].StartMs = i;
+			zones[i].DurationMs = 0.5;
+			zones[i].GPU = true;
+		}
+		return zones;
+	}
+}
+
+// --------------------------------------------------------
+// Trace, flushed to temp files: each flush writes what was
+// recorded since the last one, and recording more than the
+// buffers hold between flushes drops events rather than
+// using more memory
+// --------------------------------------------------------
+
+TEST_CASE(FlushWritesEachEventOnce)
+{
+	FlushToString();
+
+	for (int i = 0; i < 3; i++)
+	{
+		TRACE_ZONE("CPU Zone");
+	}
+	Trace::RecordGPUZones(GPUZones("GPU Zone", 2));
+
+	std::string first = FlushToString();
+	CHECK_EQUAL(CountZones(first, "CPU Zone"), 3u);
+	CHECK_EQUAL(CountZones(first, "GPU Zone"), 2u);
+	CHECK(first.find("\"pid\":2,\"tid\":0") != std::string::npos);
+
+	// Already written, so the next file doesn't have them
+	Trace::RecordGPUZones(GPUZones("Later GPU Zone", 1));
+	std::string second = FlushToString();
+	CHECK_EQUAL(CountZones(second, "CPU Zone"), 0u);
+	CHECK_EQUAL(CountZones(second, "GPU Zone"), 0u);
+	CHECK_EQUAL(CountZones(second, "Later GPU Zone"), 1u);
+}
+
+TEST_CASE(GPUZonesAreBoundedBetweenFlushes)
+{
+	FlushToString();
+	unsigned int dropped = Trace::GetDroppedEventCount();
+
+	// A long session without a flush: one more frame of
+	// zones than fits, which is dropped and counted
+	const unsigned int zonesPerFrame = 64;
+	const unsigned int frames = Trace::EventsPerThread / zonesPerFrame;
+	for (unsigned int frame = 0; frame <= frames; frame++)
+		Trace::RecordGPUZones(GPUZones("Frame Zone", zonesPerFrame));
+	CHECK_EQUAL(Trace::GetDroppedEventCount() - dropped, zonesPerFrame);
+
+	std::string trace = FlushToString();
+	CHECK_EQUAL(CountZones(trace, "Frame Zone"), Trace::EventsPerThread);
+
+	// Flushing makes room again
+	Trace::RecordGPUZones(GPUZones("Frame Zone", zonesPerFrame));
+	CHECK_EQUAL(Trace::GetDroppedEventCount() - dropped, zonesPerFrame);
+	CHECK_EQUAL(CountZones(FlushToString(), "Frame Zone"), zonesPerFrame);
+}
+
+TEST_CASE(CPUZonesAreBoundedBetweenFlushes)
+{
+	FlushToString();
+	unsigned int dropped = Trace::GetDroppedEventCount();
+
+	for (unsigned int i = 0; i < Trace::EventsPerThread + 10; i++)
+	{
+		TRACE_ZONE("Busy Zone");
+	}
+	CHECK_EQUAL(Trace::GetDroppedEventCount() - dropped, 10u);
+	CHECK_EQUAL(CountZones(FlushToString(), "Busy Zone"), Trace::EventsPerThread);
+}
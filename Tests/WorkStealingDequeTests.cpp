@@ -0,0 +1,226 @@
+#include "TestFramework.h"
+#include "WorkStealingDeque.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	const unsigned int ThiefCount = 3;
+
+	// How many times each item was taken, by anyone
+	struct TakenCounts
+	{
+		std::unique_ptr<std::atomic<unsigned int>[]> Counts;
+		unsigned int Size;
+
+		TakenCounts(unsigned int size) : Counts(new std::atomic<unsigned int>[size]), Size(size)
+		{
+			for (unsigned int i = 0; i < size; i++)
+				Counts[i] = 0;
+		}
+
+		void Take(unsigned int item) { Counts[item].fetch_add(1, std::memory_order_relaxed); }
+
+		// Every item taken exactly once?
+		bool AllOnce() const
+		{
+			for (unsigned int i = 0; i < Size; i++)
+			{
+				if (Counts[i].load() != 1)
+					return false;
+			}
+			return true;
+		}
+	};
+
+	// Thieves that steal until told to stop, and then keep
+	// going until the deque is empty
+	template<typename Deque>
+	std::vector<std::thread> StartThieves(Deque& deque, TakenCounts& taken, std::atomic<bool>& stop, std::atomic<unsigned int>& stolen)
+	{
+		std::vector<std::thread> thieves;
+		for (unsigned int i = 0; i < ThiefCount; i++)
+		{
+			thieves.emplace_back([&]()
+			{
+				unsigned int item = 0;
+				while (!stop.load() || deque.GetSize() > 0)
+				{
+					if (deque.Steal(item))
+					{
+						taken.Take(item);
+						stolen.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+			});
+		}
+		return thieves;
+	}
+}
+
+// --------------------------------------------------------
+// WorkStealingDeque, on one thread and then with thieves
+// racing the owner, especially over the last item
+// --------------------------------------------------------
+
+TEST_CASE(OwnerTakesNewestThievesTakeOldest)
+{
+	WorkStealingDeque<unsigned int, 8> deque;
+	for (unsigned int i = 1; i <= 4; i++)
+		REQUIRE(deque.Push(i));
+	CHECK_EQUAL(deque.GetSize(), 4u);
+
+	unsigned int item = 0;
+	CHECK(deque.Pop(item) && item == 4);
+	CHECK(deque.Steal(item) && item == 1);
+	CHECK(deque.Pop(item) && item == 3);
+	CHECK(deque.Steal(item) && item == 2);
+
+	CHECK(!deque.Pop(item));
+	CHECK(!deque.Steal(item));
+	CHECK_EQUAL(deque.GetSize(), 0u);
+}
+
+TEST_CASE(FullDequesRejectPushes)
+{
+	WorkStealingDeque<unsigned int, 8> deque;
+	for (unsigned int i = 0; i < 8; i++)
+		REQUIRE(deque.Push(i));
+	CHECK(!deque.Push(8));
+
+	// Stealing frees up the slot at the top
+	unsigned int item = 0;
+	CHECK(deque.Steal(item) && item == 0);
+	CHECK(deque.Push(8));
+	CHECK(!deque.Push(9));
+	CHECK(deque.Pop(item) && item == 8);
+}
+
+TEST_CASE(WrapsAroundTheRing)
+{
+	// Many times round, with the items straddling the wrap point
+	WorkStealingDeque<unsigned int, 4> deque;
+	bool inOrder = true;
+	for (unsigned int i = 0; i < 1000; i++)
+	{
+		deque.Push(i * 3);
+		deque.Push(i * 3 + 1);
+		deque.Push(i * 3 + 2);
+
+		unsigned int a = 0, b = 0, c = 0;
+		inOrder = inOrder && deque.Steal(a) && deque.Pop(b) && deque.Pop(c);
+		inOrder = inOrder && a == i * 3 && b == i * 3 + 2 && c == i * 3 + 1;
+	}
+	CHECK(inOrder);
+	CHECK_EQUAL(deque.GetSize(), 0u);
+}
+
+TEST_CASE(PoppingAnEmptyDequeLeavesItUsable)
+{
+	WorkStealingDeque<unsigned int, 4> deque;
+	unsigned int item = 0;
+	for (int i = 0; i < 10; i++)
+		CHECK(!deque.Pop(item));
+	CHECK_EQUAL(deque.GetSize(), 0u);
+
+	CHECK(deque.Push(7));
+	CHECK(deque.Steal(item) && item == 7);
+	CHECK(!deque.Pop(item));
+	CHECK(deque.Push(8));
+	CHECK(deque.Pop(item) && item == 8);
+}
+
+TEST_CASE(EveryItemIsTakenOnceWhileThievesSteal)
+{
+	// The owner pushes in bursts, popping some back as it goes,
+	// and pops whenever the deque fills up
+	const unsigned int itemCount = 200000;
+	WorkStealingDeque<unsigned int, 256> deque;
+	TakenCounts taken(itemCount);
+	std::atomic<bool> stop{ false };
+	std::atomic<unsigned int> stolen{ 0 };
+	std::vector<std::thread> thieves = StartThieves(deque, taken, stop, stolen);
+
+	unsigned int popped = 0;
+	unsigned int item = 0;
+	for (unsigned int i = 0; i < itemCount; i++)
+	{
+		while (!deque.Push(i))
+		{
+			if (deque.Pop(item))
+			{
+				taken.Take(item);
+				popped++;
+			}
+		}
+
+		if (i % 3 == 0 && deque.Pop(item))
+		{
+			taken.Take(item);
+			popped++;
+		}
+	}
+
+	// Race the thieves for whatever's left
+	while (deque.GetSize() > 0)
+	{
+		if (deque.Pop(item))
+		{
+			taken.Take(item);
+			popped++;
+		}
+	}
+
+	stop = true;
+	for (std::thread& thief : thieves)
+		thief.join();
+
+	CHECK_EQUAL(popped + stolen.load(), itemCount);
+	CHECK(taken.AllOnce());
+	CHECK_EQUAL(deque.GetSize(), 0u);
+}
+
+TEST_CASE(TheLastItemGoesToExactlyOneThread)
+{
+	// Only ever one item in the deque, so every pop races every
+	// steal through the compare-exchange on top
+	const unsigned int itemCount = 100000;
+	WorkStealingDeque<unsigned int, 4> deque;
+	TakenCounts taken(itemCount);
+	std::atomic<bool> stop{ false };
+	std::atomic<unsigned int> stolen{ 0 };
+	std::vector<std::thread> thieves = StartThieves(deque, taken, stop, stolen);
+
+	unsigned int popped = 0;
+	unsigned int item = 0;
+	for (unsigned int i = 0; i < itemCount; i++)
+	{
+		REQUIRE(deque.Push(i));
+		if (deque.Pop(item))
+		{
+			CHECK_EQUAL(item, i);
+			taken.Take(item);
+			popped++;
+		}
+
+		// Lost or not, the deque is empty again either way
+		CHECK(!deque.Pop(item));
+	}
+
+	stop = true;
+	for (std::thread& thief : thieves)
+		thief.join();
+
+	CHECK_EQUAL(popped + stolen.load(), itemCount);
+	CHECK(taken.AllOnce());
+
+	// Who wins depends on scheduling (a single core may never let
+	// a thief in), but the deque works either way afterwards
+	CHECK(deque.Push(1));
+	CHECK_EQUAL(deque.GetSize(), 1u);
+}
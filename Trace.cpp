@@ -0,0 +1,357 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace Trace
+{
+	// Annonymous namespace to hold variables
+	// only accessible in this file
+	namespace
+	{
+		// A single completed zone
+		struct Event
+		{
+			const char* Name;
+			uint64_t Start;
+			uint64_t End;
+		};
+
+		// --------------------------------------------------------
+		// Events from a single thread.  The owning thread is the
+		// only writer and Flush() is the only reader, so the two
+		// counters are all the synchronization needed.
+		// --------------------------------------------------------
+		struct ThreadBuffer
+		{
+			Event Events[EventsPerThread];
+			std::atomic<uint64_t> WriteCount{ 0 };
+			std::atomic<uint64_t> ReadCount{ 0 };
+			std::atomic<unsigned int> Dropped{ 0 };
+			unsigned int ThreadID = 0;
+			std::string Name;
+		};
+
+		// Every thread's buffer.  Buffers outlive their threads so
+		// events from threads that have exited can still be written.
+		std::vector<std::shared_ptr<ThreadBuffer>> threadBuffers;
+		std::mutex threadBuffersLock;
+		unsigned int nextThreadID = 1;
+
+		// This thread's buffer, created on first use
+		thread_local ThreadBuffer* currentThreadBuffer = 0;
+
+		// A zone ready to be written, on steady_clock time
+		struct FlushedEvent
+		{
+			std::string Name;
+			double StartUs;
+			double DurationUs;
+			unsigned int ThreadID;
+			bool GPU;
+		};
+
+		// --------------------------------------------------------
+		// Resolved GPU zones, which arrive once a frame from the
+		// GPUProfiler.  Bounded the same way as a thread's buffer
+		// (new zones are dropped once it's full), and allocated on
+		// first use.  The strings keep their capacity as slots are
+		// reused, so recording doesn't allocate once it's warm.
+		// --------------------------------------------------------
+		std::vector<FlushedEvent> gpuEvents;
+		uint64_t gpuWriteCount = 0;
+		uint64_t gpuReadCount = 0;
+		unsigned int gpuDropped = 0;
+		std::mutex gpuLock;
+
+		// Only one flush at a time
+		std::mutex flushLock;
+
+		// --------------------------------------------------------
+		// Creates and registers a buffer for the calling thread
+		// --------------------------------------------------------
+		ThreadBuffer* CreateThreadBuffer()
+		{
+			std::shared_ptr<ThreadBuffer> buffer = std::make_shared<ThreadBuffer>();
+
+			std::lock_guard<std::mutex> lock(threadBuffersLock);
+			buffer->ThreadID = nextThreadID++;
+			buffer->Name = "Thread " + std::to_string(buffer->ThreadID);
+			threadBuffers.push_back(buffer);
+			return buffer.get();
+		}
+
+		ThreadBuffer* GetThreadBuffer()
+		{
+			if (!currentThreadBuffer)
+				currentThreadBuffer = CreateThreadBuffer();
+			return currentThreadBuffer;
+		}
+
+		// A raw timestamp and steady_clock time taken together
+		struct ClockSample
+		{
+			uint64_t Timestamp;
+			double SteadyNs;
+
+			static ClockSample Take()
+			{
+				ClockSample sample;
+				sample.Timestamp = Now();
+				sample.SteadyNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()).count();
+				return sample;
+			}
+		};
+
+		// Taken at startup, and paired with a second sample at each
+		// flush to work out how raw timestamps map to real time
+		ClockSample startupSample = ClockSample::Take();
+
+		// --------------------------------------------------------
+		// Converts raw timestamps to steady_clock microseconds
+		// using two samples of both clocks
+		// --------------------------------------------------------
+		struct TimestampConverter
+		{
+			ClockSample Base;
+			double NsPerTick;
+
+			TimestampConverter(const ClockSample& first, const ClockSample& second) : Base(first)
+			{
+#if defined(TRACE_USE_TSC)
+				uint64_t ticks = second.Timestamp - first.Timestamp;
+				NsPerTick = ticks > 0 ? (second.SteadyNs - first.SteadyNs) / ticks : 1.0;
+#else
+				NsPerTick = 1.0;
+#endif
+			}
+
+			double ToUs(uint64_t timestamp) const
+			{
+				double ticks = (double)(int64_t)(timestamp - Base.Timestamp);
+				return (Base.SteadyNs + ticks * NsPerTick) / 1000.0;
+			}
+		};
+
+		// Escapes the few characters that would break a JSON string
+		std::string EscapeJSON(const std::string& text)
+		{
+			std::string escaped;
+			for (char c : text)
+			{
+				if (c == '"' || c == '\\')
+					escaped += '\\';
+				escaped += c;
+			}
+			return escaped;
+		}
+	}
+}
+
+
+// --------------------------------------------------------
+// Adds a finished zone to the calling thread's buffer, or
+// drops it if the buffer hasn't been drained in time
+// --------------------------------------------------------
+void Trace::RecordZone(const char* name, uint64_t start, uint64_t end)
+{
+	ThreadBuffer* buffer = GetThreadBuffer();
+
+	uint64_t write = buffer->WriteCount.load(std::memory_order_relaxed);
+	if (write - buffer->ReadCount.load(std::memory_order_acquire) >= EventsPerThread)
+	{
+		buffer->Dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	Event& e = buffer->Events[write % EventsPerThread];
+	e.Name = name;
+	e.Start = start;
+	e.End = end;
+
+	// Publish to Flush()
+	buffer->WriteCount.store(write + 1, std::memory_order_release);
+}
+
+// --------------------------------------------------------
+// Adds already-resolved GPU zones to the trace.  These are
+// rare enough that they skip the per-thread buffers (and
+// share a lock instead), but are dropped in the same way
+// if they aren't flushed in time.
+// --------------------------------------------------------
+void Trace::RecordGPUZones(const std::vector<ProfileZone>& zones)
+{
+#if TRACING_ENABLED
+	std::lock_guard<std::mutex> lock(gpuLock);
+	if (gpuEvents.empty())
+		gpuEvents.resize(EventsPerThread);
+
+	for (const ProfileZone& zone : zones)
+	{
+		if (gpuWriteCount - gpuReadCount >= EventsPerThread)
+		{
+			gpuDropped++;
+			continue;
+		}
+
+		FlushedEvent& e = gpuEvents[gpuWriteCount++ % EventsPerThread];
+		e.Name.assign(zone.Name);
+		e.StartUs = zone.StartMs * 1000.0;
+		e.DurationUs = zone.DurationMs * 1000.0;
+		e.ThreadID = 0;
+		e.GPU = true;
+	}
+#endif
+}
+
+void Trace::SetThreadName(const char* name)
+{
+	ThreadBuffer* buffer = GetThreadBuffer();
+
+	std::lock_guard<std::mutex> lock(threadBuffersLock);
+	buffer->Name = name;
+}
+
+// --------------------------------------------------------
+// Drains every thread's buffer (and the GPU zones) and
+// writes the events recorded since the last flush as a
+// Chrome trace JSON file.  Drained events are gone even if
+// the file can't be written.
+// --------------------------------------------------------
+bool Trace::Flush(const std::wstring& path)
+{
+	std::lock_guard<std::mutex> lock(flushLock);
+	std::vector<FlushedEvent> flushedEvents;
+
+	// Grab a copy of the list so threads can keep registering
+	std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+	{
+		std::lock_guard<std::mutex> buffersLock(threadBuffersLock);
+		buffers = threadBuffers;
+	}
+
+	// Move everything published so far out of the buffers
+	TimestampConverter converter(startupSample, ClockSample::Take());
+	for (std::shared_ptr<ThreadBuffer>& buffer : buffers)
+	{
+		uint64_t read = buffer->ReadCount.load(std::memory_order_relaxed);
+		uint64_t write = buffer->WriteCount.load(std::memory_order_acquire);
+		for (; read < write; read++)
+		{
+			const Event& e = buffer->Events[read % EventsPerThread];
+			double startUs = converter.ToUs(e.Start);
+			flushedEvents.push_back({
+				e.Name,
+				startUs,
+				converter.ToUs(e.End) - startUs,
+				buffer->ThreadID,
+				false });
+		}
+
+		// Let the thread reuse the space
+		buffer->ReadCount.store(write, std::memory_order_release);
+	}
+	{
+		std::lock_guard<std::mutex> gpuEventsLock(gpuLock);
+		for (; gpuReadCount < gpuWriteCount; gpuReadCount++)
+			flushedEvents.push_back(gpuEvents[gpuReadCount % EventsPerThread]);
+	}
+
+	std::ofstream file(std::filesystem::path{ path });
+	if (!file.is_open())
+		return false;
+
+	file.precision(15);
+	file << "{\"traceEvents\":[\n";
+
+	// Name the processes and threads
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"GPU\"}}";
+	{
+		std::lock_guard<std::mutex> buffersLock(threadBuffersLock);
+		for (std::shared_ptr<ThreadBuffer>& buffer : buffers)
+		{
+			file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->ThreadID <<
+				",\"args\":{\"name\":\"" << EscapeJSON(buffer->Name) << "\"}}";
+		}
+	}
+
+	// Every zone as a "complete" event
+	for (const FlushedEvent& e : flushedEvents)
+	{
+		file << ",\n{\"name\":\"" << EscapeJSON(e.Name) <<
+			"\",\"ph\":\"X\",\"pid\":" << (e.GPU ? 2 : 1) <<
+			",\"tid\":" << e.ThreadID <<
+			",\"ts\":" << e.StartUs <<
+			",\"dur\":" << e.DurationUs << "}";
+	}
+
+	file << "\n]}\n";
+	return file.good();
+}
+
+// --------------------------------------------------------
+// Total events thrown away because a thread's buffer (or
+// the GPU zones' buffer) was full, across all threads
+// --------------------------------------------------------
+unsigned int Trace::GetDroppedEventCount()
+{
+	std::lock_guard<std::mutex> lock(threadBuffersLock);
+
+	unsigned int dropped = 0;
+	for (std::shared_ptr<ThreadBuffer>& buffer : threadBuffers)
+		dropped += buffer->Dropped.load(std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> gpuEventsLock(gpuLock);
+	return dropped + gpuDropped;
+}
+
+// --------------------------------------------------------
+// Measures the average cost of a TRACE_ZONE() by timing
+// many empty zones on a separate thread.  That thread's
+// buffer is thrown away afterwards so the benchmark doesn't
+// end up in the trace.  Returns nanoseconds per zone.
+// --------------------------------------------------------
+double Trace::MeasureZoneOverhead(unsigned int iterations)
+{
+	// Stay within a single buffer so we never measure dropped events
+	iterations = std::min(iterations, EventsPerThread);
+	if (iterations == 0)
+		return 0;
+
+	double nsPerZone = 0;
+	ThreadBuffer* benchmarkBuffer = 0;
+	std::thread benchmark([&]()
+		{
+			benchmarkBuffer = GetThreadBuffer();
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (unsigned int i = 0; i < iterations; i++)
+			{
+				TRACE_ZONE("Overhead Benchmark");
+			}
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+			nsPerZone = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+		});
+	benchmark.join();
+
+	// Forget the benchmark thread's events
+	std::lock_guard<std::mutex> lock(threadBuffersLock);
+	for (auto it = threadBuffers.begin(); it != threadBuffers.end(); it++)
+	{
+		if (it->get() == benchmarkBuffer)
+		{
+			threadBuffers.erase(it);
+			break;
+		}
+	}
+
+	return nsPerZone;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define TRACE_USE_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_USE_TSC 1
+#endif
+
+#include "ProfileZones.h"
+
+// Set to 0 (for instance, in the project's preprocessor
+// definitions) to compile all TRACE_ZONE()s out entirely
+#ifndef TRACING_ENABLED
+#define TRACING_ENABLED 1
+#endif
+
+// --------------------------------------------------------
+// Records timed zones from any thread and writes them out
+// in the Chrome trace event format, which can be opened in
+// chrome://tracing or Perfetto.
+//
+// Each thread writes into its own fixed-size ring without
+// locking.  Flush() drains every ring into one list and
+// writes it to disk, so each file covers the time since the
+// last flush.  If a thread records faster than the rings
+// are drained, new events are dropped (and counted) rather
+// than blocking, so memory use never grows.
+//
+// Zones are timed with the CPU's timestamp counter where
+// available, since it's far cheaper to read than the OS
+// clock, and converted to steady_clock time when flushed.
+//
+// GPU zones from the GPUProfiler are added on a separate
+// track, since they share the CPU's clock, and are held in
+// a ring of the same size.
+// --------------------------------------------------------
+namespace Trace
+{
+	// --- CONSTANTS ---
+	// Events each thread (and the GPU) can hold between flushes
+	const unsigned int EventsPerThread = 1 << 16;
+
+	// --- FUNCTIONS ---
+	// Raw timestamp used by zones (TSC ticks, or steady_clock
+	// nanoseconds on platforms without a TSC)
+	inline uint64_t Now()
+	{
+#if defined(TRACE_USE_TSC)
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	// Lower level recording (the macro below is easier)
+	void RecordZone(const char* name, uint64_t start, uint64_t end);
+	void RecordGPUZones(const std::vector<ProfileZone>& zones);
+
+	// Shows up as the thread's name in the trace viewer
+	void SetThreadName(const char* name);
+
+	// Writes everything recorded since the last flush to a trace file
+	bool Flush(const std::wstring& path);
+	unsigned int GetDroppedEventCount();
+
+	// Average cost of a single zone, in nanoseconds
+	double MeasureZoneOverhead(unsigned int iterations = 100000);
+
+	// Times the enclosing scope.  The name must outlive
+	// the trace, so string literals are the best option.
+	class ScopedZone
+	{
+	public:
+		ScopedZone(const char* name) : name(name), start(Now()) {}
+		~ScopedZone() { RecordZone(name, start, Now()); }
+		ScopedZone(const ScopedZone&) = delete;
+		ScopedZone& operator=(const ScopedZone&) = delete;
+
+	private:
+		const char* name;
+		uint64_t start;
+	};
+}
+
+// Times the rest of the enclosing scope
+#if TRACING_ENABLED
+#define TRACE_ZONE_CONCAT_INNER(a, b) a##b
+#define TRACE_ZONE_CONCAT(a, b) TRACE_ZONE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) Trace::ScopedZone TRACE_ZONE_CONCAT(traceZone, __LINE__)(name)
+#else
+#define TRACE_ZONE(name)
+#endif
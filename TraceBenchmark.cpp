@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Trace.h"
+
+// Annonymous namespace to hold helpers
+// only accessible in this file
+namespace
+{
+	// Times the measurement is run, keeping the fastest
+	const int Repeats = 5;
+}
+
+// --------------------------------------------------------
+// Measures what a TRACE_ZONE() costs, and fails if it's
+// over budget.  Built by CMakeLists.txt (optimized, unlike
+// the measurement printed by the game's debug builds).
+//
+// Usage: TraceBenchmark [-iterations N] [-max-ns N]
+// --------------------------------------------------------
+int main(int argc, char** argv)
+{
+	unsigned int iterations = Trace::EventsPerThread;
+	unsigned int maxNs = 50;
+	for (int i = 1; i < argc; i++)
+	{
+		unsigned int* option = 0;
+		if (strcmp(argv[i], "-iterations") == 0) option = &iterations;
+		else if (strcmp(argv[i], "-max-ns") == 0) option = &maxNs;
+
+		if (!option || i + 1 >= argc || atoi(argv[i + 1]) <= 0)
+		{
+			printf("Usage: %s [-iterations N] [-max-ns N]\n", argv[0]);
+			return 1;
+		}
+		*option = (unsigned int)atoi(argv[++i]);
+	}
+
+	double best = 0;
+	for (int repeat = 0; repeat < Repeats; repeat++)
+	{
+		double ns = Trace::MeasureZoneOverhead(iterations);
+		best = repeat == 0 ? ns : std::min(best, ns);
+	}
+
+	printf("Trace zone overhead: %.1f ns (budget %u ns)\n", best, maxNs);
+	if (best > maxNs)
+	{
+		printf("FAILED: over budget\n");
+		return 1;
+	}
+	return 0;
+}
@@ -1,6 +1,10 @@
 
 #include "Window.h"
 #include "Graphics.h"
+#include "GPUMemory.h"
+#include "RayTracing.h"
+#include "Denoiser.h"
+#include "GPUProfiler.h"
 #include "Input.h"
 
 #include <sstream>
@@ -32,6 +36,90 @@ namespace Window
 		float fpsTimeElapsed = 0.0f;
 		__int64 fpsFrameCounter = 0;
 
+		// Whether the rest of the stats go to the console
+		bool detailedStats = false;
+
+		// --------------------------------------------------------
+		// Prints everything that doesn't fit in the title bar to
+		// the console, covering the last second:
+		//  - The average GPU time of each profiler zone
+		//  - How well the CPU and GPU are overlapping
+		//  - Input latency and frame pacing
+		//  - Path tracing convergence, rays and denoising cost
+		//  - Video memory and acceleration structure usage
+		// --------------------------------------------------------
+		void PrintDetailedStats(float elapsed)
+		{
+			std::wostringstream output;
+			output.precision(3);
+			output << "\n--- Stats for the last " << elapsed << "s ---\n";
+
+			// Average GPU time of each zone
+			output << "GPU:";
+			double denoiseMs = 0;
+			for (const ZoneTimingStats& zone : GPUProfiler::GetZoneStats())
+			{
+				output << " " << std::wstring(zone.Name.begin(), zone.Name.end()) << " " << zone.AverageMs() << "ms";
+				if (zone.Name == "Denoise")
+					denoiseMs = zone.AverageMs();
+			}
+			output << "\n";
+
+			// Is the CPU keeping the GPU fed?
+			FrameSchedulerStats scheduler = Graphics::GetFrameSchedulerStats();
+			output <<
+				"Frames In Flight: " << scheduler.FramesInFlight <<
+				" (GPU busy " << scheduler.GPUUtilization() * 100.0 << "%, idle gap " << scheduler.AverageGPUIdleMs() << "ms" <<
+				", starved " << scheduler.StarvedFrames <<
+				", CPU wait " << scheduler.AverageCPUWaitMs() << "ms)\n";
+
+			// How stale is the input by the time the GPU finishes with it?
+			FramePacerStats pacer = Graphics::GetFramePacerStats();
+			output <<
+				"Latency: " << pacer.AverageLatencyMs() << "ms (max " << pacer.MaxLatencyMs << "ms" <<
+				", pacing " << (Graphics::GetFramePacing() ? "on" : "off") <<
+				", sleep " << pacer.AverageSleepMs() << "ms)\n";
+
+			// How converged is the path traced image?
+			output << "Samples: " << RayTracing::Accumulation.GetAccumulatedSampleCount();
+			if (!RayTracing::Accumulation.GetEnabled())
+				output << " (accumulation off)";
+			if (RayTracing::AdaptiveSampling.GetSettings().Enabled && RayTracing::AdaptiveSampling.GetPixelCount() > 0)
+				output << " (" << 100 * RayTracing::AdaptiveSampling.GetLastActivePixelCount() / RayTracing::AdaptiveSampling.GetPixelCount() << "% active)";
+			output << " " << (RayTracing::Sampler == PathSampler::SamplerType::Sobol ? "Sobol" : "PCG");
+			if (RayTracing::BlueNoiseOffsets)
+				output << "+BlueNoise";
+			output << "\n";
+
+			// How much tracing work is that taking?
+			PathTracingStats paths = RayTracing::GetPathTracingStats();
+			output <<
+				"Rays: " << paths.RayCount / elapsed / 1000000.0 << "M/s" <<
+				" (path length " << paths.AveragePathLength() <<
+				", roulette " << (RayTracing::RussianRoulette ? "on" : "off") <<
+				", NEE " << (RayTracing::NextEventEstimation ? "on" : "off") <<
+				", light tree " << (RayTracing::LightTreeSampling ? "on" : "off") << ")\n";
+
+			// How much is denoising costing, for the size of the image?
+			output << "Denoise: ";
+			if (Denoiser::Settings.Enabled)
+				output << Denoiser::Settings.Iterations << " passes" <<
+					(Denoiser::Temporal.Enabled ? " + temporal, " : ", ") << denoiseMs / (windowWidth * windowHeight / 1000000.0) << "ms/MP\n";
+			else
+				output << "off\n";
+
+			// How much of our video memory budget are we using?
+			GPUMemory::Stats memory = GPUMemory::GetStats();
+			AccelerationStructureMemoryStats accelStructMemory = RayTracing::GetAccelerationStructureMemoryStats();
+			output <<
+				"VRAM: " << memory.LocalUsageBytes / (1024 * 1024) << "/" << memory.LocalBudgetBytes / (1024 * 1024) << "MB" <<
+				"    Accel Structs: " << accelStructMemory.TotalBytesBeforeCompaction() / 1024 << "KB -> " << accelStructMemory.TotalBytes() / 1024 << "KB";
+			if (accelStructMemory.PendingReleaseBytes > 0)
+				output << " (+" << accelStructMemory.PendingReleaseBytes / 1024 << "KB pending release)";
+			output << "\n";
+
+			printf("%ls", output.str().c_str());
+		}
 	}
 }
 
@@ -152,10 +240,14 @@ HRESULT Window::Create(
 // Updates the window's title bar with several stats once
 // per second, including:
 //  - The window's width & height
-//  - The current FPS and ms/frame
+//  - The current FPS and frame time percentiles/hitches
+//    over the last second of frames
 //  - The graphics API in use
+// 
+// Everything else is printed to the console at the same
+// time, when detailed stats are on (see SetDetailedStats)
 // --------------------------------------------------------
-void Window::UpdateStats(float totalTime)
+void Window::UpdateStats(float totalTime, FrameStats& frameStats)
 {
 	// Track frame count
 	fpsFrameCounter++;
@@ -165,19 +257,31 @@ void Window::UpdateStats(float totalTime)
 	if (!windowStats || elapsed < 1.0f)
 		return;
 
-	// How long did each frame take?  (Approx)
-	float mspf = 1000.0f / (float)fpsFrameCounter;
+	// How long did the frames in the last second take?
+	FrameStatsSummary frames = frameStats.Summarize((unsigned int)fpsFrameCounter);
 
-	// Quick and dirty title bar text (mostly for debugging)
+	// Quick and dirty title bar text (mostly for debugging), kept
+	// to frame times so it fits in the window's width
 	std::wostringstream output;
-	output.precision(6);
+	output.precision(3);
 	output << windowTitle <<
 		"    Width: " << windowWidth <<
 		"    Height: " << windowHeight <<
 		"    FPS: " << fpsFrameCounter <<
-		"    Frame Time: " << mspf << "ms" <<
+		"    Frame Time (p50/p95/p99/max): " << frames.Total.P50 << "/" << frames.Total.P95 << "/" << frames.Total.P99 << "/" << frames.Total.Max << "ms" <<
+		"    Hitches: " << frames.HitchCount <<
 		"    Graphics: " << Graphics::APIName();
 
+	// Everything else goes to the console, if it's been asked for
+	if (detailedStats)
+		PrintDetailedStats(elapsed);
+
+	// Each of these covers the last second, whether printed or not
+	GPUProfiler::ResetZoneStats();
+	Graphics::ResetFrameSchedulerStats();
+	Graphics::ResetFramePacerStats();
+	RayTracing::ResetPathTracingStats();
+
 	// Actually update the title bar and reset fps data
 	SetWindowText(windowHandle, output.str().c_str());
 	fpsFrameCounter = 0;
@@ -185,6 +289,19 @@ void Window::UpdateStats(float totalTime)
 }
 
 
+// --------------------------------------------------------
+// Turns printing the detailed stats on or off, opening a
+// console to print them to if there isn't one yet
+// --------------------------------------------------------
+void Window::SetDetailedStats(bool enabled)
+{
+	detailedStats = enabled;
+	if (enabled)
+		CreateConsoleWindow(500, 120, 32, 120);
+}
+bool Window::GetDetailedStats() { return detailedStats; }
+
+
 // --------------------------------------------------------
 // Sends an OS-level window close message to our process, which
 // will be handled by our message processing function
@@ -253,6 +370,9 @@ void Window::CreateConsoleWindow(int bufferLines, int bufferColumns, int windowL
 // --------------------------------------------------------
 LRESULT Window::ProcessMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
+	// Let the input system queue anything it needs first
+	Input::ProcessWindowMessage(uMsg, wParam, lParam);
+
 	// Check the incoming message and handle any we care about
 	switch (uMsg)
 	{
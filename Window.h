@@ -3,6 +3,8 @@
 #include <Windows.h>
 #include <string>
 
+#include "FrameStats.h"
+
 namespace Window
 {
 	// Getters
@@ -21,7 +23,9 @@ namespace Window
 		std::wstring titleBarText,
 		bool statsInTitleBar,
 		void (*resizeCallback)());
-	void UpdateStats(float totalTime);
+	void UpdateStats(float totalTime, FrameStats& frameStats);
+	void SetDetailedStats(bool enabled);
+	bool GetDetailedStats();
 	void Quit();
 
 	// Helper function for allocating a console window
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// --------------------------------------------------------
+// A fixed-capacity Chase-Lev work-stealing deque.
+//
+// One owner thread pushes and pops at the bottom (LIFO,
+// which keeps recently pushed work hot in its cache), while
+// any number of other threads steal from the top (FIFO,
+// which tends to hand out the largest remaining chunks).
+// Owner operations only contend with thieves when a single
+// item is left.
+//
+// Items are copied in and out, so T should be small and
+// trivially copyable (typically a pointer).  Capacity must
+// be a power of two.  Push() fails rather than growing when
+// the deque is full.
+//
+// Based on "Correct and Efficient Work-Stealing for Weak
+// Memory Models" (Lê, Pop, Cohen & Zappa Nardelli, 2013).
+// --------------------------------------------------------
+template<typename T, unsigned int Capacity>
+class WorkStealingDeque
+{
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	WorkStealingDeque() : top(0), bottom(0) { }
+
+	// Owner only.  Returns false if the deque is full.
+	bool Push(T item)
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed);
+		int64_t t = top.load(std::memory_order_acquire);
+		if (b - t >= (int64_t)Capacity)
+			return false;
+
+		items[b & Mask].store(item, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Owner only.  Takes the most recently pushed item.
+	bool Pop(T& item)
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+
+		if (t > b)
+		{
+			// Already empty
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		item = items[b & Mask].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			// Last item, so race any thieves for it
+			bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+
+		return true;
+	}
+
+	// Any thread.  Takes the oldest item.  May fail spuriously
+	// when racing another thread, so treat false as "try elsewhere".
+	bool Steal(T& item)
+	{
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = bottom.load(std::memory_order_acquire);
+		if (t >= b)
+			return false;
+
+		item = items[t & Mask].load(std::memory_order_relaxed);
+		return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+	// Approximate when other threads are using the deque
+	unsigned int GetSize() const
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed);
+		int64_t t = top.load(std::memory_order_relaxed);
+		return b > t ? (unsigned int)(b - t) : 0;
+	}
+
+private:
+	static constexpr int64_t Mask = Capacity - 1;
+
+	// Owner and thieves touch opposite ends, so keep
+	// them on separate cache lines
+	alignas(64) std::atomic<int64_t> top;
+	alignas(64) std::atomic<int64_t> bottom;
+	alignas(64) std::atomic<T> items[Capacity];
+};